@@ -18,6 +18,7 @@
 #include "engine/draw.h"
 #include "engine/edit.h"
 #include "engine/components/tiledmap.hpp"
+#include "engine/renderer/texture_atlas.h"
 #include "engine/scripting/lua_wrapper.hpp"
 #include "deps/glad/glad.h"
 
@@ -157,6 +158,9 @@ int assets_perform_hot_reload_changes(Event evt) {
 
     g_assets.changes.len = 0;
 
+    // 重载的纹理换过位置后 整理空闲过多的图集页
+    texture_atlas_compact(&texture_atlas());
+
     return 0;
 }
 
@@ -348,6 +352,21 @@ bool asset_read(u64 key, Asset *out) {
     return true;
 }
 
+bool asset_read_modtime(u64 key, u64 *modtime) {
+    Assets &g_assets = the<Assets>();
+
+    g_assets.rw_lock.shared_lock();
+    neko_defer(g_assets.rw_lock.shared_unlock());
+
+    const Asset *asset = g_assets.table.get(key);
+    if (asset == nullptr) {
+        return false;
+    }
+
+    *modtime = asset->modtime;
+    return true;
+}
+
 void asset_write(Asset asset) {
     Assets &g_assets = the<Assets>();
 
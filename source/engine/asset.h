@@ -62,7 +62,6 @@ typedef struct object_group_t {
 } object_group_t;
 
 typedef struct TiledMap {
-    XMLDoc doc;  // xml doc
     Array<tileset_t> tilesets;
     Array<object_group_t> object_groups;
     Array<layer_t> layers;
@@ -154,6 +153,7 @@ inline void asset_view_each(F&& f) {
 }
 
 bool asset_read(u64 key, Asset* out);
+bool asset_read_modtime(u64 key, u64* modtime);  // 只读取修改时间 不复制资源数据
 void asset_write(Asset asset);
 
 struct lua_State;
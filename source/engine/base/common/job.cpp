@@ -89,6 +89,10 @@ void Job::Wait() {
     }
 }
 
+u32 Job::ThreadCount() { return numThreads; }
+
+void Job::Wake() { wake_cond.notify_all(); }
+
 void Job::Dispatch(u32 job_count, u32 group_size, const std::function<void(JobDispatchArgs)>& job) {
     if (job_count == 0 || group_size == 0) return;
 
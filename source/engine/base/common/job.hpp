@@ -67,6 +67,10 @@ public:
     static bool IsBusy();  // 检查当前是否有任何线程在工作
 
     static void Wait();  // 等待直到所有线程空闲
+
+    static u32 ThreadCount();  // 工作线程数量
+
+    static void Wake();  // 唤醒所有工作线程 不等待 (轮询作业是否完成时使用)
 };
 
 }  // namespace Neko
\ No newline at end of file
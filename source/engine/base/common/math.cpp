@@ -56,6 +56,7 @@ mat3 mat3_identity() { return mat3_diag(1.f); }
 BBox bbox_merge(BBox a, BBox b) { return bbox(luavec2(float_min(a.min.x, b.min.x), float_min(a.min.y, b.min.y)), luavec2(float_max(a.max.x, b.max.x), float_max(a.max.y, b.max.y))); }
 BBox bbox_bound(vec2 a, vec2 b) { return bbox(luavec2(float_min(a.x, b.x), float_min(a.y, b.y)), luavec2(float_max(a.x, b.x), float_max(a.y, b.y))); }
 bool bbox_contains(BBox b, vec2 p) { return b.min.x <= p.x && p.x <= b.max.x && b.min.y <= p.y && p.y <= b.max.y; }
+bool bbox_overlaps(BBox a, BBox b) { return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y; }
 
 BBox bbox(vec2 min, vec2 max) {
     BBox bb;
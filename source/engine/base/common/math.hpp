@@ -964,5 +964,7 @@ BBox bbox_merge(BBox a, BBox b);
 
 bool bbox_contains(BBox b, vec2 p);
 
+bool bbox_overlaps(BBox a, BBox b);  // 边界接触也算重叠
+
 // 返回 bbox 围绕改造后的盒子
 BBox bbox_transform(mat3 m, BBox b);
\ No newline at end of file
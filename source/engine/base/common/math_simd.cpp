@@ -0,0 +1,296 @@
+#include "math_simd.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define NEKO_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define NEKO_SIMD_X86 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NEKO_TARGET_SSE2 __attribute__((target("sse2")))
+#define NEKO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NEKO_TARGET_SSE2
+#define NEKO_TARGET_AVX2
+#endif
+
+// 注意: 为了与标量版本逐位一致
+// 1. 只使用分离的乘法和加法 不使用 FMA
+// 2. 运算顺序与 mat3_mul/mat3_transform 相同 mat3_mul 的累加从 0.0f 开始 (影响 -0.0f 的结果)
+
+// -------------------------------------------------------------------------
+// 标量
+
+static void mat3_mul_batch_scalar(mat3* out, const mat3* a, const mat3* b, u64 n) {
+    for (u64 i = 0; i < n; i++) out[i] = mat3_mul(a[i], b[i]);
+}
+
+static void mat3_mul_batch_left_scalar(mat3* out, mat3 m, const mat3* b, u64 n) {
+    for (u64 i = 0; i < n; i++) out[i] = mat3_mul(m, b[i]);
+}
+
+static void mat3_transform_batch_scalar(vec2* out, mat3 m, const vec2* v, u64 n) {
+    for (u64 i = 0; i < n; i++) out[i] = mat3_transform(m, v[i]);
+}
+
+static void mat3_transform_each_scalar(vec2* out, const mat3* m, const vec2* v, u64 n) {
+    for (u64 i = 0; i < n; i++) out[i] = mat3_transform(m[i], v[i]);
+}
+
+#if NEKO_SIMD_X86
+
+// -------------------------------------------------------------------------
+// SSE2
+
+// 读取 mat3 的三列 第四个分量无意义 第三列不越界读取
+#define SIMD_LOAD_COLS(m, c0, c1, c2)                                           \
+    __m128 c0 = _mm_loadu_ps(&(m).v[0]);                                        \
+    __m128 c1 = _mm_loadu_ps(&(m).v[3]);                                        \
+    __m128 c2 = _mm_loadu_ps(&(m).v[5]);                                        \
+    c2 = _mm_shuffle_ps(c2, c2, _MM_SHUFFLE(3, 3, 2, 1))
+
+NEKO_TARGET_SSE2 static inline __m128 sse_mat3_col(__m128 a0, __m128 a1, __m128 a2, const f32* bcol) {
+    __m128 r = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(a0, _mm_set1_ps(bcol[0])));
+    r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bcol[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bcol[2])));
+    return r;
+}
+
+NEKO_TARGET_SSE2 static inline void sse_mat3_mul(mat3* out, __m128 a0, __m128 a1, __m128 a2, const mat3& b) {
+    alignas(16) f32 tmp[12];
+    __m128 r0 = sse_mat3_col(a0, a1, a2, &b.v[0]);
+    __m128 r1 = sse_mat3_col(a0, a1, a2, &b.v[3]);
+    __m128 r2 = sse_mat3_col(a0, a1, a2, &b.v[6]);
+    _mm_storeu_ps(&tmp[0], r0);
+    _mm_storeu_ps(&tmp[3], r1);
+    _mm_storeu_ps(&tmp[6], r2);
+    memcpy(out->v, tmp, sizeof(f32) * 9);
+}
+
+NEKO_TARGET_SSE2 static void mat3_mul_batch_sse2(mat3* out, const mat3* a, const mat3* b, u64 n) {
+    for (u64 i = 0; i < n; i++) {
+        SIMD_LOAD_COLS(a[i], a0, a1, a2);
+        sse_mat3_mul(&out[i], a0, a1, a2, b[i]);
+    }
+}
+
+NEKO_TARGET_SSE2 static void mat3_mul_batch_left_sse2(mat3* out, mat3 m, const mat3* b, u64 n) {
+    SIMD_LOAD_COLS(m, a0, a1, a2);
+    for (u64 i = 0; i < n; i++) sse_mat3_mul(&out[i], a0, a1, a2, b[i]);
+}
+
+NEKO_TARGET_SSE2 static void mat3_transform_batch_sse2(vec2* out, mat3 m, const vec2* v, u64 n) {
+    const __m128 ma = _mm_setr_ps(m.v[0], m.v[1], m.v[0], m.v[1]);
+    const __m128 mb = _mm_setr_ps(m.v[3], m.v[4], m.v[3], m.v[4]);
+    const __m128 mt = _mm_setr_ps(m.v[6], m.v[7], m.v[6], m.v[7]);
+
+    u64 i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128 p = _mm_loadu_ps(&v[i].x);                         // x0 y0 x1 y1
+        __m128 xx = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));  // x0 x0 x1 x1
+        __m128 yy = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));  // y0 y0 y1 y1
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ma, xx), _mm_mul_ps(mb, yy)), mt);
+        _mm_storeu_ps(&out[i].x, r);
+    }
+    for (; i < n; i++) out[i] = mat3_transform(m, v[i]);
+}
+
+NEKO_TARGET_SSE2 static void mat3_transform_each_sse2(vec2* out, const mat3* m, const vec2* v, u64 n) {
+    for (u64 i = 0; i < n; i++) {
+        SIMD_LOAD_COLS(m[i], c0, c1, c2);
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v[i].x)), _mm_mul_ps(c1, _mm_set1_ps(v[i].y))), c2);
+        _mm_storel_pi((__m64*)&out[i].x, r);
+    }
+}
+
+// -------------------------------------------------------------------------
+// AVX2 每次处理两个矩阵或四个点
+
+NEKO_TARGET_AVX2 static inline __m256 avx_pair(__m128 lo, __m128 hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1); }
+
+NEKO_TARGET_AVX2 static inline __m256 avx_set1_pair(f32 lo, f32 hi) { return avx_pair(_mm_set1_ps(lo), _mm_set1_ps(hi)); }
+
+NEKO_TARGET_AVX2 static inline void avx_mat3_mul2(mat3* out, __m256 a0, __m256 a1, __m256 a2, const mat3& b0, const mat3& b1) {
+    alignas(32) f32 lo[12], hi[12];
+    for (int y = 0; y < 3; y++) {
+        __m256 r = _mm256_add_ps(_mm256_setzero_ps(), _mm256_mul_ps(a0, avx_set1_pair(b0.v[y * 3 + 0], b1.v[y * 3 + 0])));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, avx_set1_pair(b0.v[y * 3 + 1], b1.v[y * 3 + 1])));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, avx_set1_pair(b0.v[y * 3 + 2], b1.v[y * 3 + 2])));
+        _mm_storeu_ps(&lo[y * 3], _mm256_castps256_ps128(r));
+        _mm_storeu_ps(&hi[y * 3], _mm256_extractf128_ps(r, 1));
+    }
+    memcpy(out[0].v, lo, sizeof(f32) * 9);
+    memcpy(out[1].v, hi, sizeof(f32) * 9);
+}
+
+NEKO_TARGET_AVX2 static void mat3_mul_batch_avx2(mat3* out, const mat3* a, const mat3* b, u64 n) {
+    u64 i = 0;
+    for (; i + 2 <= n; i += 2) {
+        SIMD_LOAD_COLS(a[i], x0, x1, x2);
+        SIMD_LOAD_COLS(a[i + 1], y0, y1, y2);
+        avx_mat3_mul2(&out[i], avx_pair(x0, y0), avx_pair(x1, y1), avx_pair(x2, y2), b[i], b[i + 1]);
+    }
+    for (; i < n; i++) out[i] = mat3_mul(a[i], b[i]);
+}
+
+NEKO_TARGET_AVX2 static void mat3_mul_batch_left_avx2(mat3* out, mat3 m, const mat3* b, u64 n) {
+    SIMD_LOAD_COLS(m, c0, c1, c2);
+    __m256 a0 = avx_pair(c0, c0), a1 = avx_pair(c1, c1), a2 = avx_pair(c2, c2);
+    u64 i = 0;
+    for (; i + 2 <= n; i += 2) avx_mat3_mul2(&out[i], a0, a1, a2, b[i], b[i + 1]);
+    for (; i < n; i++) out[i] = mat3_mul(m, b[i]);
+}
+
+NEKO_TARGET_AVX2 static void mat3_transform_batch_avx2(vec2* out, mat3 m, const vec2* v, u64 n) {
+    const __m256 ma = _mm256_setr_ps(m.v[0], m.v[1], m.v[0], m.v[1], m.v[0], m.v[1], m.v[0], m.v[1]);
+    const __m256 mb = _mm256_setr_ps(m.v[3], m.v[4], m.v[3], m.v[4], m.v[3], m.v[4], m.v[3], m.v[4]);
+    const __m256 mt = _mm256_setr_ps(m.v[6], m.v[7], m.v[6], m.v[7], m.v[6], m.v[7], m.v[6], m.v[7]);
+
+    u64 i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 p = _mm256_loadu_ps(&v[i].x);
+        __m256 xx = _mm256_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+        __m256 yy = _mm256_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+        __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ma, xx), _mm256_mul_ps(mb, yy)), mt);
+        _mm256_storeu_ps(&out[i].x, r);
+    }
+    for (; i < n; i++) out[i] = mat3_transform(m, v[i]);
+}
+
+NEKO_TARGET_AVX2 static void mat3_transform_each_avx2(vec2* out, const mat3* m, const vec2* v, u64 n) {
+    u64 i = 0;
+    for (; i + 2 <= n; i += 2) {
+        SIMD_LOAD_COLS(m[i], x0, x1, x2);
+        SIMD_LOAD_COLS(m[i + 1], y0, y1, y2);
+        __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(avx_pair(x0, y0), avx_set1_pair(v[i].x, v[i + 1].x)), _mm256_mul_ps(avx_pair(x1, y1), avx_set1_pair(v[i].y, v[i + 1].y))),
+                                 avx_pair(x2, y2));
+        _mm_storel_pi((__m64*)&out[i].x, _mm256_castps256_ps128(r));
+        _mm_storel_pi((__m64*)&out[i + 1].x, _mm256_extractf128_ps(r, 1));
+    }
+    for (; i < n; i++) out[i] = mat3_transform(m[i], v[i]);
+}
+
+#undef SIMD_LOAD_COLS
+
+// -------------------------------------------------------------------------
+// CPU 检测
+
+static void simd_cpuid(int info[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+    __cpuidex(info, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static u64 simd_xgetbv() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    u32 lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((u64)hi << 32) | lo;
+#endif
+}
+
+static MathSimdLevel simd_cpu_level() {
+    int info[4];
+    simd_cpuid(info, 0, 0);
+    int max_leaf = info[0];
+
+    simd_cpuid(info, 1, 0);
+    bool sse2 = (info[3] >> 26) & 1;
+    bool osxsave = (info[2] >> 27) & 1;
+    bool avx = (info[2] >> 28) & 1;
+    if (!sse2) return MathSimd_Scalar;
+
+    bool avx2 = false;
+    if (max_leaf >= 7 && osxsave && avx && (simd_xgetbv() & 0x6) == 0x6) {  // 系统保存 XMM/YMM 状态
+        simd_cpuid(info, 7, 0);
+        avx2 = (info[1] >> 5) & 1;
+    }
+    return avx2 ? MathSimd_AVX2 : MathSimd_SSE2;
+}
+
+#else
+
+static MathSimdLevel simd_cpu_level() { return MathSimd_Scalar; }
+
+#endif
+
+// -------------------------------------------------------------------------
+
+struct MathSimdKernels {
+    void (*mul)(mat3* out, const mat3* a, const mat3* b, u64 n);
+    void (*mul_left)(mat3* out, mat3 m, const mat3* b, u64 n);
+    void (*transform)(vec2* out, mat3 m, const vec2* v, u64 n);
+    void (*transform_each)(vec2* out, const mat3* m, const vec2* v, u64 n);
+};
+
+static const MathSimdKernels g_simd_kernels[MathSimd_Count] = {
+        {mat3_mul_batch_scalar, mat3_mul_batch_left_scalar, mat3_transform_batch_scalar, mat3_transform_each_scalar},
+#if NEKO_SIMD_X86
+        {mat3_mul_batch_sse2, mat3_mul_batch_left_sse2, mat3_transform_batch_sse2, mat3_transform_each_sse2},
+        {mat3_mul_batch_avx2, mat3_mul_batch_left_avx2, mat3_transform_batch_avx2, mat3_transform_each_avx2},
+#else
+        {mat3_mul_batch_scalar, mat3_mul_batch_left_scalar, mat3_transform_batch_scalar, mat3_transform_each_scalar},
+        {mat3_mul_batch_scalar, mat3_mul_batch_left_scalar, mat3_transform_batch_scalar, mat3_transform_each_scalar},
+#endif
+};
+
+static MathSimdLevel g_simd_cpu = MathSimd_Count;  // MathSimd_Count 表示尚未检测
+static const MathSimdKernels* g_simd = nullptr;
+static MathSimdLevel g_simd_level = MathSimd_Scalar;
+
+MathSimdLevel math_simd_detect() {
+    if (g_simd_cpu == MathSimd_Count) {
+        g_simd_cpu = simd_cpu_level();
+        g_simd_level = g_simd_cpu;
+        g_simd = &g_simd_kernels[g_simd_level];
+    }
+    return g_simd_cpu;
+}
+
+MathSimdLevel math_simd_level() {
+    math_simd_detect();
+    return g_simd_level;
+}
+
+const char* math_simd_level_name(MathSimdLevel level) {
+    switch (level) {
+        case MathSimd_Scalar:
+            return "scalar";
+        case MathSimd_SSE2:
+            return "sse2";
+        case MathSimd_AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+bool math_simd_set_level(MathSimdLevel level) {
+    if (level < MathSimd_Scalar || level > math_simd_detect()) return false;
+    g_simd_level = level;
+    g_simd = &g_simd_kernels[level];
+    return true;
+}
+
+static inline const MathSimdKernels* simd_kernels() {
+    if (!g_simd) math_simd_detect();
+    return g_simd;
+}
+
+void mat3_mul_batch(mat3* out, const mat3* a, const mat3* b, u64 n) { simd_kernels()->mul(out, a, b, n); }
+
+void mat3_mul_batch_left(mat3* out, mat3 m, const mat3* b, u64 n) { simd_kernels()->mul_left(out, m, b, n); }
+
+void mat3_transform_batch(vec2* out, mat3 m, const vec2* v, u64 n) { simd_kernels()->transform(out, m, v, n); }
+
+void mat3_transform_each(vec2* out, const mat3* m, const vec2* v, u64 n) { simd_kernels()->transform_each(out, m, v, n); }
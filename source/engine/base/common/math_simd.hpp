@@ -0,0 +1,34 @@
+#pragma once
+
+#include "base/common/math.hpp"
+
+// mat3 与 2D 仿射变换的批量计算
+// 运行时根据 CPU 选择 AVX2/SSE2/标量 实现
+// 所有实现与对应的单个版本 (mat3_mul mat3_transform ...) 逐位一致
+
+enum MathSimdLevel {
+    MathSimd_Scalar = 0,
+    MathSimd_SSE2,
+    MathSimd_AVX2,
+    MathSimd_Count,
+};
+
+// 首次调用任意批量函数时自动检测
+MathSimdLevel math_simd_detect();
+MathSimdLevel math_simd_level();
+const char* math_simd_level_name(MathSimdLevel level);
+
+// 强制使用某个实现 (用于测试与基准) 超过 CPU 支持时返回 false
+bool math_simd_set_level(MathSimdLevel level);
+
+// out[i] = a[i] * b[i]  out 可以与 a 或 b 相同
+void mat3_mul_batch(mat3* out, const mat3* a, const mat3* b, u64 n);
+
+// out[i] = m * b[i]
+void mat3_mul_batch_left(mat3* out, mat3 m, const mat3* b, u64 n);
+
+// out[i] = mat3_transform(m, v[i])  out 可以与 v 相同
+void mat3_transform_batch(vec2* out, mat3 m, const vec2* v, u64 n);
+
+// out[i] = mat3_transform(m[i], v[i])
+void mat3_transform_each(vec2* out, const mat3* m, const vec2* v, u64 n);
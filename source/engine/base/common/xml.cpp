@@ -280,4 +280,142 @@ XMLNode *XMLNode::FindChild(String name) {
     return NULL;
 }
 
-}  // namespace Neko
\ No newline at end of file
+// -------------------------------------------------------------------------
+
+void XMLReader::Init(String source) {
+    cur = source.data;
+    end = source.data + source.len;
+    name = {};
+    text = {};
+    attributes = {};
+    pending_close = false;
+}
+
+XMLReader::Token XMLReader::Next() {
+    if (pending_close) {
+        pending_close = false;
+        return XMLReader_Close;
+    }
+
+    while (cur < end) {
+        if (*cur != '<') {
+            const_str start = cur;
+            while (cur < end && *cur != '<') cur++;
+
+            // 只有空白的文本跳过
+            const_str a = start, b = cur;
+            while (a < b && is_whitespace(*a)) a++;
+            while (b > a && is_whitespace(b[-1])) b--;
+            if (a == b) continue;
+
+            text = String(a, b - a);
+            return XMLReader_Text;
+        }
+
+        cur++;
+        if (cur >= end) return XMLReader_Error;
+
+        // 声明与处理指令
+        if (*cur == '?') {
+            while (cur < end && *cur != '>') cur++;
+            cur++;
+            continue;
+        }
+
+        // 注释 CDATA 与 DOCTYPE
+        if (*cur == '!') {
+            if (end - cur >= 3 && StringEqualN(cur, 3, "!--")) {
+                cur += 3;
+                while (end - cur >= 3 && !StringEqualN(cur, 3, "-->")) cur++;
+                cur += 3;
+            } else if (end - cur >= 8 && StringEqualN(cur, 8, "![CDATA[")) {
+                const_str start = cur + 8;
+                cur = start;
+                while (end - cur >= 3 && !StringEqualN(cur, 3, "]]>")) cur++;
+                text = String(start, cur - start);
+                cur += 3;
+                return XMLReader_Text;
+            } else {
+                while (cur < end && *cur != '>') cur++;
+                cur++;
+            }
+            continue;
+        }
+
+        bool closing = *cur == '/';
+        if (closing) cur++;
+
+        const_str name_start = cur;
+        while (cur < end && !is_whitespace(*cur) && *cur != '>' && *cur != '/') cur++;
+        name = String(name_start, cur - name_start);
+
+        // 属性原文直到 '>' 跳过引号内的内容
+        const_str attr_start = cur;
+        char quote = 0;
+        while (cur < end && (quote || *cur != '>')) {
+            if (quote) {
+                if (*cur == quote) quote = 0;
+            } else if (*cur == '"' || *cur == '\'') {
+                quote = *cur;
+            }
+            cur++;
+        }
+        if (cur >= end) return XMLReader_Error;
+
+        const_str attr_end = cur;
+        cur++;  // '>'
+
+        if (closing) return XMLReader_Close;
+
+        if (attr_end > attr_start && attr_end[-1] == '/') {
+            attr_end--;
+            pending_close = true;
+        }
+        attributes = String(attr_start, attr_end - attr_start);
+        return XMLReader_Open;
+    }
+
+    return XMLReader_End;
+}
+
+bool XMLReader::Attribute(const_str key, String *raw) {
+    u32 key_len = neko_strlen(key);
+    const_str c = attributes.data;
+    const_str e = attributes.data + attributes.len;
+
+    while (c < e) {
+        while (c < e && is_whitespace(*c)) c++;
+
+        const_str attr_name = c;
+        while (c < e && *c != '=' && !is_whitespace(*c)) c++;
+        u32 attr_name_len = (u32)(c - attr_name);
+
+        while (c < e && *c != '"' && *c != '\'') c++;
+        if (c >= e) return false;
+
+        char quote = *c++;
+        const_str value = c;
+        while (c < e && *c != quote) c++;
+
+        if (attr_name_len == key_len && StringEqualN(attr_name, key_len, key)) {
+            *raw = String(value, c - value);
+            return true;
+        }
+        c++;
+    }
+    return false;
+}
+
+double XMLReader::AttributeNumber(const_str key, double def) {
+    String raw = {};
+    if (!Attribute(key, &raw) || raw.len == 0) return def;
+    return strtod(raw.data, NULL);
+}
+
+String XMLReader::AttributeCopy(const_str key, const_str def) {
+    String raw = {};
+    if (!Attribute(key, &raw)) raw = String(def);
+    return XMLDoc::ProcessText(raw.data, (u32)raw.len);
+}
+
+}  // namespace Neko
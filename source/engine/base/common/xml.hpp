@@ -101,4 +101,31 @@ struct XMLNode {
     void Trash();
 };
 
+// 单遍流式读取 不建立节点树 不分配内存
+// 名字 文本与属性都指向源文本 (实体未解码) 源文本需在读取期间保持有效
+struct XMLReader {
+    enum Token {
+        XMLReader_End,
+        XMLReader_Open,   // 开始标签 name/attributes 有效
+        XMLReader_Close,  // 结束标签 name 有效 自闭合标签也会产生一次
+        XMLReader_Text,   // 标签之间的非空白文本 text 有效
+        XMLReader_Error,
+    };
+
+    const_str cur;
+    const_str end;
+
+    String name;
+    String text;
+    String attributes;  // 当前开始标签的属性原文
+    bool pending_close;
+
+    void Init(String source);
+    Token Next();
+
+    bool Attribute(const_str key, String* raw);  // 原文 不含引号
+    double AttributeNumber(const_str key, double def = 0);
+    String AttributeCopy(const_str key, const_str def);  // 解码实体后复制 需 mem_free
+};
+
 }  // namespace Neko
\ No newline at end of file
@@ -28,9 +28,14 @@
 #include "engine/components/edit.h"
 #include "engine/components/sprite.h"
 #include "engine/components/rectangle.h"
+#include "engine/components/spatial.h"
 #include "engine/components/tiledmap.hpp"
+#include "engine/components/pathfind.h"
 #include "engine/components/transform.h"
 #include "engine/base/common/job.hpp"
+#include "engine/renderer/render_graph.h"
+#include "engine/renderer/gfx_null.h"
+#include "engine/renderer/texture_atlas.h"
 
 CBase gBase;
 
@@ -40,6 +45,12 @@ PostProcessor posteffect_blur_h;
 PostProcessor posteffect_blur_v;
 PostProcessor posteffect_composite;
 
+// 后处理的目标都从 post_graph 的池中分配
+RenderGraph post_graph;
+RenderResourceId post_bloom = RenderResource_None;
+RenderResourceId post_vignette = RenderResource_None;
+i32 post_graph_downsample = -1;
+
 Asset sprite_shader{};
 Asset cloud_shader{};
 Asset grass_shader{};
@@ -53,6 +64,46 @@ AssetTexture grass_texture;
 
 extern void draw_gui();
 
+static void post_vignette_setup(AssetShader &shader, void *user) {
+    CL::State &state = *(CL::State *)user;
+    neko_shader_set_float(shader.id, "intensity", state.posteffect_intensity);
+    neko_shader_set_int(shader.id, "enable", 1);
+}
+
+static void post_composite_setup(AssetShader &shader, void *user) {
+    CL::State &state = *(CL::State *)user;
+    neko_shader_set_float(shader.id, "u_exposure", state.posteffect_exposure);
+    neko_shader_set_float(shader.id, "u_gamma", state.posteffect_gamma);
+    neko_shader_set_float(shader.id, "u_bloom_scalar", state.posteffect_bloom_scalar);
+    neko_shader_set_float(shader.id, "u_saturation", state.posteffect_saturation);
+    neko_shader_set_float(shader.id, "chromatic_start", state.posteffect_chromatic_start);
+    neko_shader_set_float(shader.id, "chromatic_rOffset", state.posteffect_chromatic_rOffset);
+    neko_shader_set_float(shader.id, "chromatic_gOffset", state.posteffect_chromatic_gOffset);
+    neko_shader_set_float(shader.id, "chromatic_bOffset", state.posteffect_chromatic_bOffset);
+    neko_shader_set_int(shader.id, "u_blur_tex", 1);
+}
+
+// bloom 链路可以降采样 (0 全分辨率 1 一半 2 四分之一) 复合前只保留场景 暗角 bloom 三个目标中的两个
+static void post_graph_build(CL::State *state, RenderTarget *scene) {
+    u32 shift = (u32)NEKO_MAX(state->posteffect_bloom_downsample, 0);
+
+    render_graph_reset(&post_graph);
+    RenderResourceId source = render_graph_import(&post_graph, "scene", scene);
+    RenderResourceId bright = render_graph_transient(&post_graph, "bright", shift);
+    RenderResourceId blur_h = render_graph_transient(&post_graph, "blur_h", shift);
+    post_bloom = render_graph_transient(&post_graph, "bloom", shift);
+    post_vignette = render_graph_transient(&post_graph, "vignette");
+
+    render_graph_pass(&post_graph, "bright", &posteffect_bright, source, RenderResource_None, bright);
+    render_graph_pass(&post_graph, "blur_h", &posteffect_blur_h, bright, RenderResource_None, blur_h);
+    render_graph_pass(&post_graph, "blur_v", &posteffect_blur_v, blur_h, RenderResource_None, post_bloom);
+    render_graph_pass(&post_graph, "vignette", &posteffect_vignette, source, RenderResource_None, post_vignette, post_vignette_setup, state);
+    render_graph_pass(&post_graph, "composite", &posteffect_composite, post_vignette, post_bloom, RenderResource_Screen, post_composite_setup, state);
+    render_graph_compile(&post_graph);
+
+    post_graph_downsample = state->posteffect_bloom_downsample;
+}
+
 // -------------------------------------------------------------------------
 
 // 窗口大小改变的回调函数
@@ -63,11 +114,6 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
 
     if (CLGame.renderview_source.valid()) {
         CLGame.renderview_source.resize(width, height);
-        posteffect_vignette.Resize(neko_v2(width, height));
-        posteffect_bright.Resize(neko_v2(width, height));
-        posteffect_blur_h.Resize(neko_v2(width, height));
-        posteffect_blur_v.Resize(neko_v2(width, height));
-        posteffect_composite.Resize(neko_v2(width, height));
         quadrenderer.renderer_resize(neko_v2(width, height));
     }
 
@@ -94,6 +140,9 @@ void CL::game_draw() {
     lua_pushnumber(L, GetTimeInfo().delta);
     luax_pcall(L, 1, 0);
 
+    // NekoFrame 每帧只更新一次
+    the<Renderer>().UpdateFrameConstants(the<Camera>().GetInverseViewMatrix(), neko_v2(state.width, state.height), timing_get_elapsed() / 1000.f);
+
     if (!gBase.error_mode.load()) {
 
         glEnable(GL_BLEND);
@@ -116,17 +165,14 @@ void CL::game_draw() {
                 the<RectangleBox>().immediate_push(grass_ent);
                 the<RectangleBox>().immediate_draw(assets_get<AssetShader>(grass_shader), [&]() {
                     GLuint sid = assets_get<AssetShader>(grass_shader).id;
-                    neko_shader_set_float(sid, "u_time", the<CL>().timing_get_elapsed() / 8000.f);
-
-                    neko_shader_set_v2f(sid, "NekoScreenSize", neko_v2(state.width, state.height));
 
                     // 设置草尖颜色
-                    glUniform4f(glGetUniformLocation(sid, "uTipColor"), 0.6f, 0.9f, 0.3f, 1.0f);
+                    glUniform4f(neko_shader_uniform(sid, "uTipColor"), 0.6f, 0.9f, 0.3f, 1.0f);
 
                     // 设置风吹颜色
-                    glUniform4f(glGetUniformLocation(sid, "uWindColor"), 0.3f, 0.5f, 0.4f, 1.0f);
+                    glUniform4f(neko_shader_uniform(sid, "uWindColor"), 0.3f, 0.5f, 0.4f, 1.0f);
 
-                    glUniform1i(glGetUniformLocation(sid, "tex0"), 0);
+                    glUniform1i(neko_shader_uniform(sid, "tex0"), 0);
 
                     texture_bind(grass_texture.id, 0);
                 });
@@ -141,10 +187,7 @@ void CL::game_draw() {
                 the<RectangleBox>().immediate_push(cloud_ent);
                 the<RectangleBox>().immediate_draw(assets_get<AssetShader>(cloud_shader), [&]() {
                     GLuint sid = assets_get<AssetShader>(cloud_shader).id;
-                    neko_shader_set_float(sid, "u_time", the<CL>().timing_get_elapsed() / 8000.f);
                     neko_shader_set_v3f(sid, "u_groundColor", neko_v3(0.1, 0.1, 0.1));
-
-                    neko_shader_set_v2f(sid, "NekoScreenSize", neko_v2(state.width, state.height));
                 });
             }
 
@@ -159,37 +202,8 @@ void CL::game_draw() {
 
         if (!edit_get_enabled()) [[likely]] {
 
-            posteffect_blur_h.GetRenderTarget().bind();
-            posteffect_bright.FlushTarget(renderview_source, [](auto &shader) {});
-            posteffect_blur_h.GetRenderTarget().unbind();
-
-            posteffect_blur_v.GetRenderTarget().bind();
-            posteffect_blur_h.Flush([](auto &shader) {});
-            posteffect_blur_v.GetRenderTarget().unbind();
-
-            posteffect_blur_v.Flush([](auto &shader) {});
-
-            posteffect_composite.GetRenderTarget().bind();
-            posteffect_vignette.FlushTarget(renderview_source, [&](auto &shader) {
-                neko_shader_set_float(shader.id, "intensity", state.posteffect_intensity);
-                neko_shader_set_int(shader.id, "enable", 1);
-            });
-            posteffect_composite.GetRenderTarget().unbind();
-
-            posteffect_composite.Flush([&](auto &shader) {
-                neko_shader_set_float(shader.id, "u_exposure", state.posteffect_exposure);
-                neko_shader_set_float(shader.id, "u_gamma", state.posteffect_gamma);
-                neko_shader_set_float(shader.id, "u_bloom_scalar", state.posteffect_bloom_scalar);
-                neko_shader_set_float(shader.id, "u_saturation", state.posteffect_saturation);
-                neko_shader_set_float(shader.id, "chromatic_start", state.posteffect_chromatic_start);
-                neko_shader_set_float(shader.id, "chromatic_rOffset", state.posteffect_chromatic_rOffset);
-                neko_shader_set_float(shader.id, "chromatic_gOffset", state.posteffect_chromatic_gOffset);
-                neko_shader_set_float(shader.id, "chromatic_bOffset", state.posteffect_chromatic_bOffset);
-                neko_shader_set_int(shader.id, "u_blur_tex", 1);
-
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, posteffect_blur_v.GetRenderTarget().output);
-            });
+            if (post_graph_downsample != state.posteffect_bloom_downsample) post_graph_build(&state, &renderview_source);
+            render_graph_execute(&post_graph, state.width, state.height);
 
             {
                 ImGuiIO &io = ImGui::GetIO();
@@ -211,7 +225,7 @@ void CL::game_draw() {
 
                 // NEKO_INVOKE_ONCE(quadrenderer.renderer_push_light(light{.position = {100, 100}, .range = 1000.0f, .intensity = 20.0f}););
 
-                quadrenderer.renderer_flush();
+                quadrenderer.renderer_end_frame();
 
                 f32 fy = draw_font(default_font, false, 16.f, screenSize.x - 180.f, 20.f, "Neko build " __DATE__, NEKO_COLOR_WHITE);
 
@@ -271,7 +285,8 @@ void CL::game_draw() {
                 float viewportAspectRatio = state.width / state.height;
                 float scale = std::min(contentSize.x / state.width, contentSize.y / state.height);
 
-                ImGui::Image((ImTextureID)currentRenderViewSource.rt->output, ImVec2(state.width * scale, state.height * scale), ImVec2(0, 1), ImVec2(1, 0));
+                RenderTarget *view_rt = currentRenderViewSource.rt ? currentRenderViewSource.rt : render_graph_target(&post_graph, currentRenderViewSource.resource);
+                ImGui::Image((ImTextureID)(view_rt ? view_rt->output : 0), ImVec2(state.width * scale, state.height * scale), ImVec2(0, 1), ImVec2(1, 0));
 
                 bool on_hovered = ImGui::IsItemHovered();
                 auto &editor = the<Editor>();
@@ -344,6 +359,8 @@ void CL::game_draw() {
 
     the<ImGuiRender>().imgui_draw_post();
 
+    gfx_frame_end();
+
     window->SwapBuffer();
 }
 
@@ -475,6 +492,8 @@ void CL::init() {
     struct_foreach_luatable(ENGINE_LUA(), "app", v);
     state = v;
 
+    texture_atlas().enabled = state.texture_atlas;
+
     LOG_INFO("load game: {} {} {}", state.title.cstr(), state.width, state.height);
 
     lua_pop(L, 1);  // conf table
@@ -510,6 +529,7 @@ void CL::init() {
 
         the<Entity>().entity_init();
         the<Transform>().transform_init();
+        the<Spatial>().spatial_init();
         the<Camera>().camera_init();
 
         {
@@ -517,6 +537,7 @@ void CL::init() {
             the<Sprite>().sprite_init();
             the<RectangleBox>().init();
             the<Tiled>().tiled_init();
+            the<PathService>().path_init();
             the<Font>().font_init();
             the<ImGuiRender>().imgui_init();
             the<Editor>().edit_init();
@@ -642,6 +663,7 @@ void CL::init() {
                  return 0;
              }},
             {EventMask::Update, [](Event evt) -> int { return the<Transform>().transform_update_all(evt); }},
+            {EventMask::Update, [](Event evt) -> int { return the<Spatial>().spatial_update_all(evt); }},
 
             {EventMask::Update, [](Event evt) -> int { return the<Camera>().camera_update_all(evt); }},
             {EventMask::Update, [](Event evt) -> int { return the<Sprite>().sprite_update_all(evt); }},
@@ -649,6 +671,7 @@ void CL::init() {
             {EventMask::Update, [](Event evt) -> int { return the<Batch>().batch_update_all(evt); }},
             {EventMask::Update, [](Event evt) -> int { return the<Sound>().OnUpdate(evt); }},
             {EventMask::Update, [](Event evt) -> int { return the<Tiled>().tiled_update_all(evt); }},
+            {EventMask::Update, [](Event evt) -> int { return the<PathService>().path_update_all(evt); }},
             {EventMask::Update, [](Event evt) -> int { return the<Editor>().OnUpdate(evt); }},
 
             {EventMask::PostUpdate,
@@ -675,9 +698,10 @@ void CL::init() {
 
     posteffect_vignette.create("@code/game/shader/post_vignette.glsl", false);
     posteffect_bright.create("@code/game/shader/post_bright.glsl", false);
-    posteffect_blur_h.create("@code/game/shader/post_blur_h.glsl");
-    posteffect_blur_v.create("@code/game/shader/post_blur_v.glsl");
-    posteffect_composite.create("@code/game/shader/post_composite.glsl");
+    posteffect_blur_h.create("@code/game/shader/post_blur_h.glsl", false);
+    posteffect_blur_v.create("@code/game/shader/post_blur_v.glsl", false);
+    posteffect_composite.create("@code/game/shader/post_composite.glsl", false);
+    post_graph_build(&state, &renderview_source);
 
     bool ok = asset_load_kind(AssetKind_Shader, "@code/game/shader/sprite2.glsl", &sprite_shader);
     error_assert(ok);
@@ -685,9 +709,9 @@ void CL::init() {
     quadrenderer.new_renderer(assets_get<AssetShader>(sprite_shader), neko_v2(state.width, state.height));
 
     renderview_sources = {
-            {&renderview_source, "Editor View"},                                //
-            {&posteffect_blur_v.GetRenderTarget(), "posteffect_blur"},          //
-            {&posteffect_composite.GetRenderTarget(), "posteffect_composite"},  //
+            {&renderview_source, "Editor View"},                      //
+            {nullptr, "posteffect_blur", post_bloom},                 //
+            {nullptr, "posteffect_composite", post_vignette},         //
     };
 
     {
@@ -733,6 +757,7 @@ void CL::fini() {
 
     renderview_source.release();
 
+    render_graph_trash(&post_graph);
     posteffect_composite.release();
     posteffect_blur_h.release();
     posteffect_blur_v.release();
@@ -740,6 +765,7 @@ void CL::fini() {
     posteffect_vignette.release();
 
     quadrenderer.free_renderer();
+    the<Renderer>().FiniOpenGL();
 
     bool dump_allocs_detailed = state.dump_allocs_detailed;
 
@@ -753,11 +779,13 @@ void CL::fini() {
     the<Editor>().edit_fini();
     the<Scripting>().script_fini();
     the<Sound>().sound_fini();
+    the<PathService>().path_fini();
     the<Tiled>().tiled_fini();
     the<Sprite>().sprite_fini();
     the<RectangleBox>().fini();
     the<Batch>().batch_fini();
     the<Camera>().camera_fini();
+    the<Spatial>().spatial_fini();
     the<Transform>().transform_fini();
     the<Entity>().entity_fini();
     the<ImGuiRender>().imgui_fini();
@@ -782,6 +810,9 @@ void CL::fini() {
         assets_shutdown();
     }
 
+    // 空后端最后卸载 之前的释放仍通过它调用 GL
+    if (gfx_backend() == GfxBackend_Null) gfx_null_uninstall();
+
     // fini glfw
     glfwDestroyWindow(window->glfwWindow());
     glfwTerminate();
@@ -870,7 +901,15 @@ Int32 Main(int argc, const char *argv[]) {
     bool ok = true;
     gBase.Init(argc, argv);
 
+    // --gfx=null 不需要 GPU 的空图形后端 用于无显示设备的机器上测量与测试
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--gfx=null") == 0) gfx_set_backend(GfxBackend_Null);
+    }
+
     glfwSetErrorCallback(_glfw_error_callback);
+#if defined(GLFW_PLATFORM_NULL)
+    if (gfx_backend() == GfxBackend_Null) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
     if (!glfwInit()) {
         ok = false;
     }
@@ -39,6 +39,7 @@ struct Inspector;
 struct RenderViewSource {
     RenderTarget *rt;
     String name;
+    i32 resource = -1;  // rt 为空时从后处理图中取 见 render_graph_target
 };
 
 class CL : public Neko::SingletonClass<CL> {
@@ -86,6 +87,7 @@ public:
         f32 swap_interval;
         f32 target_fps;
         i32 batch_vertex_capacity;
+        bool texture_atlas = true;  // 小纹理放入共享的图集页
         bool dump_allocs_detailed;
         f32 width;
         f32 height;
@@ -99,6 +101,7 @@ public:
         f32 posteffect_chromatic_rOffset = 0.001f;
         f32 posteffect_chromatic_gOffset = 0.001f;
         f32 posteffect_chromatic_bOffset = -0.001f;
+        i32 posteffect_bloom_downsample = 1;  // bloom 链路的分辨率 0 全 1 一半 2 四分之一
     } state{};
 
     int currentRenderViewIndex = 0;
@@ -168,6 +171,7 @@ _Fs(reload_interval,""),
 _Fs(swap_interval,""),
 _Fs(target_fps,""),
 _Fs(batch_vertex_capacity,""),
+_Fs(texture_atlas,""),
 _Fs(posteffect_intensity,""),
 _Fs(posteffect_exposure,""),
 _Fs(posteffect_gamma,""),
@@ -176,7 +180,8 @@ _Fs(posteffect_saturation,""),
 _Fs(posteffect_chromatic_start,""),
 _Fs(posteffect_chromatic_rOffset,""),
 _Fs(posteffect_chromatic_gOffset,""),
-_Fs(posteffect_chromatic_bOffset,"")
+_Fs(posteffect_chromatic_bOffset,""),
+_Fs(posteffect_bloom_downsample,"")
 );
 
 // clang-format on
@@ -5,11 +5,12 @@
 #include "engine/base.hpp"
 #include "base/common/color.hpp"
 #include "engine/ecs/entity.h"
+#include "engine/ecs/snapshot.h"
 #include "engine/graphics.h"
 #include "engine/input.h"
 
 template <typename T>
-class ComponentTypeBase {
+class ComponentTypeBase : public SnapshotSection {
 protected:
     int Tid;
     CEntityPool<T>* EntityPool;
@@ -19,6 +20,8 @@ public:
         auto L = ENGINE_LUA();
         ComponentTypeBase::Tid = EcsRegisterCType<T>(L);
         ComponentTypeBase::EntityPool = EcsProtoGetCType<T>(L);
+        entitypool_subscribe_destroyed(ComponentTypeBase::EntityPool);
+        snapshot_register(this);
     }
 
     inline int GetTid() const { return Tid; };
@@ -44,6 +47,34 @@ public:
 
         return ptr;
     }
+
+    // 快照 子类覆盖 SnapshotSave/SnapshotLoad 并让 SnapshotEnabled 返回 true 即可参与世界快照
+    virtual void SnapshotSave(T* elem, SnapshotWriter& w) {}
+    virtual void SnapshotLoad(T* elem, SnapshotReader& r) {}
+
+    const_str SnapshotName() override { return reflection::GetTypeName<T>(); }
+
+    void SnapshotSaveAll(SnapshotWriter& w, u32* count) override {
+        for (T& elem : ComponentTypeBase::EntityPool->array) {
+            w.put<u32>(elem.ent.id);
+            u64 at = w.reserve_u32();
+            u64 start = w.buf.len;
+            SnapshotSave(&elem, w);
+            w.patch_u32(at, (u32)(w.buf.len - start));
+            ++*count;
+        }
+    }
+
+    void SnapshotLoadBegin() override { entitypool_clear(ComponentTypeBase::EntityPool); }
+
+    void SnapshotLoadRecord(CEntity ent, SnapshotReader& r) override {
+        T* elem = ComponentTypeBase::EntityPool->Add(ent);
+        SnapshotLoad(elem, r);
+    }
+
+    void SnapshotLoadEnd() override {}
+
+    void* SnapshotGetElem(CEntity ent) override { return ComponentTypeBase::EntityPool->GetPtr(ent); }
 };
 
 #endif
@@ -8,6 +8,7 @@
 #include "engine/editor.h"
 #include "engine/scripting/lua_util.h"
 #include "engine/components/transform.h"
+#include "engine/components/spatial.h"
 
 // -------------------------------------------------------------------------
 
@@ -21,6 +22,9 @@ CCamera *Camera::ComponentAdd(CEntity ent) {
     camera = ComponentTypeBase::EntityPool->Add(ent);
     camera->viewport_height = 1.0;
 
+    // 视口为 ±1 由变换的缩放决定实际大小
+    the<Spatial>().spatial_set_bounds(ent, bbox(luavec2(-1, -1), luavec2(1, 1)));
+
     if (CEntityEq(curr_camera, entity_nil)) {
         curr_camera = ent;
     }
@@ -90,6 +94,8 @@ vec2 Camera::camera_world_to_unit(vec2 p) {
     return mat3_transform(the<Camera>().inverse_view_matrix, p);
 }
 
+BBox Camera::camera_view_bounds(mat3 inverse_view) { return bbox_transform(mat3_inverse(inverse_view), bbox(luavec2(-1, -1), luavec2(1, 1))); }
+
 vec2 Camera::camera_pixels_to_world(vec2 p) { return camera_unit_to_world(Neko::the<CL>().pixels_to_unit(p)); }
 
 vec2 Camera::camera_unit_to_world(vec2 p) {
@@ -113,6 +119,9 @@ void Camera::camera_init() {
     curr_camera = entity_nil;
     edit_camera = entity_nil;
     inverse_view_matrix = mat3_identity();
+    view_bounds = camera_view_bounds(inverse_view_matrix);
+    cull_enabled = true;
+    cull_stats = {};
 
     // clang-format off
 
@@ -166,30 +175,12 @@ int Camera::camera_update_all(Event evt) {
         inverse_view_matrix = mat3_inverse(the<Transform>().transform_get_world_matrix(cam));
     }
 
-    return 0;
-}
-
-void camera_save_all(CL *app) {
-    // Store *t, *camera_s;
-    // CCamera *camera;
+    view_bounds = camera_view_bounds(inverse_view_matrix);
+    cull_stats = {};
 
-    // if (store_child_save(&t, "camera", s)) {
-    //     if (entity_get_save_filter(curr_camera)) entity_save(&curr_camera, "curr_camera", t);
-
-    //     mat3_save(&inverse_view_matrix, "inverse_view_matrix", t);
-
-    //     entitypool_save_foreach(camera, camera_s, ComponentTypeBase::EntityPool, "pool", t) float_save(&camera->viewport_height, "viewport_height", camera_s);
-    // }
+    return 0;
 }
-void camera_load_all(CL *app) {
-    // Store *t, *camera_s;
-    // CCamera *camera;
 
-    // if (store_child_load(&t, "camera", s)) {
-    //     entity_load(&curr_camera, "curr_camera", curr_camera, t);
+void Camera::SnapshotSave(CCamera *camera, SnapshotWriter &w) { w.put(camera->viewport_height); }
 
-    //     mat3_load(&inverse_view_matrix, "inverse_view_matrix", mat3_identity(), t);
-
-    //     entitypool_load_foreach(camera, camera_s, ComponentTypeBase::EntityPool, "pool", t) float_load(&camera->viewport_height, "viewport_height", 1, camera_s);
-    // }
-}
+void Camera::SnapshotLoad(CCamera *camera, SnapshotReader &r) { camera->viewport_height = r.get<f32>(); }
@@ -10,12 +10,22 @@ struct CCamera : CEntityBase {
 
 static_assert(std::is_trivially_copyable_v<CCamera>);
 
+// 每帧的剔除统计 在 camera_update_all 中清零
+struct CameraCullStats {
+    u32 sprites, sprites_visible;
+    u32 rects, rects_visible;
+    u32 tiles, tiles_visible;  // 图块按区块剔除
+};
+
 class Camera : public SingletonClass<Camera>, public ComponentTypeBase<CCamera> {
 private:
     CEntity curr_camera;
     CEntity edit_camera;
 
     mat3 inverse_view_matrix;  // 缓存逆视图矩阵
+    BBox view_bounds;          // 当前摄像机可见的世界范围 每帧由逆视图矩阵计算一次
+    bool cull_enabled;
+    CameraCullStats cull_stats;
 
 public:
     void camera_init();
@@ -45,5 +55,17 @@ public:
 
     inline const mat3 *GetInverseViewMatrixPtr() { return &inverse_view_matrix; }  // for quick GLSL binding
 
+    // 视图剔除 关闭时所有包围盒都可见
+    static BBox camera_view_bounds(mat3 inverse_view);  // 单位视图框 [-1, 1] 在世界中的包围盒
+    BBox camera_get_view_bounds() { return view_bounds; }
+    bool camera_visible(BBox world) { return !cull_enabled || bbox_overlaps(view_bounds, world); }
+    void camera_set_culling(bool enabled) { cull_enabled = enabled; }
+    bool camera_get_culling() { return cull_enabled; }
+    CameraCullStats &camera_get_cull_stats() { return cull_stats; }
+
     int Inspect(CEntity ent) override;
+
+    bool SnapshotEnabled() override { return true; }
+    void SnapshotSave(CCamera *camera, SnapshotWriter &w) override;
+    void SnapshotLoad(CCamera *camera, SnapshotReader &r) override;
 };
\ No newline at end of file
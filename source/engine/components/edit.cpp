@@ -134,10 +134,9 @@ static void _bboxes_draw_all() {
     GLuint sid = assets_get<AssetShader>(bboxes_shader).id;
 
     glUseProgram(sid);
-    glUniformMatrix3fv(glGetUniformLocation(sid, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat*)the<Camera>().GetInverseViewMatrixPtr());
     win = Neko::the<CL>().get_window_size();
-    glUniform1f(glGetUniformLocation(sid, "aspect"), win.x / win.y);
-    glUniform1f(glGetUniformLocation(sid, "is_grid"), 0);
+    glUniform1f(neko_shader_uniform(sid, "aspect"), win.x / win.y);
+    glUniform1f(neko_shader_uniform(sid, "is_grid"), 0);
 
     glBindVertexArray(bboxes_vao);
     glBindBuffer(GL_ARRAY_BUFFER, bboxes_vbo);
@@ -215,10 +214,9 @@ static void _grid_draw() {
     GLuint sid = assets_get<AssetShader>(bboxes_shader).id;
 
     glUseProgram(sid);
-    glUniformMatrix3fv(glGetUniformLocation(sid, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat*)the<Camera>().GetInverseViewMatrixPtr());
     win = Neko::the<CL>().get_window_size();
-    glUniform1f(glGetUniformLocation(sid, "aspect"), win.x / win.y);
-    glUniform1f(glGetUniformLocation(sid, "is_grid"), 1);
+    glUniform1f(neko_shader_uniform(sid, "aspect"), win.x / win.y);
+    glUniform1f(neko_shader_uniform(sid, "is_grid"), 1);
 
     _grid_create_cells();
     glBindVertexArray(bboxes_vao);
@@ -286,7 +284,7 @@ static void _line_draw_all() {
 
     // bind program, update uniforms
     glUseProgram(sid);
-    GLuint inverse_view_matrix_id = glGetUniformLocation(sid, "inverse_view_matrix");
+    GLuint inverse_view_matrix_id = neko_shader_uniform(sid, "inverse_view_matrix");
     glUniformMatrix3fv(inverse_view_matrix_id, 1, GL_FALSE, (const GLfloat*)mat);
 
     // draw!
@@ -335,6 +333,7 @@ bool edit_get_enabled() { return the<Editor>().get_enable(); }
 void edit_init_impl(lua_State* L) {
     type_uneditable = EcsRegisterCType<CUnEditable>(L);
     uneditable__pool = EcsProtoGetCType<CUnEditable>(L);
+    entitypool_subscribe_destroyed(uneditable__pool);
 
     _bboxes_init();
     _grid_init();
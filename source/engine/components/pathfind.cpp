@@ -0,0 +1,445 @@
+#include "pathfind.h"
+
+#include "base/common/job.hpp"
+#include "base/common/os.hpp"
+#include "base/common/profiler.hpp"
+#include "engine/bootstrap.h"
+#include "engine/scripting/lua_util.h"
+#include "engine/scripting/lua_wrapper.hpp"
+
+#define PATH_TICKET_SLOT_MASK ((1u << PATH_TICKET_SLOT_BITS) - 1)
+#define PATH_TICKET_GEN_MASK ((1u << (32 - PATH_TICKET_SLOT_BITS)) - 1)
+
+#define PATH_DEFAULT_BUDGET_MS 2.0f
+#define PATH_DEFAULT_QUERY_MS 0.1f  // 还没有测量时的估计
+
+PathSlot* PathService::Slot(PathTicket ticket) {
+    u32 index = ticket & PATH_TICKET_SLOT_MASK;
+    if (ticket == 0 || index >= slots.len) return nullptr;
+    PathSlot* slot = &slots[index];
+    if (slot->status == PathQuery_Invalid || slot->gen != ticket >> PATH_TICKET_SLOT_BITS) return nullptr;
+    return slot;
+}
+
+void PathService::Release(PathTicket ticket) {
+    u32 index = ticket & PATH_TICKET_SLOT_MASK;
+    PathSlot* slot = &slots[index];
+    slot->status = PathQuery_Invalid;
+    slot->path.len = 0;  // 保留容量 给下一个查询
+    free_slots.push(index);
+}
+
+// -------------------------------------------------------------------------
+
+PathTicket PathService::path_submit(TileGridSnapshot* snapshot, i32 sx, i32 sy, i32 ex, i32 ey, TileGridMode mode) {
+    if (snapshot == nullptr) return 0;
+
+    u32 index;
+    if (free_slots.len > 0) {
+        index = free_slots[--free_slots.len];
+    } else {
+        index = (u32)slots.len;
+        error_assert(index <= PATH_TICKET_SLOT_MASK, "too many path queries in flight");
+        slots.push(PathSlot{});
+    }
+
+    PathSlot* slot = &slots[index];
+    slot->gen = (slot->gen + 1) & PATH_TICKET_GEN_MASK;
+    if (slot->gen == 0) slot->gen = 1;  // 保证票据不为 0
+    slot->status = PathQuery_Pending;
+    slot->cell_size = snapshot->cell_size;
+
+    PathQuery q = {};
+    q.ticket = (slot->gen << PATH_TICKET_SLOT_BITS) | index;
+    q.snapshot = snapshot;
+    q.sx = sx;
+    q.sy = sy;
+    q.ex = ex;
+    q.ey = ey;
+    q.mode = mode;
+    tile_grid_snapshot_retain(snapshot);
+    pending.push(q);
+
+    stats.submitted++;
+    return q.ticket;
+}
+
+PathQueryStatus PathService::path_status(PathTicket ticket) {
+    PathSlot* slot = Slot(ticket);
+    return slot ? slot->status : PathQuery_Invalid;
+}
+
+PathQueryStatus PathService::path_take(PathTicket ticket, Array<TilePoint>* out, f32* cell_size) {
+    PathSlot* slot = Slot(ticket);
+    if (slot == nullptr) return PathQuery_Invalid;
+
+    PathQueryStatus status = slot->status;
+    if (status == PathQuery_Pending) return status;
+
+    out->len = 0;
+    out->reserve(slot->path.len);
+    for (TilePoint p : slot->path) out->push(p);
+    if (cell_size) *cell_size = slot->cell_size;
+
+    Release(ticket);
+    return status;
+}
+
+void PathService::path_cancel(PathTicket ticket) {
+    // 还在队列或作业线程上的查询在派发/交付时丢弃
+    if (Slot(ticket)) Release(ticket);
+}
+
+// -------------------------------------------------------------------------
+
+void PathService::Collect() {
+    if (batch.len == 0 || batch_done.load(std::memory_order_acquire) < batch.len) return;
+
+    PROFILE_FUNC();
+
+    // 平均耗时取指数滑动平均 用于计算下一批的大小
+    f32 ms = (f32)(TimeUtil::to_milliseconds(batch_ticks.load()) / batch.len);
+    query_ms = query_ms > 0 ? query_ms * 0.75f + ms * 0.25f : ms;
+
+    for (PathQuery& q : batch) {
+        tile_grid_snapshot_release(q.snapshot);
+
+        PathSlot* slot = Slot(q.ticket);
+        if (slot == nullptr) {
+            q.path.trash();  // 已取消
+            continue;
+        }
+
+        slot->status = q.found ? PathQuery_Found : PathQuery_NotFound;
+        slot->path.trash();
+        slot->path = q.path;
+        stats.delivered++;
+    }
+    batch.len = 0;
+}
+
+void PathService::Dispatch(u64 max) {
+    batch.len = 0;
+    while (pending_head < pending.len && batch.len < max) {
+        PathQuery& q = pending[pending_head++];
+        if (Slot(q.ticket) == nullptr) {
+            tile_grid_snapshot_release(q.snapshot);  // 已取消
+            continue;
+        }
+        batch.push(q);
+    }
+
+    // 队列取空后从头复用
+    if (pending_head == pending.len) {
+        pending.len = 0;
+        pending_head = 0;
+    }
+
+    if (batch.len == 0) return;
+
+    PROFILE_FUNC();
+
+    // 组数固定为线程数的两倍 查询按提交顺序连续划分 每组一份工作区
+    u32 groups = NEKO_MIN((u32)batch.len, NEKO_MAX(Job::ThreadCount(), 1u) * 2);
+    u32 group_size = ((u32)batch.len + groups - 1) / groups;
+    groups = ((u32)batch.len + group_size - 1) / group_size;
+    while (scratch.len < groups) scratch.push(TileGridSearch{});
+
+    batch_done.store(0);
+    batch_ticks.store(0);
+    stats.dispatched += (u32)batch.len;
+
+    Job::Dispatch((u32)batch.len, group_size, [this](JobDispatchArgs args) {
+        PathQuery& q = batch[args.jobIndex];
+        u64 t = TimeUtil::now();
+        q.path = {};
+        q.found = tile_grid_search(&q.snapshot->grid, &scratch[args.groupIndex], q.sx, q.sy, q.ex, q.ey, q.mode, &q.path);
+        batch_ticks.fetch_add(TimeUtil::since(t));
+        batch_done.fetch_add(1, std::memory_order_release);
+    });
+}
+
+void PathService::path_sync() {
+    PROFILE_FUNC();
+
+    Collect();
+    CollectFlows();
+
+    if (batch.len == 0) {
+        // 按测得的单个查询耗时把预算换算为本帧查询数
+        f32 per_query = query_ms > 0 ? query_ms : PATH_DEFAULT_QUERY_MS;
+        u64 max = (u64)(budget_ms * NEKO_MAX(Job::ThreadCount(), 1u) / per_query);
+        Dispatch(NEKO_MAX(max, (u64)1));
+    } else {
+        Job::Wake();  // 避免作业线程错过唤醒
+    }
+
+    stats.pending = (u32)(pending.len - pending_head);
+    stats.in_flight = (u32)batch.len;
+    stats.query_ms = query_ms;
+}
+
+void PathService::path_flush() {
+    PROFILE_FUNC();
+
+    while (batch.len > 0 || pending_head < pending.len) {
+        if (batch.len > 0) {
+            Job::Wait();
+            Collect();
+        }
+        Dispatch(pending.len - pending_head);
+    }
+
+    // 构建完成时可能接着开始等待中的目标
+    while (flows_building > 0) {
+        Job::Wait();
+        CollectFlows();
+    }
+
+    stats.pending = 0;
+    stats.in_flight = 0;
+    stats.query_ms = query_ms;
+}
+
+void PathService::path_set_budget(f32 ms) { budget_ms = NEKO_MAX(ms, 0.0f); }
+
+f32 PathService::path_get_budget() { return budget_ms; }
+
+u32 PathService::path_pending() { return (u32)(pending.len - pending_head + batch.len); }
+
+const PathServiceStats& PathService::path_get_stats() { return stats; }
+
+int PathService::path_update_all(Event evt) {
+    stats.submitted = 0;
+    stats.dispatched = 0;
+    stats.delivered = 0;
+    stats.flows_built = 0;
+    path_sync();
+    return 0;
+}
+
+// -------------------------------------------------------------------------
+
+PathFlow* PathService::Flow(PathFlowId id) {
+    u32 index = id & PATH_TICKET_SLOT_MASK;
+    if (id == 0 || index >= flows.len) return nullptr;
+    PathFlow* flow = flows[index];
+    if (!flow->alive || flow->gen != id >> PATH_TICKET_SLOT_BITS) return nullptr;
+    return flow;
+}
+
+void PathService::StartFlow(PathFlow* flow, TileGridSnapshot* snapshot, i32 gx, i32 gy) {
+    flow->building = true;
+    flow->snapshot = snapshot;
+    flow->done.store(false);
+    flows_building++;
+
+    Job::Execute([flow, gx, gy]() {
+        tile_flow_build(&flow->next, &flow->snapshot->grid, &flow->search, gx, gy);
+        flow->done.store(true, std::memory_order_release);
+    });
+}
+
+static void path_flow_trash(PathFlow* flow) {
+    tile_flow_trash(&flow->current);
+    tile_flow_trash(&flow->next);
+    tile_grid_search_trash(&flow->search);
+}
+
+void PathService::CollectFlows() {
+    if (flows_building == 0) return;
+
+    for (u32 i = 0; i < flows.len; i++) {
+        PathFlow* flow = flows[i];
+        if (!flow->building || !flow->done.load(std::memory_order_acquire)) continue;
+
+        flow->building = false;
+        flows_building--;
+        TileFlowField t = flow->current;
+        flow->current = flow->next;
+        flow->next = t;  // 保留容量 给下一次构建
+        flow->cell_size = flow->snapshot->cell_size;
+        tile_grid_snapshot_release(flow->snapshot);
+        flow->snapshot = nullptr;
+        stats.flows_built++;
+
+        if (!flow->alive) {
+            path_flow_trash(flow);
+            free_flows.push(i);
+        } else if (flow->requested) {
+            flow->requested = false;
+            StartFlow(flow, flow->request, flow->gx, flow->gy);
+            flow->request = nullptr;
+        }
+    }
+}
+
+PathFlowId PathService::flow_create() {
+    u32 index;
+    if (free_flows.len > 0) {
+        index = free_flows[--free_flows.len];
+    } else {
+        index = (u32)flows.len;
+        error_assert(index <= PATH_TICKET_SLOT_MASK, "too many flow fields");
+        flows.push(mem_new<PathFlow>());
+    }
+
+    PathFlow* flow = flows[index];
+    flow->gen = (flow->gen + 1) & PATH_TICKET_GEN_MASK;
+    if (flow->gen == 0) flow->gen = 1;
+    flow->alive = true;
+    flow->cell_size = 0;
+    return (flow->gen << PATH_TICKET_SLOT_BITS) | index;
+}
+
+void PathService::flow_destroy(PathFlowId id) {
+    PathFlow* flow = Flow(id);
+    if (flow == nullptr) return;
+
+    flow->alive = false;
+    if (flow->requested) {
+        tile_grid_snapshot_release(flow->request);
+        flow->request = nullptr;
+        flow->requested = false;
+    }
+    if (!flow->building) {
+        path_flow_trash(flow);
+        free_flows.push(id & PATH_TICKET_SLOT_MASK);
+    }
+}
+
+bool PathService::flow_set_goal(PathFlowId id, TileGridSnapshot* snapshot, i32 gx, i32 gy) {
+    PathFlow* flow = Flow(id);
+    if (flow == nullptr || snapshot == nullptr) return false;
+
+    tile_grid_snapshot_retain(snapshot);
+    if (!flow->building) {
+        StartFlow(flow, snapshot, gx, gy);
+        return true;
+    }
+
+    // 正在构建时只保留最新的目标
+    if (flow->requested) tile_grid_snapshot_release(flow->request);
+    flow->requested = true;
+    flow->request = snapshot;
+    flow->gx = gx;
+    flow->gy = gy;
+    return true;
+}
+
+const TileFlowField* PathService::flow_field(PathFlowId id, f32* cell_size) {
+    PathFlow* flow = Flow(id);
+    if (flow == nullptr || flow->cell_size == 0) return nullptr;
+    if (cell_size) *cell_size = flow->cell_size;
+    return &flow->current;
+}
+
+// -------------------------------------------------------------------------
+
+// neko.path_poll(ticket) -> 路径 {{x, y}...} (像素) 未完成时为 nil 没有路径时为 false
+static int wrap_path_poll(lua_State* L) {
+    PathTicket ticket = (PathTicket)luaL_checkinteger(L, 1);
+
+    Array<TilePoint> path = {};
+    neko_defer(path.trash());
+    f32 cell_size = 0;
+    PathQueryStatus status = the<PathService>().path_take(ticket, &path, &cell_size);
+
+    if (status == PathQuery_Pending) {
+        lua_pushnil(L);
+        return 1;
+    }
+    if (status != PathQuery_Found) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+
+    lua_createtable(L, (i32)path.len, 0);
+    for (u64 i = 0; i < path.len; i++) {
+        lua_createtable(L, 0, 2);
+        luax_set_number_field(L, "x", path[i].x * cell_size);
+        luax_set_number_field(L, "y", path[i].y * cell_size);
+        lua_rawseti(L, -2, (i32)i + 1);
+    }
+    return 1;
+}
+
+// neko.path_cancel(ticket)
+static int wrap_path_cancel(lua_State* L) {
+    the<PathService>().path_cancel((PathTicket)luaL_checkinteger(L, 1));
+    return 0;
+}
+
+// neko.flow_sample(id, x, y) -> dx, dy, cost 像素坐标 dx dy 为下一步的格子偏移 (-1, 0, 1)
+// 场还没有完成或不可达时为 nil 在目标格上为 0, 0, 0
+static int wrap_flow_sample(lua_State* L) {
+    f32 cell_size = 0;
+    const TileFlowField* flow = the<PathService>().flow_field((PathFlowId)luaL_checkinteger(L, 1), &cell_size);
+    if (flow == nullptr) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    i32 x = (i32)(luaL_checknumber(L, 2) / cell_size);
+    i32 y = (i32)(luaL_checknumber(L, 3) / cell_size);
+    float cost = tile_flow_cost(flow, x, y);
+    i32 dx = 0, dy = 0;
+    if (cost < 0 || (cost > 0 && !tile_flow_sample(flow, x, y, &dx, &dy))) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_pushinteger(L, dx);
+    lua_pushinteger(L, dy);
+    lua_pushnumber(L, cost);
+    return 3;
+}
+
+// neko.flow_destroy(id)
+static int wrap_flow_destroy(lua_State* L) {
+    the<PathService>().flow_destroy((PathFlowId)luaL_checkinteger(L, 1));
+    return 0;
+}
+
+void PathService::path_init() {
+    PROFILE_FUNC();
+
+    budget_ms = PATH_DEFAULT_BUDGET_MS;
+    query_ms = 0;
+
+    // clang-format off
+
+    auto type = BUILD_TYPE(PathService)
+        .MemberMethod("path_set_budget", this, &PathService::path_set_budget)
+        .MemberMethod("path_get_budget", this, &PathService::path_get_budget)
+        .MemberMethod("path_pending", this, &PathService::path_pending)
+        .CClosure({
+            {"path_poll", wrap_path_poll},
+            {"path_cancel", wrap_path_cancel},
+            {"flow_sample", wrap_flow_sample},
+            {"flow_destroy", wrap_flow_destroy},
+        })
+        .Build();
+
+    // clang-format on
+}
+
+void PathService::path_fini() {
+    path_flush();
+
+    for (PathFlow* flow : flows) {
+        if (flow->requested) tile_grid_snapshot_release(flow->request);
+        path_flow_trash(flow);
+        mem_del(flow);
+    }
+    flows.trash();
+    free_flows.trash();
+
+    for (PathSlot& slot : slots) slot.path.trash();
+    for (TileGridSearch& s : scratch) tile_grid_search_trash(&s);
+    slots.trash();
+    free_slots.trash();
+    pending.trash();
+    batch.trash();
+    scratch.trash();
+}
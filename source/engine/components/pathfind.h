@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+
+#include "engine/components/tiledmap.hpp"
+
+// 异步寻路服务 (主线程调用)
+// 提交查询立即得到票据 查询在同步点 (path_update_all) 按每帧预算分批派发到作业线程
+// 一批查询只读共享的网格快照 每个作业组使用自己的 TileGridSearch 结果与线程调度无关
+// 批次在作业线程上完成后 于下一个同步点交付 之后用 path_take 取出
+// 流场同样在作业线程上构建 完成后于同步点替换当前的场 构建期间仍可对旧的场采样
+
+using PathTicket = u32;  // 低 20 位为槽位 高 12 位为槽位代数 0 为无效
+
+enum PathQueryStatus {
+    PathQuery_Invalid,  // 未知票据 已取出或已取消
+    PathQuery_Pending,
+    PathQuery_Found,
+    PathQuery_NotFound,
+};
+
+struct PathQuery {
+    PathTicket ticket;
+    TileGridSnapshot* snapshot;
+    i32 sx, sy, ex, ey;  // 格子坐标
+    TileGridMode mode;
+    bool found;
+    Array<TilePoint> path;
+};
+
+struct PathSlot {
+    u32 gen;
+    PathQueryStatus status;
+    f32 cell_size;
+    Array<TilePoint> path;  // 交付后有效
+};
+
+using PathFlowId = u32;  // 编码与票据相同 0 为无效
+
+struct PathFlow {
+    u32 gen;
+    bool alive;                  // 销毁时仍在构建的 构建完成后回收
+    bool building;               // 作业线程正在写 next
+    bool requested;              // 构建期间又设置了目标
+    TileGridSnapshot* snapshot;  // 正在构建
+    TileGridSnapshot* request;   // 等待构建
+    i32 gx, gy;                  // 等待构建的目标
+    f32 cell_size;               // current 的格子像素大小
+    TileFlowField current;       // 采样用
+    TileFlowField next;
+    TileGridSearch search;
+    std::atomic<bool> done;
+};
+
+struct PathServiceStats {
+    u32 submitted;   // 上一次同步以来
+    u32 dispatched;  // 上一次同步派发
+    u32 delivered;   // 上一次同步交付
+    u32 pending;     // 等待派发
+    u32 in_flight;   // 作业线程上
+    f32 query_ms;    // 单个查询的平均耗时 (作业线程)
+    u32 flows_built;  // 上一次同步替换的流场
+};
+
+#define PATH_TICKET_SLOT_BITS 20
+
+class PathService : public SingletonClass<PathService> {
+private:
+    Array<PathSlot> slots;
+    Array<u32> free_slots;
+    Array<PathQuery> pending;  // 从 pending_head 开始按提交顺序
+    u64 pending_head;
+    Array<PathQuery> batch;         // 正在作业线程上执行
+    Array<TileGridSearch> scratch;  // 每个作业组一份
+    std::atomic<u32> batch_done;
+    std::atomic<u64> batch_ticks;
+    f32 budget_ms;
+    f32 query_ms;
+    PathServiceStats stats;
+    Array<PathFlow*> flows;
+    Array<u32> free_flows;
+    u32 flows_building;
+
+    PathSlot* Slot(PathTicket ticket);
+    void Release(PathTicket ticket);
+    void Collect();
+    void Dispatch(u64 max);
+    PathFlow* Flow(PathFlowId id);
+    void StartFlow(PathFlow* flow, TileGridSnapshot* snapshot, i32 gx, i32 gy);
+    void CollectFlows();
+
+public:
+    void path_init();
+    void path_fini();
+    int path_update_all(Event evt);
+
+    PathTicket path_submit(TileGridSnapshot* snapshot, i32 sx, i32 sy, i32 ex, i32 ey, TileGridMode mode);  // 格子坐标
+    PathQueryStatus path_status(PathTicket ticket);
+    // 已交付时把路径 (格子坐标) 写入 out 并释放票据 cell_size 为快照的格子像素大小
+    PathQueryStatus path_take(PathTicket ticket, Array<TilePoint>* out, f32* cell_size = nullptr);
+    void path_cancel(PathTicket ticket);
+
+    void path_sync();   // 同步点 收取完成的批次并按预算派发下一批 不阻塞
+    void path_flush();  // 阻塞直到所有查询交付
+
+    void path_set_budget(f32 ms);  // 每帧每个作业线程的寻路时间
+    f32 path_get_budget();
+    u32 path_pending();
+    const PathServiceStats& path_get_stats();
+
+    PathFlowId flow_create();
+    void flow_destroy(PathFlowId id);
+    bool flow_set_goal(PathFlowId id, TileGridSnapshot* snapshot, i32 gx, i32 gy);  // 格子坐标 id 无效时返回 false
+    const TileFlowField* flow_field(PathFlowId id, f32* cell_size = nullptr);      // 最近完成的场 还没有时为 nullptr
+};
@@ -108,7 +108,7 @@ int RectangleBox::update_all(Event evt) {
     return 0;
 }
 
-void RectangleBox::immediate_push(CEntity ent) {
+bool RectangleBox::immediate_push(CEntity ent) {
     CRectangle *rectangle = ComponentGetPtr(ent);
     {
         float x1 = rectangle->pos.x;
@@ -116,6 +116,12 @@ void RectangleBox::immediate_push(CEntity ent) {
         float x2 = x1 + rectangle->size.x;
         float y2 = y1 - rectangle->size.y;
 
+        Camera &camera = the<Camera>();
+        CameraCullStats &stats = camera.camera_get_cull_stats();
+        stats.rects++;
+        if (!camera.camera_visible(bbox_bound(luavec2(x1, y1), luavec2(x2, y2)))) return false;
+        stats.rects_visible++;
+
         float u1 = 0.f;
         float v1 = 0.f;
         float u2 = 1.f;
@@ -129,14 +135,15 @@ void RectangleBox::immediate_push(CEntity ent) {
         push_vertex(x2, y1, u2, v2);
         push_vertex(x2, y2, u2, v1);
     }
+    return true;
 }
 
 void RectangleBox::immediate_draw(const AssetShader &shader, std::function<void(void)> setter) {
+    if (vertex_count == 0) return;  // 全部被剔除
 
     GLuint sid = shader.id;
 
     glUseProgram(sid);
-    glUniformMatrix3fv(glGetUniformLocation(sid, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
 
     setter();
 
@@ -162,3 +169,13 @@ int RectangleBox::Inspect(CEntity ent) {
     ImGuiWrap::Auto(rectangle, "CRectangle");
     return 0;
 }
+
+void RectangleBox::SnapshotSave(CRectangle *rectangle, SnapshotWriter &w) {
+    w.put(rectangle->pos);
+    w.put(rectangle->size);
+}
+
+void RectangleBox::SnapshotLoad(CRectangle *rectangle, SnapshotReader &r) {
+    rectangle->pos = r.get<vec2>();
+    rectangle->size = r.get<vec2>();
+}
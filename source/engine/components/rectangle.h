@@ -35,8 +35,12 @@ public:
     void fini();
     void push_vertex(float x, float y, float u, float v);
     int update_all(Event evt);
-    void immediate_push(CEntity ent);
+    bool immediate_push(CEntity ent);  // 不在摄像机视图内时不提交 返回 false
     void immediate_draw(const AssetShader &shader, std::function<void(void)> setter);
 
     int Inspect(CEntity ent) override;
+
+    bool SnapshotEnabled() override { return true; }
+    void SnapshotSave(CRectangle *rectangle, SnapshotWriter &w) override;
+    void SnapshotLoad(CRectangle *rectangle, SnapshotReader &r) override;
 };
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include "spatial.h"
+
+#include <algorithm>
+
+#include "base/common/profiler.hpp"
+#include "engine/bootstrap.h"
+#include "engine/components/transform.h"
+#include "engine/scripting/lua_util.h"
+
+static const BBox spatial_default_bbox = {{-0.25f, -0.25f}, {0.25f, 0.25f}};
+
+static inline b2AABB to_b2(BBox b) {
+    b2AABB aabb;
+    aabb.lowerBound.Set(b.min.x, b.min.y);
+    aabb.upperBound.Set(b.max.x, b.max.y);
+    return aabb;
+}
+
+static inline bool bbox_overlaps(BBox a, BBox b) { return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y; }
+
+static inline bool bbox_equal(BBox a, BBox b) { return memcmp(&a, &b, sizeof(BBox)) == 0; }
+
+// 线段 a + (b - a) * t 与包围盒的最近交点 t 不相交时返回 false
+static bool bbox_segment(BBox box, vec2 a, vec2 b, f32* t) {
+    f32 tmin = 0.0f, tmax = 1.0f;
+    f32 o[2] = {a.x, a.y}, d[2] = {b.x - a.x, b.y - a.y};
+    f32 lo[2] = {box.min.x, box.min.y}, hi[2] = {box.max.x, box.max.y};
+    for (int i = 0; i < 2; i++) {
+        if (fabsf(d[i]) < NEKO_EPSILON) {
+            if (o[i] < lo[i] || o[i] > hi[i]) return false;
+        } else {
+            f32 inv = 1.0f / d[i];
+            f32 t1 = (lo[i] - o[i]) * inv, t2 = (hi[i] - o[i]) * inv;
+            if (t1 > t2) std::swap(t1, t2);
+            tmin = float_max(tmin, t1);
+            tmax = float_min(tmax, t2);
+            if (tmin > tmax) return false;
+        }
+    }
+    *t = tmin;
+    return true;
+}
+
+// -------------------------------------------------------------------------
+
+void Spatial::MarkDirty(CSpatial* s) {
+    if (!s->dirty) {
+        s->dirty = true;
+        dirty_list.push(s->ent);
+    }
+}
+
+// 重新计算世界包围盒 只有改变时才移动树节点
+void Spatial::Refresh(CSpatial* s) {
+    s->dirty = false;
+
+    CTransform* t = the<Transform>().ComponentGetPtr(s->ent);
+    BBox world = t ? bbox_transform(t->worldmat_cache, s->local) : s->local;
+
+    if (s->proxy < 0) {
+        s->world = world;
+        s->proxy = tree.CreateProxy(to_b2(world), (void*)(uintptr_t)s->ent.id);
+    } else if (!bbox_equal(world, s->world)) {
+        b2Vec2 displacement(0.5f * (world.min.x + world.max.x - s->world.min.x - s->world.max.x), 0.5f * (world.min.y + world.max.y - s->world.min.y - s->world.max.y));
+        s->world = world;
+        tree.MoveProxy(s->proxy, to_b2(world), displacement);
+    }
+}
+
+void Spatial::ResolveDirty() {
+    Transform& tr = the<Transform>();
+
+    Slice<CEntity> moved = tr.transform_get_moved();
+    for (CEntity ent : moved) {
+        CSpatial* s = pool->GetPtr(ent);
+        if (s) MarkDirty(s);
+    }
+    tr.transform_clear_moved();
+
+    if (!dirty_list.len) return;
+
+    PROFILE_FUNC();
+
+    for (CEntity ent : dirty_list) {
+        CSpatial* s = pool->GetPtr(ent);
+        if (s && s->dirty) Refresh(s);
+    }
+    dirty_list.len = 0;
+}
+
+// -------------------------------------------------------------------------
+
+void Spatial::spatial_add(CEntity ent) {
+    if (pool->GetPtr(ent)) return;
+
+    CSpatial* s = pool->Add(ent);
+    s->local = spatial_default_bbox;
+    s->world = spatial_default_bbox;
+    s->proxy = -1;
+    s->dirty = false;
+    MarkDirty(s);
+}
+
+void Spatial::spatial_remove(CEntity ent) {
+    CSpatial* s = pool->GetPtr(ent);
+    if (!s) return;
+    if (s->proxy >= 0) tree.DestroyProxy(s->proxy);
+    pool->Remove(ent);
+}
+
+bool Spatial::spatial_has(CEntity ent) { return pool->GetPtr(ent) != nullptr; }
+
+void Spatial::spatial_set_bounds(CEntity ent, BBox local) {
+    spatial_add(ent);
+    CSpatial* s = pool->GetPtr(ent);
+    if (bbox_equal(s->local, local)) return;
+    s->local = local;
+    MarkDirty(s);
+}
+
+void Spatial::spatial_reset_bounds(CEntity ent) {
+    if (pool->GetPtr(ent)) spatial_set_bounds(ent, spatial_default_bbox);
+}
+
+BBox Spatial::spatial_get_bounds(CEntity ent) {
+    CSpatial* s = pool->GetPtr(ent);
+    error_assert(s);
+    return s->local;
+}
+
+BBox Spatial::spatial_get_world_bounds(CEntity ent) {
+    ResolveDirty();
+    CSpatial* s = pool->GetPtr(ent);
+    error_assert(s);
+    return s->world;
+}
+
+u32 Spatial::spatial_count() { return entitypool_size(pool); }
+
+// b2DynamicTree 中保存的是放大后的包围盒 回调中再用精确的世界包围盒过滤
+struct SpatialQueryBox {
+    b2DynamicTree* tree;
+    CEntityPool<CSpatial>* pool;
+    BBox box;
+    Array<CEntity>* out;
+
+    bool QueryCallback(int32 proxy) {
+        CEntity ent = {(EcsId)(uintptr_t)tree->GetUserData(proxy)};
+        CSpatial* s = pool->GetPtr(ent);
+        if (s && bbox_overlaps(s->world, box)) out->push(ent);
+        return true;
+    }
+};
+
+struct SpatialQueryRadius {
+    b2DynamicTree* tree;
+    CEntityPool<CSpatial>* pool;
+    vec2 center;
+    f32 radius2;
+    Array<CEntity>* out;
+
+    bool QueryCallback(int32 proxy) {
+        CEntity ent = {(EcsId)(uintptr_t)tree->GetUserData(proxy)};
+        CSpatial* s = pool->GetPtr(ent);
+        if (!s) return true;
+        // 圆心到包围盒的最近点
+        f32 dx = center.x - NEKO_CLAMP(center.x, s->world.min.x, s->world.max.x);
+        f32 dy = center.y - NEKO_CLAMP(center.y, s->world.min.y, s->world.max.y);
+        if (dx * dx + dy * dy <= radius2) out->push(ent);
+        return true;
+    }
+};
+
+struct SpatialQueryRay {
+    b2DynamicTree* tree;
+    CEntityPool<CSpatial>* pool;
+    vec2 a, b;
+    Array<SpatialRayHit>* out;
+
+    f32 RayCastCallback(const b2RayCastInput& input, int32 proxy) {
+        CEntity ent = {(EcsId)(uintptr_t)tree->GetUserData(proxy)};
+        CSpatial* s = pool->GetPtr(ent);
+        f32 t;
+        if (s && bbox_segment(s->world, a, b, &t)) out->push(SpatialRayHit{ent, t});
+        return input.maxFraction;  // 继续 收集全部命中
+    }
+};
+
+void Spatial::spatial_query_point(vec2 p, Array<CEntity>* out) { spatial_query_aabb(bbox(p, p), out); }
+
+void Spatial::spatial_query_aabb(BBox box, Array<CEntity>* out) {
+    ResolveDirty();
+    SpatialQueryBox q = {&tree, pool, box, out};
+    tree.Query(&q, to_b2(box));
+}
+
+void Spatial::spatial_query_radius(vec2 center, f32 radius, Array<CEntity>* out) {
+    ResolveDirty();
+    SpatialQueryRadius q = {&tree, pool, center, radius * radius, out};
+    tree.Query(&q, to_b2(bbox(luavec2(center.x - radius, center.y - radius), luavec2(center.x + radius, center.y + radius))));
+}
+
+void Spatial::spatial_raycast(vec2 a, vec2 b, Array<SpatialRayHit>* out) {
+    ResolveDirty();
+    u64 first = out->len;
+
+    SpatialQueryRay q = {&tree, pool, a, b, out};
+    if (vec2_dist(a, b) < NEKO_EPSILON) {
+        // 退化为点查询 b2DynamicTree::RayCast 要求非零长度
+        Array<CEntity> hits = {};
+        spatial_query_point(a, &hits);
+        for (CEntity ent : hits) out->push(SpatialRayHit{ent, 0.0f});
+        hits.trash();
+    } else {
+        b2RayCastInput input;
+        input.p1.Set(a.x, a.y);
+        input.p2.Set(b.x, b.y);
+        input.maxFraction = 1.0f;
+        tree.RayCast(&q, input);
+    }
+
+    std::sort(out->data + first, out->data + out->len, [](const SpatialRayHit& l, const SpatialRayHit& r) { return l.fraction < r.fraction; });
+}
+
+// -------------------------------------------------------------------------
+
+void Spatial::SnapshotSaveAll(SnapshotWriter& w, u32* count) {
+    for (CSpatial& s : pool->array) {
+        w.put<u32>(s.ent.id);
+        w.put<u32>(sizeof(BBox));
+        w.put(s.local);
+        ++*count;
+    }
+}
+
+void Spatial::SnapshotLoadBegin() {
+    for (CSpatial& s : pool->array)
+        if (s.proxy >= 0) tree.DestroyProxy(s.proxy);
+    entitypool_clear(pool);
+    dirty_list.len = 0;
+}
+
+void Spatial::SnapshotLoadRecord(CEntity ent, SnapshotReader& r) {
+    spatial_add(ent);
+    pool->GetPtr(ent)->local = r.get<BBox>();
+}
+
+// -------------------------------------------------------------------------
+
+static int spatial_push_ents(lua_State* L, Array<CEntity>& ents) {
+    lua_createtable(L, (int)ents.len, 0);
+    for (u64 i = 0; i < ents.len; i++) {
+        LuaPush<CEntity>(L, ents[i]);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    ents.trash();
+    return 1;
+}
+
+// neko.spatial_query_point(p) -> {ent...}
+static int wrap_spatial_query_point(lua_State* L) {
+    vec2* p = LuaGet<vec2>(L, 1);
+    Array<CEntity> ents = {};
+    the<Spatial>().spatial_query_point(*p, &ents);
+    return spatial_push_ents(L, ents);
+}
+
+// neko.spatial_query_aabb(min, max) -> {ent...}
+static int wrap_spatial_query_aabb(lua_State* L) {
+    vec2* min = LuaGet<vec2>(L, 1);
+    vec2* max = LuaGet<vec2>(L, 2);
+    Array<CEntity> ents = {};
+    the<Spatial>().spatial_query_aabb(bbox(*min, *max), &ents);
+    return spatial_push_ents(L, ents);
+}
+
+// neko.spatial_query_radius(center, radius) -> {ent...}
+static int wrap_spatial_query_radius(lua_State* L) {
+    vec2* c = LuaGet<vec2>(L, 1);
+    f32 r = (f32)luaL_checknumber(L, 2);
+    Array<CEntity> ents = {};
+    the<Spatial>().spatial_query_radius(*c, r, &ents);
+    return spatial_push_ents(L, ents);
+}
+
+// neko.spatial_raycast(a, b) -> {ent...}, {fraction...}  按距离排序
+static int wrap_spatial_raycast(lua_State* L) {
+    vec2* a = LuaGet<vec2>(L, 1);
+    vec2* b = LuaGet<vec2>(L, 2);
+    Array<SpatialRayHit> hits = {};
+    the<Spatial>().spatial_raycast(*a, *b, &hits);
+    lua_createtable(L, (int)hits.len, 0);
+    lua_createtable(L, (int)hits.len, 0);
+    for (u64 i = 0; i < hits.len; i++) {
+        LuaPush<CEntity>(L, hits[i].ent);
+        lua_rawseti(L, -3, (lua_Integer)i + 1);
+        lua_pushnumber(L, hits[i].fraction);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    hits.trash();
+    return 2;
+}
+
+// neko.spatial_set_bounds(ent, min, max)
+static int wrap_spatial_set_bounds(lua_State* L) {
+    CEntity* ent = LuaGet<CEntity>(L, 1);
+    vec2* min = LuaGet<vec2>(L, 2);
+    vec2* max = LuaGet<vec2>(L, 3);
+    the<Spatial>().spatial_set_bounds(*ent, bbox(*min, *max));
+    return 0;
+}
+
+void Spatial::spatial_init() {
+    PROFILE_FUNC();
+
+    pool = entitypool_new<CSpatial>();
+    entitypool_subscribe_destroyed(pool);
+    snapshot_register(this);
+
+    // clang-format off
+
+    auto type = BUILD_TYPE(Spatial)
+        .MemberMethod("spatial_has", this, &Spatial::spatial_has)
+        .MemberMethod("spatial_count", this, &Spatial::spatial_count)
+        .CClosure({
+            {"spatial_query_point", wrap_spatial_query_point},
+            {"spatial_query_aabb", wrap_spatial_query_aabb},
+            {"spatial_query_radius", wrap_spatial_query_radius},
+            {"spatial_raycast", wrap_spatial_raycast},
+            {"spatial_set_bounds", wrap_spatial_set_bounds},
+        })
+        .Build();
+
+    // clang-format on
+}
+
+void Spatial::spatial_fini() {
+    snapshot_unregister(this);
+    for (CSpatial& s : pool->array)
+        if (s.proxy >= 0) tree.DestroyProxy(s.proxy);
+    entitypool_free(pool);
+    dirty_list.trash();
+}
+
+int Spatial::spatial_update_all(Event evt) {
+    entitypool_remove_destroyed(pool, [this](CEntity ent) { spatial_remove(ent); });
+    ResolveDirty();
+    return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <box2d/box2d.h>
+
+#include "engine/ecs/entity.h"
+#include "engine/component.h"
+
+// 实体包围盒的空间索引 (动态 AABB 树 使用 box2d 的 b2DynamicTree)
+// 每个 Transform 实体都有一项 局部包围盒默认为 ±0.25 由 Sprite/Camera 等设置
+// 世界包围盒在变换或包围盒改变后于 spatial_update_all 或下一次查询前更新
+// 查询结果不保证顺序 (raycast 除外 按命中距离排序)
+
+struct CSpatial : CEntityBase {
+    BBox local;  // 局部空间
+    BBox world;  // 局部包围盒经世界矩阵变换后的轴对齐包围盒
+    int proxy;   // b2DynamicTree 节点 未插入时为 -1
+    bool dirty;
+};
+
+static_assert(std::is_trivially_copyable_v<CSpatial>);
+
+struct SpatialRayHit {
+    CEntity ent;
+    f32 fraction;  // 命中点 = a + (b - a) * fraction
+};
+
+class Spatial : public SingletonClass<Spatial>, public SnapshotSection {
+private:
+    CEntityPool<CSpatial>* pool;
+    b2DynamicTree tree;
+    Array<CEntity> dirty_list;  // 包围盒改变的实体
+
+    void MarkDirty(CSpatial* s);
+    void Refresh(CSpatial* s);
+    void ResolveDirty();
+
+public:
+    void spatial_init();
+    void spatial_fini();
+    int spatial_update_all(Event evt);
+
+    void spatial_add(CEntity ent);  // 已存在时保留原包围盒
+    void spatial_remove(CEntity ent);
+    bool spatial_has(CEntity ent);
+    void spatial_set_bounds(CEntity ent, BBox local);  // 不存在时创建
+    void spatial_reset_bounds(CEntity ent);            // 恢复默认包围盒
+    BBox spatial_get_bounds(CEntity ent);
+    BBox spatial_get_world_bounds(CEntity ent);
+    u32 spatial_count();
+
+    void spatial_query_point(vec2 p, Array<CEntity>* out);
+    void spatial_query_aabb(BBox box, Array<CEntity>* out);
+    void spatial_query_radius(vec2 center, f32 radius, Array<CEntity>* out);
+    void spatial_raycast(vec2 a, vec2 b, Array<SpatialRayHit>* out);
+
+    const_str SnapshotName() override { return "Spatial"; }
+    bool SnapshotEnabled() override { return true; }
+    void SnapshotSaveAll(SnapshotWriter& w, u32* count) override;
+    void SnapshotLoadBegin() override;
+    void SnapshotLoadRecord(CEntity ent, SnapshotReader& r) override;
+    void SnapshotLoadEnd() override {}
+    void* SnapshotGetElem(CEntity ent) override { return pool->GetPtr(ent); }
+};
@@ -7,6 +7,7 @@
 #include "engine/scripting/lua_util.h"
 #include "engine/components/transform.h"
 #include "engine/components/camera.h"
+#include "engine/components/spatial.h"
 
 static char *atlas = NULL;
 
@@ -32,13 +33,16 @@ static void _set_atlas(const char *filename, bool err) {
 
     atlas_size = texture_get_size(atlas);
     glUseProgram(sid);
-    glUniform2fv(glGetUniformLocation(sid, "atlas_size"), 1, (const GLfloat *)&atlas_size);
+    glUniform2fv(neko_shader_uniform(sid, "atlas_size"), 1, (const GLfloat *)&atlas_size);
 }
 
 void Sprite::sprite_set_atlas(const char *filename) { _set_atlas(filename, true); }
 
 const char *Sprite::sprite_get_atlas() { return atlas; }
 
+// 中心位于变换位置
+static BBox sprite_bbox(vec2 size) { return bbox(vec2_float_mul(size, -0.5f), vec2_float_mul(size, 0.5f)); }
+
 CSprite *Sprite::ComponentAdd(CEntity ent) {
     CSprite *sprite;
 
@@ -52,15 +56,24 @@ CSprite *Sprite::ComponentAdd(CEntity ent) {
     sprite->texsize = luavec2(32.0f, 32.0f);
     sprite->depth = 0;
 
+    the<Spatial>().spatial_set_bounds(ent, sprite_bbox(sprite->size));
+    depth_dirty = true;
+
     return sprite;
 }
 
-void Sprite::ComponentRemove(CEntity ent) { ComponentTypeBase::EntityPool->Remove(ent); }
+void Sprite::ComponentRemove(CEntity ent) {
+    if (!ComponentGetPtr(ent)) return;
+    the<Spatial>().spatial_reset_bounds(ent);
+    ComponentTypeBase::EntityPool->Remove(ent);
+    depth_dirty = true;  // 末尾元素被换到删除的位置
+}
 
 void Sprite::sprite_set_size(CEntity ent, vec2 size) {
     CSprite *sprite = ComponentGetPtr(ent);
     error_assert(sprite);
     sprite->size = size;
+    the<Spatial>().spatial_set_bounds(ent, sprite_bbox(size));
 }
 vec2 Sprite::sprite_get_size(CEntity ent) {
     CSprite *sprite = ComponentGetPtr(ent);
@@ -92,6 +105,7 @@ vec2 Sprite::sprite_get_texsize(CEntity ent) {
 void Sprite::sprite_set_depth(CEntity ent, int depth) {
     CSprite *sprite = ComponentGetPtr(ent);
     error_assert(sprite);
+    if (sprite->depth != depth) depth_dirty = true;
     sprite->depth = depth;
 }
 int Sprite::sprite_get_depth(CEntity ent) {
@@ -113,19 +127,19 @@ void Sprite::sprite_init() {
     GLuint sid = assets_get<AssetShader>(sprite_shader).id;
 
     glUseProgram(sid);
-    glUniform1i(glGetUniformLocation(sid, "tex0"), 0);
+    glUniform1i(neko_shader_uniform(sid, "tex0"), 0);
     sprite_set_atlas("@gamedata/assets/data/default.png");
 
     glGenVertexArrays(1, &sprite_vao);
     glBindVertexArray(sprite_vao);
     glGenBuffers(1, &sprite_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, sprite_vbo);
-    gfx_bind_vertex_attrib(sid, GL_FLOAT, 3, "wmat1", CSprite, wmat.v[0]);
-    gfx_bind_vertex_attrib(sid, GL_FLOAT, 3, "wmat2", CSprite, wmat.v[3]);
-    gfx_bind_vertex_attrib(sid, GL_FLOAT, 3, "wmat3", CSprite, wmat.v[6]);
-    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "size", CSprite, size);
-    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "texcell", CSprite, texcell);
-    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "texsize", CSprite, texsize);
+    gfx_bind_vertex_attrib(sid, GL_FLOAT, 4, "wmat_xy", SpriteInstance, affine[0]);
+    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "wmat_t", SpriteInstance, affine[4]);
+    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "size", SpriteInstance, size);
+    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "texcell", SpriteInstance, texcell);
+    gfx_bind_vertex_attrib(sid, GL_FLOAT, 2, "texsize", SpriteInstance, texsize);
+    gpu_capacity = 0;
 
     // clang-format off
 
@@ -152,6 +166,13 @@ void Sprite::sprite_fini() {
 
     glDeleteBuffers(1, &sprite_vbo);
     glDeleteVertexArrays(1, &sprite_vao);
+    packed.trash();
+    packed = {};
+    instances.trash();
+    instances = {};
+    dirty_ranges.trash();
+    dirty_ranges = {};
+    gpu_capacity = 0;
 
     entitypool_free(ComponentTypeBase::EntityPool);
 
@@ -173,30 +194,112 @@ int Sprite::sprite_update_all(Event evt) {
     return 0;
 }
 
-static int _depth_compare(const void *a, const void *b) {
-    const CSprite *sa = (CSprite *)a, *sb = (CSprite *)b;
+// 深度大的在前 相同深度按 id 升序
+static u64 _depth_key(const CSprite *sprite) {
+    u32 depth = ~((u32)sprite->depth ^ 0x80000000u);
+    return ((u64)depth << 32) | sprite->ent.id;
+}
 
-    if (sb->depth == sa->depth) return ((int)sa->ent.id) - ((int)sb->ent.id);
-    return sb->depth - sa->depth;
+void Sprite::sprite_sort() {
+    if (!depth_dirty) {
+        last_sort = EntityPoolSort_None;
+        return;
+    }
+    PROFILE_FUNC();
+    last_sort = entitypool_sort_by_key(ComponentTypeBase::EntityPool, _depth_key);
+    depth_dirty = false;
 }
 
-void Sprite::sprite_draw_all() {
-    unsigned int nsprites;
+EntityPoolSortPath Sprite::sprite_get_last_sort() { return last_sort; }
+
+static SpriteInstance sprite_instance(const CSprite *sprite) {
+    SpriteInstance inst;
+    const f32 *m = sprite->wmat.v;
+    inst.affine[0] = m[0];
+    inst.affine[1] = m[1];
+    inst.affine[2] = m[3];
+    inst.affine[3] = m[4];
+    inst.affine[4] = m[6];
+    inst.affine[5] = m[7];
+    inst.size = sprite->size;
+    inst.texcell = sprite->texcell;
+    inst.texsize = sprite->texsize;
+    return inst;
+}
 
-    entitypool_sort(ComponentTypeBase::EntityPool, _depth_compare);
+void Sprite::sprite_pack_instances() {
+    PROFILE_FUNC();
+
+    sprite_sort();
+
+    Camera &camera = the<Camera>();
+    u32 n = entitypool_size(ComponentTypeBase::EntityPool);
+    CSprite *sprites = entitypool_begin(ComponentTypeBase::EntityPool);
+
+    dirty_ranges.len = 0;
+
+    // 只打包可见的精灵 实例下标为可见精灵的序号 与缓冲区中相同的实例不上传
+    u32 count = 0;
+    packed.resize(n);
+    for (u32 i = 0; i < n; i++) {
+        if (!camera.camera_visible(bbox_transform(sprites[i].wmat, sprite_bbox(sprites[i].size)))) continue;
+
+        u32 k = count++;
+        packed[k] = sprite_instance(&sprites[i]);
+        if (k < instances.len && memcmp(&instances[k], &packed[k], sizeof(SpriteInstance)) == 0) continue;
+
+        if (dirty_ranges.len && k <= dirty_ranges[dirty_ranges.len - 1].end + SPRITE_RANGE_MERGE_GAP) {
+            dirty_ranges[dirty_ranges.len - 1].end = k + 1;
+        } else {
+            dirty_ranges.push({k, k + 1});
+        }
+    }
+    packed.len = count;
+
+    CameraCullStats &stats = camera.camera_get_cull_stats();
+    stats.sprites += n;
+    stats.sprites_visible += count;
+
+    if (dirty_ranges.len > SPRITE_MAX_RANGES) {
+        dirty_ranges[0].end = dirty_ranges[dirty_ranges.len - 1].end;
+        dirty_ranges.len = 1;
+    }
+}
+
+// 把 sprite_pack_instances 的结果写进顶点缓冲区 缓冲区的容量与内容副本只在这里更新
+void Sprite::sprite_upload_instances() {
+    u32 count = (u32)packed.len;
+
+    if (count > gpu_capacity) {
+        // 存储不够 重新分配后整体上传
+        gpu_capacity = count > gpu_capacity * 2 ? count : gpu_capacity * 2;
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)gpu_capacity * sizeof(SpriteInstance), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(SpriteInstance), packed.data);
+    } else {
+        for (SpriteDirtyRange &r : dirty_ranges) {
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)r.begin * sizeof(SpriteInstance), (GLsizeiptr)(r.end - r.begin) * sizeof(SpriteInstance), &packed[r.begin]);
+        }
+    }
+
+    std::swap(instances, packed);
+    dirty_ranges.len = 0;
+}
+
+void Sprite::sprite_draw_all() {
+    sprite_pack_instances();
 
     GLuint sid = assets_get<AssetShader>(sprite_shader).id;
 
     glUseProgram(sid);
-    glUniformMatrix3fv(glGetUniformLocation(sid, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
 
     texture_bind_byname(atlas, 0);
 
     glBindVertexArray(sprite_vao);
     glBindBuffer(GL_ARRAY_BUFFER, sprite_vbo);
-    nsprites = entitypool_size(ComponentTypeBase::EntityPool);
-    glBufferData(GL_ARRAY_BUFFER, nsprites * sizeof(CSprite), entitypool_begin(ComponentTypeBase::EntityPool), GL_STREAM_DRAW);
-    glDrawArrays(GL_POINTS, 0, nsprites);
+
+    sprite_upload_instances();
+
+    glDrawArrays(GL_POINTS, 0, (GLsizei)instances.len);
 }
 
 DEFINE_IMGUI_BEGIN(template <>, CSprite) {
@@ -212,43 +315,31 @@ int Sprite::Inspect(CEntity ent) {
     CSprite *sprite = ComponentGetPtr(ent);
     error_assert(sprite);
 
+    // 尺寸经过 sprite_set_size 同步空间索引中的包围盒 深度经过 sprite_set_depth 标记重新排序
+    vec2 size = sprite->size;
+    int depth = sprite->depth;
     ImGuiWrap::Auto(sprite, "CSprite");
+    if (sprite->size.x != size.x || sprite->size.y != size.y) sprite_set_size(ent, sprite->size);
+    if (sprite->depth != depth) {
+        int edited = sprite->depth;
+        sprite->depth = depth;
+        sprite_set_depth(ent, edited);
+    }
 
     return 0;
 }
 
-void sprite_save_all(CL *app) {
-    // Store *t, *sprite_s;
-    // CSprite *sprite;
-
-    // if (store_child_save(&t, "sprite", s)) {
-    //     string_save((const char **)&atlas, "atlas", t);
-
-    //     entitypool_save_foreach(sprite, sprite_s, ComponentTypeBase::EntityPool, "pool", t) {
-    //         vec2_save(&sprite->size, "size", sprite_s);
-    //         vec2_save(&sprite->texcell, "texcell", sprite_s);
-    //         vec2_save(&sprite->texsize, "texsize", sprite_s);
-    //         int_save(&sprite->depth, "depth", sprite_s);
-    //     }
-    // }
-}
-void sprite_load_all(CL *app) {
-    // Store *t, *sprite_s;
-    // CSprite *sprite;
-    // char *tatlas;
-
-    // if (store_child_load(&t, "sprite", s)) {
-
-    //     if (string_load(&tatlas, "atlas", NULL, t)) {
-    //         _set_atlas(tatlas, false);
-    //         mem_free(tatlas);
-    //     }
-
-    //     entitypool_load_foreach(sprite, sprite_s, ComponentTypeBase::EntityPool, "pool", t) {
-    //         vec2_load(&sprite->size, "size", luavec2(1, 1), sprite_s);
-    //         vec2_load(&sprite->texcell, "texcell", luavec2(32, 32), sprite_s);
-    //         vec2_load(&sprite->texsize, "texsize", luavec2(32, 32), sprite_s);
-    //         int_load(&sprite->depth, "depth", 0, sprite_s);
-    //     }
-    // }
-}
\ No newline at end of file
+void Sprite::SnapshotSave(CSprite *sprite, SnapshotWriter &w) {
+    w.put(sprite->size);
+    w.put(sprite->texcell);
+    w.put(sprite->texsize);
+    w.put(sprite->depth);
+}
+
+void Sprite::SnapshotLoad(CSprite *sprite, SnapshotReader &r) {
+    sprite->wmat = mat3_identity();
+    sprite->size = r.get<vec2>();
+    sprite->texcell = r.get<vec2>();
+    sprite->texsize = r.get<vec2>();
+    sprite->depth = r.get<int>();
+}
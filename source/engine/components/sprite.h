@@ -16,12 +16,44 @@ struct CSprite : CEntityBase {
 
 static_assert(std::is_trivially_copyable_v<CSprite>);
 
+// 上传到 GPU 的精灵实例 只包含着色器使用的字段
+// 深度体现在实例的顺序中 不单独上传
+struct SpriteInstance {
+    f32 affine[6];  // 世界矩阵的前两行 按列存放 (a b c d tx ty)
+    vec2 size;
+    vec2 texcell;
+    vec2 texsize;
+};
+
+// 相距不超过这么多实例的脏区间合并为一次上传
+#define SPRITE_RANGE_MERGE_GAP 16
+// 区间过多时合并为一个 避免大量零碎的 glBufferSubData
+#define SPRITE_MAX_RANGES 64
+
+struct SpriteDirtyRange {
+    u32 begin, end;  // [begin, end) 实例下标
+};
+
 class Sprite : public SingletonClass<Sprite>, public ComponentTypeBase<CSprite> {
+private:
+    bool depth_dirty = false;  // 增删元素或修改深度后才需要重新排序
+    EntityPoolSortPath last_sort = EntityPoolSort_None;
+
+    Array<SpriteInstance> packed;        // 本帧打包的实例
+    Array<SpriteInstance> instances;     // 顶点缓冲区中的实例 上传后与 packed 交换
+    Array<SpriteDirtyRange> dirty_ranges;
+    u32 gpu_capacity = 0;  // 顶点缓冲区能容纳的实例数 只在上传时改变
+
+    void sprite_upload_instances();
+
 public:
     void sprite_init();
     void sprite_fini();
     int sprite_update_all(Event evt);
     void sprite_draw_all();
+    void sprite_sort();  // 按深度排序 (深度大的在前 相同时按 id) 没有改变时跳过
+    EntityPoolSortPath sprite_get_last_sort();
+    void sprite_pack_instances();  // 排序后打包可见的实例并计算需要上传的区间 不调用 GL 也不改变缓冲区的记录
 
     void sprite_set_atlas(const char *filename);
     const char *sprite_get_atlas();
@@ -39,4 +71,9 @@ public:
     int sprite_get_depth(CEntity ent);
 
     int Inspect(CEntity ent) override;
+
+    bool SnapshotEnabled() override { return true; }
+    void SnapshotSave(CSprite *sprite, SnapshotWriter &w) override;
+    void SnapshotLoad(CSprite *sprite, SnapshotReader &r) override;
+    void SnapshotLoadEnd() override { depth_dirty = true; }
 };
\ No newline at end of file
@@ -2,19 +2,23 @@
 
 #include "tiledmap.hpp"
 
+#include "base/common/job.hpp"
 #include "base/common/json.hpp"
 #include "base/common/profiler.hpp"
 #include "engine/bootstrap.h"
 #include "engine/ecs/entity.h"
+#include "engine/renderer/renderer.h"
 #include "engine/renderer/shader.h"
 #include "engine/physics.h"
 #include "engine/editor.h"
 #include "engine/scripting/lua_util.h"
 #include "engine/components/transform.h"
 #include "engine/components/camera.h"
+#include "engine/components/spatial.h"
 
 // deps
 #include <box2d/box2d.h>
+#include <miniz/miniz.h>
 
 static const_str S_UNKNOWN = "unknown";
 
@@ -244,6 +248,9 @@ void MapLdtk::trash() {
     bodies.trash();
     graph.trash();
     frontier.trash();
+    tile_grid_trash(&grid);
+    tile_grid_snapshot_release(grid_snapshot);
+    tile_hpa_trash(&hpa);
 
     arena.trash();
 }
@@ -256,7 +263,125 @@ void MapLdtk::destroy_bodies(b2World *world) {
 #endif
 }
 
+// 轮廓边的方向 +x +y -x -y 依次左转
+static const i32 contour_dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+void tile_contours_build(TileContours *out, const u8 *solid, i32 w, i32 h) {
+    PROFILE_FUNC();
+
+    out->points.len = 0;
+    out->ends.len = 0;
+
+    auto is_solid = [=](i32 x, i32 y) { return x >= 0 && y >= 0 && x < w && y < h && solid[y * w + x]; };
+
+    // 每个角点记录出边的方向位 实心格子与空格之间的每条边都是轮廓的一段
+    i32 vw = w + 1;
+    Array<u8> edges = {};
+    neko_defer(edges.trash());
+    edges.resize((u64)vw * (h + 1));
+    memset(edges.data, 0, edges.len);
+    for (i32 y = 0; y < h; y++) {
+        for (i32 x = 0; x < w; x++) {
+            if (!solid[y * w + x]) {
+                continue;
+            }
+            if (!is_solid(x, y - 1)) edges[y * vw + x] |= 1 << 0;
+            if (!is_solid(x + 1, y)) edges[y * vw + x + 1] |= 1 << 1;
+            if (!is_solid(x, y + 1)) edges[(y + 1) * vw + x + 1] |= 1 << 2;
+            if (!is_solid(x - 1, y)) edges[(y + 1) * vw + x] |= 1 << 3;
+        }
+    }
+
+    for (i32 start = 0; start < (i32)edges.len; start++) {
+        if (edges[start] == 0) {
+            continue;
+        }
+
+        i32 start_dir = 0;
+        while (!(edges[start] & (1 << start_dir))) start_dir++;
+
+        u64 first = out->points.len;
+        out->points.push(TilePoint{(float)(start % vw), (float)(start / vw)});
+
+        i32 v = start;
+        i32 d = start_dir;
+        while (true) {
+            edges[v] &= ~(1 << d);
+            v += contour_dirs[d][1] * vw + contour_dirs[d][0];
+
+            // 两块实心只在角上相接时 优先左转 让两边各自成环
+            u8 avail = edges[v] | (v == start ? 1 << start_dir : 0);
+            i32 next = -1;
+            for (i32 turn : {1, 0, 3}) {
+                if (avail & (1 << ((d + turn) & 3))) {
+                    next = (d + turn) & 3;
+                    break;
+                }
+            }
+            neko_assert(next >= 0);
+
+            if (v == start && next == start_dir) {
+                break;
+            }
+            if (next != d) {
+                out->points.push(TilePoint{(float)(v % vw), (float)(v / vw)});
+            }
+            d = next;
+        }
+
+        // 起点在直边中间时不是拐角
+        if (d == start_dir) {
+            memmove(&out->points[first], &out->points[first + 1], sizeof(TilePoint) * (out->points.len - first - 1));
+            out->points.len--;
+        }
+        out->ends.push((u32)out->points.len);
+    }
+}
+
+void tile_contours_trash(TileContours *contours) {
+    contours->points.trash();
+    contours->ends.trash();
+    *contours = {};
+}
+
 #ifdef NEKO_BOX2D
+static void make_chains_for_layer(b2Body *body, TilemapLayer *layer, float world_x, float world_y, float meter, Slice<TilemapInt> walls) {
+    PROFILE_FUNC();
+
+    bool is_wall[256] = {};
+    for (TilemapInt n : walls) is_wall[n] = true;
+
+    Array<u8> solid = {};
+    neko_defer(solid.trash());
+    solid.resize(layer->c_width * layer->c_height);
+    for (u64 i = 0; i < solid.len; i++) solid[i] = is_wall[layer->int_grid[i]];
+
+    TileContours contours = {};
+    neko_defer(tile_contours_trash(&contours));
+    tile_contours_build(&contours, solid.data, layer->c_width, layer->c_height);
+
+    Array<b2Vec2> vertices = {};
+    neko_defer(vertices.trash());
+    u32 begin = 0;
+    for (u32 end : contours.ends) {
+        vertices.len = 0;
+        for (u32 i = begin; i < end; i++) {
+            TilePoint p = contours.points[i];
+            vertices.push(b2Vec2{(p.x * layer->grid_size + world_x) / meter, (p.y * layer->grid_size + world_y) / meter});
+        }
+        begin = end;
+
+        b2ChainShape chain;
+        chain.CreateLoop(vertices.data, (i32)vertices.len);
+
+        b2FixtureDef def = {};
+        def.friction = 0;
+        def.shape = &chain;
+
+        body->CreateFixture(&def);
+    }
+}
+
 static void make_collision_for_layer(b2Body *body, TilemapLayer *layer, float world_x, float world_y, float meter, Slice<TilemapInt> walls) {
     PROFILE_FUNC();
 
@@ -340,7 +465,7 @@ static void make_collision_for_layer(b2Body *body, TilemapLayer *layer, float wo
 }
 #endif
 
-void MapLdtk::make_collision(b2World *world, float meter, String layer_name, Slice<TilemapInt> walls) {
+void MapLdtk::make_collision(b2World *world, float meter, String layer_name, Slice<TilemapInt> walls, TileCollisionMode mode) {
     PROFILE_FUNC();
 
 #ifdef NEKO_BOX2D
@@ -361,7 +486,11 @@ void MapLdtk::make_collision(b2World *world, float meter, String layer_name, Sli
     for (TilemapLevel &level : levels) {
         for (TilemapLayer &l : level.layers) {
             if (l.identifier == layer_name) {
-                make_collision_for_layer(body, &l, level.world_x, level.world_y, meter, walls);
+                if (mode == TileCollision_Chains) {
+                    make_chains_for_layer(body, &l, level.world_x, level.world_y, meter, walls);
+                } else {
+                    make_collision_for_layer(body, &l, level.world_x, level.world_y, meter, walls);
+                }
             }
         }
     }
@@ -387,8 +516,8 @@ static void make_graph_for_layer(HashMap<TileNode> *graph, TilemapLayer *layer,
             float cost = get_tile_cost(layer->int_grid[y * layer->c_width + x], costs);
             if (cost > 0) {
                 TileNode node = {};
-                node.x = (i32)(x + world_x);
-                node.y = (i32)(y + world_x);
+                node.x = (i32)(x + world_x / layer->grid_size);
+                node.y = (i32)(y + world_y / layer->grid_size);
                 node.cost = cost;
 
                 (*graph)[tile_key(node.x, node.y)] = node;
@@ -457,6 +586,45 @@ static void create_neighbor_nodes(HashMap<TileNode> *graph, Arena *arena, i32 bl
     }
 }
 
+// 覆盖所有同名图层的稠密网格
+static void make_grid_for_layers(TileGrid *grid, Slice<TilemapLevel> levels, String layer_name, Slice<TileCost> costs) {
+    PROFILE_FUNC();
+
+    i32 x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+    for (TilemapLevel &level : levels) {
+        for (TilemapLayer &l : level.layers) {
+            if (l.identifier == layer_name) {
+                i32 lx = (i32)(level.world_x / l.grid_size);
+                i32 ly = (i32)(level.world_y / l.grid_size);
+                x0 = NEKO_MIN(x0, lx);
+                y0 = NEKO_MIN(y0, ly);
+                x1 = NEKO_MAX(x1, lx + l.c_width);
+                y1 = NEKO_MAX(y1, ly + l.c_height);
+            }
+        }
+    }
+
+    if (x0 >= x1 || y0 >= y1) {
+        tile_grid_trash(grid);
+        return;
+    }
+
+    tile_grid_init(grid, x0, y0, x1 - x0, y1 - y0);
+    for (TilemapLevel &level : levels) {
+        for (TilemapLayer &l : level.layers) {
+            if (l.identifier == layer_name) {
+                i32 lx = (i32)(level.world_x / l.grid_size);
+                i32 ly = (i32)(level.world_y / l.grid_size);
+                for (i32 y = 0; y < l.c_height; y++) {
+                    for (i32 x = 0; x < l.c_width; x++) {
+                        tile_grid_set_cost(grid, lx + x, ly + y, get_tile_cost(l.int_grid[y * l.c_width + x], costs));
+                    }
+                }
+            }
+        }
+    }
+}
+
 void MapLdtk::make_graph(i32 bloom, String layer_name, Slice<TileCost> costs) {
     for (TilemapLevel &level : levels) {
         for (TilemapLayer &l : level.layers) {
@@ -470,6 +638,17 @@ void MapLdtk::make_graph(i32 bloom, String layer_name, Slice<TileCost> costs) {
     }
 
     create_neighbor_nodes(&graph, &arena, bloom);
+
+    graph_bloom = bloom;
+    make_grid_for_layers(&grid, levels, layer_name, costs);
+
+    // 已提交的异步查询继续持有旧快照
+    tile_grid_snapshot_release(grid_snapshot);
+    grid_snapshot = nullptr;
+
+    if (hpa.cluster > 0) {
+        tile_hpa_build(&hpa, &grid, hpa.cluster);
+    }
 }
 
 static float tile_distance(TileNode *lhs, TileNode *rhs) {
@@ -514,289 +693,1477 @@ TileNode *MapLdtk::astar(TilePoint start, TilePoint goal) {
         return nullptr;
     }
 
-    TileNode *begin = graph.get(tile_key(sx, sy));
-    if (begin == nullptr) {
-        return nullptr;
+    TileNode *begin = graph.get(tile_key(sx, sy));
+    if (begin == nullptr) {
+        return nullptr;
+    }
+
+    float g = 0;
+    float h = tile_heuristic(begin, end);
+    float f = g + h;
+    begin->g = 0;
+    begin->flags |= TileNodeFlags_Open;
+    frontier.push(begin, f);
+
+    while (frontier.len != 0) {
+        TileNode *top = nullptr;
+        frontier.pop(&top);
+        top->flags |= TileNodeFlags_Closed;
+
+        if (top == end) {
+            return top;
+        }
+
+        for (TileNode *next : top->neighbors) {
+            if (next->flags & TileNodeFlags_Closed) {
+                continue;
+            }
+
+            float g = top->g + next->cost * tile_distance(top, next);
+
+            bool open = next->flags & TileNodeFlags_Open;
+            if (!open || g < next->g) {
+                float h = tile_heuristic(next, end);
+                float f = g + h;
+
+                next->g = g;
+                next->prev = top;
+                next->flags |= TileNodeFlags_Open;
+
+                frontier.push(next, f);
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// -------------------------------------------------------------------------
+// 稠密网格寻路
+
+void tile_grid_init(TileGrid *grid, i32 x0, i32 y0, i32 w, i32 h) {
+    tile_grid_trash(grid);
+
+    grid->x0 = x0;
+    grid->y0 = y0;
+    grid->w = w;
+    grid->h = h;
+    grid->cost = (float *)mem_alloc(sizeof(float) * w * h);
+    memset(grid->cost, 0, sizeof(float) * w * h);
+    grid->cost_dirty = true;
+}
+
+void tile_grid_trash(TileGrid *grid) {
+    mem_free(grid->cost);
+    tile_grid_search_trash(&grid->search);
+    *grid = {};
+}
+
+void tile_grid_search_trash(TileGridSearch *s) {
+    mem_free(s->g);
+    mem_free(s->prev);
+    mem_free(s->gen);
+    mem_free(s->flags);
+    s->frontier.trash();
+    s->jumps.trash();
+    *s = {};
+}
+
+void tile_grid_set_cost(TileGrid *grid, i32 x, i32 y, float cost) {
+    x -= grid->x0;
+    y -= grid->y0;
+    if (x < 0 || y < 0 || x >= grid->w || y >= grid->h) {
+        return;
+    }
+    grid->cost[y * grid->w + x] = cost;
+    grid->cost_dirty = true;
+}
+
+float tile_grid_get_cost(TileGrid *grid, i32 x, i32 y) {
+    x -= grid->x0;
+    y -= grid->y0;
+    if (x < 0 || y < 0 || x >= grid->w || y >= grid->h) {
+        return -1;
+    }
+    return grid->cost[y * grid->w + x];
+}
+
+static inline bool tile_grid_walkable(const TileGrid *grid, i32 x, i32 y) { return x >= 0 && y >= 0 && x < grid->w && y < grid->h && grid->cost[y * grid->w + x] > 0; }
+
+static inline float tile_grid_octile(i32 dx, i32 dy) {
+    float ax = (float)abs(dx);
+    float ay = (float)abs(dy);
+    return (ax + ay) + (1.4142135f - 2) * fminf(ax, ay);
+}
+
+static inline i32 tile_sign(i32 v) { return (v > 0) - (v < 0); }
+
+void tile_grid_prepare(TileGrid *grid) {
+    if (!grid->cost_dirty) {
+        return;
+    }
+
+    float uniform = 0;
+    for (i32 i = 0; i < grid->w * grid->h; i++) {
+        float c = grid->cost[i];
+        if (c <= 0) {
+            continue;
+        }
+        if (uniform == 0) {
+            uniform = c;
+        } else if (c != uniform) {
+            uniform = 0;
+            break;
+        }
+    }
+    grid->uniform_cost = uniform;
+    grid->cost_dirty = false;
+}
+
+// 新的一次查询 节点数变多时重新分配 generation 回绕时清零
+static void tile_grid_begin(TileGridSearch *s, u64 n) {
+    if (n > s->capacity) {
+        mem_free(s->g);
+        mem_free(s->prev);
+        mem_free(s->gen);
+        mem_free(s->flags);
+        s->g = (float *)mem_alloc(sizeof(float) * n);
+        s->prev = (i32 *)mem_alloc(sizeof(i32) * n);
+        s->gen = (u32 *)mem_alloc(sizeof(u32) * n);
+        s->flags = (u8 *)mem_alloc(sizeof(u8) * n);
+        memset(s->gen, 0, sizeof(u32) * n);
+        s->capacity = n;
+        s->generation = 0;
+    }
+
+    s->generation++;
+    if (s->generation == 0) {
+        memset(s->gen, 0, sizeof(u32) * s->capacity);
+        s->generation = 1;
+    }
+    s->frontier.len = 0;
+    s->stats = {};
+}
+
+static void tile_grid_visit(TileGridSearch *s, i32 i, i32 from, float g, float h) {
+    if (s->gen[i] != s->generation) {
+        s->gen[i] = s->generation;
+        s->flags[i] = 0;
+    } else if (s->flags[i] & TileNodeFlags_Closed) {
+        return;
+    } else if ((s->flags[i] & TileNodeFlags_Open) && g >= s->g[i]) {
+        return;
+    }
+
+    s->g[i] = g;
+    s->prev[i] = from;
+    s->flags[i] |= TileNodeFlags_Open;
+    s->frontier.push(i, g + h);
+    s->stats.pushed++;
+}
+
+static const i32 tile_dirs[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {-1, 1}, {1, -1}, {-1, -1}};
+
+static void tile_grid_expand_astar(const TileGrid *grid, TileGridSearch *s, i32 i, i32 ex, i32 ey) {
+    i32 x = i % grid->w;
+    i32 y = i / grid->w;
+
+    for (i32 d = 0; d < 8; d++) {
+        i32 dx = tile_dirs[d][0];
+        i32 dy = tile_dirs[d][1];
+        i32 nx = x + dx;
+        i32 ny = y + dy;
+        if (!tile_grid_walkable(grid, nx, ny)) {
+            continue;
+        }
+
+        bool diagonal = dx != 0 && dy != 0;
+        if (diagonal && (!tile_grid_walkable(grid, nx, y) || !tile_grid_walkable(grid, x, ny))) {
+            continue;
+        }
+
+        i32 n = ny * grid->w + nx;
+        float g = s->g[i] + grid->cost[n] * (diagonal ? 1.4142135f : 1.0f);
+        tile_grid_visit(s, n, i, g, tile_grid_octile(ex - nx, ey - ny));
+    }
+}
+
+// 沿水平或竖直方向跳跃 返回跳点下标 没有时为 -1
+static i32 tile_grid_jump_straight(const TileGrid *grid, i32 x, i32 y, i32 dx, i32 dy, i32 ex, i32 ey) {
+    for (;;) {
+        x += dx;
+        y += dy;
+        if (!tile_grid_walkable(grid, x, y)) {
+            return -1;
+        }
+        if (x == ex && y == ey) {
+            return y * grid->w + x;
+        }
+
+        // 强制邻居: 侧面可通行而其后方被挡住
+        if (dx != 0) {
+            if ((tile_grid_walkable(grid, x, y - 1) && !tile_grid_walkable(grid, x - dx, y - 1)) ||
+                (tile_grid_walkable(grid, x, y + 1) && !tile_grid_walkable(grid, x - dx, y + 1))) {
+                return y * grid->w + x;
+            }
+        } else {
+            if ((tile_grid_walkable(grid, x - 1, y) && !tile_grid_walkable(grid, x - 1, y - dy)) ||
+                (tile_grid_walkable(grid, x + 1, y) && !tile_grid_walkable(grid, x + 1, y - dy))) {
+                return y * grid->w + x;
+            }
+        }
+    }
+}
+
+static i32 tile_grid_jump_diagonal(const TileGrid *grid, i32 x, i32 y, i32 dx, i32 dy, i32 ex, i32 ey) {
+    for (;;) {
+        if (!tile_grid_walkable(grid, x + dx, y) || !tile_grid_walkable(grid, x, y + dy)) {
+            return -1;
+        }
+        x += dx;
+        y += dy;
+        if (!tile_grid_walkable(grid, x, y)) {
+            return -1;
+        }
+        if (x == ex && y == ey) {
+            return y * grid->w + x;
+        }
+        if (tile_grid_jump_straight(grid, x, y, dx, 0, ex, ey) >= 0 || tile_grid_jump_straight(grid, x, y, 0, dy, ex, ey) >= 0) {
+            return y * grid->w + x;
+        }
+    }
+}
+
+static void tile_grid_expand_jps(const TileGrid *grid, TileGridSearch *s, i32 i, i32 ex, i32 ey) {
+    i32 x = i % grid->w;
+    i32 y = i / grid->w;
+
+    // 按来向裁剪邻居 起点展开全部方向
+    i32 dirs[8][2];
+    i32 count = 0;
+    auto add = [&](i32 dx, i32 dy) {
+        dirs[count][0] = dx;
+        dirs[count][1] = dy;
+        count++;
+    };
+
+    i32 p = s->prev[i];
+    if (p < 0) {
+        for (i32 d = 0; d < 8; d++) add(tile_dirs[d][0], tile_dirs[d][1]);
+    } else {
+        i32 dx = tile_sign(x - p % grid->w);
+        i32 dy = tile_sign(y - p / grid->w);
+        if (dx != 0 && dy != 0) {
+            add(dx, 0);
+            add(0, dy);
+            add(dx, dy);
+        } else if (dx != 0) {
+            add(dx, 0);
+            add(dx, 1);
+            add(dx, -1);
+            add(0, 1);
+            add(0, -1);
+        } else {
+            add(0, dy);
+            add(1, dy);
+            add(-1, dy);
+            add(1, 0);
+            add(-1, 0);
+        }
+    }
+
+    for (i32 d = 0; d < count; d++) {
+        i32 dx = dirs[d][0];
+        i32 dy = dirs[d][1];
+        i32 j = dx != 0 && dy != 0 ? tile_grid_jump_diagonal(grid, x, y, dx, dy, ex, ey) : tile_grid_jump_straight(grid, x, y, dx, dy, ex, ey);
+        if (j < 0) {
+            continue;
+        }
+
+        i32 jx = j % grid->w;
+        i32 jy = j / grid->w;
+        float g = s->g[i] + grid->uniform_cost * tile_grid_octile(jx - x, jy - y);
+        tile_grid_visit(s, j, i, g, tile_grid_octile(ex - jx, ey - jy));
+    }
+}
+
+bool tile_grid_search(const TileGrid *grid, TileGridSearch *s, i32 sx, i32 sy, i32 ex, i32 ey, TileGridMode mode, Array<TilePoint> *out) {
+    PROFILE_FUNC();
+
+    out->len = 0;
+    sx -= grid->x0;
+    sy -= grid->y0;
+    ex -= grid->x0;
+    ey -= grid->y0;
+    if (!tile_grid_walkable(grid, sx, sy) || !tile_grid_walkable(grid, ex, ey)) {
+        return false;
+    }
+
+    neko_assert(!grid->cost_dirty);
+    bool jps = mode == TileGridMode_JPS && grid->uniform_cost > 0;
+
+    tile_grid_begin(s, (u64)grid->w * grid->h);
+
+    i32 begin = sy * grid->w + sx;
+    i32 end = ey * grid->w + ex;
+    tile_grid_visit(s, begin, -1, 0, tile_grid_octile(ex - sx, ey - sy));
+
+    bool found = false;
+    i32 top = -1;
+    while (s->frontier.pop(&top)) {
+        if (s->flags[top] & TileNodeFlags_Closed) {
+            continue;  // 同一节点的旧条目
+        }
+        s->flags[top] |= TileNodeFlags_Closed;
+        s->stats.expanded++;
+
+        if (top == end) {
+            found = true;
+            break;
+        }
+
+        if (jps) {
+            tile_grid_expand_jps(grid, s, top, ex, ey);
+        } else {
+            tile_grid_expand_astar(grid, s, top, ex, ey);
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    // 回溯跳点 再逐格补全 (跳点之间都是直线或对角线)
+    s->jumps.len = 0;
+    for (i32 i = end; i >= 0; i = s->prev[i]) {
+        s->jumps.push(i);
+    }
+
+    i32 x = sx;
+    i32 y = sy;
+    out->push(TilePoint{(float)(x + grid->x0), (float)(y + grid->y0)});
+    for (i64 k = (i64)s->jumps.len - 2; k >= 0; k--) {
+        i32 jx = s->jumps[k] % grid->w;
+        i32 jy = s->jumps[k] / grid->w;
+        while (x != jx || y != jy) {
+            x += tile_sign(jx - x);
+            y += tile_sign(jy - y);
+            out->push(TilePoint{(float)(x + grid->x0), (float)(y + grid->y0)});
+        }
+    }
+    return true;
+}
+
+bool tile_grid_find_path(TileGrid *grid, i32 sx, i32 sy, i32 ex, i32 ey, TileGridMode mode, Array<TilePoint> *out) {
+    tile_grid_prepare(grid);
+    return tile_grid_search(grid, &grid->search, sx, sy, ex, ey, mode, out);
+}
+
+TileGridSnapshot *tile_grid_snapshot(TileGrid *grid, float cell_size) {
+    tile_grid_prepare(grid);
+
+    TileGridSnapshot *snapshot = (TileGridSnapshot *)mem_alloc(sizeof(TileGridSnapshot));
+    *snapshot = {};
+    snapshot->grid.x0 = grid->x0;
+    snapshot->grid.y0 = grid->y0;
+    snapshot->grid.w = grid->w;
+    snapshot->grid.h = grid->h;
+    snapshot->grid.cost = (float *)mem_alloc(sizeof(float) * grid->w * grid->h);
+    memcpy(snapshot->grid.cost, grid->cost, sizeof(float) * grid->w * grid->h);
+    snapshot->grid.uniform_cost = grid->uniform_cost;
+    snapshot->cell_size = cell_size;
+    snapshot->refs = 1;
+    return snapshot;
+}
+
+void tile_grid_snapshot_retain(TileGridSnapshot *snapshot) { snapshot->refs++; }
+
+void tile_grid_snapshot_release(TileGridSnapshot *snapshot) {
+    if (snapshot == nullptr || --snapshot->refs > 0) {
+        return;
+    }
+    tile_grid_trash(&snapshot->grid);
+    mem_free(snapshot);
+}
+
+// -------------------------------------------------------------------------
+
+bool tile_flow_build(TileFlowField *flow, const TileGrid *grid, TileGridSearch *s, i32 gx, i32 gy) {
+    PROFILE_FUNC();
+
+    u64 n = (u64)grid->w * grid->h;
+    flow->x0 = grid->x0;
+    flow->y0 = grid->y0;
+    flow->w = grid->w;
+    flow->h = grid->h;
+    flow->gx = gx;
+    flow->gy = gy;
+    flow->reached = 0;
+    flow->integration.resize(n);
+    flow->dir.resize(n);
+    for (u64 i = 0; i < n; i++) flow->integration[i] = -1;
+    memset(flow->dir.data, -1, n);
+
+    gx -= grid->x0;
+    gy -= grid->y0;
+    if (!tile_grid_walkable(grid, gx, gy)) {
+        return false;
+    }
+
+    neko_assert(!grid->cost_dirty);
+
+    // 反向搜索 邻格走到当前格的代价取当前格
+    tile_grid_begin(s, n);
+    tile_grid_visit(s, gy * grid->w + gx, -1, 0, 0);
+
+    i32 top = -1;
+    while (s->frontier.pop(&top)) {
+        if (s->flags[top] & TileNodeFlags_Closed) {
+            continue;
+        }
+        s->flags[top] |= TileNodeFlags_Closed;
+        s->stats.expanded++;
+
+        i32 x = top % grid->w;
+        i32 y = top / grid->w;
+        float cost = grid->cost[top];
+        for (i32 d = 0; d < 8; d++) {
+            i32 dx = tile_dirs[d][0];
+            i32 dy = tile_dirs[d][1];
+            if (!tile_grid_walkable(grid, x + dx, y + dy)) {
+                continue;
+            }
+
+            bool diagonal = dx != 0 && dy != 0;
+            if (diagonal && (!tile_grid_walkable(grid, x + dx, y) || !tile_grid_walkable(grid, x, y + dy))) {
+                continue;
+            }
+            tile_grid_visit(s, (y + dy) * grid->w + x + dx, top, s->g[top] + cost * (diagonal ? 1.4142135f : 1.0f), 0);
+        }
+    }
+
+    // 前驱即为下一步 方向为 tile_dirs 的反向查表
+    static const i8 dir_index[3][3] = {{7, 3, 6}, {1, -1, 0}, {5, 2, 4}};
+    for (u64 i = 0; i < n; i++) {
+        if (s->gen[i] != s->generation || !(s->flags[i] & TileNodeFlags_Closed)) {
+            continue;
+        }
+        flow->integration[i] = s->g[i];
+        flow->reached++;
+
+        i32 next = s->prev[i];
+        if (next >= 0) {
+            i32 dx = next % grid->w - (i32)(i % grid->w);
+            i32 dy = next / grid->w - (i32)(i / grid->w);
+            flow->dir[i] = dir_index[dy + 1][dx + 1];
+        }
+    }
+    return true;
+}
+
+void tile_flow_trash(TileFlowField *flow) {
+    flow->integration.trash();
+    flow->dir.trash();
+    *flow = {};
+}
+
+bool tile_flow_sample(const TileFlowField *flow, i32 x, i32 y, i32 *dx, i32 *dy) {
+    x -= flow->x0;
+    y -= flow->y0;
+    if (x < 0 || y < 0 || x >= flow->w || y >= flow->h) {
+        return false;
+    }
+
+    i8 d = flow->dir.data[y * flow->w + x];
+    if (d < 0) {
+        return false;
+    }
+    *dx = tile_dirs[d][0];
+    *dy = tile_dirs[d][1];
+    return true;
+}
+
+float tile_flow_cost(const TileFlowField *flow, i32 x, i32 y) {
+    x -= flow->x0;
+    y -= flow->y0;
+    if (x < 0 || y < 0 || x >= flow->w || y >= flow->h) {
+        return -1;
+    }
+    return flow->integration.data[y * flow->w + x];
+}
+
+// -------------------------------------------------------------------------
+// 分层寻路
+
+static TileHpaNode *tile_hpa_new_node(TileHpa *hpa, i32 cell, i32 cluster, i32 boundary, i32 *index) {
+    if (hpa->free_nodes.len > 0) {
+        *index = hpa->free_nodes[--hpa->free_nodes.len];
+    } else {
+        *index = (i32)hpa->nodes.len;
+        hpa->nodes.push(TileHpaNode{});
+    }
+
+    TileHpaNode *node = &hpa->nodes[*index];
+    node->cell = cell;
+    node->cluster = cluster;
+    node->boundary = boundary;
+    node->link = -1;
+    node->link_cost = 0;
+    node->edges.len = 0;
+    hpa->clusters[cluster].nodes.push(*index);
+    return node;
+}
+
+static void tile_hpa_remove_boundary_nodes(TileHpa *hpa, i32 cluster, i32 boundary) {
+    TileHpaCluster *c = &hpa->clusters[cluster];
+    u64 n = 0;
+    for (u64 i = 0; i < c->nodes.len; i++) {
+        i32 index = c->nodes[i];
+        if (hpa->nodes[index].boundary == boundary) {
+            hpa->nodes[index].cell = -1;
+            hpa->free_nodes.push(index);
+        } else {
+            c->nodes[n++] = index;
+        }
+    }
+    c->nodes.len = n;
+    c->dirty = true;
+}
+
+// 重新扫描一条边界 每段连续可通行的格子对较短时取中点 较长时取两端
+static void tile_hpa_build_boundary(TileHpa *hpa, const TileGrid *grid, i32 boundary) {
+    i32 a = boundary / 2;
+    bool right = boundary % 2 == 0;
+    i32 b = right ? a + 1 : a + hpa->cols;
+    tile_hpa_remove_boundary_nodes(hpa, a, boundary);
+    tile_hpa_remove_boundary_nodes(hpa, b, boundary);
+
+    TileHpaCluster *ca = &hpa->clusters[a];
+    i32 len = right ? ca->h : ca->w;
+
+    auto cells = [&](i32 i, i32 *pa, i32 *pb) {
+        i32 x = right ? ca->x0 + ca->w - 1 : ca->x0 + i;
+        i32 y = right ? ca->y0 + i : ca->y0 + ca->h - 1;
+        *pa = y * grid->w + x;
+        *pb = right ? *pa + 1 : *pa + grid->w;
+        return grid->cost[*pa] > 0 && grid->cost[*pb] > 0;
+    };
+
+    auto entrance = [&](i32 i) {
+        i32 pa, pb, ia, ib;
+        cells(i, &pa, &pb);
+        TileHpaNode *na = tile_hpa_new_node(hpa, pa, a, boundary, &ia);
+        TileHpaNode *nb = tile_hpa_new_node(hpa, pb, b, boundary, &ib);
+        na = &hpa->nodes[ia];  // nodes 可能已重新分配
+        na->link = ib;
+        na->link_cost = grid->cost[pb];
+        nb->link = ia;
+        nb->link_cost = grid->cost[pa];
+    };
+
+    i32 run = -1;
+    for (i32 i = 0; i <= len; i++) {
+        i32 pa, pb;
+        bool open = i < len && cells(i, &pa, &pb);
+        if (open && run < 0) {
+            run = i;
+        } else if (!open && run >= 0) {
+            if (i - run < 6) {
+                entrance((run + i - 1) / 2);
+            } else {
+                entrance(run);
+                entrance(i - 1);
+            }
+            run = -1;
+        }
+    }
+}
+
+static inline i32 tile_hpa_local_index(const TileGrid *grid, TileHpaCluster *c, i32 cell) { return (cell / grid->w - c->y0) * c->w + (cell % grid->w - c->x0); }
+
+// 只在簇内移动的搜索 to >= 0 时为 A* 否则为 Dijkstra 直到 targets 全部确定
+// reverse 时计算各格到 from 的代价 (代价取出发格)
+static bool tile_hpa_local_search(TileHpaScratch *w, const TileGrid *grid, TileHpaCluster *c, i32 from, i32 to, bool reverse, const i32 *targets, u64 target_count) {
+    TileGridSearch *s = &w->search;
+    tile_grid_begin(s, (u64)c->w * c->h);
+
+    i32 tx = to >= 0 ? to % grid->w : 0;
+    i32 ty = to >= 0 ? to / grid->w : 0;
+    i32 goal = to >= 0 ? tile_hpa_local_index(grid, c, to) : -1;
+    auto heuristic = [&](i32 x, i32 y) { return to >= 0 ? tile_grid_octile(tx - x, ty - y) : 0.0f; };
+
+    tile_grid_visit(s, tile_hpa_local_index(grid, c, from), -1, 0, heuristic(from % grid->w, from / grid->w));
+
+    // 目标格做标记 出队时直接判断 搜索结束后清除
+    u64 n = (u64)c->w * c->h;
+    if (w->target_mark.len < n) {
+        w->target_mark.resize(n);
+        memset(w->target_mark.data, 0, n);
+    }
+    u64 remaining = 0;
+    for (u64 i = 0; i < target_count; i++) {
+        u8 &mark = w->target_mark[tile_hpa_local_index(grid, c, targets[i])];
+        remaining += mark == 0;
+        mark = 1;
+    }
+
+    bool found = false;
+    i32 top = -1;
+    while (s->frontier.pop(&top)) {
+        if (s->flags[top] & TileNodeFlags_Closed) {
+            continue;
+        }
+        s->flags[top] |= TileNodeFlags_Closed;
+        s->stats.expanded++;
+
+        if (top == goal) {
+            found = true;
+            break;
+        }
+        if (w->target_mark[top] && --remaining == 0) {
+            break;
+        }
+
+        i32 x = c->x0 + top % c->w;
+        i32 y = c->y0 + top / c->w;
+        for (i32 d = 0; d < 8; d++) {
+            i32 dx = tile_dirs[d][0];
+            i32 dy = tile_dirs[d][1];
+            i32 nx = x + dx;
+            i32 ny = y + dy;
+            if (nx < c->x0 || ny < c->y0 || nx >= c->x0 + c->w || ny >= c->y0 + c->h || !tile_grid_walkable(grid, nx, ny)) {
+                continue;
+            }
+
+            bool diagonal = dx != 0 && dy != 0;
+            if (diagonal && (!tile_grid_walkable(grid, nx, y) || !tile_grid_walkable(grid, x, ny))) {
+                continue;
+            }
+
+            float cost = reverse ? grid->cost[y * grid->w + x] : grid->cost[ny * grid->w + nx];
+            i32 n = (ny - c->y0) * c->w + (nx - c->x0);
+            tile_grid_visit(s, n, top, s->g[top] + cost * (diagonal ? 1.4142135f : 1.0f), heuristic(nx, ny));
+        }
+    }
+
+    for (u64 i = 0; i < target_count; i++) {
+        w->target_mark[tile_hpa_local_index(grid, c, targets[i])] = 0;
+    }
+    return found;
+}
+
+// 最近一次簇内搜索中 cell 的代价 未确定时返回 false
+static bool tile_hpa_local_cost(TileHpaScratch *w, const TileGrid *grid, TileHpaCluster *c, i32 cell, float *cost) {
+    TileGridSearch *s = &w->search;
+    i32 i = tile_hpa_local_index(grid, c, cell);
+    if (s->gen[i] != s->generation || !(s->flags[i] & TileNodeFlags_Closed)) {
+        return false;
+    }
+    *cost = s->g[i];
+    return true;
+}
+
+static void tile_hpa_build_cluster(TileHpa *hpa, const TileGrid *grid, i32 cluster, TileHpaScratch *w) {
+    TileHpaCluster *c = &hpa->clusters[cluster];
+
+    Array<i32> cells = {};
+    neko_defer(cells.trash());
+    for (i32 n : c->nodes) cells.push(hpa->nodes[n].cell);
+
+    for (u64 i = 0; i < c->nodes.len; i++) {
+        TileHpaNode *node = &hpa->nodes[c->nodes[i]];
+        node->edges.len = 0;
+        tile_hpa_local_search(w, grid, c, node->cell, -1, false, cells.data, cells.len);
+
+        for (u64 j = 0; j < c->nodes.len; j++) {
+            float cost;
+            if (i != j && tile_hpa_local_cost(w, grid, c, cells[j], &cost)) {
+                node->edges.push(TileHpaEdge{c->nodes[j], cost});
+            }
+        }
+    }
+    c->dirty = false;
+}
+
+void tile_hpa_build(TileHpa *hpa, const TileGrid *grid, i32 cluster) {
+    PROFILE_FUNC();
+
+    tile_hpa_trash(hpa);
+    if (grid->cost == nullptr || cluster <= 0) {
+        return;
+    }
+
+    hpa->cluster = cluster;
+    hpa->cols = (grid->w + cluster - 1) / cluster;
+    hpa->rows = (grid->h + cluster - 1) / cluster;
+
+    for (i32 cy = 0; cy < hpa->rows; cy++) {
+        for (i32 cx = 0; cx < hpa->cols; cx++) {
+            TileHpaCluster c = {};
+            c.x0 = cx * cluster;
+            c.y0 = cy * cluster;
+            c.w = NEKO_MIN(cluster, grid->w - c.x0);
+            c.h = NEKO_MIN(cluster, grid->h - c.y0);
+            c.dirty = true;
+            hpa->clusters.push(c);
+
+            hpa->boundary_dirty.push(cx + 1 < hpa->cols);
+            hpa->boundary_dirty.push(cy + 1 < hpa->rows);
+        }
+    }
+
+    hpa->dirty = true;
+    tile_hpa_update(hpa, grid);
+}
+
+static void tile_hpa_scratch_trash(TileHpaScratch *w) {
+    tile_grid_search_trash(&w->search);
+    w->target_mark.trash();
+}
+
+void tile_hpa_trash(TileHpa *hpa) {
+    for (TileHpaNode &node : hpa->nodes) node.edges.trash();
+    for (TileHpaCluster &c : hpa->clusters) c.nodes.trash();
+    hpa->nodes.trash();
+    hpa->clusters.trash();
+    hpa->free_nodes.trash();
+    hpa->boundary_dirty.trash();
+    hpa->start_edges.trash();
+    hpa->goal_edges.trash();
+    hpa->route.trash();
+    tile_hpa_scratch_trash(&hpa->local);
+    for (TileHpaScratch &w : hpa->workers) tile_hpa_scratch_trash(&w);
+    hpa->workers.trash();
+    tile_grid_search_trash(&hpa->abstract);
+    *hpa = {};
+}
+
+void tile_hpa_set_cost(TileHpa *hpa, TileGrid *grid, i32 x, i32 y, float cost) {
+    tile_grid_set_cost(grid, x, y, cost);
+    if (hpa->cluster == 0) {
+        return;
+    }
+
+    x -= grid->x0;
+    y -= grid->y0;
+    if (x < 0 || y < 0 || x >= grid->w || y >= grid->h) {
+        return;
+    }
+
+    // 边界上的格子影响入口 簇内的格子只影响簇内代价
+    i32 cx = x / hpa->cluster;
+    i32 cy = y / hpa->cluster;
+    i32 index = cy * hpa->cols + cx;
+    TileHpaCluster *c = &hpa->clusters[index];
+    c->dirty = true;
+    if (x == c->x0 + c->w - 1 && cx + 1 < hpa->cols) hpa->boundary_dirty[index * 2] = true;
+    if (x == c->x0 && cx > 0) hpa->boundary_dirty[(index - 1) * 2] = true;
+    if (y == c->y0 + c->h - 1 && cy + 1 < hpa->rows) hpa->boundary_dirty[index * 2 + 1] = true;
+    if (y == c->y0 && cy > 0) hpa->boundary_dirty[(index - hpa->cols) * 2 + 1] = true;
+    hpa->dirty = true;
+}
+
+void tile_hpa_update(TileHpa *hpa, const TileGrid *grid) {
+    if (!hpa->dirty) {
+        return;
+    }
+
+    PROFILE_FUNC();
+
+    for (u64 b = 0; b < hpa->boundary_dirty.len; b++) {
+        if (hpa->boundary_dirty[b]) {
+            tile_hpa_build_boundary(hpa, grid, (i32)b);
+            hpa->boundary_dirty[b] = false;
+        }
+    }
+
+    Array<i32> dirty = {};
+    neko_defer(dirty.trash());
+    for (u64 i = 0; i < hpa->clusters.len; i++) {
+        if (hpa->clusters[i].dirty) dirty.push((i32)i);
+    }
+
+    // 各簇只写自己入口的边 簇较多时分到作业线程 每个作业组一份工作区
+    u32 count = (u32)dirty.len;
+    if (count < TILE_HPA_PARALLEL_MIN || Job::ThreadCount() == 0) {
+        for (i32 i : dirty) tile_hpa_build_cluster(hpa, grid, i, &hpa->local);
+    } else {
+        u32 groups = NEKO_MIN(count, Job::ThreadCount() * 4);
+        u32 group_size = (count + groups - 1) / groups;
+        groups = (count + group_size - 1) / group_size;
+        while (hpa->workers.len < groups) hpa->workers.push(TileHpaScratch{});
+
+        Job::Dispatch(count, group_size, [&](JobDispatchArgs args) { tile_hpa_build_cluster(hpa, grid, dirty[args.jobIndex], &hpa->workers[args.groupIndex]); });
+        Job::Wait();
+    }
+    hpa->stats.rebuilt_clusters = count;
+    hpa->stats.nodes = (u32)(hpa->nodes.len - hpa->free_nodes.len);
+    hpa->dirty = false;
+}
+
+// 最近一次簇内 A* 的路径接到 out 后面 (不含起点)
+static void tile_hpa_append_local(TileHpa *hpa, const TileGrid *grid, TileHpaCluster *c, i32 to, Array<TilePoint> *out) {
+    TileGridSearch *s = &hpa->local.search;
+    s->jumps.len = 0;
+    for (i32 i = tile_hpa_local_index(grid, c, to); i >= 0; i = s->prev[i]) {
+        s->jumps.push(i);
+    }
+    for (i64 k = (i64)s->jumps.len - 2; k >= 0; k--) {
+        i32 i = s->jumps[k];
+        out->push(TilePoint{(float)(c->x0 + i % c->w + grid->x0), (float)(c->y0 + i / c->w + grid->y0)});
+    }
+}
+
+// cell 到簇内各入口 (reverse 时为各入口到 cell) 的代价
+static void tile_hpa_connect(TileHpa *hpa, const TileGrid *grid, TileHpaCluster *c, i32 cell, bool reverse, Array<TileHpaEdge> *edges) {
+    edges->len = 0;
+    if (c->nodes.len == 0) {
+        return;
+    }
+
+    hpa->route.len = 0;
+    for (i32 n : c->nodes) hpa->route.push(hpa->nodes[n].cell);
+
+    tile_hpa_local_search(&hpa->local, grid, c, cell, -1, reverse, hpa->route.data, hpa->route.len);
+    hpa->stats.expanded += hpa->local.search.stats.expanded;
+    for (u64 i = 0; i < c->nodes.len; i++) {
+        float cost;
+        if (tile_hpa_local_cost(&hpa->local, grid, c, hpa->route[i], &cost)) {
+            edges->push(TileHpaEdge{c->nodes[i], cost});
+        }
+    }
+}
+
+bool tile_hpa_find_path(TileHpa *hpa, const TileGrid *grid, i32 sx, i32 sy, i32 ex, i32 ey, Array<TilePoint> *out) {
+    PROFILE_FUNC();
+
+    out->len = 0;
+    hpa->stats.expanded = 0;
+    hpa->stats.abstract_expanded = 0;
+    if (hpa->cluster == 0) {
+        return false;
+    }
+
+    sx -= grid->x0;
+    sy -= grid->y0;
+    ex -= grid->x0;
+    ey -= grid->y0;
+    if (!tile_grid_walkable(grid, sx, sy) || !tile_grid_walkable(grid, ex, ey)) {
+        return false;
+    }
+
+    tile_hpa_update(hpa, grid);
+
+    i32 start = sy * grid->w + sx;
+    i32 end = ey * grid->w + ex;
+    TileHpaCluster *cs = &hpa->clusters[(sy / hpa->cluster) * hpa->cols + sx / hpa->cluster];
+    TileHpaCluster *ce = &hpa->clusters[(ey / hpa->cluster) * hpa->cols + ex / hpa->cluster];
+    out->push(TilePoint{(float)(sx + grid->x0), (float)(sy + grid->y0)});
+
+    // 同一簇内先直接搜索 不通时再经过其他簇
+    if (cs == ce) {
+        bool found = tile_hpa_local_search(&hpa->local, grid, cs, start, end, false, nullptr, 0);
+        hpa->stats.expanded += hpa->local.search.stats.expanded;
+        if (found) {
+            tile_hpa_append_local(hpa, grid, cs, end, out);
+            return true;
+        }
+    }
+
+    tile_hpa_connect(hpa, grid, cs, start, false, &hpa->start_edges);
+    tile_hpa_connect(hpa, grid, ce, end, true, &hpa->goal_edges);
+    if (hpa->start_edges.len == 0 || hpa->goal_edges.len == 0) {
+        out->len = 0;
+        return false;
+    }
+
+    // 入口图 A* 起点与终点为额外的两个节点
+    TileGridSearch *s = &hpa->abstract;
+    i32 begin_node = (i32)hpa->nodes.len;
+    i32 goal_node = begin_node + 1;
+    tile_grid_begin(s, (u64)goal_node + 1);
+
+    auto heuristic = [&](i32 cell) { return tile_grid_octile(ex - cell % grid->w, ey - cell / grid->w); };
+
+    tile_grid_visit(s, begin_node, -1, 0, heuristic(start));
+
+    bool found = false;
+    i32 top = -1;
+    while (s->frontier.pop(&top)) {
+        if (s->flags[top] & TileNodeFlags_Closed) {
+            continue;
+        }
+        s->flags[top] |= TileNodeFlags_Closed;
+        s->stats.expanded++;
+
+        if (top == goal_node) {
+            found = true;
+            break;
+        }
+
+        if (top == begin_node) {
+            for (TileHpaEdge e : hpa->start_edges) {
+                tile_grid_visit(s, e.to, top, e.cost, heuristic(hpa->nodes[e.to].cell));
+            }
+            continue;
+        }
+
+        TileHpaNode *node = &hpa->nodes[top];
+        tile_grid_visit(s, node->link, top, s->g[top] + node->link_cost, heuristic(hpa->nodes[node->link].cell));
+        for (TileHpaEdge e : node->edges) {
+            tile_grid_visit(s, e.to, top, s->g[top] + e.cost, heuristic(hpa->nodes[e.to].cell));
+        }
+        if (&hpa->clusters[node->cluster] == ce) {
+            for (TileHpaEdge e : hpa->goal_edges) {
+                if (e.to == top) {
+                    tile_grid_visit(s, goal_node, top, s->g[top] + e.cost, 0);
+                }
+            }
+        }
+    }
+
+    hpa->stats.abstract_expanded = s->stats.expanded;
+    hpa->stats.expanded += s->stats.expanded;
+    if (!found) {
+        out->len = 0;
+        return false;
     }
 
-    float g = 0;
-    float h = tile_heuristic(begin, end);
-    float f = g + h;
-    begin->g = 0;
-    begin->flags |= TileNodeFlags_Open;
-    frontier.push(begin, f);
+    // 回溯入口序列 跨边界的一步直接走 簇内的一段用簇内 A* 细化
+    hpa->route.len = 0;
+    for (i32 i = goal_node; i >= 0; i = s->prev[i]) {
+        hpa->route.push(i);
+    }
 
-    while (frontier.len != 0) {
-        TileNode *top = nullptr;
-        frontier.pop(&top);
-        top->flags |= TileNodeFlags_Closed;
+    i32 cell = start;
+    for (i64 k = (i64)hpa->route.len - 2; k >= 0; k--) {
+        i32 id = hpa->route[k];
+        i32 prev = hpa->route[k + 1];
+        i32 next = id == goal_node ? end : hpa->nodes[id].cell;
+        if (next == cell) {
+            continue;
+        }
 
-        if (top == end) {
-            return top;
+        if (prev != begin_node && hpa->nodes[prev].link == id) {
+            out->push(TilePoint{(float)(next % grid->w + grid->x0), (float)(next / grid->w + grid->y0)});
+        } else {
+            TileHpaCluster *c = prev == begin_node ? cs : &hpa->clusters[hpa->nodes[prev].cluster];
+            tile_hpa_local_search(&hpa->local, grid, c, cell, next, false, nullptr, 0);
+            hpa->stats.expanded += hpa->local.search.stats.expanded;
+            tile_hpa_append_local(hpa, grid, c, next, out);
         }
+        cell = next;
+    }
+    return true;
+}
 
-        for (TileNode *next : top->neighbors) {
-            if (next->flags & TileNodeFlags_Closed) {
-                continue;
-            }
+bool MapLdtk::astar_grid(TilePoint start, TilePoint goal, TileGridMode mode, Array<TilePoint> *out) {
+    if (grid.cost == nullptr) {
+        out->len = 0;
+        return false;
+    }
 
-            float g = top->g + next->cost * tile_distance(top, next);
+    i32 sx = (i32)(start.x / graph_grid_size);
+    i32 sy = (i32)(start.y / graph_grid_size);
+    i32 ex = (i32)(goal.x / graph_grid_size);
+    i32 ey = (i32)(goal.y / graph_grid_size);
+    return tile_grid_find_path(&grid, sx, sy, ex, ey, mode, out);
+}
 
-            bool open = next->flags & TileNodeFlags_Open;
-            if (!open || g < next->g) {
-                float h = tile_heuristic(next, end);
-                float f = g + h;
+void MapLdtk::make_hierarchy(i32 cluster_size) { tile_hpa_build(&hpa, &grid, cluster_size > 0 ? cluster_size : TILE_HPA_CLUSTER); }
 
-                next->g = g;
-                next->prev = top;
-                next->flags |= TileNodeFlags_Open;
+bool MapLdtk::astar_hierarchical(TilePoint start, TilePoint goal, Array<TilePoint> *out) {
+    i32 sx = (i32)(start.x / graph_grid_size);
+    i32 sy = (i32)(start.y / graph_grid_size);
+    i32 ex = (i32)(goal.x / graph_grid_size);
+    i32 ey = (i32)(goal.y / graph_grid_size);
+    return tile_hpa_find_path(&hpa, &grid, sx, sy, ex, ey, out);
+}
 
-                frontier.push(next, f);
-            }
-        }
+void MapLdtk::set_tile_cost(TilePoint p, float cost) {
+    if (grid.cost == nullptr) {
+        return;
     }
 
-    return nullptr;
+    tile_hpa_set_cost(&hpa, &grid, (i32)(p.x / graph_grid_size), (i32)(p.y / graph_grid_size), cost);
+
+    // 已提交的异步查询继续使用旧快照
+    tile_grid_snapshot_release(grid_snapshot);
+    grid_snapshot = nullptr;
+}
+
+TileGridSnapshot *MapLdtk::path_snapshot() {
+    if (grid_snapshot == nullptr && grid.cost != nullptr) {
+        grid_snapshot = tile_grid_snapshot(&grid, graph_grid_size);
+    }
+    return grid_snapshot;
 }
 
 // DECL_ENT(CTiledMap, tiled_renderer *render; vec2 pos; String map_name;);
 
 Asset CTiledMap::tiled_shader = {};
 
-bool tiled_load(TiledMap *map, const_str tmx_path, const_str res_path) {
-
-    PROFILE_FUNC();
+// TMX 图块 gid 的高 4 位为翻转/旋转标记
+#define TMX_GID_FLAGS 0xF0000000u
+
+// gid -> 图块集 每个地图构建一次
+// 与原来的规则一致: 取 first_gid 不大于 gid 的最大者 没有时为 0
+struct TmxGidTable {
+    Array<u32> table;  // 下标为 gid
+    u32 last;          // 超出表范围的 gid 使用 first_gid 最大的图块集
+    u32 tilesets;      // 构建时的图块集数量
+
+    u32 lookup(u32 gid) { return gid < table.len ? table[gid] : last; }
+};
+
+static void tmx_build_gid_table(TmxGidTable *t, TiledMap *map) {
+    u32 n = (u32)map->tilesets.len;
+    t->tilesets = n;
+    t->last = 0;
+    t->table.len = 0;
+    if (n == 0) return;
+
+    // 按 first_gid 排序的下标 图块集通常只有几个
+    Array<u32> order = {};
+    for (u32 i = 0; i < n; i++) {
+        u32 k = (u32)order.len;
+        order.push(i);
+        while (k > 0 && map->tilesets[order[k - 1]].first_gid > map->tilesets[i].first_gid) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = i;
+    }
 
-    map->doc.ParseVFS(tmx_path);
-    // if (!map->doc) {
-    //     neko_panic("Failed to parse XML");
-    //     return false;
-    // }
+    u32 max_gid = 0;
+    for (tileset_t &ts : map->tilesets) max_gid = NEKO_MAX(max_gid, ts.first_gid + NEKO_MAX(ts.tile_count, 1u));
 
-    char tmx_root_path[256];
-    if (NULL == res_path) {
-        neko_util_get_dir_from_file(tmx_root_path, 256, tmx_path);
-    } else {
-        strcpy(tmx_root_path, res_path);
+    t->table.resize(max_gid);
+    u32 g = 0;
+    for (; g < max_gid && g < map->tilesets[order[0]].first_gid; g++) t->table[g] = 0;
+    for (u32 k = 0; k < n; k++) {
+        u32 next = k + 1 < n ? map->tilesets[order[k + 1]].first_gid : max_gid;
+        for (; g < max_gid && g < next; g++) t->table[g] = order[k];
     }
+    t->last = order[n - 1];
+    order.trash();
+}
 
-    XMLNode *map_node = map->doc.FindNode("map");
-    neko_assert(map_node);  // Must have a map node!
-
-    for (auto it = map_node->MakeChildIter("tileset"); it.Next();) {
-        tileset_t tileset = {0};
+static bool tmx_decode_csv(String text, tile_t *tiles, u32 count, TmxGidTable *gids) {
+    const_str c = text.data;
+    const_str e = text.data + text.len;
 
-        tileset.first_gid = it.current->Attribute<double>("firstgid");
+    for (u32 i = 0; i < count; i++) {
+        while (c < e && (*c < '0' || *c > '9')) c++;
+        if (c >= e) return false;
 
-        char tileset_path[256];
-        neko_snprintf(tileset_path, 256, "%s/%s", tmx_root_path, it.current->Attribute<String>("source").data);
-        XMLDoc tileset_doc;
-        tileset_doc.ParseVFS(tileset_path);
-        // if (!tileset_doc) {
-        //     neko_panic("Failed to parse XML from %s", tileset_path);
-        //     return false;
-        // }
+        u32 gid = 0;
+        while (c < e && *c >= '0' && *c <= '9') gid = gid * 10 + (u32)(*c++ - '0');
 
-        XMLNode *tileset_node = tileset_doc.FindNode("tileset");
-        tileset.tile_width = tileset_node->Attribute<double>("tilewidth");
-        tileset.tile_height = tileset_node->Attribute<double>("tileheight");
-        tileset.tile_count = tileset_node->Attribute<double>("tilecount");
+        gid &= ~TMX_GID_FLAGS;
+        tiles[i].id = gid;
+        tiles[i].tileset_id = gids->lookup(gid);
+    }
+    return true;
+}
 
-        XMLNode *image_node = tileset_node->FindChild("image");
-        String image_path = image_node->Attribute<String>("source");
+struct TmxBase64Lut {
+    u8 v[256];  // 字符 -> 6 位值 不在字母表中为 0xff
+};
 
-        char full_image_path[256];
-        neko_snprintf(full_image_path, 256, "%s/%s", tmx_root_path, image_path.data);
+static constexpr TmxBase64Lut tmx_base64_lut_make() {
+    TmxBase64Lut lut = {};
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (u32 i = 0; i < 256; i++) lut.v[i] = 0xff;
+    for (u32 i = 0; i < 64; i++) lut.v[(u8)alphabet[i]] = (u8)i;
+    return lut;
+}
 
-        bool ok = neko_capi_vfs_file_exists("gamedata", full_image_path);
-        if (!ok) {
-            neko_panic("failed to load texture file: %s", full_image_path);
-            return false;
+// 编译期生成 地图可能在任务线程中加载
+static constexpr TmxBase64Lut tmx_base64_lut = tmx_base64_lut_make();
+
+// 返回写入的字节数 超出 cap 的部分丢弃
+static u64 tmx_decode_base64(String text, u8 *out, u64 cap) {
+    u64 n = 0;
+    u32 acc = 0, bits = 0;
+    for (u64 i = 0; i < text.len; i++) {
+        u8 v = tmx_base64_lut.v[(u8)text.data[i]];
+        if (v == 0xff) continue;  // 空白与填充
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n < cap) out[n] = (u8)(acc >> bits);
+            n++;
         }
+    }
+    return n;
+}
 
-        size_t len = 0;
-        const_str tex_data = neko_capi_vfs_read_file("gamedata", full_image_path, &len);
-        neko_assert(tex_data);
+// gzip 头之后是原始 deflate 数据
+static bool tmx_skip_gzip_header(const u8 **data, u64 *len) {
+    const u8 *p = *data;
+    const u8 *e = p + *len;
+    if (e - p < 10 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8) return false;
+
+    u8 flags = p[3];
+    p += 10;
+    if (flags & 4) {  // FEXTRA
+        if (e - p < 2) return false;
+        p += 2 + (p[0] | (p[1] << 8));
+    }
+    if (flags & 8) {  // FNAME
+        while (p < e && *p) p++;
+        p++;
+    }
+    if (flags & 16) {  // FCOMMENT
+        while (p < e && *p) p++;
+        p++;
+    }
+    if (flags & 2) p += 2;  // FHCRC
+    if (p >= e) return false;
 
-        neko_init_texture_from_memory(&tileset.texture, (u8 *)tex_data, len, TextureFlags(TEXTURE_ALIASED | TEXTURE_NO_FLIP_VERTICAL));
+    *len = e - p;
+    *data = p;
+    return true;
+}
 
-        tileset.width = tileset.texture.width;
-        tileset.height = tileset.texture.height;
+// base64 (可选 zlib/gzip 压缩) 的 gid 直接解码到图块数组中
+// gid 先写入数组的后半部分 再从前往后展开为 tile_t (写入位置不会超过尚未读取的 gid)
+static bool tmx_decode_base64_tiles(String text, String compression, tile_t *tiles, u32 count, TmxGidTable *gids) {
+    u64 bytes = (u64)count * sizeof(u32);
+    u8 *raw = (u8 *)tiles + (u64)count * sizeof(tile_t) - bytes;
 
-        mem_free(tex_data);
+    if (compression.len == 0) {
+        if (tmx_decode_base64(text, raw, bytes) < bytes) return false;
+    } else {
+        u64 cap = text.len / 4 * 3 + 3;
+        u8 *packed = (u8 *)mem_alloc(cap);
+        u64 len = tmx_decode_base64(text, packed, cap);
+
+        size_t out = TINFL_DECOMPRESS_MEM_TO_MEM_FAILED;
+        if (compression == "zlib") {
+            out = tinfl_decompress_mem_to_mem(raw, bytes, packed, len, TINFL_FLAG_PARSE_ZLIB_HEADER);
+        } else if (compression == "gzip") {
+            const u8 *data = packed;
+            if (tmx_skip_gzip_header(&data, &len)) out = tinfl_decompress_mem_to_mem(raw, bytes, data, len, 0);
+        } else {
+            LOG_WARN("unsupported tmx compression {}", std::string(compression.data, compression.len));
+        }
+        mem_free(packed);
 
-        map->tilesets.push(tileset);
+        if (out == TINFL_DECOMPRESS_MEM_TO_MEM_FAILED || out < bytes) return false;
+    }
 
-        tileset_doc.Trash();
+    for (u32 i = 0; i < count; i++) {
+        u32 gid;
+        memcpy(&gid, raw + (u64)i * sizeof(u32), sizeof(u32));  // 小端
+        gid &= ~TMX_GID_FLAGS;
+        tiles[i].id = gid;
+        tiles[i].tileset_id = gids->lookup(gid);
     }
+    return true;
+}
 
-    for (auto it = map_node->MakeChildIter("layer"); it.Next();) {
-        XMLNode *layer_node = it.current;
+// 跳过当前元素直到对应的结束标签
+static bool tmx_skip(XMLReader *r) {
+    for (int depth = 1; depth > 0;) {
+        switch (r->Next()) {
+            case XMLReader::XMLReader_Open:
+                depth++;
+                break;
+            case XMLReader::XMLReader_Close:
+                depth--;
+                break;
+            case XMLReader::XMLReader_Text:
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
 
-        layer_t layer = {0};
-        layer.tint = color256(255, 255, 255, 255);
+static bool tmx_load_image(tileset_t *tileset, const_str root_path, String image) {
+    char full_image_path[256];
+    neko_snprintf(full_image_path, 256, "%s/%.*s", root_path, (int)image.len, image.data);
 
-        layer.width = layer_node->Attribute<double>("width");
-        layer.height = layer_node->Attribute<double>("height");
+    bool ok = neko_capi_vfs_file_exists("gamedata", full_image_path);
+    if (!ok) {
+        neko_panic("failed to load texture file: %s", full_image_path);
+        return false;
+    }
 
-        XMLAttribute *tint_attrib = layer_node->FindAttribute("tintcolor");
-        if (tint_attrib) {
-            String hexstring = std::get<String>(tint_attrib->value);
-            u32 *cols = (u32 *)layer.tint.rgba;
-            *cols = (u32)strtol(hexstring.data + 1, NULL, 16);
-            layer.tint.a = 255;
-        }
+    size_t len = 0;
+    const_str tex_data = neko_capi_vfs_read_file("gamedata", full_image_path, &len);
+    neko_assert(tex_data);
 
-        XMLNode *data_node = layer_node->FindChild("data");
+    neko_init_texture_from_memory(&tileset->texture, (u8 *)tex_data, len, TextureFlags(TEXTURE_ALIASED | TEXTURE_NO_FLIP_VERTICAL));
 
-        String encoding = data_node->Attribute<String>("encoding");
+    tileset->width = tileset->texture.width;
+    tileset->height = tileset->texture.height;
 
-        if (strcmp(encoding.data, "csv") != 0) {
-            neko_panic("%s", "Only CSV data encoding is supported.");
-            return false;
+    mem_free(tex_data);
+    return true;
+}
+
+// r 位于 <tileset> 开始标签 读取到对应的结束标签
+static bool tmx_read_tileset(XMLReader *r, tileset_t *tileset, const_str root_path) {
+    tileset->tile_width = (u32)r->AttributeNumber("tilewidth");
+    tileset->tile_height = (u32)r->AttributeNumber("tileheight");
+    tileset->tile_count = (u32)r->AttributeNumber("tilecount");
+
+    bool has_image = false;
+    for (int depth = 1; depth > 0;) {
+        switch (r->Next()) {
+            case XMLReader::XMLReader_Open:
+                depth++;
+                if (depth == 2 && r->name == "image") {
+                    String image = {};
+                    if (r->Attribute("source", &image)) {
+                        if (!tmx_load_image(tileset, root_path, image)) return false;
+                        has_image = true;
+                    }
+                }
+                break;
+            case XMLReader::XMLReader_Close:
+                depth--;
+                break;
+            case XMLReader::XMLReader_Text:
+                break;
+            default:
+                return false;
         }
+    }
 
-        String data_text = data_node->text;
+    if (!has_image) {
+        neko_panic("%s", "tileset without image is not supported");
+        return false;
+    }
+    return true;
+}
 
-        const char *cd_ptr = data_text.data;
+static bool tmx_load_external_tileset(tileset_t *tileset, const_str root_path, String source) {
+    char tileset_path[256];
+    neko_snprintf(tileset_path, 256, "%s/%.*s", root_path, (int)source.len, source.data);
 
-        layer.tiles = (tile_t *)mem_alloc(layer.width * layer.height * sizeof(tile_t));
+    size_t size = 0;
+    const_str text = neko_capi_vfs_read_file("gamedata", tileset_path, &size);
+    if (!text) {
+        neko_panic("failed to read tileset: %s", tileset_path);
+        return false;
+    }
+    neko_defer(mem_free(text));
 
-        for (u32 y = 0; y < layer.height; y++) {
-            for (u32 x = 0; x < layer.width; x++) {
-                u32 gid = (u32)strtod(cd_ptr, NULL);
-                u32 tls_id = 0;
+    XMLReader r = {};
+    r.Init(String(text, size));
+    for (XMLReader::Token tok; (tok = r.Next()) != XMLReader::XMLReader_End;) {
+        if (tok == XMLReader::XMLReader_Error) break;
+        if (tok == XMLReader::XMLReader_Open && r.name == "tileset") return tmx_read_tileset(&r, tileset, root_path);
+    }
 
-                u32 closest = 0;
-                for (u32 i = 0; i < map->tilesets.len; i++) {
-                    if (map->tilesets[i].first_gid <= gid) {
-                        if (map->tilesets[i].first_gid > closest) {
-                            closest = map->tilesets[i].first_gid;
-                            tls_id = i;
-                        }
-                    }
-                }
+    neko_panic("no tileset in %s", tileset_path);
+    return false;
+}
 
-                layer.tiles[x + y * layer.width].id = gid;
-                layer.tiles[x + y * layer.width].tileset_id = tls_id;
+// r 位于 <layer> 开始标签
+static bool tmx_read_layer(XMLReader *r, TiledMap *map, TmxGidTable *gids) {
+    layer_t layer = {0};
+    layer.tint = color256(255, 255, 255, 255);
 
-                while (*cd_ptr && *cd_ptr != ',') {
-                    cd_ptr++;
-                }
+    layer.width = (u32)r->AttributeNumber("width");
+    layer.height = (u32)r->AttributeNumber("height");
 
-                cd_ptr++; /* Skip the comma. */
-            }
+    String tint = {};
+    if (r->Attribute("tintcolor", &tint) && tint.len > 1) {
+        u32 *cols = (u32 *)layer.tint.rgba;
+        *cols = (u32)strtoul(std::string(tint.data + 1, tint.len - 1).c_str(), NULL, 16);
+        layer.tint.a = 255;
+    }
+
+    u32 count = layer.width * layer.height;
+    layer.tiles = (tile_t *)mem_alloc((u64)count * sizeof(tile_t));
+    memset(layer.tiles, 0, (u64)count * sizeof(tile_t));
+
+    if (gids->tilesets != map->tilesets.len) tmx_build_gid_table(gids, map);
+
+    String encoding = {}, compression = {};
+    bool in_data = false, ok = true;
+    for (int depth = 1; ok && depth > 0;) {
+        switch (r->Next()) {
+            case XMLReader::XMLReader_Open:
+                depth++;
+                if (depth == 2 && r->name == "data") {
+                    in_data = true;
+                    r->Attribute("encoding", &encoding);
+                    r->Attribute("compression", &compression);
+                } else if (in_data && r->name == "chunk") {
+                    neko_panic("%s", "infinite tmx maps are not supported");
+                    ok = false;
+                }
+                break;
+            case XMLReader::XMLReader_Close:
+                depth--;
+                if (r->name == "data") in_data = false;
+                break;
+            case XMLReader::XMLReader_Text:
+                if (!in_data) break;
+                if (encoding == "csv") {
+                    ok = tmx_decode_csv(r->text, layer.tiles, count, gids);
+                } else if (encoding == "base64") {
+                    ok = tmx_decode_base64_tiles(r->text, compression, layer.tiles, count, gids);
+                } else {
+                    neko_panic("unsupported tmx data encoding: %.*s", (int)encoding.len, encoding.data);
+                    ok = false;
+                }
+                break;
+            default:
+                ok = false;
+                break;
         }
+    }
 
-        map->layers.push(layer);
+    if (!ok) {
+        mem_free(layer.tiles);
+        return false;
     }
 
-    for (auto it = map_node->MakeChildIter("objectgroup"); it.Next();) {
-        XMLNode *object_group_node = it.current;
+    map->layers.push(layer);
+    return true;
+}
 
-        object_group_t object_group = {};
-        object_group.color = color256(255, 255, 255, 255);
+static String tmx_property_value(XMLReader *r) {
+    String type = {}, value = {};
+    r->Attribute("type", &type);
+    if (!r->Attribute("value", &value)) return {};
 
-        // 对象组名字
-        XMLAttribute *name_attrib = object_group_node->FindAttribute("name");
-        if (name_attrib) {
-            object_group.name = std::get<String>(name_attrib->value);
-            // u32 *cols = (u32 *)object_group.color.rgba;
-            //*cols = (u32)strtol(hexstring + 1, NULL, 16);
-            // object_group.color.a = 128;
-            LOG_INFO("objectgroup: {}", object_group.name.cstr());
+    if (type == "float" || type == "int") {
+        return to_cstr(std::to_string(strtod(std::string(value.data, value.len).c_str(), NULL)));
+    }
+    return r->AttributeCopy("value", "");
+}
 
-        } else {
-            object_group.name = "unknown";
+// r 位于 <objectgroup> 开始标签
+static bool tmx_read_object_group(XMLReader *r, TiledMap *map) {
+    object_group_t object_group = {};
+    object_group.color = color256(255, 255, 255, 255);
+    object_group.name = r->AttributeCopy("name", S_UNKNOWN);
+    LOG_INFO("objectgroup: {}", object_group.name.cstr());
+
+    String color = {};
+    if (r->Attribute("color", &color)) object_group.color = ParseHexColor(std::string(color.data, color.len));
+
+    object_t object{};
+    bool in_object = false;
+    for (int depth = 1; depth > 0;) {
+        switch (r->Next()) {
+            case XMLReader::XMLReader_Open:
+                depth++;
+                if (depth == 2 && r->name == "object") {
+                    object = {};
+                    object.id = (u32)r->AttributeNumber("id");
+                    object.x = (i32)r->AttributeNumber("x");
+                    object.y = (i32)r->AttributeNumber("y");
+                    object.visible = (i32)r->AttributeNumber("visible", 1);
+                    object.width = (i32)r->AttributeNumber("width", 1);
+                    object.height = (i32)r->AttributeNumber("height", 1);
+                    object.name = r->AttributeCopy("name", S_UNKNOWN);
+                    object.class_name = r->AttributeCopy("type", S_UNKNOWN);
+                    LOG_INFO("{} {} {}", object_group.name.cstr(), object.name.cstr(), object.class_name.cstr());
+                    in_object = true;
+                } else if (in_object && r->name == "property") {
+                    String value = tmx_property_value(r);
+                    if (value.data) {
+                        object.properties.push({r->AttributeCopy("name", ""), value});
+                        LOG_INFO("{}={}", object.properties[object.properties.len - 1].key.cstr(), value.cstr());
+                    }
+                }
+                break;
+            case XMLReader::XMLReader_Close:
+                depth--;
+                if (depth == 1 && r->name == "object") {
+                    object_group.objects.push(object);
+                    in_object = false;
+                }
+                break;
+            case XMLReader::XMLReader_Text:
+                break;
+            default:
+                map->object_groups.push(object_group);  // 由 tiled_unload 释放
+                return false;
         }
+    }
 
-        // 对象组默认颜色
-        XMLAttribute *color_attrib = object_group_node->FindAttribute("color");
-        if (color_attrib) {
-            String hexstring = std::get<String>(color_attrib->value);
-            object_group.color = ParseHexColor(hexstring.cstr());
-        }
+    map->object_groups.push(object_group);
+    return true;
+}
 
-        // 对象
-        for (auto iit = object_group_node->MakeChildIter("object"); iit.Next();) {
-            XMLNode *object_node = iit.current;
+bool tiled_load_source(TiledMap *map, String source, const_str root_path) {
 
-            object_t object{};
-            object.id = object_node->Attribute<double>("id");
-            object.x = object_node->Attribute<double>("x");
-            object.y = object_node->Attribute<double>("y");
+    PROFILE_FUNC();
 
-            XMLAttribute *attrib;
-            if ((attrib = object_node->FindAttribute("visible"))) {
-                object.visible = std::get<double>(attrib->value);
-            } else {
-                object.visible = 1;
-            }
+    TmxGidTable gids = {};
+    neko_defer(gids.table.trash());
 
-            if ((attrib = object_node->FindAttribute("width"))) {
-                object.width = std::get<double>(attrib->value);
-            } else {
-                object.width = 1;
-            }
+    XMLReader r = {};
+    r.Init(source);
 
-            if ((attrib = object_node->FindAttribute("height"))) {
-                object.height = std::get<double>(attrib->value);
+    bool has_map = false;
+    for (XMLReader::Token tok; (tok = r.Next()) != XMLReader::XMLReader_End;) {
+        if (tok == XMLReader::XMLReader_Error) {
+            neko_panic("%s", "malformed tmx");
+            return false;
+        }
+        if (tok != XMLReader::XMLReader_Open) continue;
+
+        bool ok = true;
+        if (r.name == "map") {
+            has_map = true;
+        } else if (r.name == "tileset") {
+            tileset_t tileset = {0};
+            tileset.first_gid = (u32)r.AttributeNumber("firstgid");
+
+            String tileset_source = {};
+            if (r.Attribute("source", &tileset_source)) {
+                ok = tmx_load_external_tileset(&tileset, root_path, tileset_source) && tmx_skip(&r);
             } else {
-                object.height = 1;
+                ok = tmx_read_tileset(&r, &tileset, root_path);
             }
+            if (ok) map->tilesets.push(tileset);
+        } else if (r.name == "layer") {
+            ok = tmx_read_layer(&r, map, &gids);
+        } else if (r.name == "objectgroup") {
+            ok = tmx_read_object_group(&r, map);
+        }
 
-            if ((attrib = object_node->FindAttribute("name"))) {
-                object.name = std::get<String>(attrib->value);
-            } else {
-                object.name = S_UNKNOWN;
-            }
+        if (!ok) return false;
+    }
 
-            if ((attrib = object_node->FindAttribute("type"))) {
-                object.class_name = std::get<String>(attrib->value);
-            } else {
-                object.class_name = S_UNKNOWN;
-            }
+    neko_assert(has_map);  // Must have a map node!
+    return has_map;
+}
 
-            LOG_INFO("{} {} {}", object_group.name.cstr(), object.name.cstr(), object.class_name.cstr());
-
-            XMLNode *properties = object_node->FindChild("properties");
-            if (properties) {
-                for (auto it = properties->MakeChildIter("property"); it.Next();) {
-                    XMLNode *object_node = it.current;
-                    String property_name = std::get<String>(object_node->FindAttribute("name")->value);
-                    XMLAttribute *type_attr = object_node->FindAttribute("type");
-                    XMLAttribute *value_attr = object_node->FindAttribute("value");
-                    String type_name{};
-                    if (type_attr) {
-                        type_name = std::get<String>(type_attr->value);
-                    }
-                    if (value_attr) {
-                        try {
-                            String type_value{};
-                            if (type_name == "float" || type_name == "int") {
-                                type_value = std::to_string(std::get<double>(value_attr->value));
-                            } else if (type_name == "bool") {
-                                type_value = NEKO_BOOL_STR(std::get<bool>(value_attr->value));
-                            } else if (type_name == "object") {
-                                type_value = std::get<String>(value_attr->value);
-                            } else {  // 字符串
-                                type_value = std::get<String>(value_attr->value);
-                            }
-                            object.properties.push({property_name, type_value});
-                            LOG_INFO("{}={}", property_name.cstr(), type_value);
-                        } catch (...) {
-                        }
-                    }
-                }
-            }
+bool tiled_load(TiledMap *map, const_str tmx_path, const_str res_path) {
 
-            object_group.objects.push(object);
-        }
+    PROFILE_FUNC();
+
+    char tmx_root_path[256];
+    if (NULL == res_path) {
+        neko_util_get_dir_from_file(tmx_root_path, 256, tmx_path);
+    } else {
+        strcpy(tmx_root_path, res_path);
+    }
 
-        map->object_groups.push(object_group);
+    size_t size = 0;
+    const_str source = neko_capi_vfs_read_file("gamedata", tmx_path, &size);
+    if (!source) {
+        neko_panic("failed to read tmx: %s", tmx_path);
+        return false;
     }
 
-    return true;
+    bool ok = tiled_load_source(map, String(source, size), tmx_root_path);
+    mem_free(source);
+    return ok;
 }
 
 void tiled_unload(TiledMap *map) {
@@ -814,18 +2181,22 @@ void tiled_unload(TiledMap *map) {
     map->layers.trash();
     map->tilesets.trash();
 
-    for (u32 i = 0; i < map->object_groups.len; i++) {
-        for (u32 j = 0; j < map->object_groups[i].objects.len; j++) {
-            map->object_groups[i].objects[j].properties.trash();
+    // 名字与属性都由加载时复制
+    for (object_group_t &group : map->object_groups) {
+        for (object_t &object : group.objects) {
+            for (object_property_t &property : object.properties) {
+                mem_free(property.key.data);
+                mem_free(property.value.data);
+            }
+            object.properties.trash();
+            mem_free(object.name.data);
+            mem_free(object.class_name.data);
         }
-        map->object_groups[i].objects.trash();
+        group.objects.trash();
+        mem_free(group.name.data);
     }
 
     map->object_groups.trash();
-
-    if (map->doc.nodes.len) {
-        map->doc.Trash();
-    }
 }
 
 void tiled_render_init(tiled_renderer *renderer) {
@@ -838,10 +2209,10 @@ void tiled_render_init(tiled_renderer *renderer) {
 
     glUseProgram(sid);
 
-    GLuint loc = glGetUniformLocation(sid, "inverse_view_matrix");
+    GLuint loc = neko_shader_uniform(sid, "inverse_view_matrix");
     glUniformMatrix3fv(loc, 1, GL_FALSE, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
 
-    loc = glGetUniformLocation(sid, "batch_texture");
+    loc = neko_shader_uniform(sid, "batch_texture");
     glUniform1i(loc, 0);
 
     glGenVertexArrays(1, &renderer->vao);
@@ -875,6 +2246,8 @@ void tiled_render_deinit(tiled_renderer *renderer) {
 
     renderer->quad_table.trash();
 
+    tiled_mesh_free(&renderer->mesh);
+
     glDeleteBuffers(1, &renderer->ib);
     glDeleteBuffers(1, &renderer->vbo);
     glDeleteVertexArrays(1, &renderer->vao);
@@ -899,13 +2272,13 @@ void tiled_render_flush(tiled_renderer *renderer) {
     gfx_bind_vertex_attrib_auto(sid, GL_FLOAT, 4, "color", FLOATS_PER_VERT * sizeof(f32), NEKO_INT2VOIDP(sizeof(f32) * 4));
     gfx_bind_vertex_attrib_auto(sid, GL_FLOAT, 1, "use_texture", FLOATS_PER_VERT * sizeof(f32), NEKO_INT2VOIDP(sizeof(f32) * 8));
 
-    glUniformMatrix3fv(glGetUniformLocation(sid, "inverse_view_matrix"), 1, false, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
+    glUniformMatrix3fv(neko_shader_uniform(sid, "inverse_view_matrix"), 1, false, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
 
     GLuint tex_id = renderer->batch_texture.id;
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, tex_id);
-    // glUniform1iv(glGetUniformLocation(sid, "batch_texture"), 1, 0);
+    // glUniform1iv(neko_shader_uniform(sid, "batch_texture"), 1, 0);
 
     glBindImageTexture(0, tex_id, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
 
@@ -940,8 +2313,6 @@ void tiled_render_draw(tiled_renderer *renderer) {
 
     PROFILE_FUNC();
 
-    // TODO: 24/8/20 检测quad是否在屏幕视角范围外 进行剔除性优化
-
     glBindBuffer(GL_ARRAY_BUFFER, renderer->vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->ib);
 
@@ -1025,6 +2396,274 @@ void tiled_render_draw(tiled_renderer *renderer) {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+// 图块在着色器中 y 轴翻转 世界包围盒为 x [x, x + w] y [-(y + h), -y]
+static BBox tiled_quad_bbox(vec2 position, vec2 dimentions) {
+    return bbox(luavec2(position.x, -(position.y + dimentions.y)), luavec2(position.x + dimentions.x, -position.y));
+}
+
+void tiled_chunk_fill(const TiledMap *map, u32 layer_idx, u32 cx, u32 cy, Array<TiledVertex> *verts, Array<TiledChunkBatch> *batches, BBox *bounds) {
+    const layer_t *layer = &map->layers[layer_idx];
+    u32 x0 = cx * TILED_CHUNK_SIZE, x1 = NEKO_MIN(x0 + TILED_CHUNK_SIZE, layer->width);
+    u32 y0 = cy * TILED_CHUNK_SIZE, y1 = NEKO_MIN(y0 + TILED_CHUNK_SIZE, layer->height);
+
+    batches->len = 0;
+
+    // 先按图块集计数 使同一图块集的四边形连续
+    u32 quads = 0;
+    for (u32 y = y0; y < y1; y++) {
+        for (u32 x = x0; x < x1; x++) {
+            const tile_t *tile = layer->tiles + (x + y * layer->width);
+            if (tile->id == 0) continue;
+
+            TiledChunkBatch *batch = nullptr;
+            for (TiledChunkBatch &b : *batches) {
+                if (b.tileset_id == tile->tileset_id) {
+                    batch = &b;
+                    break;
+                }
+            }
+            if (!batch) {
+                batches->push({tile->tileset_id, 0, 0});
+                batch = &(*batches)[batches->len - 1];
+            }
+            batch->count++;
+            quads++;
+        }
+    }
+
+    u32 first = 0;
+    for (TiledChunkBatch &b : *batches) {
+        b.first = first;
+        first += b.count;
+        b.count = 0;
+    }
+
+    verts->resize(quads * VERTS_PER_QUAD);
+    *bounds = bbox(luavec2(FLT_MAX, FLT_MAX), luavec2(-FLT_MAX, -FLT_MAX));
+
+    for (u32 y = y0; y < y1; y++) {
+        for (u32 x = x0; x < x1; x++) {
+            const tile_t *tile = layer->tiles + (x + y * layer->width);
+            if (tile->id == 0) continue;
+
+            TiledChunkBatch *batch = batches->data;
+            while (batch->tileset_id != tile->tileset_id) batch++;
+
+            const tileset_t *tileset = &map->tilesets[tile->tileset_id];
+            u32 tsxx = (tile->id % (tileset->width / tileset->tile_width) - 1) * tileset->tile_width;
+            u32 tsyy = tileset->tile_height * ((tile->id - tileset->first_gid) / (tileset->width / tileset->tile_width));
+
+            const f32 tx = (f32)tsxx / tileset->width;
+            const f32 ty = (f32)tsyy / tileset->height;
+            const f32 tw = (f32)tileset->tile_width / tileset->width;
+            const f32 th = (f32)tileset->tile_height / tileset->height;
+
+            const f32 px = (f32)(x * tileset->tile_width * SPRITE_SCALE);
+            const f32 py = (f32)(y * tileset->tile_height * SPRITE_SCALE);
+            const f32 w = (f32)(tileset->tile_width * SPRITE_SCALE);
+            const f32 h = (f32)(tileset->tile_height * SPRITE_SCALE);
+
+            TiledVertex *v = &(*verts)[(batch->first + batch->count++) * VERTS_PER_QUAD];
+            v[0] = {{px, py}, {tx, ty}};
+            v[1] = {{px + w, py}, {tx + tw, ty}};
+            v[2] = {{px + w, py + h}, {tx + tw, ty + th}};
+            v[3] = {{px, py + h}, {tx, ty + th}};
+
+            *bounds = bbox_merge(*bounds, bbox(luavec2(px, py), luavec2(px + w, py + h)));
+        }
+    }
+}
+
+// 区块的顶点数组记录顶点属性与索引缓冲区 提交时只需要绑定它
+static void tiled_chunk_vao_create(TiledMesh *mesh, TiledChunk *chunk) {
+    GLuint sid = assets_get<AssetShader>(CTiledMap::tiled_shader).id;
+    GLint pos_loc = glGetAttribLocation(sid, "position");
+    GLint uv_loc = glGetAttribLocation(sid, "uv");
+
+    glGenVertexArrays(1, &chunk->vao);
+    glBindVertexArray(chunk->vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ib);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glVertexAttribPointer(pos_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TiledVertex), NEKO_INT2VOIDP(offsetof(TiledVertex, position)));
+    glEnableVertexAttribArray(pos_loc);
+    glVertexAttribPointer(uv_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TiledVertex), NEKO_INT2VOIDP(offsetof(TiledVertex, uv)));
+    glEnableVertexAttribArray(uv_loc);
+    glBindVertexArray(0);
+}
+
+static void tiled_chunk_rebuild(TiledMesh *mesh, TiledChunk *chunk, const TiledMap *map) {
+    tiled_chunk_fill(map, chunk->layer, chunk->cx, chunk->cy, &mesh->scratch, &chunk->batches, &chunk->bounds);
+    chunk->quad_count = (u32)(mesh->scratch.len / VERTS_PER_QUAD);
+    chunk->dirty = false;
+    mesh->rebuilt++;
+
+    if (chunk->quad_count == 0) return;
+
+    if (!chunk->vbo) {
+        glGenBuffers(1, &chunk->vbo);
+        tiled_chunk_vao_create(mesh, chunk);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    if (chunk->quad_count > chunk->vbo_quads) {
+        chunk->vbo_quads = chunk->quad_count;
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)mesh->scratch.len * sizeof(TiledVertex), mesh->scratch.data, GL_STATIC_DRAW);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)mesh->scratch.len * sizeof(TiledVertex), mesh->scratch.data);
+    }
+}
+
+static void tiled_mesh_clear(TiledMesh *mesh) {
+    for (TiledChunk &chunk : mesh->chunks) {
+        if (chunk.vbo) glDeleteBuffers(1, &chunk.vbo);
+        if (chunk.vao) glDeleteVertexArrays(1, &chunk.vao);
+        chunk.batches.trash();
+    }
+    mesh->chunks.len = 0;
+    mesh->layer_first.len = 0;
+    mesh->layer_cols.len = 0;
+    mesh->tints.len = 0;
+    mesh->textures.len = 0;
+    mesh->map_asset = 0;
+}
+
+void tiled_mesh_update(TiledMesh *mesh, const TiledMap *map, u64 map_asset, u64 modtime) {
+    PROFILE_FUNC();
+
+    mesh->rebuilt = 0;
+
+    if (mesh->map_asset != map_asset || mesh->modtime != modtime) {
+        tiled_mesh_clear(mesh);
+        mesh->map_asset = map_asset;
+        mesh->modtime = modtime;
+
+        for (u32 i = 0; i < map->layers.len; i++) {
+            const layer_t *layer = &map->layers[i];
+            u32 cols = (layer->width + TILED_CHUNK_SIZE - 1) / TILED_CHUNK_SIZE;
+            u32 rows = (layer->height + TILED_CHUNK_SIZE - 1) / TILED_CHUNK_SIZE;
+            mesh->layer_first.push((u32)mesh->chunks.len);
+            mesh->layer_cols.push(cols);
+            mesh->tints.push(layer->tint);
+            for (u32 cy = 0; cy < rows; cy++) {
+                for (u32 cx = 0; cx < cols; cx++) {
+                    TiledChunk chunk = {};
+                    chunk.layer = i;
+                    chunk.cx = cx;
+                    chunk.cy = cy;
+                    chunk.dirty = true;
+                    mesh->chunks.push(chunk);
+                }
+            }
+        }
+        for (u32 i = 0; i < map->tilesets.len; i++) mesh->textures.push(map->tilesets[i].texture);
+    }
+
+    if (!mesh->vao) {
+        // 区块内四边形的索引都相同
+        Array<u32> indices = {};
+        indices.resize(TILED_CHUNK_SIZE * TILED_CHUNK_SIZE * IND_PER_QUAD);
+        for (u32 q = 0; q < TILED_CHUNK_SIZE * TILED_CHUNK_SIZE; q++) {
+            u32 v = q * VERTS_PER_QUAD;
+            u32 *idx = &indices[q * IND_PER_QUAD];
+            idx[0] = v + 3;
+            idx[1] = v + 2;
+            idx[2] = v + 1;
+            idx[3] = v + 3;
+            idx[4] = v + 1;
+            idx[5] = v + 0;
+        }
+        glGenVertexArrays(1, &mesh->vao);
+        glBindVertexArray(mesh->vao);
+        glGenBuffers(1, &mesh->ib);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ib);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indices.len * sizeof(u32), indices.data, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        indices.trash();
+    }
+
+    for (TiledChunk &chunk : mesh->chunks) {
+        if (chunk.dirty) tiled_chunk_rebuild(mesh, &chunk, map);
+    }
+    mesh->dirty = false;
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void tiled_mesh_invalidate(TiledMesh *mesh, u32 layer, u32 x, u32 y) {
+    if (layer >= mesh->layer_first.len) return;
+    u32 i = mesh->layer_first[layer] + (y / TILED_CHUNK_SIZE) * mesh->layer_cols[layer] + x / TILED_CHUNK_SIZE;
+    if (i < mesh->chunks.len) {
+        mesh->chunks[i].dirty = true;
+        mesh->dirty = true;
+    }
+}
+
+// 地图的平移在 params 中 图层颜色在 state 中
+static void tiled_apply(const RenderCommand *cmd) {
+    GLuint sid = cmd->shader;
+
+    // 顶点为地图局部坐标 在逆视图矩阵中加入地图的平移 (着色器中 y 轴翻转)
+    mat3 m = mat3_mul(the<Camera>().GetInverseViewMatrix(), mat3_scaling_rotation_translation(luavec2(1.f, 1.f), 0.f, luavec2(cmd->params[0], -cmd->params[1])));
+    glUniformMatrix3fv(neko_shader_uniform(sid, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat *)&m);
+
+    u32 tint = cmd->state;
+    glVertexAttrib4f(glGetAttribLocation(sid, "color"), (tint & 0xff) / 255.f, ((tint >> 8) & 0xff) / 255.f, ((tint >> 16) & 0xff) / 255.f, (tint >> 24) / 255.f);
+    glVertexAttrib1f(glGetAttribLocation(sid, "use_texture"), 1.f);
+}
+
+void tiled_mesh_submit(TiledMesh *mesh, RenderQueue *q, vec2 offset, u8 layer) {
+    PROFILE_FUNC();
+
+    Camera &camera = the<Camera>();
+    CameraCullStats &stats = camera.camera_get_cull_stats();
+
+    GLuint sid = assets_get<AssetShader>(CTiledMap::tiled_shader).id;
+    const u32 last_layer = RenderLayer_Background + RenderLayer_BackgroundCount - 1;
+    u32 depth = 0;
+
+    for (TiledChunk &chunk : mesh->chunks) {
+        stats.tiles += chunk.quad_count;
+        if (chunk.quad_count == 0) continue;
+
+        BBox local = chunk.bounds;
+        vec2 position = luavec2(local.min.x + offset.x, local.min.y + offset.y);
+        vec2 dimentions = luavec2(local.max.x - local.min.x, local.max.y - local.min.y);
+        if (!camera.camera_visible(tiled_quad_bbox(position, dimentions))) continue;
+        stats.tiles_visible += chunk.quad_count;
+
+        Color256 tint = mesh->tints[chunk.layer];
+
+        for (TiledChunkBatch &batch : chunk.batches) {
+            RenderCommand cmd = {};
+            cmd.shader = sid;
+            cmd.texture = mesh->textures[batch.tileset_id].id;
+            cmd.key = render_key((u8)NEKO_MIN(layer + chunk.layer, last_layer), sid, cmd.texture, depth++);
+            cmd.vao = chunk.vao;
+            cmd.mode = GL_TRIANGLES;
+            cmd.indexed = true;  // 四边形 q 的索引指向顶点 q * 4 起 不需要 base vertex
+            cmd.first = (i32)(batch.first * IND_PER_QUAD);
+            cmd.count = (i32)(batch.count * IND_PER_QUAD);
+            cmd.apply = tiled_apply;
+            cmd.state = (u32)tint.r | (u32)tint.g << 8 | (u32)tint.b << 16 | (u32)tint.a << 24;
+            cmd.params[0] = offset.x;
+            cmd.params[1] = offset.y;
+            render_queue_submit(q, cmd);
+        }
+    }
+}
+
+void tiled_mesh_free(TiledMesh *mesh) {
+    tiled_mesh_clear(mesh);
+    if (mesh->ib) glDeleteBuffers(1, &mesh->ib);
+    if (mesh->vao) glDeleteVertexArrays(1, &mesh->vao);
+    mesh->chunks.trash();
+    mesh->layer_first.trash();
+    mesh->layer_cols.trash();
+    mesh->tints.trash();
+    mesh->textures.trash();
+    mesh->scratch.trash();
+    *mesh = {};
+}
+
 static void tiled_map_edit_w(CTiledMap *tiled, u32 layer_idx, u32 x, u32 y, u32 id) {
 
     Asset asset = {};
@@ -1051,6 +2690,12 @@ void Tiled::tiled_map_edit(CEntity ent, u32 layer_idx, u32 x, u32 y, u32 id) {
     error_assert(tiled);
 
     tiled_map_edit_w(tiled, layer_idx, x, y, id);
+
+    // 使用同一地图的实体都要重建这个区块
+    u64 map_asset = tiled->render->map_asset;
+    ComponentTypeBase::EntityPool->ForEach([&](CTiledMap *other) {
+        if (other->render->map_asset == map_asset) tiled_mesh_invalidate(&other->render->mesh, layer_idx, x, y);
+    });
 }
 
 int Tiled::RenderMap(CTiledMap *tiled) {
@@ -1059,52 +2704,58 @@ int Tiled::RenderMap(CTiledMap *tiled) {
 
     vec2 xform = tiled->pos;
 
-    Asset asset = {};
-    bool ok = asset_read(tiled->render->map_asset, &asset);
+    u64 modtime = 0;
+    bool ok = asset_read_modtime(tiled->render->map_asset, &modtime);
     error_assert(ok);
 
-    TiledMap map = assets_get<TiledMap>(asset);
+    TiledMesh *mesh = &tiled->render->mesh;
+    bool stale = mesh->dirty || mesh->map_asset != tiled->render->map_asset || mesh->modtime != modtime;
 
-    {
-        tiled_render_begin(tiled->render);
+    // 只有网格需要重建或绘制对象组时才读取地图
+    Asset asset = {};
+    if (stale || tiled->draw_object_groups_rect) {
+        ok = asset_read(tiled->render->map_asset, &asset);
+        error_assert(ok);
+    }
 
+    {
         PROFILE_BLOCK("tiled_render");
 
-        for (u32 i = 0; i < map.layers.len; i++) {
-            layer_t *layer = &map.layers[i];
-            for (u32 y = 0; y < layer->height; y++) {
-                for (u32 x = 0; x < layer->width; x++) {
-                    tile_t *tile = layer->tiles + (x + y * layer->width);
-                    if (tile->id != 0) {
-                        tileset_t *tileset = &map.tilesets[tile->tileset_id];
-                        u32 tsxx = (tile->id % (tileset->width / tileset->tile_width) - 1) * tileset->tile_width;
-                        u32 tsyy = tileset->tile_height * ((tile->id - tileset->first_gid) / (tileset->width / tileset->tile_width));
-                        TiledQuad quad = {.tileset_id = tile->tileset_id,
-                                          .texture = tileset->texture,
-                                          .texture_size = {(f32)tileset->width, (f32)tileset->height},
-                                          .position = {(f32)(x * tileset->tile_width * SPRITE_SCALE) + xform.x, (f32)(y * tileset->tile_height * SPRITE_SCALE) + xform.y},
-                                          .dimentions = {(f32)(tileset->tile_width * SPRITE_SCALE), (f32)(tileset->tile_height * SPRITE_SCALE)},
-                                          .rectangle = {(f32)tsxx, (f32)tsyy, (f32)tileset->tile_width, (f32)tileset->tile_height},
-                                          .color = layer->tint,
-                                          .use_texture = true};
-                        tiled_render_push(tiled->render, quad);
-                    }
+        if (stale) tiled_mesh_update(mesh, &assets_get<TiledMap>(asset), tiled->render->map_asset, modtime);
+
+        // 背景段用完时先画出已提交的地图
+        RenderQueue *q = &the<Renderer>().queue;
+        u32 layers = (u32)mesh->layer_first.len;
+        if (render_layer && render_layer + layers > RenderLayer_BackgroundCount) {
+            render_queue_flush(q);
+            render_layer = 0;
+        }
+        tiled_mesh_submit(mesh, q, xform, (u8)(RenderLayer_Background + render_layer));
+        render_layer += layers;
+
+        if (tiled->draw_object_groups_rect) {
+            TiledMap &map = assets_get<TiledMap>(asset);
+            Camera &camera = the<Camera>();
+
+            // 对象组直接绘制 画在这张地图的图块之上
+            render_queue_flush(q);
+            render_layer = 0;
+
+            tiled_render_begin(tiled->render);
+
+            for (u32 i = 0; i < map.object_groups.len; i++) {
+                object_group_t *group = &map.object_groups[i];
+                for (u32 ii = 0; ii < map.object_groups[i].objects.len; ii++) {
+                    object_t *object = &group->objects[ii];
+                    TiledQuad quad = {.position = {(f32)(object->x * SPRITE_SCALE) + xform.x, (f32)(object->y * SPRITE_SCALE) + xform.y},
+                                      .dimentions = {(f32)(object->width * SPRITE_SCALE), (f32)(object->height * SPRITE_SCALE)},
+                                      .color = group->color,
+                                      .use_texture = false};
+                    if (!camera.camera_visible(tiled_quad_bbox(quad.position, quad.dimentions))) continue;
+                    tiled_render_push(tiled->render, quad);
                 }
+                tiled_render_draw(tiled->render);  // 一层渲染一次
             }
-            tiled_render_draw(tiled->render);  // 一层渲染一次
-        }
-
-        for (u32 i = 0; tiled->draw_object_groups_rect && i < map.object_groups.len; i++) {
-            object_group_t *group = &map.object_groups[i];
-            for (u32 ii = 0; ii < map.object_groups[i].objects.len; ii++) {
-                object_t *object = &group->objects[ii];
-                TiledQuad quad = {.position = {(f32)(object->x * SPRITE_SCALE) + xform.x, (f32)(object->y * SPRITE_SCALE) + xform.y},
-                                  .dimentions = {(f32)(object->width * SPRITE_SCALE), (f32)(object->height * SPRITE_SCALE)},
-                                  .color = group->color,
-                                  .use_texture = false};
-                tiled_render_push(tiled->render, quad);
-            }
-            tiled_render_draw(tiled->render);  // 一层渲染一次
         }
     }
 
@@ -1127,7 +2778,11 @@ CTiledMap *Tiled::ComponentAdd(CEntity ent) {
     return tiled;
 }
 
-void Tiled::ComponentRemove(CEntity ent) { ComponentTypeBase::EntityPool->Remove(ent); }
+void Tiled::ComponentRemove(CEntity ent) {
+    if (!ComponentGetPtr(ent)) return;
+    the<Spatial>().spatial_reset_bounds(ent);
+    ComponentTypeBase::EntityPool->Remove(ent);
+}
 
 DEFINE_IMGUI_BEGIN(template <>, CTiledMap) {
     ImGuiWrap::Auto(var.map_name, "map_name");
@@ -1155,6 +2810,9 @@ void Tiled::tiled_init() {
     bool ok = asset_load_kind(AssetKind_Shader, "@code/game/shader/tiled.glsl", &CTiledMap::tiled_shader);
     error_assert(ok);
 
+    // 同一图块层的区块互不重叠 背景段的层按纹理排序
+    for (u32 l = 0; l < RenderLayer_BackgroundCount; l++) render_queue_set_layer_sorted(&the<Renderer>().queue, (u8)(RenderLayer_Background + l), true);
+
     // clang-format off
 
     auto type = BUILD_TYPE(Tiled)
@@ -1193,17 +2851,23 @@ int Tiled::tiled_update_all(Event evt) {
         tiled->pos = the<Transform>().transform_get_position(tiled->ent);
         tiled->draw_object_groups_rect = edit_get_enabled();
 
+        // 空间索引与编辑包围盒一致 编辑器拾取先查询空间索引 没有变化时 spatial_set_bounds 直接返回
+        BBox bounds = bbox(vec2_mul(tiled->size, min), vec2_mul(tiled->size, max));
+        the<Spatial>().spatial_set_bounds(tiled->ent, bounds);
+
         if (edit_get_enabled()) {
-            edit_bboxes_update(tiled->ent, bbox(vec2_mul(tiled->size, min), vec2_mul(tiled->size, max)));
+            edit_bboxes_update(tiled->ent, bounds);
         }
     });
 
     return 0;
 }
 
+// 各地图的图块层依次占用背景段的层 整个背景段排序后一起绘制
 void Tiled::tiled_draw_all() {
-
+    render_layer = 0;
     ComponentTypeBase::EntityPool->ForEach([this](CTiledMap *tiled) { this->RenderMap(tiled); });
+    render_queue_flush(&the<Renderer>().queue);
 }
 
 void Tiled::tiled_set_map(CEntity ent, const char *str) {
@@ -3,6 +3,7 @@
 #include "engine/asset.h"
 #include "engine/ecs/entity.h"
 #include "engine/component.h"
+#include "engine/renderer/render_queue.h"
 
 struct Tile {
     float x, y, u, v;
@@ -62,6 +63,160 @@ struct TilePoint {
 
 inline u64 tile_key(i32 x, i32 y) { return ((u64)x << 32) | (u64)y; }
 
+// 稠密网格寻路 格子下标为 y*w+x
+// 移动规则与 bloom=1 的 graph 相同: 八方向 斜向移动要求两侧格子都可通行 (不切角)
+// 每次查询递增 generation 代替 astar_reset 节点的 gen 与之不同即视为未访问
+enum TileGridMode {
+    TileGridMode_AStar,
+    TileGridMode_JPS,  // 跳点搜索 仅在所有可通行格代价相同时使用 否则退回 A*
+};
+
+struct TileGridStats {
+    u32 expanded;  // 出队展开的节点数
+    u32 pushed;    // 入队次数
+};
+
+// 一次查询的工作区 每个线程各用一份 节点数组按网格大小分配
+struct TileGridSearch {
+    float* g;
+    i32* prev;  // 前驱下标 起点为 -1
+    u32* gen;   // 节点最近一次被访问的 generation
+    u8* flags;  // TileNodeFlags
+    u64 capacity;
+    u32 generation;
+    PriorityQueue<i32> frontier;
+    Array<i32> jumps;
+    TileGridStats stats;  // 最近一次查询
+};
+
+struct TileGrid {
+    i32 x0, y0;  // 网格左上角 (格子坐标)
+    i32 w, h;
+    float* cost;         // <= 0 为不可通行
+    float uniform_cost;  // 所有可通行格代价相同时为该代价 否则为 0
+    bool cost_dirty;
+    TileGridSearch search;  // tile_grid_find_path 使用
+};
+
+// 只读的网格快照 供后台线程寻路 引用计数只在主线程修改
+struct TileGridSnapshot {
+    TileGrid grid;
+    float cell_size;  // 像素
+    i32 refs;
+};
+
+void tile_grid_init(TileGrid* grid, i32 x0, i32 y0, i32 w, i32 h);
+void tile_grid_trash(TileGrid* grid);
+void tile_grid_set_cost(TileGrid* grid, i32 x, i32 y, float cost);  // 格子坐标 越界忽略
+float tile_grid_get_cost(TileGrid* grid, i32 x, i32 y);
+void tile_grid_prepare(TileGrid* grid);  // 修改代价后 在 tile_grid_search 之前调用
+void tile_grid_search_trash(TileGridSearch* s);
+// grid 只读 不同线程使用不同的 s 时可并行查询
+bool tile_grid_search(const TileGrid* grid, TileGridSearch* s, i32 sx, i32 sy, i32 ex, i32 ey, TileGridMode mode, Array<TilePoint>* out);
+bool tile_grid_find_path(TileGrid* grid, i32 sx, i32 sy, i32 ex, i32 ey, TileGridMode mode, Array<TilePoint>* out);
+
+TileGridSnapshot* tile_grid_snapshot(TileGrid* grid, float cell_size);  // 复制代价 refs 为 1
+void tile_grid_snapshot_retain(TileGridSnapshot* snapshot);
+void tile_grid_snapshot_release(TileGridSnapshot* snapshot);
+
+// 流场 多个单位走向同一个目标时共用一次搜索
+// 从目标反向做 Dijkstra 得到每格到目标的代价 (积分场) 与下一步走向的邻格 (方向场)
+// 移动规则与 tile_grid_search 相同 沿方向场走到目标的代价等于积分场的值
+struct TileFlowField {
+    i32 x0, y0, w, h;          // 与网格相同
+    i32 gx, gy;                // 目标 格子坐标
+    Array<float> integration;  // 不可达为 -1
+    Array<i8> dir;             // tile_dirs 下标 目标与不可达的格子为 -1
+    u32 reached;               // 可达的格子数
+};
+
+// grid 只读 不同线程使用不同的 s 时可并行构建 目标不可通行时返回 false
+bool tile_flow_build(TileFlowField* flow, const TileGrid* grid, TileGridSearch* s, i32 gx, i32 gy);
+void tile_flow_trash(TileFlowField* flow);
+bool tile_flow_sample(const TileFlowField* flow, i32 x, i32 y, i32* dx, i32* dy);  // 格子坐标 O(1) 没有下一步时返回 false
+float tile_flow_cost(const TileFlowField* flow, i32 x, i32 y);                     // 格子坐标 不可达为 -1
+
+// 分层寻路 (HPA*) 网格切成 cluster x cluster 的簇
+// 相邻簇的公共边界上 每段连续可通行的格子取一到两个入口 入口节点成对出现 分属两侧的簇
+// 同一簇内入口之间的代价用簇内 Dijkstra 预先计算 查询先在入口图上搜索 再逐段在簇内细化
+// 路径不保证最短 修改代价后只重建受影响的边界与簇
+#define TILE_HPA_CLUSTER 32
+#define TILE_HPA_PARALLEL_MIN 8  // 需要重建的簇不少于此数时使用作业线程
+
+struct TileHpaEdge {
+    i32 to;
+    float cost;
+};
+
+struct TileHpaNode {
+    i32 cell;      // 网格下标 -1 为空闲节点
+    i32 cluster;
+    i32 boundary;  // 簇下标 * 2 为右边界 * 2 + 1 为下边界
+    i32 link;      // 边界另一侧对应的节点
+    float link_cost;
+    Array<TileHpaEdge> edges;  // 同一簇内可达的入口
+};
+
+struct TileHpaCluster {
+    i32 x0, y0, w, h;  // 网格局部坐标
+    Array<i32> nodes;
+    bool dirty;  // 需要重新计算簇内代价
+};
+
+struct TileHpaStats {
+    u32 expanded;           // 最近一次查询 入口图与簇内搜索展开的节点总数
+    u32 abstract_expanded;  // 其中入口图的部分
+    u32 rebuilt_clusters;   // 最近一次更新
+    u32 nodes;
+};
+
+// 簇内搜索的工作区 并行重建时每个作业组一份
+struct TileHpaScratch {
+    TileGridSearch search;  // 下标为簇内局部下标
+    Array<u8> target_mark;  // 目标格
+};
+
+struct TileHpa {
+    i32 cluster;  // 为 0 时未构建
+    i32 cols, rows;
+    Array<TileHpaCluster> clusters;
+    Array<TileHpaNode> nodes;
+    Array<i32> free_nodes;
+    Array<u8> boundary_dirty;  // 按边界下标
+    bool dirty;
+    TileHpaScratch local;             // 查询与少量簇的重建
+    Array<TileHpaScratch> workers;    // 作业线程重建簇
+    TileGridSearch abstract;          // 入口图搜索 下标为节点下标
+    Array<TileHpaEdge> start_edges;
+    Array<TileHpaEdge> goal_edges;
+    Array<i32> route;
+    TileHpaStats stats;
+};
+
+// grid 不归 TileHpa 所有 每次调用传入同一个网格
+void tile_hpa_build(TileHpa* hpa, const TileGrid* grid, i32 cluster);
+void tile_hpa_trash(TileHpa* hpa);
+void tile_hpa_set_cost(TileHpa* hpa, TileGrid* grid, i32 x, i32 y, float cost);  // 格子坐标 修改网格并标记受影响的部分
+void tile_hpa_update(TileHpa* hpa, const TileGrid* grid);                         // 查询前自动调用
+bool tile_hpa_find_path(TileHpa* hpa, const TileGrid* grid, i32 sx, i32 sy, i32 ex, i32 ey, Array<TilePoint>* out);
+
+// 图块碰撞轮廓 相连的实心格子合并为闭合折线 只保留拐角
+// 前进方向左侧为实心: 外轮廓为逆时针 内部的洞为顺时针 (按格子坐标的数学方向)
+// 只在角上相接的实心格子在该角点分开 同一轮廓可能两次经过同一个角点
+// 作为 b2ChainShape 环时法线朝外 相邻边自带幽灵顶点 格子接缝处不会卡住
+struct TileContours {
+    Array<TilePoint> points;  // 格子角点坐标
+    Array<u32> ends;          // 每个轮廓在 points 中的结束下标
+};
+
+void tile_contours_build(TileContours* out, const u8* solid, i32 w, i32 h);  // solid 为 w*h 掩码 网格外视为空
+void tile_contours_trash(TileContours* contours);
+
+enum TileCollisionMode {
+    TileCollision_Chains,  // 每个轮廓一个 b2ChainShape 环
+    TileCollision_Boxes,   // 贪心合并的矩形 每个一个 b2PolygonShape
+};
+
 class b2Body;
 class b2World;
 
@@ -73,13 +228,22 @@ struct MapLdtk {
     HashMap<TileNode> graph;       // key: x, y
     PriorityQueue<TileNode*> frontier;
     float graph_grid_size;
+    i32 graph_bloom;
+    TileGrid grid;                   // 最近一次 make_graph 的图层
+    TileGridSnapshot* grid_snapshot;  // grid 的只读副本 供异步寻路 代价修改后为空 用到时重新生成
+    TileHpa hpa;                      // make_hierarchy 之后有效
 
     bool load(String filepath);
     void trash();
     void destroy_bodies(b2World* world);
-    void make_collision(b2World* world, float meter, String layer_name, Slice<TilemapInt> walls);
+    void make_collision(b2World* world, float meter, String layer_name, Slice<TilemapInt> walls, TileCollisionMode mode = TileCollision_Chains);
     void make_graph(i32 bloom, String layer_name, Slice<TileCost> costs);
     TileNode* astar(TilePoint start, TilePoint goal);
+    bool astar_grid(TilePoint start, TilePoint goal, TileGridMode mode, Array<TilePoint>* out);  // 像素坐标 out 为格子坐标
+    void make_hierarchy(i32 cluster_size);
+    bool astar_hierarchical(TilePoint start, TilePoint goal, Array<TilePoint>* out);  // 同 astar_grid
+    void set_tile_cost(TilePoint p, float cost);                                      // 像素坐标 <= 0 为不可通行
+    TileGridSnapshot* path_snapshot();
 };
 
 #define SPRITE_SCALE 1.0
@@ -89,6 +253,7 @@ struct MapLdtk {
 ==========================*/
 
 bool tiled_load(TiledMap* map, const_str tmx_path, const_str res_path);
+bool tiled_load_source(TiledMap* map, String source, const_str root_path);  // 单遍流式解析 tmx 文本
 void tiled_unload(TiledMap* map);
 
 typedef struct TiledQuad {
@@ -113,6 +278,61 @@ typedef struct TiledQuadList {
     Array<TiledQuad> quad_list;  // quad 绘制队列
 } tiled_quad_list_t;
 
+// 图块层按区块缓存网格 只在图块改变或地图重新加载后重建
+// 每个区块一个顶点缓冲区和顶点数组 按图块集分段 共用一个索引缓冲区
+// 颜色与 use_texture 在整个图层内不变 绘制时作为常量属性设置
+// 区块作为渲染命令提交 同一图块层的区块互不重叠 在排序的层中按图块集纹理分组
+
+#define TILED_CHUNK_SIZE 32
+
+struct TiledVertex {
+    f32 position[2];  // 地图局部坐标 (y 向下)
+    f32 uv[2];
+};
+
+struct TiledChunkBatch {
+    u32 tileset_id;
+    u32 first;  // 区块内第一个四边形
+    u32 count;
+};
+
+struct TiledChunk {
+    u32 layer;
+    u32 cx, cy;
+    BBox bounds;  // 地图局部坐标 quad_count 为 0 时无意义
+    u32 quad_count;
+    Array<TiledChunkBatch> batches;
+    GLuint vbo;
+    GLuint vao;     // 绑定 vbo 与网格的索引缓冲区
+    u32 vbo_quads;  // 顶点缓冲区能容纳的四边形数
+    bool dirty;
+};
+
+struct TiledMesh {
+    u64 map_asset;  // 网格对应的地图资源 为 0 时未构建
+    u64 modtime;    // 构建时地图的修改时间 热重载后整体重建
+    Array<TiledChunk> chunks;  // 按图层 行 列排列
+    Array<u32> layer_first;    // 每个图层的第一个区块
+    Array<u32> layer_cols;     // 每个图层每行的区块数
+    Array<Color256> tints;
+    Array<AssetTexture> textures;  // 按图块集
+    Array<TiledVertex> scratch;
+    GLuint vao;  // 创建索引缓冲区时使用
+    GLuint ib;
+    bool dirty;   // 有区块被标记
+    u32 rebuilt;  // 上一次 tiled_mesh_update 重建的区块数
+};
+
+// 只生成顶点 不调用 GL
+void tiled_chunk_fill(const TiledMap* map, u32 layer, u32 cx, u32 cy, Array<TiledVertex>* verts, Array<TiledChunkBatch>* batches, BBox* bounds);
+
+// 地图资源或修改时间改变时整体重建 否则只重建标记过的区块
+void tiled_mesh_update(TiledMesh* mesh, const TiledMap* map, u64 map_asset, u64 modtime);
+void tiled_mesh_invalidate(TiledMesh* mesh, u32 layer, u32 x, u32 y);  // x y 为图块坐标
+// 按区块剔除后提交 图块层 i 使用渲染层 layer + i 超出背景段的图块层共用最后一层
+void tiled_mesh_submit(TiledMesh* mesh, RenderQueue* q, vec2 offset, u8 layer);
+void tiled_mesh_free(TiledMesh* mesh);
+
 typedef struct tiled_renderer {
     GLuint vao;
     GLuint vbo;
@@ -121,6 +341,7 @@ typedef struct tiled_renderer {
     HashMap<TiledQuadList> quad_table;  // 分层绘制哈希表 (tiled_quad_list_t)
     u32 quad_count;
     u64 map_asset;  // tiled data
+    TiledMesh mesh;  // 图块层网格缓存
 } tiled_renderer;
 
 void tiled_render_init(tiled_renderer* renderer);
@@ -164,6 +385,8 @@ public:
     int Inspect(CEntity ent) override;
 
 private:
+    u32 render_layer = 0;  // 本帧下一个图块层使用的背景层
+
     int RenderMap(CTiledMap* tiled);
 };
 
@@ -1,20 +1,38 @@
 
 #include "transform.h"
 
+#include "base/common/math_simd.hpp"
 #include "base/common/profiler.hpp"
 #include "engine/bootstrap.h"
 #include "engine/ecs/entity.h"
 #include "engine/editor.h"
+#include "engine/components/spatial.h"
 #include "engine/scripting/lua_util.h"
 
 // -------------------------------------------------------------------------
 
+// 重新计算 ent 及其子树的世界矩阵 parent 为 NULL 时 ent 为根
 void Transform::UpdateChild(CTransform *parent, CEntity ent) {
     CTransform *transform;
 
     transform = ComponentGetPtr(ent);
     error_assert(transform);
-    transform->worldmat_cache = mat3_mul(parent->worldmat_cache, transform->mat_cache);
+
+    if (transform->dirty) {
+        transform->mat_cache = mat3_scaling_rotation_translation(transform->scale, transform->rotation, transform->position);
+        transform->dirty = false;
+        ++stat_mat_ops;
+    }
+
+    mat3 old = transform->worldmat_cache;
+    if (parent) {
+        transform->worldmat_cache = mat3_mul(parent->worldmat_cache, transform->mat_cache);
+        ++stat_mat_ops;
+    } else {
+        transform->worldmat_cache = transform->mat_cache;
+    }
+    if (memcmp(&old, &transform->worldmat_cache, sizeof(mat3)) != 0) moved_list.push(ent);
+
     if (transform->children.len) {
         for (auto &child : transform->children) {
             UpdateChild(transform, child);
@@ -22,32 +40,71 @@ void Transform::UpdateChild(CTransform *parent, CEntity ent) {
     }
 }
 
+// 只标记 矩阵在 transform_update_all 或读取世界矩阵时统一更新
 void Transform::Modified(CTransform *transform) {
-    CTransform *parent;
-
     ++transform->dirty_count;
 
-    transform->mat_cache = mat3_scaling_rotation_translation(transform->scale, transform->rotation, transform->position);
+    if (!transform->dirty) {
+        transform->dirty = true;
+        dirty_list.push(transform->ent);
+    }
+}
 
-    // 更新世界矩阵
-    parent = ComponentGetPtr(transform->parent);
-    if (parent) {
-        transform->worldmat_cache = mat3_mul(parent->worldmat_cache, transform->mat_cache);
-    } else {
-        transform->worldmat_cache = transform->mat_cache;
+// 更新所有脏节点 每棵脏子树只从最上层的脏节点更新一次
+void Transform::ResolveDirty() {
+    PROFILE_FUNC();
+
+    if (flat_enabled) {
+        FlatResolve();
+        dirty_list.len = 0;
+        return;
     }
 
-    // 更新子世界矩阵
-    if (transform->children.len) {
-        for (auto &child : transform->children) {
-            UpdateChild(transform, child);
+    for (CEntity ent : dirty_list) {
+        CTransform *transform = ComponentGetPtr(ent);
+        if (!transform || !transform->dirty) continue;  // 已删除或已被祖先一并更新
+
+        // 祖先中有脏节点时由祖先统一更新
+        CTransform *parent = ComponentGetPtr(transform->parent);
+        bool covered = false;
+        for (CTransform *p = parent; p; p = ComponentGetPtr(p->parent)) {
+            if (p->dirty) {
+                covered = true;
+                break;
+            }
         }
+        if (covered) continue;
+
+        UpdateChild(parent, ent);
     }
+    dirty_list.len = 0;
+}
+
+void Transform::SetDepth(CTransform *t, u32 depth) {
+    t->depth = depth;
+    for (auto &child : t->children) SetDepth(ComponentGetPtr(child), depth + 1);
+}
+
+// 更新 t 在 flat_parents 中的父级下标 父级位于 t 之后时需要重新排序
+void Transform::FlatSetParentIndex(CTransform *t) {
+    if (!flat_enabled || flat_order_dirty) return;
+
+    int i = (int)(t - ComponentTypeBase::EntityPool->array.data);
+    int pi = entitymap_get(ComponentTypeBase::EntityPool->emap, t->parent);
+    if (CEntityEq(t->parent, entity_nil)) pi = -1;
+
+    if (pi > i)
+        flat_order_dirty = true;
+    else
+        flat_parents[i] = pi;
+    flat_world_dirty = true;
 }
 
 void Transform::Detach(CTransform *p, CTransform *c) {
     // remove child -> parent link
     c->parent = entity_nil;
+    SetDepth(c, 0);
+    FlatSetParentIndex(c);
 
     // search for parent -> child link and remove it
     for (auto &child : p->children)
@@ -77,6 +134,8 @@ void Transform::DetachAll(CTransform *t) {
             c = ComponentGetPtr(child);
             error_assert(c);
             c->parent = entity_nil;
+            SetDepth(c, 0);
+            FlatSetParentIndex(c);
             Modified(c);
         }
         t->children.trash();
@@ -99,8 +158,14 @@ CTransform *Transform::ComponentAdd(CEntity ent) {
     transform->children = {};
 
     transform->dirty_count = 0;
+    transform->dirty = false;
+    transform->depth = 0;
+
+    // 新元素追加在末尾且没有父级 不会破坏顺序
+    if (flat_enabled && !flat_order_dirty) flat_parents.push(-1);
 
     Modified(transform);
+    the<Spatial>().spatial_add(ent);
 
     return transform;
 }
@@ -109,6 +174,8 @@ void Transform::ComponentRemove(CEntity ent) {
     CTransform *transform = ComponentGetPtr(ent);
     if (transform) DetachAll(transform);
     ComponentTypeBase::EntityPool->Remove(ent);
+    the<Spatial>().spatial_remove(ent);
+    flat_order_dirty = true;  // Remove 会与末尾元素交换
 }
 
 // 根转换具有父级 = entity_nil
@@ -138,7 +205,11 @@ void Transform::transform_set_parent(CEntity ent, CEntity parent) {
             newp->children.reserve(4);  // TODO: 可以优化
         }
         newp->children.push(ent);
+        SetDepth(t, newp->depth + 1);
+    } else {
+        SetDepth(t, 0);
     }
+    FlatSetParentIndex(t);
 
     Modified(t);
 }
@@ -223,16 +294,19 @@ vec2 Transform::transform_get_scale(CEntity ent) {
 }
 
 vec2 Transform::transform_get_world_position(CEntity ent) {
+    ResolveIfDirty();
     CTransform *transform = ComponentGetPtr(ent);
     error_assert(transform);
     return mat3_get_translation(transform->worldmat_cache);
 }
 f32 Transform::transform_get_world_rotation(CEntity ent) {
+    ResolveIfDirty();
     CTransform *transform = ComponentGetPtr(ent);
     error_assert(transform);
     return mat3_get_rotation(transform->worldmat_cache);
 }
 vec2 Transform::transform_get_world_scale(CEntity ent) {
+    ResolveIfDirty();
     CTransform *transform = ComponentGetPtr(ent);
     error_assert(transform);
     return mat3_get_scale(transform->worldmat_cache);
@@ -243,6 +317,7 @@ mat3 Transform::transform_get_world_matrix(CEntity ent) {
 
     if (CEntityEq(ent, entity_nil)) return mat3_identity();
 
+    ResolveIfDirty();
     transform = ComponentGetPtr(ent);
     error_assert(transform);
     return transform->worldmat_cache;
@@ -253,17 +328,20 @@ mat3 Transform::transform_get_matrix(CEntity ent) {
 
     if (CEntityEq(ent, entity_nil)) return mat3_identity();
 
+    ResolveIfDirty();
     transform = ComponentGetPtr(ent);
     error_assert(transform);
     return transform->mat_cache;
 }
 
 vec2 Transform::transform_local_to_world(CEntity ent, vec2 v) {
+    ResolveIfDirty();
     CTransform *transform = ComponentGetPtr(ent);
     error_assert(transform);
     return mat3_transform(transform->worldmat_cache, v);
 }
 vec2 Transform::transform_world_to_local(CEntity ent, vec2 v) {
+    ResolveIfDirty();
     CTransform *transform = ComponentGetPtr(ent);
     error_assert(transform);
     return mat3_transform(mat3_inverse(transform->worldmat_cache), v);
@@ -287,6 +365,121 @@ void Transform::transform_set_save_filter_rec(CEntity ent, bool filter) {
     }
 }
 
+// 按深度稳定计数排序 深度小的在前 因而父级总在子级之前
+void Transform::FlatReorder() {
+    PROFILE_FUNC();
+
+    auto pool = ComponentTypeBase::EntityPool;
+    u64 n = pool->array.len;
+
+    // 检查现有顺序是否仍然有效 只有被破坏时才重排
+    flat_parents.resize(n);
+    bool valid = true;
+    for (u64 i = 0; i < n; i++) {
+        CTransform *t = &pool->array[i];
+        int pi = CEntityEq(t->parent, entity_nil) ? -1 : entitymap_get(pool->emap, t->parent);
+        flat_parents[i] = pi;
+        if (pi >= (int)i) valid = false;
+    }
+    flat_order_dirty = false;
+    if (valid) return;
+
+    u32 max_depth = 0;
+    for (CTransform &t : pool->array) max_depth = std::max(max_depth, t.depth);
+
+    Array<u32> offsets = {};
+    offsets.resize(max_depth + 2);
+    memset(offsets.data, 0, sizeof(u32) * offsets.len);
+    for (CTransform &t : pool->array) offsets[t.depth + 1]++;
+    for (u64 d = 1; d < offsets.len; d++) offsets[d] += offsets[d - 1];
+
+    Array<CTransform> sorted = {};
+    sorted.resize(n);
+    for (CTransform &t : pool->array) sorted[offsets[t.depth]++] = t;
+
+    memcpy(pool->array.data, sorted.data, sizeof(CTransform) * n);
+    sorted.trash();
+    offsets.trash();
+
+    for (u64 i = 0; i < n; i++) entitymap_set(pool->emap, pool->array[i].ent, (int)i);
+    for (u64 i = 0; i < n; i++) {
+        CTransform *t = &pool->array[i];
+        flat_parents[i] = CEntityEq(t->parent, entity_nil) ? -1 : entitymap_get(pool->emap, t->parent);
+    }
+
+    flat_world_dirty = true;
+}
+
+// 线性遍历更新所有世界矩阵
+// 父级都在当前段之前的一段元素互不依赖 收集后用 mat3_mul_batch 一次计算
+// 按深度排序时每一段就是一层
+void Transform::FlatResolve() {
+    PROFILE_FUNC();
+
+    if (flat_order_dirty) FlatReorder();
+
+    CTransform *arr = ComponentTypeBase::EntityPool->array.data;
+    const int *parents = flat_parents.data;
+    u64 n = ComponentTypeBase::EntityPool->array.len;
+    for (u64 s = 0; s < n;) {
+        flat_world.len = 0;
+        flat_local.len = 0;
+
+        u64 e = s;
+        for (; e < n && parents[e] < (int)s; e++) {
+            CTransform *t = &arr[e];
+            if (t->dirty) {
+                t->mat_cache = mat3_scaling_rotation_translation(t->scale, t->rotation, t->position);
+                t->dirty = false;
+                ++stat_mat_ops;
+            }
+            if (parents[e] >= 0) {
+                flat_world.push(arr[parents[e]].worldmat_cache);
+                flat_local.push(t->mat_cache);
+            }
+        }
+
+        mat3_mul_batch(flat_world.data, flat_world.data, flat_local.data, flat_world.len);
+        stat_mat_ops += flat_world.len;
+
+        u64 k = 0;
+        for (u64 i = s; i < e; i++) {
+            CTransform *t = &arr[i];
+            mat3 world = parents[i] >= 0 ? flat_world[k++] : t->mat_cache;
+            if (memcmp(&t->worldmat_cache, &world, sizeof(mat3)) != 0) moved_list.push(t->ent);
+            t->worldmat_cache = world;
+        }
+        s = e;
+    }
+
+    flat_world_dirty = false;
+}
+
+void Transform::transform_set_flat_hierarchy(bool enable) {
+    if (flat_enabled == enable) return;
+    ResolveIfDirty();  // 切换前先更新完所有矩阵
+    flat_enabled = enable;
+    if (enable) {
+        flat_order_dirty = true;
+        flat_world_dirty = true;
+    } else {
+        flat_parents.trash();
+        flat_world.trash();
+        flat_local.trash();
+    }
+}
+
+bool Transform::transform_get_flat_hierarchy() { return flat_enabled; }
+
+u64 Transform::transform_get_matrix_ops() { return stat_mat_ops_frame; }
+
+Slice<CEntity> Transform::transform_get_moved() {
+    ResolveIfDirty();
+    return Slice<CEntity>(moved_list);
+}
+
+void Transform::transform_clear_moved() { moved_list.len = 0; }
+
 // -------------------------------------------------------------------------
 
 void Transform::transform_init() {
@@ -315,6 +508,9 @@ void Transform::transform_init() {
         .MemberMethod("transform_world_to_local", this, &Transform::transform_world_to_local)
         .MemberMethod("transform_get_dirty_count", this, &Transform::transform_get_dirty_count)
         .MemberMethod("transform_set_save_filter_rec", this, &Transform::transform_set_save_filter_rec)
+        .MemberMethod("transform_set_flat_hierarchy", this, &Transform::transform_set_flat_hierarchy)
+        .MemberMethod("transform_get_flat_hierarchy", this, &Transform::transform_get_flat_hierarchy)
+        .MemberMethod("transform_get_matrix_ops", this, &Transform::transform_get_matrix_ops)
 
         .MemberMethod<ComponentTypeBase>("transform_add", this, &ComponentTypeBase::WrapAdd)
         .MemberMethod<ComponentTypeBase>("transform_has", this, &ComponentTypeBase::ComponentHas)
@@ -335,6 +531,11 @@ void Transform::transform_fini() {
     CTransform *transform;
     entitypool_foreach(transform, ComponentTypeBase::EntityPool) if (transform->children.len) transform->children.trash();
     entitypool_free(ComponentTypeBase::EntityPool);
+    flat_parents.trash();
+    flat_world.trash();
+    flat_local.trash();
+    dirty_list.trash();
+    moved_list.trash();
 }
 
 int Transform::transform_update_all(Event evt) {
@@ -343,6 +544,10 @@ int Transform::transform_update_all(Event evt) {
 
     entitypool_remove_destroyed(ComponentTypeBase::EntityPool, [this](CEntity ent) { ComponentRemove(ent); });
 
+    ResolveIfDirty();
+    stat_mat_ops_frame = stat_mat_ops;
+    stat_mat_ops = 0;
+
     // update edit bbox
     if (edit_get_enabled()) entitypool_foreach(transform, ComponentTypeBase::EntityPool) edit_bboxes_update(transform->ent, bbox);
 
@@ -367,70 +572,51 @@ int Transform::Inspect(CEntity ent) {
     return 0;
 }
 
-// save/load for just the children array
-static void _children_save(CTransform *t, CL *app) {
-    // Store *u;
+// 快照只保存局部变换和父级 矩阵缓存与 children 在加载结束时重建
 
-    // if (store_child_save(&u, "children", s))
-    //     if (t->children.len)
-    //         for (auto &child : t->children)
-    //             if (entity_get_save_filter(child)) entity_save(&child, NULL, u);
+void Transform::SnapshotSave(CTransform *transform, SnapshotWriter &w) {
+    w.put(transform->position);
+    w.put(transform->rotation);
+    w.put(transform->scale);
+    w.put(transform->parent);
+    w.put(transform->dirty_count);
 }
-static void _children_load(CTransform *t, CL *app) {
-    // Store *u;
-    // CEntity child;
 
-    // t->children = {};
-
-    //// this is a little weird because we want NULL array when no children
-    // if (store_child_load(&u, "children", s))
-    //     if (entity_load(&child, NULL, entity_nil, u)) {
-    //         // t->children = (Array<CEntity> *)mem_alloc(sizeof(Array<CEntity>));
-    //         // *t->children = {};
-    //         do {
-    //             t->children.push(child);
-    //         } while (entity_load(&child, NULL, entity_nil, u));
-    //     }
+void Transform::SnapshotLoad(CTransform *transform, SnapshotReader &r) {
+    transform->position = r.get<vec2>();
+    transform->rotation = r.get<f32>();
+    transform->scale = r.get<vec2>();
+    transform->parent = r.get<CEntity>();
+    transform->children = {};
+    transform->dirty_count = r.get<EcsId>();
+    transform->dirty = true;
+    transform->depth = 0;
 }
 
-void transform_save_all(CL *app) {
-    // Store *t, *transform_s;
-    // CTransform *transform;
-
-    // if (store_child_save(&t, "transform", s)) entitypool_save_foreach(transform, transform_s, ComponentTypeBase::EntityPool, "pool", t) {
-    //         vec2_save(&transform->position, "position", transform_s);
-    //         float_save(&transform->rotation, "rotation", transform_s);
-    //         vec2_save(&transform->scale, "scale", transform_s);
-
-    //         if (entity_get_save_filter(transform->parent))
-    //             entity_save(&transform->parent, "parent", transform_s);
-    //         else
-    //             entity_save(&entity_nil, "parent", transform_s);
-    //         _children_save(transform, transform_s);
-
-    //         mat3_save(&transform->mat_cache, "mat_cache", transform_s);
-    //         mat3_save(&transform->worldmat_cache, "worldmat_cache", transform_s);
-
-    //         uint_save(&transform->dirty_count, "dirty_count", transform_s);
-    //     }
+void Transform::SnapshotLoadBegin() {
+    CTransform *transform;
+    entitypool_foreach(transform, ComponentTypeBase::EntityPool) if (transform->children.len) transform->children.trash();
+    entitypool_clear(ComponentTypeBase::EntityPool);
+    dirty_list.len = 0;
+    flat_order_dirty = true;
 }
-void transform_load_all(CL *app) {
-    // Store *t, *transform_s;
-    // CTransform *transform;
 
-    // if (store_child_load(&t, "transform", s)) {
-    //     entitypool_load_foreach(transform, transform_s, ComponentTypeBase::EntityPool, "pool", t) {
-    //         vec2_load(&transform->position, "position", vec2_zero, transform_s);
-    //         float_load(&transform->rotation, "rotation", 0, transform_s);
-    //         vec2_load(&transform->scale, "scale", luavec2(1, 1), transform_s);
+void Transform::SnapshotLoadEnd() {
+    CTransform *transform, *parent;
 
-    //         entity_load(&transform->parent, "parent", entity_nil, transform_s);
-    //         _children_load(transform, transform_s);
-
-    //         mat3_load(&transform->mat_cache, "mat_cache", mat3_identity(), transform_s);
-    //         mat3_load(&transform->worldmat_cache, "worldmat_cache", mat3_identity(), transform_s);
+    entitypool_foreach(transform, ComponentTypeBase::EntityPool) {
+        parent = ComponentGetPtr(transform->parent);
+        if (parent)
+            parent->children.push(transform->ent);
+        else
+            transform->parent = entity_nil;
+    }
 
-    //         uint_load(&transform->dirty_count, "dirty_count", 0, transform_s);
-    //     }
-    // }
+    // 所有元素都已标记为脏 只需把根加入更新列表
+    entitypool_foreach(transform, ComponentTypeBase::EntityPool) {
+        if (CEntityEq(transform->parent, entity_nil)) {
+            SetDepth(transform, 0);
+            dirty_list.push(transform->ent);
+        }
+    }
 }
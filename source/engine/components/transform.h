@@ -13,6 +13,8 @@ struct CTransform : CEntityBase {
     mat3 mat_cache;           // 更新此内容
     mat3 worldmat_cache;      // 在父子更新时缓存
     EcsId dirty_count;
+    bool dirty;               // mat_cache 与子树世界矩阵需要重新计算
+    u32 depth;                // 层级深度 root 为 0
 };
 
 static_assert(std::is_trivially_copyable_v<CTransform>);
@@ -24,6 +26,33 @@ private:
     void Detach(CTransform *p, CTransform *c);
     void DetachAll(CTransform *t);
 
+    // 扁平层级存储
+    // 开启后池内按 父级先于子级 的顺序排列 世界矩阵由一次线性遍历求得
+    bool flat_enabled = false;
+    bool flat_order_dirty = false;  // flat_parents 需要重建 顺序可能被破坏
+    bool flat_world_dirty = false;  // 有 mat_cache 更改但世界矩阵尚未更新
+    Array<int> flat_parents;        // 池中每个元素父级的下标 root 为 -1
+    Array<mat3> flat_world;         // FlatResolve 的临时数组 父级世界矩阵 计算后为子级世界矩阵
+    Array<mat3> flat_local;         // FlatResolve 的临时数组 子级局部矩阵
+
+    void SetDepth(CTransform *t, u32 depth);
+    void FlatSetParentIndex(CTransform *t);
+    void FlatReorder();
+    void FlatResolve();
+
+    // 延迟更新 setter 只标记 在 transform_update_all 或读取世界矩阵时统一计算
+    Array<CEntity> dirty_list;
+    u64 stat_mat_ops = 0;        // 本帧矩阵运算次数 (合成 + 乘法)
+    u64 stat_mat_ops_frame = 0;  // 上一帧
+
+    // 世界矩阵实际发生改变的实体 (可能重复) 由 Spatial 读取后清空
+    Array<CEntity> moved_list;
+
+    void ResolveDirty();
+    inline void ResolveIfDirty() {
+        if (dirty_list.len || (flat_enabled && (flat_world_dirty || flat_order_dirty))) ResolveDirty();
+    }
+
 public:
     void transform_init();
     void transform_fini();
@@ -57,5 +86,17 @@ public:
     EcsId transform_get_dirty_count(CEntity ent);
     void transform_set_save_filter_rec(CEntity ent, bool filter);
 
+    void transform_set_flat_hierarchy(bool enable);
+    bool transform_get_flat_hierarchy();
+    u64 transform_get_matrix_ops();  // 上一帧的矩阵运算次数
+    Slice<CEntity> transform_get_moved();  // 先更新所有脏节点
+    void transform_clear_moved();
+
     int Inspect(CEntity ent) override;
+
+    bool SnapshotEnabled() override { return true; }
+    void SnapshotSave(CTransform *transform, SnapshotWriter &w) override;
+    void SnapshotLoad(CTransform *transform, SnapshotReader &r) override;
+    void SnapshotLoadBegin() override;
+    void SnapshotLoadEnd() override;
 };
\ No newline at end of file
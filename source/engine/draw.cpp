@@ -7,6 +7,8 @@
 #include "engine/bootstrap.h"
 #include "engine/component.h"
 #include "engine/graphics.h"
+#include "engine/renderer/renderer.h"
+#include "engine/renderer/texture_atlas.h"
 #include "engine/scripting/lua_wrapper.hpp"
 #include "engine/ecs/entity.h"
 #include "engine/edit.h"
@@ -375,7 +377,12 @@ void draw_sprite(AseSprite *spr, DrawDescription *desc) {
 
     AseSpriteFrame f = view.data.frames[view.frame()];
 
-    batch.batch_texture(gl_tex_id);
+    // 效果按纹理的像素与 uv 范围采样 这时使用源纹理
+    if (spr->effects.any()) {
+        batch.batch_texture_direct(gl_tex_id);
+    } else {
+        batch.batch_texture(gl_tex_id);
+    }
 
     desc->x -= desc->ox;
     desc->y -= desc->oy;
@@ -571,18 +578,11 @@ static void draw_font_line(FontFamily *font, bool draw_in_world, float size, flo
     GLuint font_program = assets_get<AssetShader>(font_renderer.font_shader).id;
 
     glUseProgram(font_program);
-    glUniform3f(glGetUniformLocation(font_program, "textColor"), col.r / 255.f, col.g / 255.f, col.b / 255.f);
+    glUniform3f(neko_shader_uniform(font_program, "textColor"), col.r / 255.f, col.g / 255.f, col.b / 255.f);
     glActiveTexture(GL_TEXTURE0);
-    glUniform1i(glGetUniformLocation(font_program, "text"), 0);
+    glUniform1i(neko_shader_uniform(font_program, "text"), 0);
 
-    if (draw_in_world) {
-        glUniformMatrix3fv(glGetUniformLocation(font_program, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
-        glUniform1i(glGetUniformLocation(font_program, "mode"), 0);
-    } else {
-        mat4 cam_mat = mat4_ortho(0.0f, (float)the<CL>().state.width, (float)the<CL>().state.height, 0.0f, -1.0f, 1.0f);
-        glUniformMatrix4fv(glGetUniformLocation(font_program, "u_mvp"), 1, GL_FALSE, (const GLfloat *)cam_mat.elements);
-        glUniform1i(glGetUniformLocation(font_program, "mode"), 1);
-    }
+    glUniform1i(neko_shader_uniform(font_program, "mode"), draw_in_world ? 0 : 1);
 
     glBindVertexArray(font_renderer.font_vao);
 
@@ -705,10 +705,10 @@ void Batch::batch_init(int vertex_capacity) {
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(BatchVertex) * vertex_capacity, NULL, GL_DYNAMIC_DRAW);
+    batch = (batch_renderer *)mem_alloc(sizeof(batch_renderer));
+
+    // 每段可放 4 批 批次开始时预留整批的空间
+    streambuffer_init(&batch->stream, sizeof(BatchVertex) * vertex_capacity * 4);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, position));
@@ -721,28 +721,34 @@ void Batch::batch_init(int vertex_capacity) {
         error_assert(ok);
     }
 
-    batch = (batch_renderer *)mem_alloc(sizeof(batch_renderer));
-
     asset_load(AssetLoadData{AssetKind_Image, false}, "@gamedata/assets/aliens.png", NULL);
 
     // batch->shader = program;
     batch->vao = vao;
-    batch->vbo = vbo;
     batch->vertex_count = 0;
     batch->vertex_capacity = vertex_capacity;
-    batch->vertices = (BatchVertex *)mem_alloc(sizeof(BatchVertex) * vertex_capacity);
+    batch->vertices = NULL;
     batch->texture_id = 0;
+    batch->uv_offset[0] = batch->uv_offset[1] = 0;
+    batch->uv_scale[0] = batch->uv_scale[1] = 1;
     batch->scale = 0;
+    batch->layer = RenderLayer_World;
+    batch->depth = 0;
+    batch->outline = batch->glow = batch->bloom = batch->trans = batch->pixelate = false;
+    batch->pixelate_value = 0;
 
     auto type = BUILD_TYPE(Batch)
-                        .MemberMethod("batch_texture", this, &Batch::batch_texture)          //
-                        .MemberMethod("batch_flush", this, &Batch::batch_flush)              //
-                        .MemberMethod("batch_push_vertex", this, &Batch::batch_push_vertex)  //
+                        .MemberMethod("batch_texture", this, &Batch::batch_texture)            //
+                        .MemberMethod("batch_flush", this, &Batch::batch_flush)                //
+                        .MemberMethod("batch_push_vertex", this, &Batch::batch_push_vertex)    //
+                        .MemberMethod("batch_layer", this, &Batch::batch_layer)                //
+                        .MemberMethod("batch_layer_sorted", this, &Batch::batch_layer_sorted)  //
                         .Build();
 }
 
 void Batch::batch_fini() {
-    mem_free(batch->vertices);
+    streambuffer_fini(&batch->stream);
+    glDeleteVertexArrays(1, &batch->vao);
     mem_free(batch);
 }
 
@@ -799,8 +805,28 @@ int Batch::batch_update_all(Event evt) {
     return 0;
 }
 
-void Batch::batch_draw_all() { batch_flush(); }
+void Batch::batch_draw_all() {
+    batch_flush();
+    render_queue_flush(&the<Renderer>().queue);
+    streambuffer_nextframe(&batch->stream);
+    batch->depth = 0;
+}
+
+static void batch_apply(const RenderCommand *cmd) {
+    GLuint sid = cmd->shader;
+
+    glUniform1i(neko_shader_uniform(sid, "outline_enable"), (cmd->state >> 0) & 1);
+    glUniform1i(neko_shader_uniform(sid, "glow_enable"), (cmd->state >> 1) & 1);
+    glUniform1i(neko_shader_uniform(sid, "bloom_enable"), (cmd->state >> 2) & 1);
+    glUniform1i(neko_shader_uniform(sid, "trans_enable"), (cmd->state >> 3) & 1);
+    glUniform1i(neko_shader_uniform(sid, "pixelate_enable"), (cmd->state >> 4) & 1);
+    glUniform1f(neko_shader_uniform(sid, "pixelate_value"), cmd->params[0]);
+
+    glUniform1i(neko_shader_uniform(sid, "u_texture"), 0);
+    glUniform1f(neko_shader_uniform(sid, "scale"), cmd->params[1]);
+}
 
+// 把当前一段顶点作为命令提交 默认的层立即绘制 开启排序的层在 batch_draw_all 时与其他命令一起排序合并后绘制
 void Batch::batch_flush() {
     if (batch->vertex_count == 0) {
         return;
@@ -808,38 +834,63 @@ void Batch::batch_flush() {
 
     GLuint sid = assets_get<AssetShader>(shader_asset).id;
 
-    glUseProgram(sid);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, batch->texture_id);
-
-    glUniform1i(glGetUniformLocation(sid, "outline_enable"), batch->outline);
-    glUniform1i(glGetUniformLocation(sid, "glow_enable"), batch->glow);
-    glUniform1i(glGetUniformLocation(sid, "bloom_enable"), batch->bloom);
-    glUniform1i(glGetUniformLocation(sid, "trans_enable"), batch->trans);
-    glUniform1i(glGetUniformLocation(sid, "pixelate_enable"), batch->pixelate);
-    glUniform1f(glGetUniformLocation(sid, "pixelate_value"), batch->pixelate_value);
+    const size_t offset = streambuffer_unmap(&batch->stream, sizeof(BatchVertex) * batch->vertex_count);
+    batch->vertices = NULL;
+
+    RenderCommand cmd = {};
+    cmd.key = render_key(batch->layer, sid, batch->texture_id, batch->depth++);
+    cmd.shader = sid;
+    cmd.texture = batch->texture_id;
+    cmd.vao = batch->vao;
+    cmd.mode = GL_TRIANGLES;
+    cmd.first = (i32)(offset / sizeof(BatchVertex));
+    cmd.count = batch->vertex_count;
+    cmd.apply = batch_apply;
+    cmd.state = (u32)batch->outline << 0 | (u32)batch->glow << 1 | (u32)batch->bloom << 2 | (u32)batch->trans << 3 | (u32)batch->pixelate << 4;
+    cmd.params[0] = batch->pixelate_value;
+    cmd.params[1] = batch->scale;
+    render_queue_submit(&the<Renderer>().queue, cmd);
 
-    glUniform1i(glGetUniformLocation(sid, "u_texture"), 0);
-    // glUniformMatrix4fv(glGetUniformLocation(sid, "u_mvp"), 1, GL_FALSE, (const GLfloat *)&batch->mvp.cols[0]);
-    glUniformMatrix3fv(glGetUniformLocation(sid, "inverse_view_matrix"), 1, GL_FALSE, (const GLfloat *)the<Camera>().GetInverseViewMatrixPtr());
+    batch->vertex_count = 0;
+}
 
-    glUniform1f(glGetUniformLocation(sid, "scale"), batch->scale);
+void Batch::batch_layer(int layer) {
+    if (batch->layer != (u8)layer) {
+        batch_flush();
+        batch->layer = (u8)layer;
+    }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(BatchVertex) * batch->vertex_count, batch->vertices);
+void Batch::batch_layer_sorted(int layer, bool sorted) {
+    if (batch->layer == (u8)layer) batch_flush();
+    render_queue_set_layer_sorted(&the<Renderer>().queue, (u8)layer, sorted);
+}
 
-    glBindVertexArray(batch->vao);
-    glDrawArrays(GL_TRIANGLES, 0, batch->vertex_count);
+void Batch::batch_texture(GLuint id) {
+    TextureAtlasRegion region;
+    if (!texture_atlas_find(&texture_atlas(), id, &region)) {
+        batch_texture_direct(id);
+        return;
+    }
 
-    batch->vertex_count = 0;
+    // 同一页中的纹理不打断批次
+    if (batch->texture_id != region.page->id) {
+        batch_flush();
+        batch->texture_id = region.page->id;
+    }
+    batch->uv_offset[0] = region.u0;
+    batch->uv_offset[1] = region.v0;
+    batch->uv_scale[0] = region.u1 - region.u0;
+    batch->uv_scale[1] = region.v1 - region.v0;
 }
 
-void Batch::batch_texture(GLuint id) {
+void Batch::batch_texture_direct(GLuint id) {
     if (batch->texture_id != id) {
         batch_flush();
         batch->texture_id = id;
     }
+    batch->uv_offset[0] = batch->uv_offset[1] = 0;
+    batch->uv_scale[0] = batch->uv_scale[1] = 1;
 }
 
 void Batch::batch_push_vertex(float x, float y, float u, float v) {
@@ -847,9 +898,19 @@ void Batch::batch_push_vertex(float x, float y, float u, float v) {
         batch_flush();
     }
 
+    if (batch->vertices == NULL) {
+        const size_t bytes = sizeof(BatchVertex) * batch->vertex_capacity;
+
+        // 换段前先画完队列 否则排队中的命令引用的顶点可能在绘制前被覆盖
+        if (batch->stream.offset + bytes > batch->stream.size) {
+            render_queue_flush(&the<Renderer>().queue);
+        }
+        batch->vertices = (BatchVertex *)streambuffer_map(&batch->stream, bytes);
+    }
+
     batch->vertices[batch->vertex_count++] = BatchVertex{
             .position = {x, y},
-            .texcoord = {u, v},
+            .texcoord = {batch->uv_offset[0] + u * batch->uv_scale[0], batch->uv_offset[1] + v * batch->uv_scale[1]},
     };
 }
 
@@ -887,9 +948,9 @@ void DebugDraw::debug_draw_init() {
     debug_renderer->pos_width = glGetAttribLocation(debug_renderer->program_id, "pos_width");
     debug_renderer->col = glGetAttribLocation(debug_renderer->program_id, "col");
 
-    debug_renderer->view = glGetUniformLocation(debug_renderer->program_id, "inverse_view_matrix");
-    debug_renderer->viewport_size = glGetUniformLocation(debug_renderer->program_id, "u_viewport_size");
-    debug_renderer->aa_radius = glGetUniformLocation(debug_renderer->program_id, "u_aa_radius");
+    debug_renderer->view = neko_shader_uniform(debug_renderer->program_id, "inverse_view_matrix");
+    debug_renderer->viewport_size = neko_shader_uniform(debug_renderer->program_id, "u_viewport_size");
+    debug_renderer->aa_radius = neko_shader_uniform(debug_renderer->program_id, "u_aa_radius");
 
     GLuint binding_idx = 0;
     glCreateVertexArrays(1, &debug_renderer->vao);
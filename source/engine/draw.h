@@ -122,14 +122,19 @@ struct batch_renderer {
 
     // vertex buffer data
     GLuint vao;
-    GLuint vbo;
+    StreamBuffer stream;
     int vertex_count;
     int vertex_capacity;
-    BatchVertex* vertices;
+    BatchVertex* vertices;  // 本批在 stream 中的写入位置 批次开始前为 NULL
 
     float scale;
 
-    GLuint texture_id;
+    GLuint texture_id;  // 绑定的纹理 源纹理在图集中时为所在的页
+    f32 uv_offset[2];   // 源纹理空间的 uv 映射到 texture_id 中
+    f32 uv_scale[2];
+
+    u8 layer;    // RenderLayer
+    u32 depth;   // 本帧的提交序号 同一状态内保持顺序
 
     bool outline;
     bool glow;
@@ -151,8 +156,11 @@ public:
     void batch_draw_all();
 
     void batch_flush();
-    void batch_texture(GLuint id);
+    void batch_texture(GLuint id);         // 之后顶点的 uv 按 id 给出 小纹理会换成图集页
+    void batch_texture_direct(GLuint id);  // 不经过图集 用于依赖纹理尺寸与 uv 范围的效果
     void batch_push_vertex(float x, float y, float u, float v);
+    void batch_layer(int layer);
+    void batch_layer_sorted(int layer, bool sorted);  // 该层按纹理分组 不保持提交顺序 只用于互不重叠的内容
 
     inline batch_renderer* GetBatch() { return batch; }
 };
@@ -12,6 +12,8 @@
 #include "engine/bootstrap.h"
 #include "engine/component.h"
 #include "engine/ecs/lua_ecs.hpp"
+#include "engine/ecs/native_component.h"
+#include "engine/ecs/snapshot.h"
 #include "engine/edit.h"
 #include "engine/graphics.h"
 #include "engine/imgui.hpp"
@@ -43,7 +45,68 @@ CEntity entity_create(const String& name) {
 
 void entity_destroy_all() {}
 
-bool entity_destroyed(CEntity ent) { return NULL == EcsGetEnt(ENGINE_LUA(), ENGINE_ECS(), ent.id); }
+bool entity_destroyed(CEntity ent) {
+    EcsWorld* w = ENGINE_ECS();
+    if (ent.id >= (EcsId)w->entity_cap) return true;
+    EntityData* e = &w->entity_buf[ent.id];
+    return e->components_count < 0 || e->next != LINK_NONE;  // 空闲或已标记死亡
+}
+
+// -------------------------------------------------------------------------
+
+#define DESTROYED_EVENTS_MAX 65536  // 超出时丢弃最旧的事件 落后的读取者退回全量检查
+
+static Array<CEntity> destroyed_events;
+static u64 destroyed_base = 0;  // destroyed_events[0] 的序号
+static Array<u64*> destroyed_cursors;
+
+static u64 entity_destroyed_head() { return destroyed_base + destroyed_events.len; }
+
+static void entity_destroyed_push(int eid) { destroyed_events.push(CEntity{(EcsId)eid}); }
+
+void entity_destroyed_subscribe(u64* cursor) {
+    *cursor = entity_destroyed_head();
+    destroyed_cursors.push(cursor);
+}
+
+void entity_destroyed_unsubscribe(u64* cursor) {
+    for (u64 i = 0; i < destroyed_cursors.len; i++) {
+        if (destroyed_cursors[i] == cursor) {
+            destroyed_cursors.quick_remove(i);
+            return;
+        }
+    }
+}
+
+bool entity_destroyed_missed(u64 cursor) { return cursor < destroyed_base; }
+
+bool entity_destroyed_poll(u64* cursor, CEntity* ent) {
+    if (*cursor < destroyed_base) *cursor = destroyed_base;
+    if (*cursor >= entity_destroyed_head()) return false;
+    *ent = destroyed_events[*cursor - destroyed_base];
+    ++*cursor;
+    return true;
+}
+
+void entity_destroyed_invalidate() {
+    destroyed_base = entity_destroyed_head() + 1;
+    destroyed_events.len = 0;
+}
+
+// 丢弃所有读取者都已读过的事件
+static void entity_destroyed_trim() {
+    u64 head = entity_destroyed_head();
+    u64 keep = head;
+    for (u64* cursor : destroyed_cursors)
+        if (*cursor >= destroyed_base && *cursor < keep) keep = *cursor;
+    if (head - keep > DESTROYED_EVENTS_MAX) keep = head - DESTROYED_EVENTS_MAX;
+
+    u64 drop = keep - destroyed_base;
+    if (!drop) return;
+    memmove(destroyed_events.data, destroyed_events.data + drop, sizeof(CEntity) * (destroyed_events.len - drop));
+    destroyed_events.len -= drop;
+    destroyed_base = keep;
+}
 
 int wrap_EntityCreate(lua_State* L) {
     String name = luax_opt_string(L, 1, "something_unknown_from_lua");
@@ -98,6 +161,8 @@ void Entity::entity_init() {
 
     auto L = ENGINE_LUA();
 
+    EcsEntityDeadCallback = entity_destroyed_push;
+
     EcsRegister(L, "CTag");
 
     {
@@ -149,9 +214,18 @@ void Entity::entity_init() {
                                 {"entity_get_save_filter", wrap_entity_get_save_filter},
                         })
                         .Build();
+
+    snapshot_init(L);
+    native_component_init(L);
 }
 
-void Entity::entity_fini() {}
+void Entity::entity_fini() {
+    native_component_fini();
+    snapshot_fini();
+    EcsEntityDeadCallback = nullptr;
+    destroyed_events.trash();
+    destroyed_cursors.trash();
+}
 
 int Entity::entity_update_all(Event evt) {
     // EcsId i;
@@ -170,6 +244,10 @@ int Entity::entity_update_all(Event evt) {
 
     EcsUpdate(ENGINE_LUA());
 
+    native_component_update_all();
+
+    entity_destroyed_trim();
+
     return 0;
 }
 
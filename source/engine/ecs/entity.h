@@ -28,6 +28,15 @@ CEntity entity_create(const String& name);
 void entity_destroy_all();
 bool entity_destroyed(CEntity ent);
 
+// 实体销毁事件流
+// 实体被标记死亡时 id 按顺序追加到流中 每个读取者持有一个游标 (事件序号)
+// 每帧结束时丢弃所有读取者都已读过的事件 游标早于保留范围的读取者需要自行全量检查
+void entity_destroyed_subscribe(u64* cursor);
+void entity_destroyed_unsubscribe(u64* cursor);
+bool entity_destroyed_missed(u64 cursor);              // cursor 之前有事件已被丢弃
+bool entity_destroyed_poll(u64* cursor, CEntity* ent);  // 读取下一个事件 没有时返回 false
+void entity_destroyed_invalidate();                    // 丢弃所有事件 所有读取者下次都会全量检查
+
 class Entity : public SingletonClass<Entity> {
 public:
     void entity_init();
@@ -56,6 +65,8 @@ template <typename T>
 struct CEntityPool {
     CEntityMap* emap;  // 只是数组索引的映射 如果不存在则为 -1
     Array<T> array;
+    u64 destroyed_cursor;       // 已处理到的销毁事件
+    bool destroyed_subscribed;  // 订阅了销毁事件流 见 entitypool_subscribe_destroyed
 
     T* Add(CEntity ent) {
         T* elem = nullptr;
@@ -126,10 +137,21 @@ CEntityPool<T>* entitypool_new_(size_t object_size) {
 
     pool->emap = entitymap_new(-1);
     pool->array.reserve(2);
+    pool->destroyed_cursor = 0;
+    pool->destroyed_subscribed = false;
 
     return pool;
 }
 
+// 调用 entitypool_remove_destroyed 的池需要订阅 否则每次都遍历整个池
+// 不订阅的池不持有游标 不会阻止事件被丢弃
+template <typename T>
+void entitypool_subscribe_destroyed(CEntityPool<T>* pool) {
+    if (pool->destroyed_subscribed) return;
+    entity_destroyed_subscribe(&pool->destroyed_cursor);
+    pool->destroyed_subscribed = true;
+}
+
 template <typename T>
 auto entitypool_new() -> CEntityPool<T>* {
     return entitypool_new_<T>(sizeof(T));
@@ -137,6 +159,7 @@ auto entitypool_new() -> CEntityPool<T>* {
 
 template <typename T>
 void entitypool_free(CEntityPool<T>* pool) {
+    if (pool->destroyed_subscribed) entity_destroyed_unsubscribe(&pool->destroyed_cursor);
     pool->array.trash();
     entitymap_free(pool->emap);
     mem_free(pool);
@@ -189,6 +212,109 @@ void entitypool_sort(CEntityPool<T>* pool, int (*compar)(const void*, const void
     }
 }
 
+enum EntityPoolSortPath {
+    EntityPoolSort_None,       // 已有序
+    EntityPoolSort_Insertion,  // 少量元素无序 插入排序 只重新映射移动过的元素
+    EntityPoolSort_Radix,      // 基数排序 重建整个映射
+};
+
+// 按 key(elem) 返回的 u64 升序稳定排序
+// 先扫描一遍统计相邻逆序 没有则直接返回 很少且移动距离不大时走插入排序 否则走 LSD 基数排序 (跳过所有键都相同的字节)
+template <typename T, class K>
+EntityPoolSortPath entitypool_sort_by_key(CEntityPool<T>* pool, K key) {
+    struct KeyIndex {
+        u64 key;
+        u32 index;
+    };
+
+    u64 n = pool->array.len;
+    if (n < 2) return EntityPoolSort_None;
+
+    Array<u64> keys = {};
+    keys.resize(n);
+    u64 descents = 0;
+    for (u64 i = 0; i < n; i++) {
+        keys[i] = key(&pool->array[i]);
+        if (i && keys[i] < keys[i - 1]) descents++;
+    }
+
+    if (descents == 0) {
+        keys.trash();
+        return EntityPoolSort_None;
+    }
+
+    T* arr = pool->array.data;
+
+    // 插入排序的移动次数与元素移动的距离有关 超过 2n 次时放弃 从当前状态改走基数排序
+    // 映射只在结束时对移动过的区间重写一次
+    if (descents <= 32 || descents * 64 <= n) {
+        u64 budget = n * 2;
+        u64 lo = n, hi = 0;
+        bool done = true;
+        for (u64 i = 1; i < n; i++) {
+            if (keys[i] >= keys[i - 1]) continue;
+            T tmp = arr[i];
+            u64 k = keys[i];
+            u64 j = i;
+            for (; j > 0 && keys[j - 1] > k; j--) {
+                arr[j] = arr[j - 1];
+                keys[j] = keys[j - 1];
+            }
+            arr[j] = tmp;
+            keys[j] = k;
+            if (j < lo) lo = j;
+            hi = i;
+            if (i - j > budget) {
+                done = false;
+                break;
+            }
+            budget -= i - j;
+        }
+        if (done) {
+            for (u64 i = lo; i <= hi; i++) entitymap_set(pool->emap, arr[i].ent, (int)i);
+            keys.trash();
+            return EntityPoolSort_Insertion;
+        }
+    }
+
+    // 一次遍历统计全部 8 个字节的直方图
+    u32 hist[8][256] = {};
+    for (u64 i = 0; i < n; i++)
+        for (int d = 0; d < 8; d++) hist[d][(keys[i] >> (d * 8)) & 0xff]++;
+
+    Array<KeyIndex> a = {}, b = {};
+    a.resize(n);
+    b.resize(n);
+    for (u64 i = 0; i < n; i++) a[i] = KeyIndex{keys[i], (u32)i};
+
+    for (int d = 0; d < 8; d++) {
+        u32* h = hist[d];
+        if (h[(keys[0] >> (d * 8)) & 0xff] == n) continue;  // 该字节全部相同
+        u32 offset = 0;
+        for (int v = 0; v < 256; v++) {
+            u32 c = h[v];
+            h[v] = offset;
+            offset += c;
+        }
+        for (u64 i = 0; i < n; i++) b[h[(a[i].key >> (d * 8)) & 0xff]++] = a[i];
+        std::swap(a, b);
+    }
+
+    Array<T> sorted = {};
+    sorted.resize(n);
+    for (u64 i = 0; i < n; i++) sorted[i] = arr[a[i].index];
+    for (u64 i = 0; i < n; i++) {
+        arr[i] = sorted[i];
+        entitymap_set(pool->emap, arr[i].ent, (int)i);
+    }
+
+    sorted.trash();
+    a.trash();
+    b.trash();
+    keys.trash();
+    return EntityPoolSort_Radix;
+}
+
 // elem must be /pointer to/ pointer to element
 template <typename T>
 void entitypool_elem_save(CEntityPool<T>* pool, void* elem) {
@@ -210,8 +336,18 @@ void entitypool_elem_load(CEntityPool<T>* pool, void* elem) {
     // (*p)->ent = ent;
 }
 
+// 只处理上次调用之后销毁的实体 错过事件时退回遍历整个池
+// id 释放后可能已被新的实体重新使用 这时事件已过期 跳过
 template <typename T, class F>
 auto entitypool_remove_destroyed(CEntityPool<T>* pool, F func) {
+    CEntity ent;
+
+    if (pool->destroyed_subscribed && !entity_destroyed_missed(pool->destroyed_cursor)) {
+        while (entity_destroyed_poll(&pool->destroyed_cursor, &ent))
+            if (entity_destroyed(ent) && pool->GetPtr(ent)) func(ent);
+        return;
+    }
+
     do {
         EcsId i;
         CEntityBase* e;
@@ -223,6 +359,9 @@ auto entitypool_remove_destroyed(CEntityPool<T>* pool, F func) {
                 ++i;
         }
     } while (0);
+
+    if (pool->destroyed_subscribed)
+        while (entity_destroyed_poll(&pool->destroyed_cursor, &ent));  // 跳到最新
 }
 
 #define entitypool_foreach(var, pool) for (void* __end = (var = (decltype(var))entitypool_begin(pool), entitypool_end(pool)); var != __end; ++var)
@@ -122,6 +122,8 @@ EntityData* EcsEntityAlloc(EcsWorld* world) {
     return e;
 }
 
+void (*EcsEntityDeadCallback)(int eid) = nullptr;
+
 void EcsEntityDead(EcsWorld* world, EntityData* e) {
     if (e->components_count < 0) {  // 检查实体组件数量components_count是否小于0 如果是则表示该实体已经被标记为死亡或无效
         assert(e->next != LINK_NONE);
@@ -136,6 +138,8 @@ void EcsEntityDead(EcsWorld* world, EntityData* e) {
     }
     e->next = world->entity_dead_id;
     world->entity_dead_id = e - world->entity_buf;
+
+    if (EcsEntityDeadCallback) EcsEntityDeadCallback(world->entity_dead_id);
 }
 
 void EcsEntityFree(EcsWorld* world, EntityData* e) {
@@ -145,6 +149,56 @@ void EcsEntityFree(EcsWorld* world, EntityData* e) {
     --world->entity_count;
 }
 
+// 按指定 eid 重新占用实体 用于快照恢复 调用前世界必须为空
+void EcsEntityRestore(EcsWorld* world, const int* eids, int n) {
+    neko_assert(world->entity_count == 0 && "world is not empty");
+
+    int maxid = -1;
+    for (int i = 0; i < n; i++)
+        if (eids[i] > maxid) maxid = eids[i];
+
+    if (maxid >= world->entity_cap) {
+        int newcap = world->entity_cap;
+        while (newcap <= maxid) newcap *= 2;
+        world->entity_buf = (EntityData*)mem_realloc(world->entity_buf, newcap * sizeof(world->entity_buf[0]));
+        world->entity_cap = newcap;
+    }
+
+    for (int i = 0; i < world->entity_cap; i++) world->entity_buf[i].components_count = -1;
+
+    for (int i = 0; i < n; i++) {
+        EntityData* e = &world->entity_buf[eids[i]];
+        e->components_count = 0;
+        std::memset(e->components, ENTITY_MAX_COMPONENTS, sizeof(e->components));
+        std::memset(e->components_index, -1, sizeof(e->components_index));
+        e->next = LINK_NONE;
+    }
+    world->entity_count = n;
+
+    // 重建闲置链表 保持 eid 升序
+    int* link = &world->entity_free_id;
+    for (int i = 0; i < world->entity_cap; i++) {
+        EntityData* e = &world->entity_buf[i];
+        if (e->components_count >= 0) continue;
+        *link = i;
+        link = &e->next;
+    }
+    *link = LINK_NIL;
+}
+
+// 销毁所有实体和组件
+void EcsWorldReset(lua_State* L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, NEKO_ECS_CORE);
+    EcsWorld* w = (EcsWorld*)luaL_checkudata(L, -1, ECS_WORLD_METATABLE);
+    lua_pop(L, 1);
+
+    for (int eid = 0; eid < w->entity_cap; eid++) {
+        EntityData* e = &w->entity_buf[eid];
+        if (e->components_count >= 0 && e->next == LINK_NONE) EcsEntityDead(w, e);
+    }
+    EcsUpdate(L);
+}
+
 int EcsGetTid_w(lua_State* L, int stk, int proto_id) {
     stk = lua_absindex(L, stk);
     lua_pushvalue(L, stk);  // stk 应为 WORLD_PROTO_ID[] 表的键
@@ -36,6 +36,7 @@ enum ECS_WORLD_UPVALUES {
 #define NEKO_ECS_CORE "__NEKO_ECS_CORE"
 #define ECS_WORLD_METATABLE "__NEKO_ECS_WORLD_METATABLE"
 #define ECS_WORLD (1)
+#define ECS_MATCH_BATCH_METATABLE "__NEKO_ECS_MATCH_BATCH_METATABLE"
 
 struct ComponentData {
     int eid;  // 该组件附着的实体id
@@ -96,6 +97,15 @@ struct MatchCtx {
     int keys[ENTITY_MAX_COMPONENTS];
 };
 
+// world:query 创建的批量匹配游标 uservalue 1 为所属世界
+// 每次 next 填充至多 n 个结果 避免逐个实体跨越 Lua/C 边界
+struct MatchBatch {
+    MatchMode mode;
+    int i;  // MATCH_ALL 时为组件池下标 否则为链表节点
+    int kn;
+    int keys[ENTITY_MAX_COMPONENTS];
+};
+
 int EcsCreateWorld(lua_State* L);
 
 // EcsId ecs_component_w(ecs_t* registry, const_str component_name, size_t component_size, ecs_constructor_fn constructor, ecs_destructor_fn destructor);
@@ -118,6 +128,11 @@ void EcsEntityDead(EcsWorld* world, EntityData* e);
 EntityData* EcsEntityNew(lua_State* L, const LuaRef& ref, lua_CFunction gc);
 void EcsEntityDel(lua_State* L, int eid);
 void EcsEntityFree(EcsWorld* world, EntityData* e);
+void EcsEntityRestore(EcsWorld* world, const int* eids, int n);
+
+// 实体被标记死亡时调用 用于发布销毁事件
+extern void (*EcsEntityDeadCallback)(int eid);
+void EcsWorldReset(lua_State* L);
 int EcsComponentAlloc(EcsWorld* world, EntityData* e, int tid);
 int EcsComponentHas(EntityData* e, int tid);
 int EcsComponentSet(lua_State* L, EntityData* e, int tid, const LuaRef& ref);
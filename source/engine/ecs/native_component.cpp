@@ -0,0 +1,339 @@
+#include "engine/ecs/native_component.h"
+
+#include "base/common/logger.hpp"
+#include "base/common/profiler.hpp"
+#include "engine/bootstrap.h"
+#include "engine/scripting/lua_util.h"
+#include "engine/scripting/lua_wrapper.hpp"
+
+#define NATIVE_COMPONENT_VIEW "mt_native_component_view"
+
+static Array<NativeComponentPool*> g_pools;
+static HashMap<int> g_pool_names;  // fnv1a(name) -> type
+
+void* NativeComponentPool::Add(CEntity ent) {
+    void* elem = GetPtr(ent);
+    if (elem) return elem;
+
+    if (len == capacity) {
+        u32 cap = capacity ? capacity * 2 : 16;
+        data = (u8*)mem_realloc(data, (u64)cap * stride);
+        capacity = cap;
+    }
+
+    elem = Nth(len);
+    memset(elem, 0, stride);
+    ents.push(ent);
+    entitymap_set(emap, ent, (int)len);
+    len++;
+    return elem;
+}
+
+void NativeComponentPool::Remove(CEntity ent) {
+    int i = entitymap_get(emap, ent);
+    if (i < 0) return;
+
+    // 与最后一个元素交换
+    u32 last = len - 1;
+    if ((u32)i != last) {
+        memcpy(Nth(i), Nth(last), stride);
+        ents[i] = ents[last];
+        entitymap_set(emap, ents[i], i);
+    }
+    ents.len--;
+    len--;
+    entitymap_set(emap, ent, -1);
+}
+
+void* NativeComponentPool::GetPtr(CEntity ent) {
+    int i = entitymap_get(emap, ent);
+    return i >= 0 ? Nth(i) : nullptr;
+}
+
+void NativeComponentPool::SnapshotSaveAll(SnapshotWriter& w, u32* count) {
+    for (u32 i = 0; i < len; i++) {
+        w.put<u32>(ents[i].id);
+        w.put<u32>(size);
+        w.write(Nth(i), size);
+        ++*count;
+    }
+}
+
+void NativeComponentPool::SnapshotLoadBegin() {
+    entitymap_clear(emap);
+    ents.len = 0;
+    len = 0;
+}
+
+void NativeComponentPool::SnapshotLoadRecord(CEntity ent, SnapshotReader& r) {
+    void* elem = Add(ent);
+    // 类型大小改变后的旧快照 多余部分丢弃 不足部分保持为零
+    u64 n = r.len < size ? r.len : size;
+    r.read(elem, n);
+}
+
+// -------------------------------------------------------------------------
+
+int native_component_register(const_str name, u32 size, u32 align) {
+    error_assert(align > 0 && align <= 16 && (align & (align - 1)) == 0, "native component alignment must be a power of two <= 16");
+    error_assert(size > 0);
+
+    u64 key = fnv1a(String(name));
+    if (int* exists = g_pool_names.get(key)) {
+        error_assert(g_pools[*exists]->size == size, "native component registered twice with different size");
+        return *exists;
+    }
+
+    NativeComponentPool* pool = new NativeComponentPool();
+    String copy = to_cstr(String(name));
+    pool->name = copy.data;
+    pool->type = (int)g_pools.len;
+    pool->size = size;
+    pool->stride = (size + align - 1) & ~(align - 1);
+    pool->data = nullptr;
+    pool->len = 0;
+    pool->capacity = 0;
+    pool->ents = {};
+    pool->emap = entitymap_new(-1);
+    pool->fields = {};
+    entity_destroyed_subscribe(&pool->destroyed_cursor);
+    snapshot_register(pool);
+
+    g_pools.push(pool);
+    g_pool_names[key] = pool->type;
+    return pool->type;
+}
+
+int native_component_find(const_str name) {
+    int* type = g_pool_names.get(fnv1a(String(name)));
+    return type ? *type : -1;
+}
+
+NativeComponentPool* native_component_pool(int type) {
+    if (type < 0 || type >= (int)g_pools.len) return nullptr;
+    return g_pools[type];
+}
+
+void native_component_field(int type, const_str name, u32 offset, NativeFieldKind kind) {
+    NativeComponentPool* pool = native_component_pool(type);
+    error_assert(pool);
+    pool->fields[fnv1a(String(name))] = NativeComponentField{name, offset, kind};
+}
+
+void* native_component_add(int type, CEntity ent) { return native_component_pool(type)->Add(ent); }
+
+void native_component_remove(int type, CEntity ent) { native_component_pool(type)->Remove(ent); }
+
+void* native_component_get(int type, CEntity ent) { return native_component_pool(type)->GetPtr(ent); }
+
+u32 native_component_count(int type) { return native_component_pool(type)->len; }
+
+u64 native_component_memory() {
+    u64 bytes = 0;
+    for (NativeComponentPool* pool : g_pools) {
+        bytes += (u64)pool->capacity * pool->stride;
+        bytes += pool->ents.capacity * sizeof(CEntity);
+        bytes += (u64)pool->emap->capacity * sizeof(int);
+    }
+    return bytes;
+}
+
+void native_component_update_all() {
+    PROFILE_FUNC();
+
+    CEntity ent;
+    for (NativeComponentPool* pool : g_pools) {
+        if (!entity_destroyed_missed(pool->destroyed_cursor)) {
+            while (entity_destroyed_poll(&pool->destroyed_cursor, &ent)) pool->Remove(ent);
+            continue;
+        }
+
+        for (u32 i = 0; i < pool->len;) {
+            if (entity_destroyed(pool->ents[i]))
+                pool->Remove(pool->ents[i]);
+            else
+                ++i;
+        }
+        while (entity_destroyed_poll(&pool->destroyed_cursor, &ent));  // 跳到最新
+    }
+}
+
+// -------------------------------------------------------------------------
+// Lua 视图
+
+struct NativeComponentView {
+    int type;
+    CEntity ent;
+};
+
+static void* native_view_elem(lua_State* L, NativeComponentView* view) {
+    NativeComponentPool* pool = native_component_pool(view->type);
+    void* elem = pool->GetPtr(view->ent);
+    if (!elem) luaL_error(L, "native component %s of entity %d has been removed", pool->name, (int)view->ent.id);
+    return elem;
+}
+
+static NativeComponentField* native_view_field(lua_State* L, NativeComponentView* view, int idx) {
+    size_t n = 0;
+    const char* key = luaL_checklstring(L, idx, &n);
+    NativeComponentPool* pool = native_component_pool(view->type);
+    NativeComponentField* field = pool->fields.get(fnv1a(key, n));
+    if (!field) luaL_error(L, "native component %s has no field '%s'", pool->name, key);
+    return field;
+}
+
+static int native_view_index(lua_State* L) {
+    NativeComponentView* view = (NativeComponentView*)luaL_checkudata(L, 1, NATIVE_COMPONENT_VIEW);
+    NativeComponentField* field = native_view_field(L, view, 2);
+    u8* p = (u8*)native_view_elem(L, view) + field->offset;
+
+    switch (field->kind) {
+        case NativeField_F32:
+            lua_pushnumber(L, *(f32*)p);
+            break;
+        case NativeField_F64:
+            lua_pushnumber(L, *(f64*)p);
+            break;
+        case NativeField_I32:
+            lua_pushinteger(L, *(i32*)p);
+            break;
+        case NativeField_U32:
+            lua_pushinteger(L, *(u32*)p);
+            break;
+        case NativeField_Bool:
+            lua_pushboolean(L, *(bool*)p);
+            break;
+        case NativeField_Vec2:
+            LuaPush<vec2>(L, *(vec2*)p);
+            break;
+    }
+    return 1;
+}
+
+static int native_view_newindex(lua_State* L) {
+    NativeComponentView* view = (NativeComponentView*)luaL_checkudata(L, 1, NATIVE_COMPONENT_VIEW);
+    NativeComponentField* field = native_view_field(L, view, 2);
+    u8* p = (u8*)native_view_elem(L, view) + field->offset;
+
+    switch (field->kind) {
+        case NativeField_F32:
+            *(f32*)p = (f32)luaL_checknumber(L, 3);
+            break;
+        case NativeField_F64:
+            *(f64*)p = (f64)luaL_checknumber(L, 3);
+            break;
+        case NativeField_I32:
+            *(i32*)p = (i32)luaL_checkinteger(L, 3);
+            break;
+        case NativeField_U32:
+            *(u32*)p = (u32)luaL_checkinteger(L, 3);
+            break;
+        case NativeField_Bool:
+            *(bool*)p = lua_toboolean(L, 3);
+            break;
+        case NativeField_Vec2:
+            *(vec2*)p = *LuaGet<vec2>(L, 3);
+            break;
+    }
+    return 0;
+}
+
+static int native_view_tostring(lua_State* L) {
+    NativeComponentView* view = (NativeComponentView*)luaL_checkudata(L, 1, NATIVE_COMPONENT_VIEW);
+    lua_pushfstring(L, "%s: entity %d", native_component_pool(view->type)->name, (int)view->ent.id);
+    return 1;
+}
+
+static NativeComponentPool* native_check_pool(lua_State* L, int idx) {
+    const char* name = luaL_checkstring(L, idx);
+    NativeComponentPool* pool = native_component_pool(native_component_find(name));
+    if (!pool) luaL_error(L, "unknown native component %s", name);
+    return pool;
+}
+
+static void native_push_view(lua_State* L, NativeComponentPool* pool, CEntity ent) {
+    NativeComponentView* view = (NativeComponentView*)lua_newuserdatauv(L, sizeof(NativeComponentView), 0);
+    view->type = pool->type;
+    view->ent = ent;
+    luaL_setmetatable(L, NATIVE_COMPONENT_VIEW);
+}
+
+// neko.native_component_add(ent, name) -> view
+static int wrap_native_component_add(lua_State* L) {
+    CEntity* ent = LuaGet<CEntity>(L, 1);
+    NativeComponentPool* pool = native_check_pool(L, 2);
+    pool->Add(*ent);
+    native_push_view(L, pool, *ent);
+    return 1;
+}
+
+// neko.native_component_get(ent, name) -> view 或 nil
+static int wrap_native_component_get(lua_State* L) {
+    CEntity* ent = LuaGet<CEntity>(L, 1);
+    NativeComponentPool* pool = native_check_pool(L, 2);
+    if (!pool->GetPtr(*ent)) return 0;
+    native_push_view(L, pool, *ent);
+    return 1;
+}
+
+// neko.native_component_has(ent, name) -> boolean
+static int wrap_native_component_has(lua_State* L) {
+    CEntity* ent = LuaGet<CEntity>(L, 1);
+    NativeComponentPool* pool = native_check_pool(L, 2);
+    lua_pushboolean(L, pool->GetPtr(*ent) != nullptr);
+    return 1;
+}
+
+// neko.native_component_remove(ent, name)
+static int wrap_native_component_remove(lua_State* L) {
+    CEntity* ent = LuaGet<CEntity>(L, 1);
+    NativeComponentPool* pool = native_check_pool(L, 2);
+    pool->Remove(*ent);
+    return 0;
+}
+
+// neko.native_component_count(name) -> integer
+static int wrap_native_component_count(lua_State* L) {
+    NativeComponentPool* pool = native_check_pool(L, 1);
+    lua_pushinteger(L, pool->len);
+    return 1;
+}
+
+void native_component_init(lua_State* L) {
+    luaL_Reg reg[] = {
+            {"__index", native_view_index},
+            {"__newindex", native_view_newindex},
+            {"__tostring", native_view_tostring},
+            {NULL, NULL},
+    };
+    luaL_newmetatable(L, NATIVE_COMPONENT_VIEW);
+    luaL_setfuncs(L, reg, 0);
+    lua_pop(L, 1);
+
+    auto type = BUILD_TYPE(NativeComponent)
+                        .CClosure({
+                                {"native_component_add", wrap_native_component_add},
+                                {"native_component_get", wrap_native_component_get},
+                                {"native_component_has", wrap_native_component_has},
+                                {"native_component_remove", wrap_native_component_remove},
+                                {"native_component_count", wrap_native_component_count},
+                        })
+                        .Build();
+}
+
+void native_component_fini() {
+    for (NativeComponentPool* pool : g_pools) {
+        snapshot_unregister(pool);
+        entity_destroyed_unsubscribe(&pool->destroyed_cursor);
+        entitymap_free(pool->emap);
+        pool->ents.trash();
+        pool->fields.trash();
+        mem_free(pool->data);
+        mem_free((void*)pool->name);
+        delete pool;
+    }
+    g_pools.trash();
+    g_pools = {};
+    g_pool_names.trash();
+    g_pool_names = {};
+}
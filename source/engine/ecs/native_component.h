@@ -0,0 +1,95 @@
+#ifndef NEKO_NATIVE_COMPONENT_H
+#define NEKO_NATIVE_COMPONENT_H
+
+#include "engine/base.hpp"
+#include "engine/ecs/entity.h"
+#include "engine/ecs/snapshot.h"
+
+// 纯原生组件
+// 只声明大小与对齐 数据全部存放在原生池中 不在 Lua 世界里为每个实例创建组件表
+// Lua 通过 neko.native_component_get 按需创建轻量视图 (userdata 只保存类型与实体)
+// 视图每次访问都重新查找元素 组件被删除后访问会报错
+
+enum NativeFieldKind : u8 {
+    NativeField_F32,
+    NativeField_F64,
+    NativeField_I32,
+    NativeField_U32,
+    NativeField_Bool,
+    NativeField_Vec2,
+};
+
+struct NativeComponentField {
+    const_str name;
+    u32 offset;
+    NativeFieldKind kind;
+};
+
+// 连续存储 删除时与最后一个元素交换
+class NativeComponentPool : public SnapshotSection {
+public:
+    const_str name;
+    int type;
+    u32 size;
+    u32 stride;  // size 按 align 向上取整
+    u8* data;
+    u32 len;
+    u32 capacity;
+    Array<CEntity> ents;  // 与 data 平行
+    CEntityMap* emap;     // ent -> index 不存在为 -1
+    u64 destroyed_cursor;
+    HashMap<NativeComponentField> fields;  // fnv1a(name) -> field
+
+    void* Add(CEntity ent);
+    void Remove(CEntity ent);
+    void* GetPtr(CEntity ent);
+    void* Nth(u32 i) { return data + (u64)i * stride; }
+
+    const_str SnapshotName() override { return name; }
+    bool SnapshotEnabled() override { return true; }
+    void SnapshotSaveAll(SnapshotWriter& w, u32* count) override;
+    void SnapshotLoadBegin() override;
+    void SnapshotLoadRecord(CEntity ent, SnapshotReader& r) override;
+    void SnapshotLoadEnd() override {}
+    void* SnapshotGetElem(CEntity ent) override { return GetPtr(ent); }
+};
+
+// 返回类型 id 重复注册同名类型返回已有 id (大小必须一致)
+int native_component_register(const_str name, u32 size, u32 align);
+int native_component_find(const_str name);  // 不存在为 -1
+NativeComponentPool* native_component_pool(int type);
+
+// 声明字段后 Lua 视图才能按名字读写
+void native_component_field(int type, const_str name, u32 offset, NativeFieldKind kind);
+
+void* native_component_add(int type, CEntity ent);  // 新元素清零 已存在时返回原元素
+void native_component_remove(int type, CEntity ent);
+void* native_component_get(int type, CEntity ent);  // 不存在为 NULL
+u32 native_component_count(int type);
+u64 native_component_memory();  // 所有池占用的字节数
+
+// 移除已销毁实体的组件 在 entity_update_all 中调用
+void native_component_update_all();
+
+void native_component_init(lua_State* L);
+void native_component_fini();
+
+template <typename T>
+int native_component_register() {
+    static_assert(std::is_trivially_copyable_v<T>, "native component must be trivially copyable");
+    return native_component_register(reflection::GetTypeName<T>(), sizeof(T), alignof(T));
+}
+
+template <typename T>
+T* native_component_add(int type, CEntity ent) {
+    return (T*)native_component_add(type, ent);
+}
+
+template <typename T>
+T* native_component_get(int type, CEntity ent) {
+    return (T*)native_component_get(type, ent);
+}
+
+#define NATIVE_COMPONENT_FIELD(type, T, member, kind) native_component_field(type, #member, (u32)offsetof(T, member), kind)
+
+#endif
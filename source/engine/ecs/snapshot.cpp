@@ -0,0 +1,787 @@
+#include "engine/ecs/snapshot.h"
+
+#include "base/common/logger.hpp"
+#include "base/common/profiler.hpp"
+#include "engine/bootstrap.h"
+#include "engine/ecs/entity.h"
+#include "engine/ecs/lua_ecs.hpp"
+#include "engine/scripting/lua_util.h"
+
+using namespace Neko::luabind;
+using namespace Neko::ecs;
+
+#define SNAPSHOT_LUA_SECTION "__lua_ecs"
+#define SNAPSHOT_LUA_MAX_DEPTH 32  // 组件表为第 0 层 编码与解码都只接受层数小于该值的表
+
+static Array<SnapshotSection *> g_sections;
+static u64 g_snapshot_frame = 0;
+
+void snapshot_register(SnapshotSection *section) {
+    for (SnapshotSection *s : g_sections)
+        if (s == section) return;
+    g_sections.push(section);
+}
+
+void snapshot_unregister(SnapshotSection *section) {
+    for (u64 i = 0; i < g_sections.len; i++) {
+        if (g_sections[i] == section) {
+            g_sections.quick_remove(i);
+            return;
+        }
+    }
+}
+
+static SnapshotSection *snapshot_find_section(String name) {
+    for (SnapshotSection *s : g_sections) {
+        String sname = s->SnapshotName();
+        if (sname.equel(name)) return s;
+    }
+    return nullptr;
+}
+
+static Slice<u8> snapshot_slice(const u8 *data, u64 len) {
+    Slice<u8> s;
+    s.data = (u8 *)data;
+    s.len = len;
+    return s;
+}
+
+// -------------------------------------------------------------------------
+// 解析
+
+struct SnapshotSectionView {
+    String name;
+    u32 record_count;
+    const u8 *records;
+    u64 records_size;
+    u32 removed_count;
+    const u8 *removed;
+};
+
+static bool snapshot_parse(Slice<u8> snap, SnapshotHeader *header, Array<SnapshotSectionView> *sections) {
+    SnapshotReader r(snap.data, snap.len);
+
+    r.read(header, sizeof(SnapshotHeader));
+    if (!r.ok || header->magic != NEKO_SNAPSHOT_MAGIC) {
+        LOG_WARN("snapshot: bad magic");
+        return false;
+    }
+    if (header->version != NEKO_SNAPSHOT_VERSION) {
+        LOG_WARN("snapshot: unsupported version {}", header->version);
+        return false;
+    }
+
+    for (u32 i = 0; i < header->section_count && r.ok; i++) {
+        SnapshotSectionView v = {};
+        u16 name_len = r.get<u16>();
+        v.name = String((const char *)r.skip(name_len), name_len);
+        v.record_count = r.get<u32>();
+        v.records = r.data + r.pos;
+        for (u32 j = 0; j < v.record_count && r.ok; j++) {
+            r.skip(sizeof(u32));
+            r.skip(r.get<u32>());
+        }
+        v.records_size = (r.data + r.pos) - v.records;
+        v.removed_count = r.get<u32>();
+        v.removed = r.skip((u64)v.removed_count * sizeof(u32));
+        sections->push(v);
+    }
+
+    if (!r.ok) LOG_WARN("snapshot: truncated data");
+    return r.ok;
+}
+
+static SnapshotSectionView *snapshot_find_view(Array<SnapshotSectionView> &sections, String name) {
+    for (SnapshotSectionView &v : sections)
+        if (v.name.equel(name)) return &v;
+    return nullptr;
+}
+
+// 遍历 section 内的 record
+template <typename F>
+static void snapshot_foreach_record(const SnapshotSectionView &v, F func) {
+    SnapshotReader r(v.records, v.records_size);
+    for (u32 i = 0; i < v.record_count; i++) {
+        const u8 *record = r.data + r.pos;
+        u32 ent = r.get<u32>();
+        u32 size = r.get<u32>();
+        const u8 *payload = r.skip(size);
+        func(ent, record, payload, size);
+    }
+}
+
+static void snapshot_write_header(SnapshotWriter &w, u32 flags, u64 frame, u64 base_frame) {
+    SnapshotHeader header = {};
+    header.magic = NEKO_SNAPSHOT_MAGIC;
+    header.version = NEKO_SNAPSHOT_VERSION;
+    header.flags = flags;
+    header.section_count = 0;
+    header.frame = frame;
+    header.base_frame = base_frame;
+    w.put(header);
+}
+
+static void snapshot_patch_section_count(SnapshotWriter &w, u64 header_at, u32 count) { w.patch_u32(header_at + offsetof(SnapshotHeader, section_count), count); }
+
+static void snapshot_write_section_name(SnapshotWriter &w, String name) {
+    w.put<u16>((u16)name.len);
+    w.write(name.data, name.len);
+}
+
+static void snapshot_write_record(SnapshotWriter &w, u32 ent, const u8 *payload, u32 size) {
+    w.put<u32>(ent);
+    w.put<u32>(size);
+    w.write(payload, size);
+}
+
+const SnapshotHeader *snapshot_header(Slice<u8> snap) {
+    if (snap.len < sizeof(SnapshotHeader)) return nullptr;
+    const SnapshotHeader *header = (const SnapshotHeader *)snap.data;
+    if (header->magic != NEKO_SNAPSHOT_MAGIC) return nullptr;
+    return header;
+}
+
+// -------------------------------------------------------------------------
+// Lua 值编码
+// 只保存 boolean/number/string/table 其余类型 (函数 userdata) 无法跨快照恢复因此跳过
+
+enum SnapshotLuaTag : u8 {
+    SnapshotLuaTag_Nil,
+    SnapshotLuaTag_False,
+    SnapshotLuaTag_True,
+    SnapshotLuaTag_Int,
+    SnapshotLuaTag_Num,
+    SnapshotLuaTag_Str,
+    SnapshotLuaTag_Table,
+    SnapshotLuaTag_End,
+};
+
+static bool snapshot_lua_encodable(lua_State *L, int idx, int depth) {
+    switch (lua_type(L, idx)) {
+        case LUA_TBOOLEAN:
+        case LUA_TNUMBER:
+        case LUA_TSTRING:
+            return true;
+        case LUA_TTABLE:
+            return depth + 1 < SNAPSHOT_LUA_MAX_DEPTH;  // 作为 depth 层表的键值 位于 depth + 1 层
+        default:
+            return false;
+    }
+}
+
+// 组件表中由 ECS 维护的键 加载时会重新写入
+static bool snapshot_lua_is_ecs_key(lua_State *L, int idx) {
+    if (lua_type(L, idx) != LUA_TSTRING) return false;
+    size_t len;
+    const char *key = lua_tolstring(L, idx, &len);
+    return len == 5 && key[0] == '_' && key[1] == '_' && (!strcmp(key, "__eid") || !strcmp(key, "__tid"));
+}
+
+static void snapshot_lua_encode_table(lua_State *L, int idx, SnapshotWriter &w, int depth, bool component_root);
+
+static void snapshot_lua_encode_value(lua_State *L, int idx, SnapshotWriter &w, int depth) {
+    switch (lua_type(L, idx)) {
+        case LUA_TBOOLEAN:
+            w.put<u8>(lua_toboolean(L, idx) ? SnapshotLuaTag_True : SnapshotLuaTag_False);
+            break;
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, idx)) {
+                w.put<u8>(SnapshotLuaTag_Int);
+                w.put<i64>((i64)lua_tointeger(L, idx));
+            } else {
+                w.put<u8>(SnapshotLuaTag_Num);
+                w.put<f64>((f64)lua_tonumber(L, idx));
+            }
+            break;
+        case LUA_TSTRING: {
+            size_t len;
+            const char *str = lua_tolstring(L, idx, &len);
+            w.put<u8>(SnapshotLuaTag_Str);
+            w.put_string(String(str, len));
+            break;
+        }
+        case LUA_TTABLE:
+            snapshot_lua_encode_table(L, idx, w, depth + 1, false);
+            break;
+        default:
+            w.put<u8>(SnapshotLuaTag_Nil);
+            break;
+    }
+}
+
+static void snapshot_lua_encode_table(lua_State *L, int idx, SnapshotWriter &w, int depth, bool component_root) {
+    idx = lua_absindex(L, idx);
+    w.put<u8>(SnapshotLuaTag_Table);
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        bool skip = !snapshot_lua_encodable(L, -2, depth) || !snapshot_lua_encodable(L, -1, depth) || lua_istable(L, -2);
+        if (component_root && snapshot_lua_is_ecs_key(L, -2)) skip = true;
+        if (!skip) {
+            snapshot_lua_encode_value(L, -2, w, depth);
+            snapshot_lua_encode_value(L, -1, w, depth);
+        }
+        lua_pop(L, 1);
+    }
+    w.put<u8>(SnapshotLuaTag_End);
+}
+
+// 压入一个解码后的值 失败时压入 nil 并返回 false
+static bool snapshot_lua_decode_value(lua_State *L, SnapshotReader &r, int depth) {
+    u8 tag = r.get<u8>();
+    switch (tag) {
+        case SnapshotLuaTag_False:
+            lua_pushboolean(L, 0);
+            break;
+        case SnapshotLuaTag_True:
+            lua_pushboolean(L, 1);
+            break;
+        case SnapshotLuaTag_Int:
+            lua_pushinteger(L, (lua_Integer)r.get<i64>());
+            break;
+        case SnapshotLuaTag_Num:
+            lua_pushnumber(L, (lua_Number)r.get<f64>());
+            break;
+        case SnapshotLuaTag_Str: {
+            String str = r.get_string();
+            lua_pushlstring(L, str.data, str.len);
+            break;
+        }
+        case SnapshotLuaTag_Table: {
+            if (depth >= SNAPSHOT_LUA_MAX_DEPTH) {
+                r.ok = false;
+                lua_pushnil(L);
+                return false;
+            }
+            lua_newtable(L);
+            while (r.ok) {
+                if (r.pos < r.len && r.data[r.pos] == SnapshotLuaTag_End) {
+                    r.skip(1);
+                    break;
+                }
+                snapshot_lua_decode_value(L, r, depth + 1);
+                snapshot_lua_decode_value(L, r, depth + 1);
+                if (lua_isnil(L, -2)) {
+                    lua_pop(L, 2);
+                    continue;
+                }
+                lua_rawset(L, -3);
+            }
+            break;
+        }
+        default:
+            lua_pushnil(L);
+            break;
+    }
+    return r.ok;
+}
+
+// -------------------------------------------------------------------------
+// Lua ECS section
+// 每个存活实体一条 record: u8 组件数 | (name u8 长度 + 字符 | kind u8 | [表数据]) * 组件数
+
+enum SnapshotLuaComponentKind : u8 {
+    SnapshotLuaComponentKind_Table,  // Lua 组件 保存整个表
+    SnapshotLuaComponentKind_CType,  // 原生组件 只保存链接 数据由对应的 SnapshotSection 恢复
+};
+
+struct SnapshotLuaTypeInfo {
+    String name;
+    bool ctype;
+};
+
+static void snapshot_lua_collect_types(lua_State *L, int ecs_ud, Array<SnapshotLuaTypeInfo> &types) {
+    types.resize(TYPE_COUNT);
+    memset(types.data, 0, sizeof(SnapshotLuaTypeInfo) * TYPE_COUNT);
+
+    lua_getiuservalue(L, ecs_ud, WORLD_PROTO_ID);
+    lua_getiuservalue(L, ecs_ud, WORLD_PROTO_DEFINE);
+    lua_pushnil(L);
+    while (lua_next(L, -3) != 0) {
+        int tid = (int)lua_tointeger(L, -1);
+        if (tid >= TYPE_MIN_ID && tid <= TYPE_MAX_ID) {
+            size_t len;
+            const char *name = lua_tolstring(L, -2, &len);  // 字符串由 WORLD_PROTO_ID 持有
+            types[tid].name = String(name, len);
+            lua_pushvalue(L, -2);
+            lua_rawget(L, -4);  // WORLD_PROTO_DEFINE[name]
+            types[tid].ctype = lua_islightuserdata(L, -1);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 2);  // # pop WORLD_PROTO_DEFINE | WORLD_PROTO_ID
+}
+
+static void snapshot_lua_save(lua_State *L, SnapshotWriter &w, u32 *count) {
+    lua_getfield(L, LUA_REGISTRYINDEX, NEKO_ECS_CORE);
+    int ecs_ud = lua_gettop(L);
+    EcsWorld *world = (EcsWorld *)luaL_checkudata(L, ecs_ud, ECS_WORLD_METATABLE);
+
+    Array<SnapshotLuaTypeInfo> types = {};
+    snapshot_lua_collect_types(L, ecs_ud, types);
+
+    lua_getiuservalue(L, ecs_ud, WORLD_COMPONENTS);
+    int components = lua_gettop(L);
+
+    for (int eid = 0; eid < world->entity_cap; eid++) {
+        EntityData *e = &world->entity_buf[eid];
+        if (e->components_count < 0 || e->next != LINK_NONE) continue;  // 空闲或已标记死亡
+
+        w.put<u32>((u32)eid);
+        u64 size_at = w.reserve_u32();
+        u64 start = w.buf.len;
+
+        u64 n_at = w.buf.len;
+        w.put<u8>(0);
+        u8 n = 0;
+
+        for (int tid = TYPE_MIN_ID; tid <= world->type_idx; tid++) {
+            int cid = EcsEntityGetCid(e, tid);
+            if (cid < 0 || !types[tid].name.len) continue;
+            if (world->component_pool[tid].buf[cid].dead_next != LINK_NONE) continue;
+
+            w.put<u8>((u8)types[tid].name.len);
+            w.write(types[tid].name.data, types[tid].name.len);
+
+            if (types[tid].ctype) {
+                w.put<u8>(SnapshotLuaComponentKind_CType);
+            } else {
+                w.put<u8>(SnapshotLuaComponentKind_Table);
+                lua_rawgeti(L, components, tid);
+                lua_rawgeti(L, -1, cid);
+                if (lua_istable(L, -1)) {
+                    snapshot_lua_encode_table(L, -1, w, 0, true);
+                } else {
+                    w.put<u8>(SnapshotLuaTag_Table);
+                    w.put<u8>(SnapshotLuaTag_End);
+                }
+                lua_pop(L, 2);
+            }
+            n++;
+        }
+
+        w.buf.data[n_at] = n;
+        w.patch_u32(size_at, (u32)(w.buf.len - start));
+        ++*count;
+    }
+
+    types.trash();
+    lua_pop(L, 2);  // # pop WORLD_COMPONENTS | __NEKO_ECS_CORE
+}
+
+// 设置栈顶的表为实体 e 的 tid 组件 弹出该表
+static int snapshot_lua_component_set(lua_State *L, int ecs_ud, int components, EcsWorld *world, EntityData *e, int tid) {
+    int eid = e - world->entity_buf;
+
+    lua_getiuservalue(L, ecs_ud, WORLD_KEY_EID);
+    lua_pushinteger(L, eid);
+    lua_rawset(L, -3);
+    lua_getiuservalue(L, ecs_ud, WORLD_KEY_TID);
+    lua_pushinteger(L, tid);
+    lua_rawset(L, -3);
+
+    int cid = EcsComponentAlloc(world, e, tid);
+    if (cid < 0) {
+        lua_pop(L, 1);
+        return -1;
+    }
+
+    lua_rawgeti(L, components, tid);  // WORLD_COMPONENTS[tid]
+    lua_pushvalue(L, -2);             // 复制 {...}
+    lua_rawseti(L, -2, cid);          // WORLD_COMPONENTS[tid][cid] = {...}
+    lua_pop(L, 2);                    // # pop WORLD_COMPONENTS[tid] | {...}
+
+    return cid;
+}
+
+static bool snapshot_lua_load(lua_State *L, const SnapshotSectionView *lua_section, Array<SnapshotSectionView> &sections) {
+    lua_getfield(L, LUA_REGISTRYINDEX, NEKO_ECS_CORE);
+    int ecs_ud = lua_gettop(L);
+    EcsWorld *world = (EcsWorld *)luaL_checkudata(L, ecs_ud, ECS_WORLD_METATABLE);
+
+    // 清空当前世界并按快照中的 eid 重新占用实体
+    EcsWorldReset(L);
+
+    Array<int> eids = {};
+    if (lua_section) {
+        eids.reserve(lua_section->record_count);
+        snapshot_foreach_record(*lua_section, [&](u32 ent, const u8 *, const u8 *, u32) { eids.push((int)ent); });
+    }
+    EcsEntityRestore(world, eids.data, (int)eids.len);
+    eids.trash();
+
+    // 原生组件池
+    for (SnapshotSection *section : g_sections) {
+        if (!section->SnapshotEnabled()) continue;
+        section->SnapshotLoadBegin();
+        SnapshotSectionView *v = snapshot_find_view(sections, section->SnapshotName());
+        if (v) {
+            snapshot_foreach_record(*v, [&](u32 ent, const u8 *, const u8 *payload, u32 size) {
+                SnapshotReader rr(payload, size);
+                section->SnapshotLoadRecord(CEntity{ent}, rr);
+            });
+        }
+        section->SnapshotLoadEnd();
+    }
+
+    // Lua 组件表 原生组件重新建立 __ud 链接
+    bool ok = true;
+    if (lua_section) {
+        lua_getiuservalue(L, ecs_ud, WORLD_PROTO_ID);
+        int proto_id = lua_gettop(L);
+        lua_getiuservalue(L, ecs_ud, WORLD_COMPONENTS);
+        int components = lua_gettop(L);
+
+        snapshot_foreach_record(*lua_section, [&](u32 ent, const u8 *, const u8 *payload, u32 size) {
+            EntityData *e = &world->entity_buf[ent];
+            SnapshotReader r(payload, size);
+            u8 n = r.get<u8>();
+            for (u8 i = 0; i < n && r.ok; i++) {
+                u8 name_len = r.get<u8>();
+                String name((const char *)r.skip(name_len), name_len);
+                u8 kind = r.get<u8>();
+
+                lua_pushlstring(L, name.data, name.len);
+                lua_rawget(L, proto_id);
+                int tid = (int)lua_tointeger(L, -1);
+                lua_pop(L, 1);
+
+                if (kind == SnapshotLuaComponentKind_Table) {
+                    snapshot_lua_decode_value(L, r, 0);
+                    if (tid < TYPE_MIN_ID || !lua_istable(L, -1)) {
+                        lua_pop(L, 1);  // 当前世界没有注册该组件
+                        continue;
+                    }
+                    snapshot_lua_component_set(L, ecs_ud, components, world, e, tid);
+                } else {
+                    SnapshotSection *section = snapshot_find_section(name);
+                    void *elem = section ? section->SnapshotGetElem(CEntity{ent}) : nullptr;
+                    if (tid < TYPE_MIN_ID || !elem) continue;
+                    lua_createtable(L, 0, 3);
+                    lua_getiuservalue(L, ecs_ud, WORLD_KEY_UD);
+                    lua_pushlightuserdata(L, elem);
+                    lua_rawset(L, -3);
+                    snapshot_lua_component_set(L, ecs_ud, components, world, e, tid);
+                }
+            }
+            ok = ok && r.ok;
+        });
+
+        lua_pop(L, 2);  // # pop WORLD_COMPONENTS | WORLD_PROTO_ID
+    }
+
+    lua_pop(L, 1);  // # pop __NEKO_ECS_CORE
+
+    // 重置世界产生的销毁事件不应作用于刚恢复的组件 让各组件池下次全量检查
+    entity_destroyed_invalidate();
+
+    return ok;
+}
+
+// -------------------------------------------------------------------------
+
+bool snapshot_save(SnapshotWriter *out, Slice<u8> base) {
+    PROFILE_FUNC();
+
+    if (base.len) {
+        SnapshotWriter full = {};
+        bool ok = snapshot_save(&full, {}) && snapshot_diff(out, base, Slice<u8>(full.buf));
+        full.trash();
+        return ok;
+    }
+
+    lua_State *L = ENGINE_LUA();
+
+    u64 header_at = out->buf.len;
+    snapshot_write_header(*out, SnapshotFlags_None, ++g_snapshot_frame, 0);
+    u32 section_count = 0;
+
+    auto write_section = [&](String name, auto &&records) {
+        snapshot_write_section_name(*out, name);
+        u64 count_at = out->reserve_u32();
+        u32 count = 0;
+        records(&count);
+        out->patch_u32(count_at, count);
+        out->put<u32>(0);  // removed_count
+        section_count++;
+    };
+
+    write_section(SNAPSHOT_LUA_SECTION, [&](u32 *count) { snapshot_lua_save(L, *out, count); });
+
+    for (SnapshotSection *section : g_sections) {
+        if (!section->SnapshotEnabled()) continue;
+        write_section(section->SnapshotName(), [&](u32 *count) { section->SnapshotSaveAll(*out, count); });
+    }
+
+    snapshot_patch_section_count(*out, header_at, section_count);
+    return true;
+}
+
+bool snapshot_load(Slice<u8> snap, Slice<u8> base) {
+    PROFILE_FUNC();
+
+    if (base.len) {
+        SnapshotWriter full = {};
+        bool ok = snapshot_apply(&full, base, snap) && snapshot_load(Slice<u8>(full.buf), {});
+        full.trash();
+        return ok;
+    }
+
+    SnapshotHeader header = {};
+    Array<SnapshotSectionView> sections = {};
+    bool ok = snapshot_parse(snap, &header, &sections);
+
+    if (ok && (header.flags & SnapshotFlags_Delta)) {
+        LOG_WARN("snapshot: delta snapshot {} must be loaded with its base {}", header.frame, header.base_frame);
+        ok = false;
+    }
+
+    if (ok) {
+        ok = snapshot_lua_load(ENGINE_LUA(), snapshot_find_view(sections, SNAPSHOT_LUA_SECTION), sections);
+    }
+
+    sections.trash();
+    return ok;
+}
+
+bool snapshot_diff(SnapshotWriter *out, Slice<u8> base, Slice<u8> cur) {
+    PROFILE_FUNC();
+
+    SnapshotHeader base_header = {}, cur_header = {};
+    Array<SnapshotSectionView> base_sections = {}, cur_sections = {};
+
+    bool ok = snapshot_parse(base, &base_header, &base_sections) && snapshot_parse(cur, &cur_header, &cur_sections);
+    if (ok && ((base_header.flags | cur_header.flags) & SnapshotFlags_Delta)) {
+        LOG_WARN("snapshot: diff requires two full snapshots");
+        ok = false;
+    }
+
+    if (ok) {
+        u64 header_at = out->buf.len;
+        snapshot_write_header(*out, SnapshotFlags_Delta, cur_header.frame, base_header.frame);
+        u32 section_count = 0;
+
+        constexpr int VISITED = -2;
+
+        for (SnapshotSectionView &cv : cur_sections) {
+            SnapshotSectionView *bv = snapshot_find_view(base_sections, cv.name);
+
+            // base record 偏移 ent -> offset
+            CEntityMap *emap = entitymap_new(-1);
+            if (bv) snapshot_foreach_record(*bv, [&](u32 ent, const u8 *record, const u8 *, u32) { entitymap_set(emap, CEntity{ent}, (int)(record - bv->records)); });
+
+            snapshot_write_section_name(*out, cv.name);
+            u64 count_at = out->reserve_u32();
+            u32 changed = 0;
+
+            snapshot_foreach_record(cv, [&](u32 ent, const u8 *, const u8 *payload, u32 size) {
+                int off = entitymap_get(emap, CEntity{ent});
+                if (off >= 0) {
+                    SnapshotReader br(bv->records + off, bv->records_size - off);
+                    br.get<u32>();
+                    u32 bsize = br.get<u32>();
+                    const u8 *bpayload = br.skip(bsize);
+                    entitymap_set(emap, CEntity{ent}, VISITED);
+                    if (bsize == size && memcmp(bpayload, payload, size) == 0) return;  // 未改变
+                }
+                snapshot_write_record(*out, ent, payload, size);
+                changed++;
+            });
+            out->patch_u32(count_at, changed);
+
+            u64 removed_at = out->reserve_u32();
+            u32 removed = 0;
+            if (bv) {
+                snapshot_foreach_record(*bv, [&](u32 ent, const u8 *, const u8 *, u32) {
+                    if (entitymap_get(emap, CEntity{ent}) >= 0) {
+                        out->put<u32>(ent);
+                        removed++;
+                    }
+                });
+            }
+            out->patch_u32(removed_at, removed);
+
+            entitymap_free(emap);
+            section_count++;
+        }
+
+        // base 中存在而当前不存在的 section 全部记为删除
+        for (SnapshotSectionView &bv : base_sections) {
+            if (snapshot_find_view(cur_sections, bv.name)) continue;
+            snapshot_write_section_name(*out, bv.name);
+            out->put<u32>(0);
+            out->put<u32>(bv.record_count);
+            snapshot_foreach_record(bv, [&](u32 ent, const u8 *, const u8 *, u32) { out->put<u32>(ent); });
+            section_count++;
+        }
+
+        snapshot_patch_section_count(*out, header_at, section_count);
+    }
+
+    base_sections.trash();
+    cur_sections.trash();
+    return ok;
+}
+
+bool snapshot_apply(SnapshotWriter *out, Slice<u8> base, Slice<u8> delta) {
+    PROFILE_FUNC();
+
+    SnapshotHeader base_header = {}, delta_header = {};
+    Array<SnapshotSectionView> base_sections = {}, delta_sections = {};
+
+    bool ok = snapshot_parse(base, &base_header, &base_sections) && snapshot_parse(delta, &delta_header, &delta_sections);
+    if (ok && (!(delta_header.flags & SnapshotFlags_Delta) || (base_header.flags & SnapshotFlags_Delta))) {
+        LOG_WARN("snapshot: apply requires a full base and a delta");
+        ok = false;
+    }
+    if (ok && delta_header.base_frame != base_header.frame) {
+        LOG_WARN("snapshot: delta is based on {} but base is {}", delta_header.base_frame, base_header.frame);
+        ok = false;
+    }
+
+    if (ok) {
+        u64 header_at = out->buf.len;
+        snapshot_write_header(*out, SnapshotFlags_None, delta_header.frame, 0);
+        u32 section_count = 0;
+
+        constexpr int REMOVED = -2;
+        constexpr int CONSUMED = -3;
+
+        for (SnapshotSectionView &bv : base_sections) {
+            SnapshotSectionView *dv = snapshot_find_view(delta_sections, bv.name);
+
+            snapshot_write_section_name(*out, bv.name);
+            u64 count_at = out->reserve_u32();
+            u32 count = 0;
+
+            if (!dv) {
+                out->write(bv.records, bv.records_size);
+                count = bv.record_count;
+            } else {
+                // delta record 偏移 ent -> offset 删除的实体标记为 REMOVED
+                CEntityMap *emap = entitymap_new(-1);
+                snapshot_foreach_record(*dv, [&](u32 ent, const u8 *record, const u8 *, u32) { entitymap_set(emap, CEntity{ent}, (int)(record - dv->records)); });
+                for (u32 i = 0; i < dv->removed_count; i++) {
+                    u32 ent;
+                    memcpy(&ent, dv->removed + i * sizeof(u32), sizeof(u32));
+                    entitymap_set(emap, CEntity{ent}, REMOVED);
+                }
+
+                snapshot_foreach_record(bv, [&](u32 ent, const u8 *, const u8 *payload, u32 size) {
+                    int off = entitymap_get(emap, CEntity{ent});
+                    if (off == REMOVED) return;
+                    if (off >= 0) {
+                        SnapshotReader dr(dv->records + off, dv->records_size - off);
+                        dr.get<u32>();
+                        u32 dsize = dr.get<u32>();
+                        snapshot_write_record(*out, ent, dr.skip(dsize), dsize);
+                        entitymap_set(emap, CEntity{ent}, CONSUMED);
+                    } else {
+                        snapshot_write_record(*out, ent, payload, size);
+                    }
+                    count++;
+                });
+
+                // 新增的实体
+                snapshot_foreach_record(*dv, [&](u32 ent, const u8 *, const u8 *payload, u32 size) {
+                    if (entitymap_get(emap, CEntity{ent}) < 0) return;
+                    snapshot_write_record(*out, ent, payload, size);
+                    count++;
+                });
+
+                entitymap_free(emap);
+            }
+
+            out->patch_u32(count_at, count);
+            out->put<u32>(0);
+            section_count++;
+        }
+
+        // base 中不存在的 section
+        for (SnapshotSectionView &dv : delta_sections) {
+            if (snapshot_find_view(base_sections, dv.name)) continue;
+            snapshot_write_section_name(*out, dv.name);
+            out->put<u32>(dv.record_count);
+            out->write(dv.records, dv.records_size);
+            out->put<u32>(0);
+            section_count++;
+        }
+
+        snapshot_patch_section_count(*out, header_at, section_count);
+    }
+
+    base_sections.trash();
+    delta_sections.trash();
+    return ok;
+}
+
+// -------------------------------------------------------------------------
+
+static Slice<u8> snapshot_check_lstring(lua_State *L, int idx) {
+    size_t len = 0;
+    const char *str = luaL_checklstring(L, idx, &len);
+    return snapshot_slice((const u8 *)str, len);
+}
+
+static Slice<u8> snapshot_opt_lstring(lua_State *L, int idx) {
+    if (lua_isnoneornil(L, idx)) return {};
+    return snapshot_check_lstring(L, idx);
+}
+
+// neko.snapshot_save([base]) -> string
+static int wrap_snapshot_save(lua_State *L) {
+    Slice<u8> base = snapshot_opt_lstring(L, 1);
+    SnapshotWriter w = {};
+    if (snapshot_save(&w, base)) {
+        lua_pushlstring(L, (const char *)w.buf.data, w.buf.len);
+    } else {
+        lua_pushnil(L);
+    }
+    w.trash();
+    return 1;
+}
+
+// neko.snapshot_load(snap [, base]) -> boolean
+static int wrap_snapshot_load(lua_State *L) {
+    Slice<u8> snap = snapshot_check_lstring(L, 1);
+    Slice<u8> base = snapshot_opt_lstring(L, 2);
+    lua_pushboolean(L, snapshot_load(snap, base));
+    return 1;
+}
+
+// neko.snapshot_apply(base, delta) -> string
+static int wrap_snapshot_apply(lua_State *L) {
+    Slice<u8> base = snapshot_check_lstring(L, 1);
+    Slice<u8> delta = snapshot_check_lstring(L, 2);
+    SnapshotWriter w = {};
+    if (snapshot_apply(&w, base, delta)) {
+        lua_pushlstring(L, (const char *)w.buf.data, w.buf.len);
+    } else {
+        lua_pushnil(L);
+    }
+    w.trash();
+    return 1;
+}
+
+// neko.snapshot_info(snap) -> frame, base_frame, is_delta
+static int wrap_snapshot_info(lua_State *L) {
+    const SnapshotHeader *header = snapshot_header(snapshot_check_lstring(L, 1));
+    if (!header) return 0;
+    lua_pushinteger(L, (lua_Integer)header->frame);
+    lua_pushinteger(L, (lua_Integer)header->base_frame);
+    lua_pushboolean(L, header->flags & SnapshotFlags_Delta);
+    return 3;
+}
+
+void snapshot_init(lua_State *L) {
+    auto type = BUILD_TYPE(Snapshot)
+                        .CClosure({
+                                {"snapshot_save", wrap_snapshot_save},
+                                {"snapshot_load", wrap_snapshot_load},
+                                {"snapshot_apply", wrap_snapshot_apply},
+                                {"snapshot_info", wrap_snapshot_info},
+                        })
+                        .Build();
+}
+
+void snapshot_fini() { g_sections.trash(); }
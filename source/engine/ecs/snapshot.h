@@ -0,0 +1,151 @@
+#ifndef NEKO_ECS_SNAPSHOT_H
+#define NEKO_ECS_SNAPSHOT_H
+
+#include "engine/base.hpp"
+
+struct lua_State;
+struct CEntity;
+
+// 世界快照 (二进制)
+// 用于快速存档 编辑器撤销/停止回滚
+//
+// 布局:
+//     SnapshotHeader
+//     Section * section_count
+// Section:
+//     name_len u16 | name[name_len] | record_count u32 | Record * record_count | removed_count u32 | ent u32 * removed_count
+// Record:
+//     ent u32 | size u32 | bytes[size]
+//
+// 完整快照的 removed_count 总是 0
+// 增量快照只保存与基准快照不同(新增或修改)的 record 以及被删除的实体
+// 增量快照必须先通过 snapshot_apply 与基准合并为完整快照后才能加载
+
+constexpr u32 NEKO_SNAPSHOT_MAGIC = 0x53534b4e;  // "NKSS"
+constexpr u32 NEKO_SNAPSHOT_VERSION = 1;
+
+enum SnapshotFlags : u32 {
+    SnapshotFlags_None = 0,
+    SnapshotFlags_Delta = 1 << 0,
+};
+
+struct SnapshotHeader {
+    u32 magic;
+    u32 version;
+    u32 flags;
+    u32 section_count;
+    u64 frame;       // 快照序号 每次保存递增
+    u64 base_frame;  // 增量快照对应的基准快照序号
+};
+
+struct SnapshotWriter {
+    Array<u8> buf;
+
+    void trash() { buf.trash(); }
+
+    void write(const void* src, u64 size) {
+        if (buf.len + size > buf.capacity) {
+            u64 cap = buf.capacity ? buf.capacity : 256;
+            while (cap < buf.len + size) cap *= 2;
+            buf.reserve(cap);
+        }
+        memcpy(buf.data + buf.len, src, size);
+        buf.len += size;
+    }
+
+    template <typename T>
+    void put(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write(&v, sizeof(T));
+    }
+
+    void put_string(String str) {
+        put<u32>((u32)str.len);
+        write(str.data, str.len);
+    }
+
+    // 预留一个 u32 稍后通过 patch_u32 回填
+    u64 reserve_u32() {
+        u64 at = buf.len;
+        put<u32>(0);
+        return at;
+    }
+
+    void patch_u32(u64 at, u32 v) { memcpy(buf.data + at, &v, sizeof(u32)); }
+};
+
+struct SnapshotReader {
+    const u8* data;
+    u64 len;
+    u64 pos;
+    bool ok;
+
+    SnapshotReader(const u8* data, u64 len) : data(data), len(len), pos(0), ok(true) {}
+
+    const u8* skip(u64 size) {
+        if (!ok || pos + size > len) {
+            ok = false;
+            return nullptr;
+        }
+        const u8* p = data + pos;
+        pos += size;
+        return p;
+    }
+
+    bool read(void* dst, u64 size) {
+        const u8* p = skip(size);
+        if (p) memcpy(dst, p, size);
+        return p != nullptr;
+    }
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T v{};
+        read(&v, sizeof(T));
+        return v;
+    }
+
+    String get_string() {
+        u32 n = get<u32>();
+        const u8* p = skip(n);
+        return p ? String((const char*)p, n) : String();
+    }
+
+    bool eof() const { return pos >= len; }
+};
+
+// 每个可快照的组件池实现此接口
+// ComponentTypeBase 会在 ComponentReg 时自动注册
+class SnapshotSection {
+public:
+    virtual const_str SnapshotName() = 0;
+    virtual bool SnapshotEnabled() { return false; }  // false 时只用于重建 Lua 组件表的 __ud 链接
+    virtual void SnapshotSaveAll(SnapshotWriter& w, u32* count) = 0;
+    virtual void SnapshotLoadBegin() = 0;
+    virtual void SnapshotLoadRecord(CEntity ent, SnapshotReader& r) = 0;
+    virtual void SnapshotLoadEnd() = 0;
+    virtual void* SnapshotGetElem(CEntity ent) = 0;
+};
+
+void snapshot_register(SnapshotSection* section);
+void snapshot_unregister(SnapshotSection* section);
+
+// 保存当前世界的完整快照 base 不为空时写出相对 base 的增量快照
+bool snapshot_save(SnapshotWriter* out, Slice<u8> base = {});
+
+// 加载完整快照 base 不为空时将 snap 作为 base 的增量快照加载
+bool snapshot_load(Slice<u8> snap, Slice<u8> base = {});
+
+// 计算 cur 相对 base 的增量快照
+bool snapshot_diff(SnapshotWriter* out, Slice<u8> base, Slice<u8> cur);
+
+// 将增量快照合并到基准快照上得到完整快照
+bool snapshot_apply(SnapshotWriter* out, Slice<u8> base, Slice<u8> delta);
+
+const SnapshotHeader* snapshot_header(Slice<u8> snap);
+
+void snapshot_init(lua_State* L);
+void snapshot_fini();
+
+#endif
@@ -16,6 +16,7 @@
 #include "base/common/profiler.hpp"
 #include "engine/bootstrap.h"
 #include "engine/graphics.h"
+#include "engine/renderer/shader.h"
 #include "engine/window.h"
 #include "engine/component.h"
 #include "engine/scripting/lua_util.h"
@@ -25,6 +26,7 @@
 #include "engine/components/edit.h"
 #include "engine/components/sprite.h"
 #include "engine/components/tiledmap.hpp"
+#include "engine/components/spatial.h"
 
 using namespace Neko::ImGuiWrap;
 
@@ -1436,7 +1438,7 @@ void inspect_shader(const char* label, GLuint program) {
                     GLenum type;
                     glGetActiveUniform(program, i, max_name_length, nullptr, &ignored, &type, name.data());
 
-                    const auto location = glGetUniformLocation(program, name.data());
+                    const auto location = neko_shader_uniform(program, name.data());
                     ImGui::Indent();
                     ImGui::PushID(i);
                     ImGui::PushItemWidth(-1.0f);
@@ -2029,20 +2031,15 @@ std::vector<CEntity> Editor::GetEntitiesUnderPos(vec2 pos) {
 
     auto& trans = the<Transform>();
 
-    int num_bboxes = edit_bboxes_get_num();
-    for (int i = 0; i < num_bboxes; ++i) {
-        CEntity ent = edit_bboxes_get_nth_ent(i);
-        BBox bbox = edit_bboxes_get_nth_bbox(i);
+    // 空间索引给出世界包围盒包含 pos 的候选 再用编辑包围盒做精确判断
+    Array<CEntity> candidates = {};
+    the<Spatial>().spatial_query_point(pos, &candidates);
+    for (CEntity ent : candidates) {
+        if (!edit_bboxes_has(ent)) continue;
         mat3 wmat = trans.transform_get_world_matrix(ent);
-        bool on = false;
-
-        if (bbox_contains(bbox, mat3_transform(mat3_inverse(wmat), pos))) {
-            ents.push_back(ent);
-            on = true;
-        }
-
-        // LOG_TRACE("GetEntitiesUnderPos id:{} on:{}", ent.id, on);
+        if (bbox_contains(edit_bboxes_get(ent), mat3_transform(mat3_inverse(wmat), pos))) ents.push_back(ent);
     }
+    candidates.trash();
 
     // 按与鼠标的距离排序
     auto distcomp = [&pos, &trans](const CEntity& e1, const CEntity& e2) {
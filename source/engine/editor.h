@@ -146,6 +146,7 @@ bool edit_get_editable(CEntity ent);
 void edit_set_grid_size(vec2 size);
 vec2 edit_get_grid_size();
 bool edit_bboxes_has(CEntity ent);
+BBox edit_bboxes_get(CEntity ent);
 int edit_bboxes_get_num();
 CEntity edit_bboxes_get_nth_ent(int n);
 void edit_bboxes_set_selected(CEntity ent, bool selected);
@@ -171,15 +171,43 @@ void gfx_init(gfx_t* render) {
 #endif
 }
 
+static GfxFrameStats g_frame_stats;
+static GfxFrameStats g_last_frame_stats;
+
+GfxFrameStats& gfx_frame_stats() { return g_frame_stats; }
+
+const GfxFrameStats& gfx_last_frame_stats() { return g_last_frame_stats; }
+
+void gfx_frame_end() {
+    g_last_frame_stats = g_frame_stats;
+    g_frame_stats = {};
+}
+
+static GfxBackend g_backend = GfxBackend_OpenGL;
+
+void gfx_set_backend(GfxBackend backend) { g_backend = backend; }
+
+GfxBackend gfx_backend() { return g_backend; }
+
 void streambuffer_init(StreamBuffer* buffer, size_t size) {
     glGenBuffers(1, &buffer->vbo);
     glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
 
-    GLbitfield storageflags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
-    GLbitfield mapflags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
-    glBufferStorage(GL_ARRAY_BUFFER, size * BUFFER_FRAMES, NULL, storageflags);
+    // glBufferStorage 需要 4.4 或 ARB_buffer_storage 加载器只在支持时填入函数指针
+    buffer->persistent = glBufferStorage != NULL;
+
+    if (buffer->persistent) {
+        GLbitfield storageflags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLbitfield mapflags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size * BUFFER_FRAMES, NULL, storageflags);
+
+        buffer->data = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size * BUFFER_FRAMES, mapflags);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, size * BUFFER_FRAMES, NULL, GL_DYNAMIC_DRAW);
+
+        buffer->data = (char*)mem_alloc(size);
+    }
 
-    buffer->data = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size * BUFFER_FRAMES, mapflags);
     buffer->size = size;
     buffer->offset = 0;
     buffer->index = 0;
@@ -187,7 +215,37 @@ void streambuffer_init(StreamBuffer* buffer, size_t size) {
     for (int i = 0; i < BUFFER_FRAMES; i++) buffer->syncs[i] = 0;
 }
 
-void* streambuffer_map(StreamBuffer* buffer) {
+void streambuffer_fini(StreamBuffer* buffer) {
+    for (int i = 0; i < BUFFER_FRAMES; i++) {
+        if (buffer->syncs[i]) glDeleteSync(buffer->syncs[i]);
+        buffer->syncs[i] = 0;
+    }
+
+    if (buffer->persistent) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else {
+        mem_free(buffer->data);
+    }
+
+    glDeleteBuffers(1, &buffer->vbo);
+    buffer->vbo = 0;
+    buffer->data = NULL;
+}
+
+void* streambuffer_map(StreamBuffer* buffer, size_t size) {
+    neko_assert(size <= buffer->size);
+
+    // 当前段放不下 换到下一段
+    if (buffer->offset + size > buffer->size) {
+        streambuffer_nextframe(buffer);
+    }
+
+    if (!buffer->persistent) {
+        return buffer->data + buffer->offset;
+    }
+
     GLsync sync = buffer->syncs[buffer->index];
     GLbitfield flags = 0;
     GLuint64 duration = 0;
@@ -195,10 +253,11 @@ void* streambuffer_map(StreamBuffer* buffer) {
         GLenum status = glClientWaitSync(sync, flags, duration);
         if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED) break;
 
+        if (flags == 0) g_frame_stats.stream_waits++;
         flags = GL_SYNC_FLUSH_COMMANDS_BIT;
         duration = 1000000000;  // 1 second in nanoseconds
     }
-    glDeleteSync(sync);
+    if (sync) glDeleteSync(sync);
     buffer->syncs[buffer->index] = 0;
 
     return buffer->data + (buffer->index * buffer->size) + buffer->offset;
@@ -206,14 +265,28 @@ void* streambuffer_map(StreamBuffer* buffer) {
 
 size_t streambuffer_unmap(StreamBuffer* buffer, size_t used) {
     size_t offset = (buffer->index * buffer->size) + buffer->offset;
+
+    if (!buffer->persistent && used > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, used, buffer->data + buffer->offset);
+        g_frame_stats.uploads++;
+    }
+
+    g_frame_stats.upload_bytes += used;
+
     buffer->offset += used;
     return offset;
 }
 
 void streambuffer_nextframe(StreamBuffer* buffer) {
-    GLsync sync = buffer->syncs[buffer->index];
-    if (sync) glDeleteSync(sync);
-    buffer->syncs[buffer->index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (buffer->offset == 0) return;
+
+    // glBufferSubData 由驱动同步 只有持久映射需要栅栏
+    if (buffer->persistent) {
+        GLsync sync = buffer->syncs[buffer->index];
+        if (sync) glDeleteSync(sync);
+        buffer->syncs[buffer->index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
 
     buffer->index = (buffer->index + 1) % BUFFER_FRAMES;
     buffer->offset = 0;
@@ -309,12 +309,42 @@ typedef struct {
 typedef struct {
     GLuint vbo;
     GLsync syncs[BUFFER_FRAMES];
-    char* data;
-    size_t size;
-    size_t offset;
-    int index;
+    char* data;      // 持久映射的地址 不支持时为一段大小的内存暂存区
+    size_t size;     // 每段的大小
+    size_t offset;   // 当前段已写入的长度
+    int index;       // 当前段
+    bool persistent;  // glBufferStorage 持久映射 否则在 unmap 时 glBufferSubData 上传
 } StreamBuffer;
 
+// 流式顶点缓冲 共 BUFFER_FRAMES 段轮流写入 段写满或帧结束时插入栅栏换到下一段
+// 再次写入某一段之前等待 GPU 读完 size 与每次写入的长度应为顶点大小的整数倍
+void streambuffer_init(StreamBuffer* buffer, size_t size);
+void streambuffer_fini(StreamBuffer* buffer);
+void* streambuffer_map(StreamBuffer* buffer, size_t size);     // 返回至少 size 字节的可写区域
+size_t streambuffer_unmap(StreamBuffer* buffer, size_t used);  // 提交写入的 used 字节 返回其在缓冲区中的字节偏移
+void streambuffer_nextframe(StreamBuffer* buffer);
+
+// 每帧的绘制统计 渲染器提交时累加 gfx_frame_end 时保存为上一帧并清零
+struct GfxFrameStats {
+    u32 draws;
+    u32 uploads;       // 顶点数据上传 (glBufferSubData) 次数 持久映射不计
+    u64 upload_bytes;  // 写入流缓冲的字节数
+    u32 stream_waits;  // 等待栅栏的次数
+};
+
+GfxFrameStats& gfx_frame_stats();
+const GfxFrameStats& gfx_last_frame_stats();
+void gfx_frame_end();
+
+// 图形后端 Null 时不创建 GL 上下文 用 renderer/gfx_null.h 的空实现代替 GL
+enum GfxBackend {
+    GfxBackend_OpenGL,
+    GfxBackend_Null,
+};
+
+void gfx_set_backend(GfxBackend backend);  // 在创建窗口之前设置
+GfxBackend gfx_backend();
+
 // typedef struct {
 //     int quad_count;
 //     u64 texture;
@@ -743,8 +743,11 @@ void ImGuiRender::imgui_init() {
         style.Colors[ImGuiCol_WindowBg].w = 1.0f;
     }
 
+    // 空后端没有 GL 上下文 不初始化 OpenGL3 后端 界面照常构建但不提交
+    bool gl = gfx_backend() != GfxBackend_Null;
+
     ImGui_ImplGlfw_InitForOpenGL(the<Window>().glfwWindow(), true);
-    ImGui_ImplOpenGL3_Init();
+    if (gl) ImGui_ImplOpenGL3_Init();
 
     if (the<CL>().state.default_font.len > 0) {
         auto& io = ImGui::GetIO();
@@ -757,6 +760,8 @@ void ImGuiRender::imgui_init() {
         io.Fonts->AddFontFromMemoryTTF(ttf_file.data, ttf_file.len, 16.0f, &config, io.Fonts->GetGlyphRangesChineseSimplifiedCommon());
     }
 
+    if (!gl) io.Fonts->Build();  // 否则由 ImGui_ImplOpenGL3_NewFrame 构建
+
     ImGuiPlatformIO& platform_io = ImGui::GetPlatformIO();
 
     the<CL>().devui_vp = ImGui::GetMainViewport()->ID;
@@ -797,13 +802,13 @@ void ImGuiRender::imgui_init() {
 
 void ImGuiRender::imgui_fini() {
 
-    ImGui_ImplOpenGL3_Shutdown();
+    if (gfx_backend() != GfxBackend_Null) ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 }
 
 int ImGuiRender::imgui_draw_pre() {
-    ImGui_ImplOpenGL3_NewFrame();
+    if (gfx_backend() != GfxBackend_Null) ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
     return 0;
@@ -812,7 +817,7 @@ int ImGuiRender::imgui_draw_pre() {
 void ImGuiRender::imgui_draw_post() {
     ImGui::Render();
 
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    if (gfx_backend() != GfxBackend_Null) ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
     ImGuiIO& io = ImGui::GetIO();
 
@@ -113,6 +113,7 @@ local function stop_save()
     -- ns.system.save_all(s)
     -- stop_savepoint = ffi.string(ng.store_write_str(s))
     -- ng.store_close(s)
+    stop_savepoint = neko.snapshot_save()
 
     if ns.timing.get_paused() then
         ns.edit.stopped = true
@@ -130,6 +131,7 @@ function ns.edit.stop()
     -- local s = ng.store_open_str(stop_savepoint)
     -- ns.system.load_all(s)
     -- ng.store_close(s)
+    neko.snapshot_load(stop_savepoint)
 
     ns.timing.set_paused(true)
     ns.edit.stopped = true
@@ -0,0 +1,1377 @@
+#include "engine/renderer/gfx_null.h"
+
+#include "base/common/array.hpp"
+#include "base/common/hashmap.hpp"
+#include "base/common/mem.hpp"
+#include "base/common/string.hpp"
+
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+
+// graphics.h 在 GLFW 之后取消了 APIENTRY 的定义
+#if defined(_WIN32) && !defined(_WIN64)
+#define GFX_NULL_API __stdcall
+#else
+#define GFX_NULL_API
+#endif
+
+struct NullBuffer {
+    bool alive;
+    u64 size;
+    u8* memory;  // 第一次映射时分配
+};
+
+struct NullTexture {
+    bool alive;
+    bool mipmaps;
+    i32 width, height;
+    u64 bytes;  // 第 0 层
+};
+
+struct NullVertexArray {
+    bool alive;
+    GLuint element_buffer;
+};
+
+struct NullFramebuffer {
+    bool alive;
+};
+
+struct NullShader {
+    bool alive;
+    GLenum type;
+    char* source;
+};
+
+struct NullUniform {
+    char name[64];
+    GLint size;
+    GLenum type;
+};
+
+struct NullProgram {
+    bool alive;
+    bool linked;
+    char* source;  // 链接时所有附加着色器的源码
+    GLuint shaders[4];
+    u32 shader_count;
+    HashMap<GLint> uniforms;  // 名字的 fnv1a
+    HashMap<GLint> attribs;
+    HashMap<GLint> blocks;
+    GLint next_uniform, next_attrib, next_block;
+    Array<NullUniform> active;  // glGetActiveUniform 列出的 uniform
+};
+
+static struct {
+    bool installed;
+    void* saved[GfxNull_Count];
+    int saved_dsa;
+    gladGLversionStruct saved_version;
+
+    GfxRecorder rec;
+    GfxNullObjects live;
+
+    // 句柄即下标 0 号不用 删除后不重用
+    Array<NullBuffer> buffers;
+    Array<NullTexture> textures;
+    Array<NullVertexArray> vaos;
+    Array<NullFramebuffer> framebuffers;
+    Array<NullShader> shaders;
+    Array<NullProgram> programs;
+    u64 next_sync;
+
+    GLuint program, vao, read_fbo, draw_fbo;
+    u32 active_unit;
+    GLuint units[32];
+    GLuint array_buffer, element_buffer, uniform_buffer, other_buffer;
+    Array<GLenum> enabled;
+    GLenum blend[4];
+    GLenum blend_equation[2];
+    GLint viewport[4];
+    GLint scissor[4];
+    f32 clear_color[4];
+} g_null;
+
+static const char* g_null_names[GfxNull_Count] = {
+#define GFX_NULL_NAME(name) #name,
+        GFX_NULL_FUNCS(GFX_NULL_NAME)
+#undef GFX_NULL_NAME
+};
+
+#define NULL_CALL(name) (g_null.rec.calls++, g_null.rec.fn_calls[GfxNull_##name]++)
+
+template <typename T>
+static GLuint null_create(Array<T>& objects) {
+    if (objects.len == 0) objects.push(T{});
+    T obj = {};
+    obj.alive = true;
+    objects.push(obj);
+    g_null.rec.created++;
+    return (GLuint)(objects.len - 1);
+}
+
+template <typename T>
+static T* null_get(Array<T>& objects, GLuint handle) {
+    return handle < objects.len && objects[handle].alive ? &objects[handle] : nullptr;
+}
+
+static void null_bind(GLuint* slot, GLuint value, u32* counter) {
+    if (*slot == value) {
+        g_null.rec.redundant++;
+        return;
+    }
+    *slot = value;
+    (*counter)++;
+    g_null.rec.state_changes++;
+}
+
+template <typename T>
+static void null_set(T* state, const T* value, u32 n) {
+    if (memcmp(state, value, sizeof(T) * n) == 0) {
+        g_null.rec.redundant++;
+        return;
+    }
+    memcpy(state, value, sizeof(T) * n);
+    g_null.rec.state_changes++;
+}
+
+static u32 null_texel_bytes(GLenum format, GLenum type) {
+    u32 channels = 4;
+    switch (format) {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT:
+            channels = 1;
+            break;
+        case GL_RG:
+            channels = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+            channels = 3;
+            break;
+    }
+    switch (type) {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+            return channels * 4;
+        case GL_HALF_FLOAT:
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return channels * 2;
+    }
+    return channels;
+}
+
+static u32 null_internal_bytes(GLenum internalformat) {
+    switch (internalformat) {
+        case GL_RED:
+        case GL_R8:
+            return 1;
+        case GL_RG:
+        case GL_RG8:
+        case GL_R16F:
+            return 2;
+        case GL_RGB:
+        case GL_RGB8:
+            return 3;
+        case GL_RGB16F:
+            return 6;
+        case GL_RGBA16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGB32F:
+            return 12;
+        case GL_RGBA32F:
+            return 16;
+    }
+    return 4;
+}
+
+static u64 null_texture_memory(const NullTexture* t) { return t->mipmaps ? t->bytes + t->bytes / 3 : t->bytes; }
+
+static void null_texture_storage(NullTexture* t, i32 width, i32 height, u32 texel, bool mipmaps) {
+    g_null.live.texture_bytes -= null_texture_memory(t);
+    t->width = width;
+    t->height = height;
+    t->bytes = (u64)width * height * texel;
+    t->mipmaps = mipmaps;
+    g_null.live.texture_bytes += null_texture_memory(t);
+}
+
+static void null_buffer_storage(NullBuffer* b, u64 size) {
+    g_null.live.buffer_bytes = g_null.live.buffer_bytes - b->size + size;
+    if (b->memory && size != b->size) b->memory = (u8*)mem_realloc(b->memory, size);
+    b->size = size;
+}
+
+static void null_buffer_write(NullBuffer* b, u64 offset, u64 size, const void* data) {
+    g_null.rec.buffer_uploads++;
+    g_null.rec.buffer_upload_bytes += size;
+    if (b && b->memory && data && offset + size <= b->size) memcpy(b->memory + offset, data, size);
+}
+
+static GLuint* null_buffer_binding(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            return &g_null.array_buffer;
+        case GL_ELEMENT_ARRAY_BUFFER: {
+            NullVertexArray* vao = null_get(g_null.vaos, g_null.vao);  // 索引缓冲属于顶点数组
+            return vao ? &vao->element_buffer : &g_null.element_buffer;
+        }
+        case GL_UNIFORM_BUFFER:
+            return &g_null.uniform_buffer;
+    }
+    return &g_null.other_buffer;
+}
+
+static NullBuffer* null_bound_buffer(GLenum target) { return null_get(g_null.buffers, *null_buffer_binding(target)); }
+
+static NullTexture* null_bound_texture() { return null_get(g_null.textures, g_null.units[g_null.active_unit]); }
+
+static void* null_map(NullBuffer* b, u64 offset) {
+    g_null.rec.maps++;
+    if (!b || b->size == 0) return nullptr;
+    if (!b->memory) {
+        b->memory = (u8*)mem_alloc(b->size);
+        memset(b->memory, 0, b->size);
+    }
+    return b->memory + offset;
+}
+
+static void null_draw(GLsizei count) {
+    g_null.rec.draws++;
+    g_null.rec.vertices += count;
+}
+
+// 名字在链接的源码中出现才有位置 数组与结构成员按开头的标识符查找
+static GLint null_location(NullProgram* p, HashMap<GLint>* map, GLint* next, const char* name) {
+    if (!p || !p->linked || !p->source) return -1;
+
+    char base[128];
+    size_t n = strcspn(name, "[.");
+    if (n == 0 || n >= sizeof(base)) return -1;
+    memcpy(base, name, n);
+    base[n] = '\0';
+    if (!strstr(p->source, base)) return -1;
+
+    // "a" 与 "a[0]" 是同一个位置
+    size_t len = strlen(name);
+    u64 key = len > 3 && strcmp(name + len - 3, "[0]") == 0 ? fnv1a(name, len - 3) : fnv1a(name, len);
+
+    GLint* loc = nullptr;
+    if (!map->find_or_insert(key, &loc)) *loc = (*next)++;
+    return *loc;
+}
+
+static void null_program_reset(NullProgram* p) {
+    if (p->source) mem_free(p->source);
+    p->source = nullptr;
+    p->uniforms.trash();
+    p->attribs.trash();
+    p->blocks.trash();
+    p->uniforms = {};
+    p->attribs = {};
+    p->blocks = {};
+    p->next_uniform = p->next_attrib = p->next_block = 0;
+    p->active.trash();
+    p->active = {};
+}
+
+// 活动 uniform
+// 按源码中的声明列出 与 GL 的规则相同 数组只列出 "a[0]" 并给出长度 结构按成员展开 uniform 块中的成员不列出
+// 不做预处理 数组长度可以是数字或 #define 的常量 不支持嵌套结构
+
+struct NullLexer {
+    const char* p;
+    char tok[64];
+};
+
+static bool null_lex(NullLexer* lx) {
+    const char* p = lx->p;
+    for (;;) {
+        while (*p && isspace((u8)*p)) p++;
+        if (p[0] == '/' && p[1] == '/') {
+            while (*p && *p != '\n') p++;
+        } else if (p[0] == '/' && p[1] == '*') {
+            const char* end = strstr(p + 2, "*/");
+            p = end ? end + 2 : p + strlen(p);
+        } else if (*p == '#') {
+            while (*p && *p != '\n') p++;
+        } else {
+            break;
+        }
+    }
+    if (!*p) {
+        lx->p = p;
+        lx->tok[0] = '\0';
+        return false;
+    }
+
+    u32 n = 0;
+    if (isalnum((u8)*p) || *p == '_') {
+        while ((isalnum((u8)*p) || *p == '_') && n + 1 < sizeof(lx->tok)) lx->tok[n++] = *p++;
+        while (isalnum((u8)*p) || *p == '_') p++;
+    } else {
+        lx->tok[n++] = *p++;
+    }
+    lx->tok[n] = '\0';
+    lx->p = p;
+    return true;
+}
+
+static GLint null_array_size(const char* source, const char* tok) {
+    if (isdigit((u8)tok[0])) return NEKO_MAX(atoi(tok), 1);
+    size_t len = strlen(tok);
+    for (const char* d = strstr(source, "#define"); d; d = strstr(d + 7, "#define")) {
+        const char* q = d + 7;
+        while (*q == ' ' || *q == '\t') q++;
+        if (strncmp(q, tok, len) == 0 && (q[len] == ' ' || q[len] == '\t')) return NEKO_MAX(atoi(q + len), 1);
+    }
+    return 1;
+}
+
+static GLenum null_uniform_type(const char* type) {
+    static const struct {
+        const char* name;
+        GLenum type;
+    } types[] = {
+            {"float", GL_FLOAT},          {"vec2", GL_FLOAT_VEC2},           {"vec3", GL_FLOAT_VEC3},    {"vec4", GL_FLOAT_VEC4},
+            {"int", GL_INT},              {"ivec2", GL_INT_VEC2},            {"uint", GL_UNSIGNED_INT},  {"bool", GL_BOOL},
+            {"mat3", GL_FLOAT_MAT3},      {"mat4", GL_FLOAT_MAT4},           {"sampler2D", GL_SAMPLER_2D},
+    };
+    for (auto& t : types)
+        if (strcmp(t.name, type) == 0) return t.type;
+    return GL_FLOAT;
+}
+
+// [N] 或者什么都没有 结束时 lx->tok 为之后的记号
+static GLint null_lex_array(NullLexer* lx, const char* source, bool* is_array) {
+    *is_array = false;
+    null_lex(lx);
+    if (strcmp(lx->tok, "[") != 0) return 1;
+    *is_array = true;
+    null_lex(lx);
+    GLint size = null_array_size(source, lx->tok);
+    while (strcmp(lx->tok, "]") != 0 && null_lex(lx));
+    null_lex(lx);
+    return size;
+}
+
+static void null_active_push(NullProgram* p, GLenum type, GLint size, const char* fmt, ...) {
+    NullUniform u = {};
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(u.name, sizeof(u.name), fmt, args);
+    va_end(args);
+    for (NullUniform& a : p->active)
+        if (strcmp(a.name, u.name) == 0) return;  // 多个阶段声明同一个 uniform
+    u.size = size;
+    u.type = type;
+    p->active.push(u);
+}
+
+static void null_program_parse_uniforms(NullProgram* p) {
+    struct Member {
+        NullUniform u;
+        bool is_array;
+    };
+    struct Struct {
+        char name[64];
+        u64 first, count;
+    };
+    Array<Member> members = {};
+    Array<Struct> structs = {};
+
+    NullLexer lx = {p->source};
+    while (null_lex(&lx)) {
+        if (strcmp(lx.tok, "struct") == 0) {
+            Struct st = {};
+            null_lex(&lx);
+            snprintf(st.name, sizeof(st.name), "%s", lx.tok);
+            st.first = members.len;
+            null_lex(&lx);  // {
+            while (null_lex(&lx) && strcmp(lx.tok, "}") != 0) {
+                GLenum type = null_uniform_type(lx.tok);
+                do {
+                    Member m = {};
+                    null_lex(&lx);
+                    snprintf(m.u.name, sizeof(m.u.name), "%s", lx.tok);
+                    m.u.type = type;
+                    m.u.size = null_lex_array(&lx, p->source, &m.is_array);
+                    members.push(m);
+                } while (strcmp(lx.tok, ",") == 0);
+            }
+            st.count = members.len - st.first;
+            structs.push(st);
+            continue;
+        }
+
+        if (strcmp(lx.tok, "uniform") != 0) continue;
+
+        null_lex(&lx);
+        while (!strcmp(lx.tok, "lowp") || !strcmp(lx.tok, "mediump") || !strcmp(lx.tok, "highp")) null_lex(&lx);
+        char type[64];
+        snprintf(type, sizeof(type), "%s", lx.tok);
+
+        NullLexer peek = lx;
+        null_lex(&peek);
+        if (strcmp(peek.tok, "{") == 0) {  // uniform 块
+            lx = peek;
+            for (int depth = 1; depth > 0 && null_lex(&lx);) depth += !strcmp(lx.tok, "{") - !strcmp(lx.tok, "}");
+            continue;
+        }
+
+        Struct* st = nullptr;
+        for (Struct& s : structs)
+            if (strcmp(s.name, type) == 0) st = &s;
+
+        do {
+            char name[64];
+            null_lex(&lx);
+            snprintf(name, sizeof(name), "%s", lx.tok);
+            bool is_array;
+            GLint size = null_lex_array(&lx, p->source, &is_array);
+
+            if (!st) {
+                null_active_push(p, null_uniform_type(type), size, is_array ? "%s[0]" : "%s", name);
+                continue;
+            }
+            for (GLint i = 0; i < size; i++) {
+                for (u64 j = st->first; j < st->first + st->count; j++) {
+                    Member& m = members[j];
+                    if (is_array) {
+                        null_active_push(p, m.u.type, m.u.size, m.is_array ? "%s[%d].%s[0]" : "%s[%d].%s", name, i, m.u.name);
+                    } else {
+                        null_active_push(p, m.u.type, m.u.size, m.is_array ? "%s.%s[0]" : "%s.%s", name, m.u.name);
+                    }
+                }
+            }
+        } while (strcmp(lx.tok, ",") == 0);
+    }
+
+    members.trash();
+    structs.trash();
+}
+
+// 状态
+
+static void GFX_NULL_API null_glActiveTexture(GLenum texture) {
+    NULL_CALL(glActiveTexture);
+    u32 unit = texture - GL_TEXTURE0;
+    g_null.active_unit = unit < NEKO_ARR_SIZE(g_null.units) ? unit : 0;
+}
+
+static void GFX_NULL_API null_glEnable(GLenum cap) {
+    NULL_CALL(glEnable);
+    for (u64 i = 0; i < g_null.enabled.len; i++) {
+        if (g_null.enabled[i] == cap) {
+            g_null.rec.redundant++;
+            return;
+        }
+    }
+    g_null.enabled.push(cap);
+    g_null.rec.state_changes++;
+}
+
+static void GFX_NULL_API null_glDisable(GLenum cap) {
+    NULL_CALL(glDisable);
+    for (u64 i = 0; i < g_null.enabled.len; i++) {
+        if (g_null.enabled[i] == cap) {
+            g_null.enabled[i] = g_null.enabled[g_null.enabled.len - 1];
+            g_null.enabled.len--;
+            g_null.rec.state_changes++;
+            return;
+        }
+    }
+    g_null.rec.redundant++;
+}
+
+static GLboolean GFX_NULL_API null_glIsEnabled(GLenum cap) {
+    NULL_CALL(glIsEnabled);
+    for (u64 i = 0; i < g_null.enabled.len; i++)
+        if (g_null.enabled[i] == cap) return GL_TRUE;
+    return GL_FALSE;
+}
+
+static void GFX_NULL_API null_glBlendFunc(GLenum sfactor, GLenum dfactor) {
+    NULL_CALL(glBlendFunc);
+    GLenum blend[4] = {sfactor, dfactor, sfactor, dfactor};
+    null_set(g_null.blend, blend, 4);
+}
+
+static void GFX_NULL_API null_glBlendFuncSeparate(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha) {
+    NULL_CALL(glBlendFuncSeparate);
+    GLenum blend[4] = {sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha};
+    null_set(g_null.blend, blend, 4);
+}
+
+static void GFX_NULL_API null_glBlendEquationSeparate(GLenum modeRGB, GLenum modeAlpha) {
+    NULL_CALL(glBlendEquationSeparate);
+    GLenum eq[2] = {modeRGB, modeAlpha};
+    null_set(g_null.blend_equation, eq, 2);
+}
+
+static void GFX_NULL_API null_glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    NULL_CALL(glViewport);
+    GLint v[4] = {x, y, width, height};
+    null_set(g_null.viewport, v, 4);
+}
+
+static void GFX_NULL_API null_glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+    NULL_CALL(glScissor);
+    GLint v[4] = {x, y, width, height};
+    null_set(g_null.scissor, v, 4);
+}
+
+static void GFX_NULL_API null_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+    NULL_CALL(glClearColor);
+    f32 c[4] = {red, green, blue, alpha};
+    null_set(g_null.clear_color, c, 4);
+}
+
+static void GFX_NULL_API null_glClear(GLbitfield mask) {
+    NULL_CALL(glClear);
+    g_null.rec.clears++;
+}
+
+static void GFX_NULL_API null_glPixelStorei(GLenum pname, GLint param) { NULL_CALL(glPixelStorei); }
+
+static void GFX_NULL_API null_glFinish(void) { NULL_CALL(glFinish); }
+
+static GLenum GFX_NULL_API null_glGetError(void) {
+    NULL_CALL(glGetError);
+    return GL_NO_ERROR;
+}
+
+static void GFX_NULL_API null_glDebugMessageCallback(GLDEBUGPROC callback, const void* userParam) { NULL_CALL(glDebugMessageCallback); }
+
+static void GFX_NULL_API null_glDebugMessageControl(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint* ids, GLboolean enabled) {
+    NULL_CALL(glDebugMessageControl);
+}
+
+// 查询
+
+static void GFX_NULL_API null_glGetIntegerv(GLenum pname, GLint* data) {
+    NULL_CALL(glGetIntegerv);
+    switch (pname) {
+        case GL_MAJOR_VERSION:
+            *data = 4;
+            break;
+        case GL_MINOR_VERSION:
+            *data = 6;
+            break;
+        case GL_MAX_TEXTURE_SIZE:
+            *data = 16384;
+            break;
+        case GL_MAX_TEXTURE_IMAGE_UNITS:
+            *data = (GLint)NEKO_ARR_SIZE(g_null.units);
+            break;
+        case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:
+            *data = 80;
+            break;
+        case GL_MAX_VERTEX_ATTRIBS:
+            *data = 16;
+            break;
+        case GL_MAX_UNIFORM_BUFFER_BINDINGS:
+            *data = 36;
+            break;
+        case GL_MAX_UNIFORM_BLOCK_SIZE:
+            *data = 65536;
+            break;
+        case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+            *data = 256;
+            break;
+        case GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS:
+            *data = 1024;
+            break;
+        case GL_UNPACK_ALIGNMENT:
+        case GL_PACK_ALIGNMENT:
+            *data = 4;
+            break;
+        case GL_CURRENT_PROGRAM:
+            *data = (GLint)g_null.program;
+            break;
+        case GL_VERTEX_ARRAY_BINDING:
+            *data = (GLint)g_null.vao;
+            break;
+        case GL_ARRAY_BUFFER_BINDING:
+            *data = (GLint)g_null.array_buffer;
+            break;
+        case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+            *data = (GLint)*null_buffer_binding(GL_ELEMENT_ARRAY_BUFFER);
+            break;
+        case GL_UNIFORM_BUFFER_BINDING:
+            *data = (GLint)g_null.uniform_buffer;
+            break;
+        case GL_TEXTURE_BINDING_2D:
+            *data = (GLint)g_null.units[g_null.active_unit];
+            break;
+        case GL_ACTIVE_TEXTURE:
+            *data = (GLint)(GL_TEXTURE0 + g_null.active_unit);
+            break;
+        case GL_DRAW_FRAMEBUFFER_BINDING:
+            *data = (GLint)g_null.draw_fbo;
+            break;
+        case GL_READ_FRAMEBUFFER_BINDING:
+            *data = (GLint)g_null.read_fbo;
+            break;
+        case GL_VIEWPORT:
+            memcpy(data, g_null.viewport, sizeof(g_null.viewport));
+            break;
+        case GL_SCISSOR_BOX:
+            memcpy(data, g_null.scissor, sizeof(g_null.scissor));
+            break;
+        case GL_BLEND_SRC_RGB:
+            *data = (GLint)g_null.blend[0];
+            break;
+        case GL_BLEND_DST_RGB:
+            *data = (GLint)g_null.blend[1];
+            break;
+        case GL_BLEND_SRC_ALPHA:
+            *data = (GLint)g_null.blend[2];
+            break;
+        case GL_BLEND_DST_ALPHA:
+            *data = (GLint)g_null.blend[3];
+            break;
+        case GL_BLEND_EQUATION_RGB:
+            *data = (GLint)g_null.blend_equation[0];
+            break;
+        case GL_BLEND_EQUATION_ALPHA:
+            *data = (GLint)g_null.blend_equation[1];
+            break;
+        default:
+            *data = 0;  // 包括 GL_NUM_EXTENSIONS
+            break;
+    }
+}
+
+static void GFX_NULL_API null_glGetIntegeri_v(GLenum target, GLuint index, GLint* data) {
+    NULL_CALL(glGetIntegeri_v);
+    switch (target) {
+        case GL_MAX_COMPUTE_WORK_GROUP_COUNT:
+            *data = 65535;
+            break;
+        case GL_MAX_COMPUTE_WORK_GROUP_SIZE:
+            *data = index == 2 ? 64 : 1024;
+            break;
+        default:
+            *data = 0;
+            break;
+    }
+}
+
+static const GLubyte* GFX_NULL_API null_glGetString(GLenum name) {
+    NULL_CALL(glGetString);
+    switch (name) {
+        case GL_VENDOR:
+            return (const GLubyte*)"neko";
+        case GL_RENDERER:
+            return (const GLubyte*)"Neko Null";
+        case GL_VERSION:
+            return (const GLubyte*)"4.6 Neko Null";
+        case GL_SHADING_LANGUAGE_VERSION:
+            return (const GLubyte*)"4.60";
+    }
+    return (const GLubyte*)"";
+}
+
+static const GLubyte* GFX_NULL_API null_glGetStringi(GLenum name, GLuint index) {
+    NULL_CALL(glGetStringi);
+    return (const GLubyte*)"";
+}
+
+// 缓冲
+
+static void GFX_NULL_API null_glGenBuffers(GLsizei n, GLuint* buffers) {
+    NULL_CALL(glGenBuffers);
+    for (GLsizei i = 0; i < n; i++) buffers[i] = null_create(g_null.buffers);
+    g_null.live.buffers += n;
+}
+
+static void GFX_NULL_API null_glCreateBuffers(GLsizei n, GLuint* buffers) {
+    NULL_CALL(glCreateBuffers);
+    for (GLsizei i = 0; i < n; i++) buffers[i] = null_create(g_null.buffers);
+    g_null.live.buffers += n;
+}
+
+static void GFX_NULL_API null_glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    NULL_CALL(glDeleteBuffers);
+    for (GLsizei i = 0; i < n; i++) {
+        NullBuffer* b = null_get(g_null.buffers, buffers[i]);
+        if (!b) continue;
+        GLuint* bindings[] = {&g_null.array_buffer, &g_null.element_buffer, &g_null.uniform_buffer, &g_null.other_buffer};
+        for (GLuint* binding : bindings)
+            if (*binding == buffers[i]) *binding = 0;
+        null_buffer_storage(b, 0);
+        if (b->memory) mem_free(b->memory);
+        *b = {};
+        g_null.live.buffers--;
+        g_null.rec.deleted++;
+    }
+}
+
+static void GFX_NULL_API null_glBindBuffer(GLenum target, GLuint buffer) {
+    NULL_CALL(glBindBuffer);
+    null_bind(null_buffer_binding(target), buffer, &g_null.rec.buffer_binds);
+}
+
+static void GFX_NULL_API null_glBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    NULL_CALL(glBindBufferBase);
+    null_bind(null_buffer_binding(target), buffer, &g_null.rec.buffer_binds);
+}
+
+static void GFX_NULL_API null_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    NULL_CALL(glBufferData);
+    NullBuffer* b = null_bound_buffer(target);
+    if (b) null_buffer_storage(b, size);
+    if (data) null_buffer_write(b, 0, size, data);
+}
+
+static void GFX_NULL_API null_glBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) {
+    NULL_CALL(glBufferStorage);
+    NullBuffer* b = null_bound_buffer(target);
+    if (b) null_buffer_storage(b, size);
+    if (data) null_buffer_write(b, 0, size, data);
+}
+
+static void GFX_NULL_API null_glNamedBufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags) {
+    NULL_CALL(glNamedBufferStorage);
+    NullBuffer* b = null_get(g_null.buffers, buffer);
+    if (b) null_buffer_storage(b, size);
+    if (data) null_buffer_write(b, 0, size, data);
+}
+
+static void GFX_NULL_API null_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    NULL_CALL(glBufferSubData);
+    null_buffer_write(null_bound_buffer(target), offset, size, data);
+}
+
+static void GFX_NULL_API null_glNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+    NULL_CALL(glNamedBufferSubData);
+    null_buffer_write(null_get(g_null.buffers, buffer), offset, size, data);
+}
+
+static void* GFX_NULL_API null_glMapBuffer(GLenum target, GLenum access) {
+    NULL_CALL(glMapBuffer);
+    return null_map(null_bound_buffer(target), 0);
+}
+
+static void* GFX_NULL_API null_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    NULL_CALL(glMapBufferRange);
+    NullBuffer* b = null_bound_buffer(target);
+    if (b && (u64)(offset + length) > b->size) return nullptr;
+    return null_map(b, offset);
+}
+
+static GLboolean GFX_NULL_API null_glUnmapBuffer(GLenum target) {
+    NULL_CALL(glUnmapBuffer);
+    return GL_TRUE;
+}
+
+static void GFX_NULL_API null_glGetBufferParameteriv(GLenum target, GLenum pname, GLint* params) {
+    NULL_CALL(glGetBufferParameteriv);
+    NullBuffer* b = null_bound_buffer(target);
+    *params = pname == GL_BUFFER_SIZE && b ? (GLint)b->size : 0;
+}
+
+static GLsync GFX_NULL_API null_glFenceSync(GLenum condition, GLbitfield flags) {
+    NULL_CALL(glFenceSync);
+    g_null.rec.fences++;
+    g_null.live.syncs++;
+    return (GLsync)(uintptr_t)++g_null.next_sync;
+}
+
+static GLenum GFX_NULL_API null_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    NULL_CALL(glClientWaitSync);
+    return GL_ALREADY_SIGNALED;
+}
+
+static void GFX_NULL_API null_glDeleteSync(GLsync sync) {
+    NULL_CALL(glDeleteSync);
+    if (sync) g_null.live.syncs--;
+}
+
+// 纹理
+
+static void GFX_NULL_API null_glGenTextures(GLsizei n, GLuint* textures) {
+    NULL_CALL(glGenTextures);
+    for (GLsizei i = 0; i < n; i++) textures[i] = null_create(g_null.textures);
+    g_null.live.textures += n;
+}
+
+static void GFX_NULL_API null_glCreateTextures(GLenum target, GLsizei n, GLuint* textures) {
+    NULL_CALL(glCreateTextures);
+    for (GLsizei i = 0; i < n; i++) textures[i] = null_create(g_null.textures);
+    g_null.live.textures += n;
+}
+
+static void GFX_NULL_API null_glDeleteTextures(GLsizei n, const GLuint* textures) {
+    NULL_CALL(glDeleteTextures);
+    for (GLsizei i = 0; i < n; i++) {
+        NullTexture* t = null_get(g_null.textures, textures[i]);
+        if (!t) continue;
+        for (GLuint& unit : g_null.units)
+            if (unit == textures[i]) unit = 0;
+        g_null.live.texture_bytes -= null_texture_memory(t);
+        *t = {};
+        g_null.live.textures--;
+        g_null.rec.deleted++;
+    }
+}
+
+static void GFX_NULL_API null_glBindTexture(GLenum target, GLuint texture) {
+    NULL_CALL(glBindTexture);
+    null_bind(&g_null.units[g_null.active_unit], texture, &g_null.rec.texture_binds);
+}
+
+static void GFX_NULL_API null_glBindTextureUnit(GLuint unit, GLuint texture) {
+    NULL_CALL(glBindTextureUnit);
+    if (unit < NEKO_ARR_SIZE(g_null.units)) null_bind(&g_null.units[unit], texture, &g_null.rec.texture_binds);
+}
+
+static void GFX_NULL_API null_glBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format) {
+    NULL_CALL(glBindImageTexture);
+}
+
+static void GFX_NULL_API null_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) {
+    NULL_CALL(glTexImage2D);
+    NullTexture* t = null_bound_texture();
+    if (t && level == 0) null_texture_storage(t, width, height, null_internal_bytes(internalformat), t->mipmaps);
+    if (pixels) {
+        g_null.rec.texture_uploads++;
+        g_null.rec.texture_upload_bytes += (u64)width * height * null_texel_bytes(format, type);
+    }
+}
+
+static void GFX_NULL_API null_glTextureStorage2D(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height) {
+    NULL_CALL(glTextureStorage2D);
+    NullTexture* t = null_get(g_null.textures, texture);
+    if (t) null_texture_storage(t, width, height, null_internal_bytes(internalformat), levels > 1);
+}
+
+static void GFX_NULL_API null_glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) {
+    NULL_CALL(glTexSubImage2D);
+    g_null.rec.texture_uploads++;
+    g_null.rec.texture_upload_bytes += (u64)width * height * null_texel_bytes(format, type);
+}
+
+static void GFX_NULL_API null_glTextureSubImage2D(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type,
+                                                  const void* pixels) {
+    NULL_CALL(glTextureSubImage2D);
+    g_null.rec.texture_uploads++;
+    g_null.rec.texture_upload_bytes += (u64)width * height * null_texel_bytes(format, type);
+}
+
+static void GFX_NULL_API null_glGenerateMipmap(GLenum target) {
+    NULL_CALL(glGenerateMipmap);
+    NullTexture* t = null_bound_texture();
+    if (t) null_texture_storage(t, t->width, t->height, t->width && t->height ? (u32)(t->bytes / ((u64)t->width * t->height)) : 0, true);
+}
+
+static void GFX_NULL_API null_glTexParameteri(GLenum target, GLenum pname, GLint param) { NULL_CALL(glTexParameteri); }
+
+static void GFX_NULL_API null_glTextureParameteri(GLuint texture, GLenum pname, GLint param) { NULL_CALL(glTextureParameteri); }
+
+static void GFX_NULL_API null_glGetTextureSubImage(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format,
+                                                   GLenum type, GLsizei bufSize, void* pixels) {
+    NULL_CALL(glGetTextureSubImage);
+    if (pixels && bufSize > 0) memset(pixels, 0, bufSize);
+}
+
+static void GFX_NULL_API null_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) {
+    NULL_CALL(glReadPixels);
+    if (pixels) memset(pixels, 0, (size_t)width * height * null_texel_bytes(format, type));
+}
+
+// 顶点数组
+
+static void GFX_NULL_API null_glGenVertexArrays(GLsizei n, GLuint* arrays) {
+    NULL_CALL(glGenVertexArrays);
+    for (GLsizei i = 0; i < n; i++) arrays[i] = null_create(g_null.vaos);
+    g_null.live.vertex_arrays += n;
+}
+
+static void GFX_NULL_API null_glCreateVertexArrays(GLsizei n, GLuint* arrays) {
+    NULL_CALL(glCreateVertexArrays);
+    for (GLsizei i = 0; i < n; i++) arrays[i] = null_create(g_null.vaos);
+    g_null.live.vertex_arrays += n;
+}
+
+static void GFX_NULL_API null_glDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    NULL_CALL(glDeleteVertexArrays);
+    for (GLsizei i = 0; i < n; i++) {
+        NullVertexArray* vao = null_get(g_null.vaos, arrays[i]);
+        if (!vao) continue;
+        if (g_null.vao == arrays[i]) g_null.vao = 0;
+        *vao = {};
+        g_null.live.vertex_arrays--;
+        g_null.rec.deleted++;
+    }
+}
+
+static void GFX_NULL_API null_glBindVertexArray(GLuint array) {
+    NULL_CALL(glBindVertexArray);
+    null_bind(&g_null.vao, array, &g_null.rec.vao_binds);
+}
+
+static GLboolean GFX_NULL_API null_glIsVertexArray(GLuint array) {
+    NULL_CALL(glIsVertexArray);
+    return null_get(g_null.vaos, array) ? GL_TRUE : GL_FALSE;
+}
+
+static void GFX_NULL_API null_glEnableVertexAttribArray(GLuint index) { NULL_CALL(glEnableVertexAttribArray); }
+
+static void GFX_NULL_API null_glDisableVertexAttribArray(GLuint index) { NULL_CALL(glDisableVertexAttribArray); }
+
+static void GFX_NULL_API null_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+    NULL_CALL(glVertexAttribPointer);
+}
+
+static void GFX_NULL_API null_glVertexAttrib1f(GLuint index, GLfloat x) { NULL_CALL(glVertexAttrib1f); }
+
+static void GFX_NULL_API null_glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w) { NULL_CALL(glVertexAttrib4f); }
+
+static void GFX_NULL_API null_glEnableVertexArrayAttrib(GLuint vaobj, GLuint index) { NULL_CALL(glEnableVertexArrayAttrib); }
+
+static void GFX_NULL_API null_glVertexArrayAttribFormat(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset) {
+    NULL_CALL(glVertexArrayAttribFormat);
+}
+
+static void GFX_NULL_API null_glVertexArrayAttribBinding(GLuint vaobj, GLuint attribindex, GLuint bindingindex) { NULL_CALL(glVertexArrayAttribBinding); }
+
+static void GFX_NULL_API null_glVertexArrayVertexBuffer(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride) { NULL_CALL(glVertexArrayVertexBuffer); }
+
+static void GFX_NULL_API null_glGetVertexAttribiv(GLuint index, GLenum pname, GLint* params) {
+    NULL_CALL(glGetVertexAttribiv);
+    *params = 0;
+}
+
+static void GFX_NULL_API null_glGetVertexAttribPointerv(GLuint index, GLenum pname, void** pointer) {
+    NULL_CALL(glGetVertexAttribPointerv);
+    *pointer = nullptr;
+}
+
+// 帧缓冲
+
+static void GFX_NULL_API null_glGenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    NULL_CALL(glGenFramebuffers);
+    for (GLsizei i = 0; i < n; i++) framebuffers[i] = null_create(g_null.framebuffers);
+    g_null.live.framebuffers += n;
+}
+
+static void GFX_NULL_API null_glCreateFramebuffers(GLsizei n, GLuint* framebuffers) {
+    NULL_CALL(glCreateFramebuffers);
+    for (GLsizei i = 0; i < n; i++) framebuffers[i] = null_create(g_null.framebuffers);
+    g_null.live.framebuffers += n;
+}
+
+static void GFX_NULL_API null_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    NULL_CALL(glDeleteFramebuffers);
+    for (GLsizei i = 0; i < n; i++) {
+        NullFramebuffer* fb = null_get(g_null.framebuffers, framebuffers[i]);
+        if (!fb) continue;
+        if (g_null.draw_fbo == framebuffers[i]) g_null.draw_fbo = 0;
+        if (g_null.read_fbo == framebuffers[i]) g_null.read_fbo = 0;
+        *fb = {};
+        g_null.live.framebuffers--;
+        g_null.rec.deleted++;
+    }
+}
+
+static void GFX_NULL_API null_glBindFramebuffer(GLenum target, GLuint framebuffer) {
+    NULL_CALL(glBindFramebuffer);
+    if (target == GL_READ_FRAMEBUFFER) {
+        null_bind(&g_null.read_fbo, framebuffer, &g_null.rec.framebuffer_binds);
+    } else if (target == GL_DRAW_FRAMEBUFFER) {
+        null_bind(&g_null.draw_fbo, framebuffer, &g_null.rec.framebuffer_binds);
+    } else {
+        g_null.read_fbo = framebuffer;
+        null_bind(&g_null.draw_fbo, framebuffer, &g_null.rec.framebuffer_binds);
+    }
+}
+
+static void GFX_NULL_API null_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) { NULL_CALL(glFramebufferTexture2D); }
+
+static void GFX_NULL_API null_glNamedFramebufferTexture(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level) { NULL_CALL(glNamedFramebufferTexture); }
+
+static GLenum GFX_NULL_API null_glCheckFramebufferStatus(GLenum target) {
+    NULL_CALL(glCheckFramebufferStatus);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static GLenum GFX_NULL_API null_glCheckNamedFramebufferStatus(GLuint framebuffer, GLenum target) {
+    NULL_CALL(glCheckNamedFramebufferStatus);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+// 着色器与程序
+
+static GLuint GFX_NULL_API null_glCreateShader(GLenum type) {
+    NULL_CALL(glCreateShader);
+    GLuint shader = null_create(g_null.shaders);
+    g_null.shaders[shader].type = type;
+    g_null.live.shaders++;
+    return shader;
+}
+
+static void GFX_NULL_API null_glDeleteShader(GLuint shader) {
+    NULL_CALL(glDeleteShader);
+    NullShader* s = null_get(g_null.shaders, shader);
+    if (!s) return;
+    if (s->source) mem_free(s->source);
+    *s = {};
+    g_null.live.shaders--;
+    g_null.rec.deleted++;
+}
+
+static void GFX_NULL_API null_glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) {
+    NULL_CALL(glShaderSource);
+    NullShader* s = null_get(g_null.shaders, shader);
+    if (!s) return;
+
+    size_t total = 0;
+    for (GLsizei i = 0; i < count; i++) total += length && length[i] >= 0 ? length[i] : strlen(string[i]);
+
+    if (s->source) mem_free(s->source);
+    s->source = (char*)mem_alloc(total + 1);
+    char* dst = s->source;
+    for (GLsizei i = 0; i < count; i++) {
+        size_t len = length && length[i] >= 0 ? length[i] : strlen(string[i]);
+        memcpy(dst, string[i], len);
+        dst += len;
+    }
+    *dst = '\0';
+}
+
+static void GFX_NULL_API null_glCompileShader(GLuint shader) { NULL_CALL(glCompileShader); }
+
+static void GFX_NULL_API null_glGetShaderiv(GLuint shader, GLenum pname, GLint* params) {
+    NULL_CALL(glGetShaderiv);
+    NullShader* s = null_get(g_null.shaders, shader);
+    switch (pname) {
+        case GL_COMPILE_STATUS:
+            *params = s ? GL_TRUE : GL_FALSE;
+            break;
+        case GL_SHADER_TYPE:
+            *params = s ? (GLint)s->type : 0;
+            break;
+        case GL_SHADER_SOURCE_LENGTH:
+            *params = s && s->source ? (GLint)strlen(s->source) + 1 : 0;
+            break;
+        default:
+            *params = 0;
+            break;
+    }
+}
+
+static void GFX_NULL_API null_glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    NULL_CALL(glGetShaderInfoLog);
+    if (length) *length = 0;
+    if (infoLog && bufSize > 0) infoLog[0] = '\0';
+}
+
+static void GFX_NULL_API null_glGetShaderSource(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* source) {
+    NULL_CALL(glGetShaderSource);
+    NullShader* s = null_get(g_null.shaders, shader);
+    GLsizei n = 0;
+    if (source && bufSize > 0) {
+        if (s && s->source) {
+            n = (GLsizei)NEKO_MIN(strlen(s->source), (size_t)bufSize - 1);
+            memcpy(source, s->source, n);
+        }
+        source[n] = '\0';
+    }
+    if (length) *length = n;
+}
+
+static GLuint GFX_NULL_API null_glCreateProgram(void) {
+    NULL_CALL(glCreateProgram);
+    g_null.live.programs++;
+    return null_create(g_null.programs);
+}
+
+static void GFX_NULL_API null_glDeleteProgram(GLuint program) {
+    NULL_CALL(glDeleteProgram);
+    NullProgram* p = null_get(g_null.programs, program);
+    if (!p) return;
+    null_program_reset(p);
+    *p = {};
+    g_null.live.programs--;
+    g_null.rec.deleted++;
+}
+
+static void GFX_NULL_API null_glAttachShader(GLuint program, GLuint shader) {
+    NULL_CALL(glAttachShader);
+    NullProgram* p = null_get(g_null.programs, program);
+    if (p && p->shader_count < NEKO_ARR_SIZE(p->shaders)) p->shaders[p->shader_count++] = shader;
+}
+
+static void GFX_NULL_API null_glDetachShader(GLuint program, GLuint shader) {
+    NULL_CALL(glDetachShader);
+    NullProgram* p = null_get(g_null.programs, program);
+    if (!p) return;
+    for (u32 i = 0; i < p->shader_count; i++) {
+        if (p->shaders[i] == shader) {
+            p->shaders[i] = p->shaders[--p->shader_count];
+            break;
+        }
+    }
+}
+
+static void GFX_NULL_API null_glLinkProgram(GLuint program) {
+    NULL_CALL(glLinkProgram);
+    NullProgram* p = null_get(g_null.programs, program);
+    if (!p) return;
+
+    null_program_reset(p);
+
+    size_t total = 0;
+    for (u32 i = 0; i < p->shader_count; i++) {
+        NullShader* s = null_get(g_null.shaders, p->shaders[i]);
+        if (s && s->source) total += strlen(s->source) + 1;
+    }
+    p->source = (char*)mem_alloc(total + 1);
+    char* dst = p->source;
+    for (u32 i = 0; i < p->shader_count; i++) {
+        NullShader* s = null_get(g_null.shaders, p->shaders[i]);
+        if (!s || !s->source) continue;
+        size_t len = strlen(s->source);
+        memcpy(dst, s->source, len);
+        dst += len;
+        *dst++ = '\n';
+    }
+    *dst = '\0';
+    p->linked = true;
+    null_program_parse_uniforms(p);
+}
+
+static void GFX_NULL_API null_glUseProgram(GLuint program) {
+    NULL_CALL(glUseProgram);
+    null_bind(&g_null.program, program, &g_null.rec.program_binds);
+}
+
+static GLboolean GFX_NULL_API null_glIsProgram(GLuint program) {
+    NULL_CALL(glIsProgram);
+    return null_get(g_null.programs, program) ? GL_TRUE : GL_FALSE;
+}
+
+static void GFX_NULL_API null_glGetProgramiv(GLuint program, GLenum pname, GLint* params) {
+    NULL_CALL(glGetProgramiv);
+    NullProgram* p = null_get(g_null.programs, program);
+    switch (pname) {
+        case GL_LINK_STATUS:
+            *params = p && p->linked ? GL_TRUE : GL_FALSE;
+            break;
+        case GL_VALIDATE_STATUS:
+            *params = p ? GL_TRUE : GL_FALSE;
+            break;
+        case GL_ATTACHED_SHADERS:
+            *params = p ? (GLint)p->shader_count : 0;
+            break;
+        case GL_ACTIVE_UNIFORMS:
+            *params = p ? (GLint)p->active.len : 0;
+            break;
+        case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+            *params = 0;
+            if (p)
+                for (NullUniform& u : p->active) *params = NEKO_MAX(*params, (GLint)strlen(u.name) + 1);
+            break;
+        default:
+            *params = 0;
+            break;
+    }
+}
+
+static void GFX_NULL_API null_glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    NULL_CALL(glGetProgramInfoLog);
+    if (length) *length = 0;
+    if (infoLog && bufSize > 0) infoLog[0] = '\0';
+}
+
+static void GFX_NULL_API null_glGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders) {
+    NULL_CALL(glGetAttachedShaders);
+    NullProgram* p = null_get(g_null.programs, program);
+    GLsizei n = p ? NEKO_MIN((GLsizei)p->shader_count, maxCount) : 0;
+    for (GLsizei i = 0; i < n; i++) shaders[i] = p->shaders[i];
+    if (count) *count = n;
+}
+
+static void GFX_NULL_API null_glGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+    NULL_CALL(glGetActiveUniform);
+    NullProgram* p = null_get(g_null.programs, program);
+    NullUniform* u = p && index < p->active.len ? &p->active[index] : nullptr;
+    GLsizei n = 0;
+    if (name && bufSize > 0) {
+        n = u ? NEKO_MIN((GLsizei)strlen(u->name), bufSize - 1) : 0;
+        if (u) memcpy(name, u->name, n);
+        name[n] = '\0';
+    }
+    if (length) *length = n;
+    if (size) *size = u ? u->size : 0;
+    if (type) *type = u ? u->type : 0;
+}
+
+static GLint GFX_NULL_API null_glGetUniformLocation(GLuint program, const GLchar* name) {
+    NULL_CALL(glGetUniformLocation);
+    NullProgram* p = null_get(g_null.programs, program);
+    return p ? null_location(p, &p->uniforms, &p->next_uniform, name) : -1;
+}
+
+static GLint GFX_NULL_API null_glGetAttribLocation(GLuint program, const GLchar* name) {
+    NULL_CALL(glGetAttribLocation);
+    NullProgram* p = null_get(g_null.programs, program);
+    return p ? null_location(p, &p->attribs, &p->next_attrib, name) : -1;
+}
+
+static GLuint GFX_NULL_API null_glGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName) {
+    NULL_CALL(glGetUniformBlockIndex);
+    NullProgram* p = null_get(g_null.programs, program);
+    GLint index = p ? null_location(p, &p->blocks, &p->next_block, uniformBlockName) : -1;
+    return index < 0 ? GL_INVALID_INDEX : (GLuint)index;
+}
+
+static void GFX_NULL_API null_glUniformBlockBinding(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding) { NULL_CALL(glUniformBlockBinding); }
+
+static void GFX_NULL_API null_glGetUniformfv(GLuint program, GLint location, GLfloat* params) {
+    NULL_CALL(glGetUniformfv);
+    *params = 0.0f;
+}
+
+static void GFX_NULL_API null_glGetUniformuiv(GLuint program, GLint location, GLuint* params) {
+    NULL_CALL(glGetUniformuiv);
+    *params = 0;
+}
+
+// uniform
+
+#define NULL_UNIFORM(name)                                                  \
+    (g_null.rec.calls++, g_null.rec.fn_calls[GfxNull_##name]++); \
+    g_null.rec.uniforms++
+
+static void GFX_NULL_API null_glUniform1f(GLint location, GLfloat v0) { NULL_UNIFORM(glUniform1f); }
+static void GFX_NULL_API null_glUniform1fv(GLint location, GLsizei count, const GLfloat* value) { NULL_UNIFORM(glUniform1fv); }
+static void GFX_NULL_API null_glUniform1i(GLint location, GLint v0) { NULL_UNIFORM(glUniform1i); }
+static void GFX_NULL_API null_glUniform1iv(GLint location, GLsizei count, const GLint* value) { NULL_UNIFORM(glUniform1iv); }
+static void GFX_NULL_API null_glUniform1ui(GLint location, GLuint v0) { NULL_UNIFORM(glUniform1ui); }
+static void GFX_NULL_API null_glUniform2f(GLint location, GLfloat v0, GLfloat v1) { NULL_UNIFORM(glUniform2f); }
+static void GFX_NULL_API null_glUniform2fv(GLint location, GLsizei count, const GLfloat* value) { NULL_UNIFORM(glUniform2fv); }
+static void GFX_NULL_API null_glUniform2i(GLint location, GLint v0, GLint v1) { NULL_UNIFORM(glUniform2i); }
+static void GFX_NULL_API null_glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { NULL_UNIFORM(glUniform3f); }
+static void GFX_NULL_API null_glUniform3fv(GLint location, GLsizei count, const GLfloat* value) { NULL_UNIFORM(glUniform3fv); }
+static void GFX_NULL_API null_glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { NULL_UNIFORM(glUniform4f); }
+static void GFX_NULL_API null_glUniform4fv(GLint location, GLsizei count, const GLfloat* value) { NULL_UNIFORM(glUniform4fv); }
+static void GFX_NULL_API null_glUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { NULL_UNIFORM(glUniformMatrix3fv); }
+static void GFX_NULL_API null_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { NULL_UNIFORM(glUniformMatrix4fv); }
+static void GFX_NULL_API null_glProgramUniform1uiv(GLuint program, GLint location, GLsizei count, const GLuint* value) { NULL_UNIFORM(glProgramUniform1uiv); }
+static void GFX_NULL_API null_glProgramUniform3fv(GLuint program, GLint location, GLsizei count, const GLfloat* value) { NULL_UNIFORM(glProgramUniform3fv); }
+static void GFX_NULL_API null_glProgramUniform3uiv(GLuint program, GLint location, GLsizei count, const GLuint* value) { NULL_UNIFORM(glProgramUniform3uiv); }
+static void GFX_NULL_API null_glProgramUniform4fv(GLuint program, GLint location, GLsizei count, const GLfloat* value) { NULL_UNIFORM(glProgramUniform4fv); }
+
+#undef NULL_UNIFORM
+
+// 绘制
+
+static void GFX_NULL_API null_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    NULL_CALL(glDrawArrays);
+    null_draw(count);
+}
+
+static void GFX_NULL_API null_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    NULL_CALL(glDrawElements);
+    null_draw(count);
+}
+
+static void GFX_NULL_API null_glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex) {
+    NULL_CALL(glDrawElementsBaseVertex);
+    null_draw(count);
+}
+
+static void GFX_NULL_API null_glDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices, GLint basevertex) {
+    NULL_CALL(glDrawRangeElementsBaseVertex);
+    null_draw(count);
+}
+
+static void GFX_NULL_API null_glMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount) {
+    NULL_CALL(glMultiDrawArrays);
+    GLsizei total = 0;
+    for (GLsizei i = 0; i < drawcount; i++) total += count[i];
+    null_draw(total);
+    g_null.rec.draw_ranges += drawcount;
+}
+
+#undef NULL_CALL
+
+static void null_trash_objects() {
+    for (u64 i = 0; i < g_null.buffers.len; i++)
+        if (g_null.buffers[i].memory) mem_free(g_null.buffers[i].memory);
+    for (u64 i = 0; i < g_null.shaders.len; i++)
+        if (g_null.shaders[i].source) mem_free(g_null.shaders[i].source);
+    for (u64 i = 0; i < g_null.programs.len; i++) null_program_reset(&g_null.programs[i]);
+
+    g_null.buffers.trash();
+    g_null.textures.trash();
+    g_null.vaos.trash();
+    g_null.framebuffers.trash();
+    g_null.shaders.trash();
+    g_null.programs.trash();
+    g_null.enabled.trash();
+}
+
+bool gfx_null_install() {
+    if (g_null.installed) return false;
+
+    g_null = {};
+
+#define GFX_NULL_SWAP(name)                               \
+    g_null.saved[GfxNull_##name] = (void*)glad_##name; \
+    glad_##name = null_##name;
+    GFX_NULL_FUNCS(GFX_NULL_SWAP)
+#undef GFX_NULL_SWAP
+
+    // 假装是 4.6 上下文 streambuffer 与纹理走持久映射和 DSA 的路径
+    g_null.saved_dsa = GLAD_GL_ARB_direct_state_access;
+    g_null.saved_version = GLVersion;
+    GLAD_GL_ARB_direct_state_access = 1;
+    GLVersion.major = 4;
+    GLVersion.minor = 6;
+
+    GLenum blend[4] = {GL_ONE, GL_ZERO, GL_ONE, GL_ZERO};
+    memcpy(g_null.blend, blend, sizeof(blend));
+    g_null.blend_equation[0] = g_null.blend_equation[1] = GL_FUNC_ADD;
+    g_null.enabled.push(GL_DITHER);
+    g_null.enabled.push(GL_MULTISAMPLE);
+
+    g_null.installed = true;
+    return true;
+}
+
+void gfx_null_uninstall() {
+    if (!g_null.installed) return;
+
+#define GFX_NULL_RESTORE(name) glad_##name = (decltype(glad_##name))g_null.saved[GfxNull_##name];
+    GFX_NULL_FUNCS(GFX_NULL_RESTORE)
+#undef GFX_NULL_RESTORE
+
+    GLAD_GL_ARB_direct_state_access = g_null.saved_dsa;
+    GLVersion = g_null.saved_version;
+
+    null_trash_objects();
+    g_null = {};
+}
+
+bool gfx_null_installed() { return g_null.installed; }
+
+GfxRecorder& gfx_recorder() { return g_null.rec; }
+
+void gfx_recorder_reset() { g_null.rec = {}; }
+
+u32 gfx_recorder_calls(const char* fn) {
+    for (u32 i = 0; i < GfxNull_Count; i++)
+        if (strcmp(g_null_names[i], fn) == 0) return g_null.rec.fn_calls[i];
+    return 0;
+}
+
+const GfxNullObjects& gfx_null_objects() { return g_null.live; }
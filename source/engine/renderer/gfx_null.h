@@ -0,0 +1,84 @@
+#pragma once
+
+#include "base/common/base.hpp"
+#include "engine/graphics.h"
+
+// 空图形后端
+// 把 glad 的函数指针换成只记录调用的空实现 不需要 GPU 与 GL 上下文
+// 对象句柄按种类递增分配 缓冲与纹理记录尺寸 映射缓冲返回真实的内存
+// 着色器总是编译链接成功 uniform 位置按名字稳定分配 着色器源码里没有的名字返回 -1
+// 活动 uniform 按源码中的声明列出 (展开数组与结构 不含 uniform 块)
+// 绑定与开关状态会被跟踪 可以据此断言一帧的绘制次数与状态切换次数 或测量一帧的 CPU 开销
+
+#define GFX_NULL_FUNCS(X)                                                                                                                                                          \
+    X(glActiveTexture) X(glAttachShader) X(glBindBuffer) X(glBindBufferBase) X(glBindFramebuffer) X(glBindImageTexture) X(glBindTexture) X(glBindTextureUnit)                  \
+    X(glBindVertexArray) X(glBlendEquationSeparate) X(glBlendFunc) X(glBlendFuncSeparate) X(glBufferData) X(glBufferStorage) X(glBufferSubData) X(glCheckFramebufferStatus)    \
+    X(glCheckNamedFramebufferStatus) X(glClear) X(glClearColor) X(glClientWaitSync) X(glCompileShader) X(glCreateBuffers) X(glCreateFramebuffers) X(glCreateProgram)          \
+    X(glCreateShader) X(glCreateTextures) X(glCreateVertexArrays) X(glDebugMessageCallback) X(glDebugMessageControl) X(glDeleteBuffers) X(glDeleteFramebuffers)                \
+    X(glDeleteProgram) X(glDeleteShader) X(glDeleteSync) X(glDeleteTextures) X(glDeleteVertexArrays) X(glDetachShader) X(glDisable) X(glDisableVertexAttribArray)              \
+    X(glDrawArrays) X(glDrawElements) X(glDrawElementsBaseVertex) X(glDrawRangeElementsBaseVertex) X(glEnable) X(glEnableVertexArrayAttrib) X(glEnableVertexAttribArray)      \
+    X(glFenceSync) X(glFinish) X(glFramebufferTexture2D) X(glGenBuffers) X(glGenFramebuffers) X(glGenTextures) X(glGenVertexArrays) X(glGenerateMipmap)                       \
+    X(glGetActiveUniform) X(glGetAttachedShaders) X(glGetAttribLocation) X(glGetBufferParameteriv) X(glGetError) X(glGetIntegeri_v) X(glGetIntegerv) X(glGetProgramInfoLog) X(glGetProgramiv)    \
+    X(glGetShaderInfoLog) X(glGetShaderSource) X(glGetShaderiv) X(glGetString) X(glGetStringi) X(glGetTextureSubImage) X(glGetUniformBlockIndex) X(glGetUniformLocation)       \
+    X(glGetUniformfv) X(glGetUniformuiv) X(glGetVertexAttribPointerv) X(glGetVertexAttribiv) X(glIsEnabled) X(glIsProgram) X(glIsVertexArray) X(glLinkProgram) X(glMapBuffer) \
+    X(glMapBufferRange) X(glMultiDrawArrays) X(glNamedBufferStorage) X(glNamedBufferSubData) X(glNamedFramebufferTexture) X(glPixelStorei) X(glProgramUniform1uiv)             \
+    X(glProgramUniform3fv) X(glProgramUniform3uiv) X(glProgramUniform4fv) X(glReadPixels) X(glScissor) X(glShaderSource) X(glTexImage2D) X(glTexParameteri)                   \
+    X(glTexSubImage2D) X(glTextureParameteri) X(glTextureStorage2D) X(glTextureSubImage2D) X(glUniform1f) X(glUniform1fv) X(glUniform1i) X(glUniform1iv) X(glUniform1ui)      \
+    X(glUniform2f) X(glUniform2fv) X(glUniform2i) X(glUniform3f) X(glUniform3fv) X(glUniform4f) X(glUniform4fv) X(glUniformBlockBinding) X(glUniformMatrix3fv)                \
+    X(glUniformMatrix4fv) X(glUnmapBuffer) X(glUseProgram) X(glVertexArrayAttribBinding) X(glVertexArrayAttribFormat) X(glVertexArrayVertexBuffer) X(glVertexAttrib1f)        \
+    X(glVertexAttrib4f) X(glVertexAttribPointer) X(glViewport)
+
+enum GfxNullFn {
+#define GFX_NULL_ENUM(name) GfxNull_##name,
+    GFX_NULL_FUNCS(GFX_NULL_ENUM)
+#undef GFX_NULL_ENUM
+            GfxNull_Count
+};
+
+// 调用记录 gfx_recorder_reset 清零
+struct GfxRecorder {
+    u64 calls;                    // 所有调用
+    u32 fn_calls[GfxNull_Count];  // 按函数
+    u32 draws;                    // 绘制调用 glMultiDrawArrays 记一次
+    u32 draw_ranges;              // glMultiDrawArrays 的每一段另计
+    u64 vertices;                 // 绘制的顶点或索引数
+    u32 state_changes;            // 确实改变了状态的绑定 开关与混合设置
+    u32 redundant;                // 与当前状态相同的绑定与设置
+    u32 program_binds;
+    u32 texture_binds;
+    u32 vao_binds;
+    u32 buffer_binds;
+    u32 framebuffer_binds;
+    u32 uniforms;  // glUniform* glProgramUniform*
+    u32 clears;
+    u32 buffer_uploads;
+    u64 buffer_upload_bytes;
+    u32 texture_uploads;
+    u64 texture_upload_bytes;
+    u32 maps;
+    u32 fences;
+    u32 created;
+    u32 deleted;
+};
+
+// 当前存活的对象 不随 gfx_recorder_reset 清零
+struct GfxNullObjects {
+    u32 buffers;
+    u32 textures;
+    u32 vertex_arrays;
+    u32 framebuffers;
+    u32 shaders;
+    u32 programs;
+    u32 syncs;
+    u64 buffer_bytes;
+    u64 texture_bytes;
+};
+
+bool gfx_null_install();    // 替换函数指针 已安装时返回 false
+void gfx_null_uninstall();  // 恢复安装前的指针并释放所有对象
+bool gfx_null_installed();
+
+GfxRecorder& gfx_recorder();
+void gfx_recorder_reset();
+u32 gfx_recorder_calls(const char* fn);  // 按函数名 例如 "glDrawArrays"
+const GfxNullObjects& gfx_null_objects();
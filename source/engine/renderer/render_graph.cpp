@@ -0,0 +1,226 @@
+#include "engine/renderer/render_graph.h"
+
+#include "base/common/profiler.hpp"
+
+#define RENDER_POOL_MAX_IDLE 3  // 帧
+
+static u64 render_target_bytes(const RenderTarget& rt) { return (u64)rt.width * rt.height * 3; }
+
+static i32 render_pool_acquire(RenderGraph* g, u32 width, u32 height) {
+    i32 empty = -1;
+    for (u64 i = 0; i < g->pool.len; i++) {
+        RenderTargetPoolEntry& e = g->pool[i];
+        if (!e.rt.valid()) {
+            if (empty < 0) empty = (i32)i;
+        } else if (!e.in_use && e.rt.width == width && e.rt.height == height) {
+            e.in_use = e.used = true;
+            return (i32)i;
+        }
+    }
+
+    if (empty < 0) {
+        g->pool.push(RenderTargetPoolEntry{});
+        empty = (i32)g->pool.len - 1;
+    }
+    RenderTargetPoolEntry& e = g->pool[empty];
+    e = {};
+    e.rt.create(width, height);
+    e.in_use = e.used = true;
+    return empty;
+}
+
+// 释放连续几帧没有用到的目标 并统计池的大小
+static void render_pool_trim(RenderGraph* g) {
+    g->stats.targets = 0;
+    g->stats.target_bytes = 0;
+    for (u64 i = 0; i < g->pool.len; i++) {
+        RenderTargetPoolEntry& e = g->pool[i];
+        if (!e.rt.valid()) continue;
+        e.idle_frames = e.used ? 0 : e.idle_frames + 1;
+        e.used = false;
+        e.in_use = false;
+        if (e.idle_frames > RENDER_POOL_MAX_IDLE) {
+            e.rt.release();
+            e = {};
+            continue;
+        }
+        g->stats.targets++;
+        g->stats.target_bytes += render_target_bytes(e.rt);
+    }
+}
+
+void render_graph_trash(RenderGraph* g) {
+    for (u64 i = 0; i < g->pool.len; i++)
+        if (g->pool[i].rt.valid()) g->pool[i].rt.release();
+    g->pool.trash();
+    g->resources.trash();
+    g->passes.trash();
+    *g = {};
+}
+
+void render_graph_reset(RenderGraph* g) {
+    g->resources.len = 0;
+    g->passes.len = 0;
+    g->compiled = false;
+}
+
+RenderResourceId render_graph_import(RenderGraph* g, const char* name, RenderTarget* rt) {
+    RenderGraphResource res = {};
+    res.name = name;
+    res.imported = rt;
+    res.target = res.last_target = -1;
+    g->resources.push(res);
+    g->compiled = false;
+    return (RenderResourceId)g->resources.len - 1;
+}
+
+RenderResourceId render_graph_transient(RenderGraph* g, const char* name, u32 scale_shift) {
+    RenderGraphResource res = {};
+    res.name = name;
+    res.scale_shift = NEKO_MIN(scale_shift, 2u);
+    res.target = res.last_target = -1;
+    g->resources.push(res);
+    g->compiled = false;
+    return (RenderResourceId)g->resources.len - 1;
+}
+
+void render_graph_pass(RenderGraph* g, const char* name, PostProcessor* effect, RenderResourceId input0, RenderResourceId input1, RenderResourceId output,
+                       RenderPassSetupFn setup, void* user) {
+    RenderGraphPass pass = {};
+    pass.name = name;
+    pass.effect = effect;
+    pass.inputs[0] = input0;
+    pass.inputs[1] = input1;
+    pass.output = output;
+    pass.setup = setup;
+    pass.user = user;
+    g->passes.push(pass);
+    g->compiled = false;
+}
+
+void render_graph_compile(RenderGraph* g) {
+    PROFILE_FUNC();
+
+    Array<bool> read = {};
+    read.resize(g->resources.len);
+    for (u64 i = 0; i < read.len; i++) read[i] = false;
+
+    // 从后往前 输出到屏幕或导入目标的 pass 总是保留 其余的只在输出被后面的 pass 读取时保留
+    g->stats.culled = 0;
+    for (i64 i = (i64)g->passes.len - 1; i >= 0; i--) {
+        RenderGraphPass& pass = g->passes[i];
+        RenderResourceId out = pass.output;
+        bool external = out == RenderResource_Screen || (out >= 0 && g->resources[out].imported);
+        pass.culled = !external && !(out >= 0 && read[out]);
+        if (pass.culled) {
+            g->stats.culled++;
+            continue;
+        }
+        if (out >= 0) read[out] = false;  // 更早的写入被这次覆盖
+        for (RenderResourceId in : pass.inputs)
+            if (in >= 0) read[in] = true;
+    }
+    read.trash();
+
+    for (u64 r = 0; r < g->resources.len; r++) {
+        g->resources[r].first_pass = -1;
+        g->resources[r].last_pass = -1;
+    }
+    g->stats.transients = 0;
+    for (u64 i = 0; i < g->passes.len; i++) {
+        RenderGraphPass& pass = g->passes[i];
+        if (pass.culled) continue;
+        if (pass.output >= 0) {
+            RenderGraphResource& res = g->resources[pass.output];
+            if (res.first_pass < 0) {
+                res.first_pass = (i32)i;
+                if (!res.imported) g->stats.transients++;
+            }
+            res.last_pass = NEKO_MAX(res.last_pass, (i32)i);
+        }
+        for (RenderResourceId in : pass.inputs) {
+            if (in < 0) continue;
+            RenderGraphResource& res = g->resources[in];
+            error_assert(res.imported || res.first_pass >= 0, "render graph reads a resource before it is written");
+            res.last_pass = (i32)i;
+        }
+    }
+
+    g->compiled = true;
+}
+
+static RenderTarget* render_graph_resolve(RenderGraph* g, RenderResourceId id) {
+    RenderGraphResource& res = g->resources[id];
+    if (res.imported) return res.imported;
+    return res.target >= 0 ? &g->pool[res.target].rt : nullptr;
+}
+
+void render_graph_execute(RenderGraph* g, u32 width, u32 height) {
+    PROFILE_FUNC();
+
+    if (!g->compiled) render_graph_compile(g);
+
+    for (u64 r = 0; r < g->resources.len; r++) g->resources[r].target = -1;
+
+    g->stats.passes = 0;
+    for (u64 i = 0; i < g->passes.len; i++) {
+        RenderGraphPass& pass = g->passes[i];
+        if (pass.culled) continue;
+
+        // 先取输出再归还输入 同一个 pass 的输入与输出不会是同一个目标
+        u32 w = width, h = height;
+        if (pass.output == RenderResource_Screen) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        } else {
+            RenderGraphResource& res = g->resources[pass.output];
+            if (!res.imported && res.target < 0) {
+                res.target = render_pool_acquire(g, NEKO_MAX(width >> res.scale_shift, 1u), NEKO_MAX(height >> res.scale_shift, 1u));
+            }
+            RenderTarget* rt = render_graph_resolve(g, pass.output);
+            rt->bind();
+            w = rt->width;
+            h = rt->height;
+        }
+        glViewport(0, 0, w, h);
+
+        // 倒序绑定 不支持 DSA 时活动纹理单元最后停在 0
+        for (i32 u = NEKO_ARR_SIZE(pass.inputs) - 1; u >= 0; u--) {
+            if (pass.inputs[u] < 0) continue;
+            render_graph_resolve(g, pass.inputs[u])->bind_output(u);
+        }
+
+        pass.effect->dimentions = neko_v2(w, h);
+        pass.effect->Draw([&](AssetShader& shader) {
+            if (pass.setup) pass.setup(shader, pass.user);
+        });
+        g->stats.passes++;
+
+        for (RenderResourceId in : pass.inputs) {
+            if (in < 0) continue;
+            RenderGraphResource& res = g->resources[in];
+            if (res.target >= 0 && res.last_pass == (i32)i) {
+                g->pool[res.target].in_use = false;
+                res.last_target = res.target;
+                res.target = -1;
+            }
+        }
+    }
+
+    for (u64 r = 0; r < g->resources.len; r++) {
+        RenderGraphResource& res = g->resources[r];
+        if (res.target >= 0) res.last_target = res.target;
+    }
+    render_pool_trim(g);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+RenderTarget* render_graph_target(RenderGraph* g, RenderResourceId id) {
+    if (id < 0 || (u64)id >= g->resources.len) return nullptr;
+    RenderGraphResource& res = g->resources[id];
+    if (res.imported) return res.imported;
+    if (res.last_target < 0 || (u64)res.last_target >= g->pool.len || !g->pool[res.last_target].rt.valid()) return nullptr;
+    return &g->pool[res.last_target].rt;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "base/common/array.hpp"
+#include "base/common/base.hpp"
+#include "engine/renderer/renderer.h"
+
+// 后处理的 pass 图
+// 每个 pass 用一个 PostProcessor 读至多两个资源 (依次绑定到纹理单元 0 1) 写一个资源
+// 资源是导入的渲染目标 (例如场景) 屏幕 或者从池中分配的临时目标
+// compile 剔除输出没有被读取的 pass 并求出临时资源的生命期 (第一次写入到最后一次读取)
+// execute 在第一次写入前从池中取目标 最后一次读取后归还 生命期不重叠的资源共用一个目标
+// 临时资源可以是全分辨率 1/2 或 1/4 池中超过几帧没有用到的目标 (例如窗口改变大小后) 被释放
+
+using RenderResourceId = i32;
+
+enum : RenderResourceId {
+    RenderResource_None = -1,
+    RenderResource_Screen = -2,
+};
+
+struct RenderGraphResource {
+    const char* name;
+    RenderTarget* imported;  // 非空时为外部的目标 不从池中分配
+    u32 scale_shift;         // 0 全分辨率 1 一半 2 四分之一
+    i32 first_pass;          // compile 后的生命期 没有用到时为 -1
+    i32 last_pass;
+    i32 target;       // 本帧在池中的下标
+    i32 last_target;  // 上一次 execute 结束时的下标 用于调试查看
+};
+
+typedef void (*RenderPassSetupFn)(AssetShader& shader, void* user);  // 设置其余的 uniform
+
+struct RenderGraphPass {
+    const char* name;
+    PostProcessor* effect;
+    RenderResourceId inputs[2];
+    RenderResourceId output;
+    RenderPassSetupFn setup;
+    void* user;
+    bool culled;
+};
+
+struct RenderTargetPoolEntry {
+    RenderTarget rt;  // rt.id 为 0 时是空位
+    bool in_use;      // 本帧被某个资源持有
+    bool used;        // 本帧用到过
+    u32 idle_frames;
+};
+
+struct RenderGraphStats {
+    u32 passes;        // 上一次 execute 执行的 pass
+    u32 culled;        // compile 剔除的 pass
+    u32 transients;    // 用到的临时资源
+    u32 targets;       // 池中的目标
+    u64 target_bytes;  // 池中目标的纹理内存 (GL_RGB8)
+};
+
+struct RenderGraph {
+    Array<RenderGraphResource> resources;
+    Array<RenderGraphPass> passes;
+    Array<RenderTargetPoolEntry> pool;
+    bool compiled;
+    RenderGraphStats stats;
+};
+
+void render_graph_trash(RenderGraph* g);  // 释放池中的目标
+void render_graph_reset(RenderGraph* g);  // 清除资源与 pass 保留池
+RenderResourceId render_graph_import(RenderGraph* g, const char* name, RenderTarget* rt);
+RenderResourceId render_graph_transient(RenderGraph* g, const char* name, u32 scale_shift = 0);
+void render_graph_pass(RenderGraph* g, const char* name, PostProcessor* effect, RenderResourceId input0, RenderResourceId input1, RenderResourceId output,
+                       RenderPassSetupFn setup = nullptr, void* user = nullptr);
+void render_graph_compile(RenderGraph* g);
+void render_graph_execute(RenderGraph* g, u32 width, u32 height);  // 屏幕大小 结束时视口恢复为屏幕大小
+RenderTarget* render_graph_target(RenderGraph* g, RenderResourceId id);  // 上一次 execute 后资源所在的目标 之后可能被别的资源覆盖
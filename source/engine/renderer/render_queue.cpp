@@ -0,0 +1,210 @@
+#include "engine/renderer/render_queue.h"
+
+#include "base/common/profiler.hpp"
+
+void render_queue_trash(RenderQueue* q) {
+    q->commands.trash();
+    q->order.trash();
+    q->draws.trash();
+    q->firsts.trash();
+    q->counts.trash();
+    *q = {};
+}
+
+void render_queue_set_layer_sorted(RenderQueue* q, u8 layer, bool sorted) {
+    u64 bit = 1ull << (layer & 63);
+    if (sorted)
+        q->sorted_layers[layer >> 6] |= bit;
+    else
+        q->sorted_layers[layer >> 6] &= ~bit;
+}
+
+bool render_queue_layer_sorted(const RenderQueue* q, u8 layer) { return (q->sorted_layers[layer >> 6] >> (layer & 63)) & 1; }
+
+static u8 render_key_layer(RenderKey key) { return (u8)(key >> 56); }
+
+static void render_draw_range(const RenderCommand* cmd, i32 first, i32 count) {
+    if (cmd->indexed)
+        glDrawElements(cmd->mode, count, GL_UNSIGNED_INT, NEKO_INT2VOIDP((u64)first * sizeof(u32)));
+    else
+        glDrawArrays(cmd->mode, first, count);
+}
+
+// 不经过排序 直接绘制一个命令
+static void render_command_execute(const RenderCommand* cmd) {
+    glUseProgram(cmd->shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, cmd->texture);
+    glBindVertexArray(cmd->vao);
+    if (cmd->apply) cmd->apply(cmd);
+    render_draw_range(cmd, cmd->first, cmd->count);
+    gfx_frame_stats().draws++;
+    glBindVertexArray(0);
+}
+
+void render_queue_submit(RenderQueue* q, const RenderCommand& cmd) {
+    if (cmd.count <= 0) return;
+    if (!render_queue_layer_sorted(q, render_key_layer(cmd.key))) {
+        render_command_execute(&cmd);
+        return;
+    }
+    q->commands.push(cmd);
+}
+
+void render_queue_sort(RenderQueue* q) {
+    PROFILE_FUNC();
+
+    struct KeyIndex {
+        u64 key;
+        u32 index;
+    };
+
+    u64 n = q->commands.len;
+    q->order.resize(n);
+
+    u64 descents = 0;
+    for (u64 i = 0; i < n; i++) {
+        q->order[i] = (u32)i;
+        if (i && q->commands[i].key < q->commands[i - 1].key) descents++;
+    }
+    if (descents == 0) return;
+
+    u32 hist[8][256] = {};
+    for (u64 i = 0; i < n; i++)
+        for (int d = 0; d < 8; d++) hist[d][(q->commands[i].key >> (d * 8)) & 0xff]++;
+
+    Array<KeyIndex> a = {}, b = {};
+    a.resize(n);
+    b.resize(n);
+    for (u64 i = 0; i < n; i++) a[i] = KeyIndex{q->commands[i].key, (u32)i};
+
+    u64 first = q->commands[0].key;
+    for (int d = 0; d < 8; d++) {
+        u32* h = hist[d];
+        if (h[(first >> (d * 8)) & 0xff] == n) continue;  // 该字节全部相同
+        u32 offset = 0;
+        for (int v = 0; v < 256; v++) {
+            u32 c = h[v];
+            h[v] = offset;
+            offset += c;
+        }
+        for (u64 i = 0; i < n; i++) b[h[(a[i].key >> (d * 8)) & 0xff]++] = a[i];
+        std::swap(a, b);
+    }
+
+    for (u64 i = 0; i < n; i++) q->order[i] = a[i].index;
+
+    a.trash();
+    b.trash();
+}
+
+static bool render_same_params(const RenderCommand* a, const RenderCommand* b) {
+    return a->apply == b->apply && a->state == b->state && a->params[0] == b->params[0] && a->params[1] == b->params[1];
+}
+
+static bool render_same_state(const RenderCommand* a, const RenderCommand* b) {
+    return a->shader == b->shader && a->texture == b->texture && a->vao == b->vao && a->mode == b->mode && a->indexed == b->indexed && render_same_params(a, b);
+}
+
+void render_queue_merge(RenderQueue* q) {
+    PROFILE_FUNC();
+
+    q->draws.len = 0;
+    q->firsts.len = 0;
+    q->counts.len = 0;
+    q->stats = {};
+    q->stats.commands = (u32)q->commands.len;
+
+    const RenderCommand* prev = nullptr;
+    u32 shader = 0, texture = (u32)-1;
+    for (u64 i = 0; i < q->order.len; i++) {
+        const RenderCommand* cmd = &q->commands[q->order[i]];
+
+        u64 last = q->firsts.len - 1;
+        bool touching = prev && q->firsts[last] + q->counts[last] == cmd->first;
+        if (prev && render_same_state(prev, cmd) && (touching || !cmd->indexed)) {
+            RenderDraw& draw = q->draws[q->draws.len - 1];
+            if (touching) {
+                q->counts[last] += cmd->count;  // 顶点相接
+            } else {
+                q->firsts.push(cmd->first);
+                q->counts.push(cmd->count);
+                draw.range_count++;
+            }
+        } else {
+            q->draws.push(RenderDraw{(u32)i, (u32)q->firsts.len, 1});
+            q->firsts.push(cmd->first);
+            q->counts.push(cmd->count);
+
+            if (cmd->shader != shader) {
+                shader = cmd->shader;
+                q->stats.shader_binds++;
+            }
+            if (cmd->texture != texture) {
+                texture = cmd->texture;
+                q->stats.texture_binds++;
+            }
+        }
+        prev = cmd;
+    }
+
+    q->stats.draws = (u32)q->draws.len;
+    q->stats.ranges = (u32)q->firsts.len;
+}
+
+void render_queue_execute(RenderQueue* q) {
+    PROFILE_FUNC();
+
+    u32 shader = 0, texture = (u32)-1, vao = (u32)-1;
+    const RenderCommand* applied = nullptr;  // 程序的 uniform 已是这些参数
+
+    for (u64 i = 0; i < q->draws.len; i++) {
+        const RenderDraw& draw = q->draws[i];
+        const RenderCommand* cmd = &q->commands[q->order[draw.command]];
+
+        if (cmd->shader != shader) {
+            shader = cmd->shader;
+            glUseProgram(shader);
+            applied = nullptr;
+        }
+        if (cmd->texture != texture) {
+            texture = cmd->texture;
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+        }
+        if (cmd->vao != vao) {
+            vao = cmd->vao;
+            glBindVertexArray(vao);
+        }
+        if (cmd->apply && !(applied && render_same_params(applied, cmd))) {
+            cmd->apply(cmd);
+            applied = cmd;
+        }
+
+        if (draw.range_count == 1) {
+            render_draw_range(cmd, q->firsts[draw.range_begin], q->counts[draw.range_begin]);
+        } else {
+            glMultiDrawArrays(cmd->mode, q->firsts.data + draw.range_begin, q->counts.data + draw.range_begin, draw.range_count);
+        }
+        gfx_frame_stats().draws++;
+    }
+
+    glBindVertexArray(0);
+}
+
+void render_queue_clear(RenderQueue* q) {
+    q->commands.len = 0;
+    q->order.len = 0;
+    q->draws.len = 0;
+    q->firsts.len = 0;
+    q->counts.len = 0;
+}
+
+void render_queue_flush(RenderQueue* q) {
+    if (q->commands.len == 0) return;
+
+    render_queue_sort(q);
+    render_queue_merge(q);
+    render_queue_execute(q);
+    render_queue_clear(q);
+}
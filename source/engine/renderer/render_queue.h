@@ -0,0 +1,79 @@
+#pragma once
+
+#include "base/common/array.hpp"
+#include "base/common/base.hpp"
+#include "engine/graphics.h"
+
+// 渲染命令队列
+// 子系统提交带 64 位排序键的命令 在提交点按键稳定排序 再把状态相同的相邻命令合并为一次绘制
+// 键从高位到低位: 层 (8) | 着色器 (16) | 纹理 (16) | 深度 (24)
+// 同一层内按纹理分组 会打乱提交顺序 所以只有用 render_queue_set_layer_sorted 开启的层才进入队列
+// 这些层只应放互不重叠的内容 其余层的命令在提交时立即绘制 与直接绘制的子系统保持原来的先后
+// 背景段的层由图块地图开启 每个图块层占一层 (见 Tiled::tiled_draw_all)
+// 排序与合并不调用 GL 只有 render_queue_execute 提交绘制
+
+using RenderKey = u64;
+
+enum RenderLayer : u8 {
+    RenderLayer_Background = 0,
+    RenderLayer_World = 64,
+    RenderLayer_Overlay = 128,
+    RenderLayer_Debug = 192,
+    RenderLayer_BackgroundCount = RenderLayer_World - RenderLayer_Background,
+};
+
+inline RenderKey render_key(u8 layer, u32 shader, u32 texture, u32 depth) {
+    return ((u64)layer << 56) | ((u64)(shader & 0xffff) << 40) | ((u64)(texture & 0xffff) << 24) | (u64)(depth & 0xffffff);
+}
+
+struct RenderCommand;
+typedef void (*RenderApplyFn)(const RenderCommand* cmd);  // 设置着色器的其余 uniform
+
+struct RenderCommand {
+    RenderKey key;
+    u32 shader;
+    u32 texture;  // 绑定到单元 0
+    u32 vao;
+    u32 mode;      // GL_TRIANGLES 等
+    bool indexed;  // 用 vao 中的 u32 索引绘制 first count 为索引
+    i32 first;     // 顶点
+    i32 count;
+    RenderApplyFn apply;
+    u32 state;      // apply 使用的参数 与 params 一起相同才合并
+    f32 params[2];
+};
+
+// 合并后的一次绘制 ranges 多于一段时用 glMultiDrawArrays 索引绘制只合并相接的范围
+struct RenderDraw {
+    u32 command;  // 排序后第一个命令的下标
+    u32 range_begin;
+    u32 range_count;
+};
+
+struct RenderQueueStats {
+    u32 commands;
+    u32 draws;
+    u32 ranges;
+    u32 shader_binds;
+    u32 texture_binds;
+};
+
+struct RenderQueue {
+    u64 sorted_layers[4];  // 按状态排序的层 每层一位
+    Array<RenderCommand> commands;
+    Array<u32> order;  // 排序后的命令下标
+    Array<RenderDraw> draws;
+    Array<i32> firsts;
+    Array<i32> counts;
+    RenderQueueStats stats;  // 上一次 flush
+};
+
+void render_queue_trash(RenderQueue* q);
+void render_queue_set_layer_sorted(RenderQueue* q, u8 layer, bool sorted);
+bool render_queue_layer_sorted(const RenderQueue* q, u8 layer);
+void render_queue_submit(RenderQueue* q, const RenderCommand& cmd);  // 层未开启排序时立即绘制
+void render_queue_sort(RenderQueue* q);   // LSD 基数排序 键相同时保持提交顺序
+void render_queue_merge(RenderQueue* q);  // 由 order 生成 draws 并统计状态切换
+void render_queue_execute(RenderQueue* q);
+void render_queue_clear(RenderQueue* q);
+void render_queue_flush(RenderQueue* q);  // sort merge execute clear
@@ -5,7 +5,9 @@
 #include "base/common/mem.hpp"
 #include "engine/bootstrap.h"
 #include "engine/graphics.h"
+#include "engine/renderer/gfx_null.h"
 #include "engine/renderer/texture.h"
+#include "engine/renderer/texture_atlas.h"
 #include "engine/base/common/profiler.hpp"
 
 #include <assert.h>
@@ -214,10 +216,12 @@ void VertexBuffer::draw_vb_n(u32 count) const {
     glDrawElements(draw_type, count, GL_UNSIGNED_INT, 0);
 }
 
-#define batch_size 100
+#define batch_size 2048
 #define els_per_vert 11
 #define verts_per_quad 4
 #define indices_per_quad 6
+#define quad_bytes (els_per_vert * verts_per_quad * sizeof(f32))
+#define batches_per_segment 4
 
 Color256 make_color(u32 rgb, u8 alpha) { return Color256{(u8)((rgb >> 16) & 0xFF), (u8)((rgb >> 8) & 0xFF), (u8)(rgb & 0xff), alpha}; }
 
@@ -228,10 +232,29 @@ void QuadRenderer::new_renderer(AssetShader shader, vec2 dimentions) {
 
     this->ambient_light = 1.0f;
 
+    this->light_count = 0;
+    this->lights_dirty = true;
+
     this->vb.init_vb(vb_dynamic | vb_tris);
+    streambuffer_init(&this->stream, quad_bytes * batch_size * batches_per_segment);
+    this->mapped = NULL;
+
+    // 每批的索引相同 只上传一次 绘制时用 basevertex 指向本批在 stream 中的顶点
+    u32* indices = (u32*)mem_alloc(indices_per_quad * batch_size * sizeof(u32));
+    for (u32 i = 0; i < batch_size; i++) {
+        const u32 idx_off = i * verts_per_quad;
+        u32* dst = indices + i * indices_per_quad;
+        dst[0] = idx_off + 3;
+        dst[1] = idx_off + 2;
+        dst[2] = idx_off + 1;
+        dst[3] = idx_off + 3;
+        dst[4] = idx_off + 1;
+        dst[5] = idx_off + 0;
+    }
+
     this->vb.bind_vb_for_edit(true);
-    this->vb.push_vertices(NULL, els_per_vert * verts_per_quad * batch_size);
-    this->vb.push_indices(NULL, indices_per_quad * batch_size);
+    glBindBuffer(GL_ARRAY_BUFFER, this->stream.vbo);
+    this->vb.push_indices(indices, indices_per_quad * batch_size);
     this->vb.configure_vb(0, 2, els_per_vert, 0);  /* vec2 position */
     this->vb.configure_vb(1, 2, els_per_vert, 2);  /* vec2 uv */
     this->vb.configure_vb(2, 4, els_per_vert, 4);  /* vec4 color */
@@ -240,6 +263,8 @@ void QuadRenderer::new_renderer(AssetShader shader, vec2 dimentions) {
     this->vb.configure_vb(5, 1, els_per_vert, 10); /* f32 unlit */
     this->vb.bind_vb_for_edit(NULL);
 
+    mem_free(indices);
+
     this->clip_enable = false;
     this->camera_enable = false;
 
@@ -253,7 +278,10 @@ void QuadRenderer::new_renderer(AssetShader shader, vec2 dimentions) {
     neko_bind_shader(NULL);
 }
 
-void QuadRenderer::free_renderer() { this->vb.fini_vb(); }
+void QuadRenderer::free_renderer() {
+    streambuffer_fini(&this->stream);
+    this->vb.fini_vb();
+}
 
 void QuadRenderer::renderer_flush() {
     if (this->quad_count == 0) {
@@ -278,21 +306,12 @@ void QuadRenderer::renderer_flush() {
         neko_shader_set_int(this->shader.id, name, i);
     }
 
-    for (u32 i = 0; i < this->light_count; i++) {
-        char name[64];
-
-        sprintf(name, "lights[%u].position", i);
-        neko_shader_set_v2f(this->shader.id, name, this->lights[i].position);
-
-        sprintf(name, "lights[%u].intensity", i);
-        neko_shader_set_float(this->shader.id, name, this->lights[i].intensity);
-
-        sprintf(name, "lights[%u].range", i);
-        neko_shader_set_float(this->shader.id, name, this->lights[i].range);
+    Renderer& renderer = the<Renderer>();
+    if (this->lights_dirty || renderer.lights_owner != this) {
+        renderer.UpdateLights(this, this->lights, this->light_count);
+        this->lights_dirty = false;
     }
 
-    neko_shader_set_int(this->shader.id, "light_count", this->light_count);
-
     neko_shader_set_m4f(this->shader.id, "camera", this->camera);
     neko_shader_set_float(this->shader.id, "ambient_light", this->ambient_light);
 
@@ -303,14 +322,13 @@ void QuadRenderer::renderer_flush() {
         neko_shader_set_m4f(this->shader.id, "view", mat4_identity());
     }
 
-    this->vb.bind_vb_for_edit(true);
-    this->vb.update_vertices(this->verts, 0, this->quad_count * els_per_vert * verts_per_quad);
-    this->vb.update_indices(this->indices, 0, this->quad_count * indices_per_quad);
-    this->vb.bind_vb_for_edit(false);
+    const size_t offset = streambuffer_unmap(&this->stream, this->quad_count * quad_bytes);
+    this->mapped = NULL;
 
     this->vb.bind_vb_for_draw(true);
-    this->vb.draw_vb_n(this->quad_count * indices_per_quad);
+    glDrawElementsBaseVertex(GL_TRIANGLES, this->quad_count * indices_per_quad, GL_UNSIGNED_INT, 0, (GLint)(offset / (els_per_vert * sizeof(f32))));
     this->vb.bind_vb_for_draw(false);
+    gfx_frame_stats().draws++;
     neko_bind_shader(NULL);
 
     this->quad_count = 0;
@@ -321,16 +339,21 @@ void QuadRenderer::renderer_flush() {
 
 void QuadRenderer::renderer_end_frame() {
     renderer_flush();
-    this->light_count = 0;
+    if (this->light_count > 0) {
+        this->light_count = 0;
+        this->lights_dirty = true;
+    }
+    streambuffer_nextframe(&this->stream);
 }
 
 void QuadRenderer::renderer_push_light(struct light light) {
-    if (this->light_count > max_lights) {
+    if (this->light_count >= max_lights) {
         fprintf(stderr, "Too many lights! Max: %d\n", max_lights);
         return;
     }
 
     this->lights[this->light_count++] = light;
+    this->lights_dirty = true;
 }
 
 void QuadRenderer::renderer_push(TexturedQuad* quad) {
@@ -338,15 +361,21 @@ void QuadRenderer::renderer_push(TexturedQuad* quad) {
 
     i32 tidx = -1;
     if (quad->texture) {
+        // 在图集中的纹理换成所在的页 rect 仍按源纹理给出
+        AssetTexture* texture = quad->texture;
+        TextureAtlasRegion region;
+        bool atlased = texture_atlas_find(&texture_atlas(), texture->id, &region);
+        if (atlased) texture = region.page;
+
         for (u32 i = 0; i < this->texture_count; i++) {
-            if (this->textures[i] == quad->texture) {
+            if (this->textures[i] == texture) {
                 tidx = (i32)i;
                 break;
             }
         }
 
         if (tidx == -1) {
-            this->textures[this->texture_count] = quad->texture;
+            this->textures[this->texture_count] = texture;
             tidx = this->texture_count;
 
             this->texture_count++;
@@ -354,7 +383,7 @@ void QuadRenderer::renderer_push(TexturedQuad* quad) {
             if (this->texture_count >= 32) {
                 renderer_flush();
                 tidx = 0;
-                this->textures[0] = quad->texture;
+                this->textures[0] = texture;
             }
         }
 
@@ -362,6 +391,13 @@ void QuadRenderer::renderer_push(TexturedQuad* quad) {
         ty = (f32)quad->rect.y / (f32)quad->texture->height;
         tw = (f32)quad->rect.w / (f32)quad->texture->width;
         th = (f32)quad->rect.h / (f32)quad->texture->height;
+
+        if (atlased) {
+            tx = region.u0 + tx * (region.u1 - region.u0);
+            ty = region.v0 + ty * (region.v1 - region.v0);
+            tw *= region.u1 - region.u0;
+            th *= region.v1 - region.v0;
+        }
     }
 
     const f32 r = (f32)quad->color.r / 255.0f;
@@ -396,12 +432,12 @@ void QuadRenderer::renderer_push(TexturedQuad* quad) {
             p0.x, p0.y, tx,      ty,      r, g, b, a, (f32)tidx, (f32)quad->inverted, (f32)quad->unlit, p1.x, p1.y, tx + tw, ty,      r, g, b, a, (f32)tidx, (f32)quad->inverted, (f32)quad->unlit,
             p2.x, p2.y, tx + tw, ty + th, r, g, b, a, (f32)tidx, (f32)quad->inverted, (f32)quad->unlit, p3.x, p3.y, tx,      ty + th, r, g, b, a, (f32)tidx, (f32)quad->inverted, (f32)quad->unlit};
 
-    const u32 idx_off = this->quad_count * verts_per_quad;
-
-    u32 indices[] = {idx_off + 3, idx_off + 2, idx_off + 1, idx_off + 3, idx_off + 1, idx_off + 0};
+    // 批次开始时预留整批的空间 之后直接写入 stream
+    if (this->mapped == NULL) {
+        this->mapped = (f32*)streambuffer_map(&this->stream, quad_bytes * batch_size);
+    }
 
-    memcpy(this->verts + (this->quad_count * els_per_vert * verts_per_quad), verts, els_per_vert * verts_per_quad * sizeof(f32));
-    memcpy(this->indices + (this->quad_count * indices_per_quad), indices, indices_per_quad * sizeof(u32));
+    memcpy(this->mapped + (this->quad_count * els_per_vert * verts_per_quad), verts, quad_bytes);
 
     this->quad_count++;
 
@@ -601,10 +637,13 @@ void PostProcessor::Resize(vec2 dimentions) {
 void PostProcessor::post_processor_fit_to_main_window() { Resize(neko_v2(the<CL>().state.width, the<CL>().state.height)); }
 
 void PostProcessor::FlushTarget(RenderTarget& rt, std::function<void(AssetShader&)> op) {
+    rt.bind_output(0);
+    Draw(op);
+}
 
-    AssetShader& shader = assets_get<AssetShader>(shader_asset);
+void PostProcessor::Draw(std::function<void(AssetShader&)> op) {
 
-    rt.bind_output(0);
+    AssetShader& shader = assets_get<AssetShader>(shader_asset);
 
     neko_bind_shader(shader.id);
 
@@ -612,7 +651,7 @@ void PostProcessor::FlushTarget(RenderTarget& rt, std::function<void(AssetShader
 
     std::invoke(op, shader);
 
-    GLint screenTextureLocation = glGetUniformLocation(shader.id, "NekoTextureInput");
+    GLint screenTextureLocation = neko_shader_uniform(shader.id, "NekoTextureInput");
     if (screenTextureLocation == -1) {
         // wtf
     }
@@ -640,8 +679,10 @@ extern "C" int GLAD_GL_ARB_direct_state_access;
 void Renderer::InitOpenGL() {
     PROFILE_FUNC();
 
-    // initialize GLEW
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    if (gfx_backend() == GfxBackend_Null) {
+        gfx_null_install();
+        LOG_INFO("renderer using null graphics backend");
+    } else if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {  // initialize GLEW
         LOG_INFO("Failed to initialize GLAD");
     }
 
@@ -666,4 +707,53 @@ void Renderer::InitOpenGL() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glDisable(GL_DEPTH_TEST);
     glClearColor(NEKO_COL255(28.f), NEKO_COL255(28.f), NEKO_COL255(28.f), 1.f);
+
+    // 共享的 uniform 块 绑定点在程序的整个生命周期内不变
+    const GLsizeiptr block_sizes[UniformBlock_Count] = {sizeof(FrameConstants), sizeof(LightConstants)};
+    glGenBuffers(UniformBlock_Count, uniform_blocks);
+    for (u32 i = 0; i < UniformBlock_Count; i++) {
+        glBindBuffer(GL_UNIFORM_BUFFER, uniform_blocks[i]);
+        glBufferData(GL_UNIFORM_BUFFER, block_sizes[i], NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, i, uniform_blocks[i]);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Renderer::FiniOpenGL() {
+    render_queue_trash(&queue);
+    texture_atlas_trash(&texture_atlas());
+    glDeleteBuffers(UniformBlock_Count, uniform_blocks);
+    memset(uniform_blocks, 0, sizeof(uniform_blocks));
+}
+
+static_assert(sizeof(FrameConstants) == 64, "NekoFrame std140");
+static_assert(sizeof(struct light) == 16 && offsetof(LightConstants, light_count) == 16 * max_lights, "NekoLights std140");
+static_assert(offsetof(struct light, range) == 8 && offsetof(struct light, intensity) == 12, "NekoLights member order");
+
+void Renderer::UpdateFrameConstants(mat3 inverse_view, vec2 screen_size, f32 time) {
+    FrameConstants frame = {};
+    for (i32 c = 0; c < 3; c++) {
+        for (i32 r = 0; r < 3; r++) {
+            frame.inverse_view_matrix[c * 4 + r] = inverse_view.v[c * 3 + r];
+        }
+    }
+    frame.screen_size = screen_size;
+    frame.time = time;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, uniform_blocks[UniformBlock_Frame]);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Renderer::UpdateLights(const QuadRenderer* owner, const struct light* lights, u32 count) {
+    // 只上传用到的部分和 light_count
+    glBindBuffer(GL_UNIFORM_BUFFER, uniform_blocks[UniformBlock_Lights]);
+    if (count > 0) {
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(struct light) * count, lights);
+    }
+    i32 light_count = (i32)count;
+    glBufferSubData(GL_UNIFORM_BUFFER, offsetof(LightConstants, light_count), sizeof(i32), &light_count);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    lights_owner = owner;
 }
@@ -5,6 +5,7 @@
 #include "base/common/color.hpp"
 #include "base/common/math.hpp"
 #include "base/common/singleton.hpp"
+#include "engine/renderer/render_queue.h"
 #include "engine/renderer/shader.h"
 #include "engine/asset.h"
 
@@ -98,6 +99,7 @@ struct TexturedQuad {
     f32 rotation;
 };
 
+// 与 sprite2.glsl 的 struct light 成员顺序一致 直接复制进 NekoLights
 struct light {
     vec2 position;
     f32 range;
@@ -106,7 +108,9 @@ struct light {
 
 struct QuadRenderer {
     AssetShader shader;
-    VertexBuffer vb;
+    VertexBuffer vb;      // 顶点数组与静态索引
+    StreamBuffer stream;  // 顶点数据
+    f32* mapped;          // 本批在 stream 中的写入位置 批次开始前为 NULL
 
     u32 quad_count;
 
@@ -128,9 +132,7 @@ struct QuadRenderer {
 
     struct light lights[max_lights];
     u32 light_count;
-
-    f32 verts[100 * 11 * 4];
-    u32 indices[100 * 6];
+    bool lights_dirty;  // 下一次提交时更新 NekoLights
 
     void new_renderer(AssetShader shader, vec2 dimentions);
     void free_renderer();
@@ -155,15 +157,40 @@ struct PostProcessor {
     void Resize(vec2 dimentions);
     void post_processor_fit_to_main_window();
     void FlushTarget(RenderTarget& target, std::function<void(AssetShader&)> op);
+    void Draw(std::function<void(AssetShader&)> op);  // 输入已绑定到纹理单元 0
     void Flush(std::function<void(AssetShader&)> op);
 
     inline RenderTarget& GetRenderTarget() { return target; }
 };
 
+// 与着色器中的 std140 布局一致
+struct FrameConstants {
+    f32 inverse_view_matrix[12];  // mat3 每列占一个 vec4
+    vec2 screen_size;
+    f32 time;  // 秒
+    f32 pad;
+};
+
+struct LightConstants {
+    struct light lights[max_lights];  // 每个元素 16 字节
+    i32 light_count;
+    i32 pad[3];
+};
+
 class Renderer : public Neko::SingletonClass<Renderer> {
 public:
     bool EnableDSA{};
 
+    GLuint uniform_blocks[UniformBlock_Count]{};
+    const QuadRenderer* lights_owner{};  // 最近上传光源的渲染器
+
+    RenderQueue queue{};
+
 public:
     void InitOpenGL();
+    void FiniOpenGL();
+
+    // 每帧开始时更新一次 之后所有声明了 NekoFrame 的着色器共用
+    void UpdateFrameConstants(mat3 inverse_view, vec2 screen_size, f32 time);
+    void UpdateLights(const QuadRenderer* owner, const struct light* lights, u32 count);
 };
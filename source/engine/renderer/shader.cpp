@@ -1,6 +1,7 @@
 
 #include "shader.h"
 
+#include "base/common/hashmap.hpp"
 #include "base/common/util.hpp"
 #include "base/common/logger.hpp"
 #include "base/common/vfs.hpp"
@@ -108,6 +109,8 @@ bool neko_init_shader(AssetShader* shader, char* source) {
     glGetProgramiv(id, GL_LINK_STATUS, &success);
     if (!success) {
         shader->panic_mode = true;
+    } else {
+        neko_shader_reflect(id);
     }
 
     glDeleteShader(v);
@@ -124,6 +127,7 @@ bool neko_init_shader(AssetShader* shader, char* source) {
 void neko_unload_shader(AssetShader* shader) {
     neko_assert(shader);
     if (shader->panic_mode) return;
+    neko_shader_forget(shader->id);
     glDeleteProgram(shader->id);
 }
 
@@ -141,23 +145,108 @@ bool neko_load_shader(AssetShader* shader, String path) {
     return ok;
 }
 
+// 程序 id -> (名字哈希 -> 位置)
+// 程序删除后只清空内层表 不从外层移除 程序 id 会被 GL 重用
+static HashMap<HashMap<GLint>> g_uniforms;
+static u32 g_uniforms_last_program;
+static HashMap<GLint>* g_uniforms_last;
+
+static HashMap<GLint>* shader_uniform_table(u32 shader) {
+    if (shader == g_uniforms_last_program && g_uniforms_last) {
+        return g_uniforms_last;
+    }
+
+    HashMap<GLint>* table = nullptr;
+    g_uniforms.find_or_insert(shader, &table);  // 外层可能扩容 之前取得的指针失效
+
+    g_uniforms_last_program = shader;
+    g_uniforms_last = table;
+    return table;
+}
+
+static const char* g_uniform_block_names[UniformBlock_Count] = {"NekoFrame", "NekoLights"};
+
+void neko_shader_reflect(u32 shader) {
+    for (u32 i = 0; i < UniformBlock_Count; i++) {
+        GLuint index = glGetUniformBlockIndex(shader, g_uniform_block_names[i]);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(shader, index, i);
+        }
+    }
+
+    HashMap<GLint>* table = shader_uniform_table(shader);
+    if (table->load > 0) {
+        table->clear();
+    }
+
+    GLint count = 0;
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORMS, &count);
+
+    char name[256];
+    for (GLint i = 0; i < count; i++) {
+        GLsizei len = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shader, (GLuint)i, sizeof(name), &len, &size, &type, name);
+
+        GLint location = glGetUniformLocation(shader, name);
+        if (location < 0) {
+            continue;  // uniform block 中的成员
+        }
+
+        (*table)[fnv1a(name, len)] = location;
+
+        // 数组只列出第一个元素 "a[0]" 展开其余元素 并让 "a" 指向第一个元素
+        if (len > 3 && strcmp(name + len - 3, "[0]") == 0) {
+            const i32 base = len - 3;
+            (*table)[fnv1a(name, base)] = location;
+
+            for (GLint j = 1; j < size && base + 16 < (i32)sizeof(name); j++) {
+                i32 n = snprintf(name + base, sizeof(name) - base, "[%d]", j);
+                (*table)[fnv1a(name, base + n)] = glGetUniformLocation(shader, name);
+            }
+        }
+    }
+}
+
+void neko_shader_forget(u32 shader) {
+    HashMap<GLint>* table = g_uniforms.get(shader);
+    if (table && table->load > 0) {
+        table->clear();
+    }
+}
+
+GLint neko_shader_uniform(u32 shader, const char* name) {
+    if (shader == 0) {
+        return -1;
+    }
+
+    HashMap<GLint>* table = shader_uniform_table(shader);
+
+    GLint* location = nullptr;
+    if (!table->find_or_insert(fnv1a(name, strlen(name)), &location)) {
+        *location = glGetUniformLocation(shader, name);  // 未反射的程序或不存在的名字
+    }
+    return *location;
+}
+
 void neko_bind_shader(u32 shader) { glUseProgram(shader); }
 
 void neko_shader_set_int(u32 shader, const char* name, i32 v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniform1i(location, v);
 }
 
 void neko_shader_set_uint(u32 shader, const char* name, u32 v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniform1ui(location, v);
 }
 
 void neko_shader_set_float(u32 shader, const char* name, float v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniform1f(location, v);
 }
 
@@ -172,25 +261,25 @@ void neko_shader_set_rgb_color(u32 shader, const char* name, Color color) { neko
 
 void neko_shader_set_v2f(u32 shader, const char* name, vec2 v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniform2f(location, v.x, v.y);
 }
 
 void neko_shader_set_v3f(u32 shader, const char* name, vec3 v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniform3f(location, v.x, v.y, v.z);
 }
 
 void neko_shader_set_v4f(u32 shader, const char* name, vec4 v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniform4f(location, v.x, v.y, v.z, v.w);
 }
 
 void neko_shader_set_m4f(u32 shader, const char* name, mat4 v) {
 
-    u32 location = glGetUniformLocation(shader, name);
+    GLint location = neko_shader_uniform(shader, name);
     glUniformMatrix4fv(location, 1, GL_FALSE, (float*)v.elements);
 }
 
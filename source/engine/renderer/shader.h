@@ -22,6 +22,19 @@ namespace shader {
 std::unordered_map<std::string, std::string> ShaderParse(String src);
 }
 
+// 共享的 uniform 块 着色器中以 std140 声明 链接后绑定到固定的绑定点
+enum UniformBlock {
+    UniformBlock_Frame,   // NekoFrame 每帧的摄像机 屏幕大小 时间
+    UniformBlock_Lights,  // NekoLights 光源列表
+    UniformBlock_Count,
+};
+
+// uniform 位置缓存 按程序 id 分表 键为名字的 fnv1a
+// 程序链接后通过反射填入所有活动的 uniform (数组展开到每个元素) 表中没有的名字首次查询后缓存 (包括 -1)
+void neko_shader_reflect(u32 shader);
+void neko_shader_forget(u32 shader);
+NEKO_API() GLint neko_shader_uniform(u32 shader, const char* name);
+
 NEKO_API() void neko_bind_shader(u32 shader);
 NEKO_API() void neko_shader_set_int(u32 shader, const char* name, i32 v);
 NEKO_API() void neko_shader_set_uint(u32 shader, const char* name, u32 v);
@@ -2,6 +2,7 @@
 #include "texture.h"
 
 #include "engine/renderer/renderer.h"
+#include "engine/renderer/texture_atlas.h"
 #include "engine/graphics.h"
 #include "base/common/vfs.hpp"
 #include "base/common/logger.hpp"
@@ -64,8 +65,11 @@ struct texture_create_impl<1> {
         {
             LockGuard<Mutex> lock(gBase.gpu_mtx);
 
-            // 如果存在 则释放旧的 GL 纹理
-            if (tex->id != 0) glDeleteTextures(1, &tex->id);
+            // 如果存在 则释放旧的 GL 纹理 图集中的记录留到新句柄生成后转过去
+            u32 old_id = tex->id;
+            if (tex->id != 0) {
+                glDeleteTextures(1, &tex->id);
+            }
 
             u32 alias_mode = GL_NEAREST;
             if (tex->flags & TEXTURE_LINEAR) {
@@ -88,6 +92,7 @@ struct texture_create_impl<1> {
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, alias_mode);
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, alias_mode);
             }
+            if (old_id != 0) texture_atlas_rekey(&texture_atlas(), old_id, tex->id);
 
             if (tex->flip_image_vertical) {
                 _flip_image_vertical(data, tex->width, tex->height);
@@ -119,6 +124,9 @@ struct texture_create_impl<1> {
 
                 glBindTexture(GL_TEXTURE_2D, 0);
             }
+
+            // 小纹理同时复制进图集 热重载时在这里原位更新或换位置
+            texture_atlas_put(&texture_atlas(), tex->id, tex->width, tex->height, tex->components, tex->flags, data);
         }
 
         return true;
@@ -302,6 +310,7 @@ bool texture_create(AssetTexture* tex, u8* data, u32 width, u32 height, u32 num_
 
 void texture_release(AssetTexture* texture) {
     assert(texture);
+    texture_atlas_remove(&texture_atlas(), texture->id);
     glDeleteTextures(1, &texture->id);
 }
 
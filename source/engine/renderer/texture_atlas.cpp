@@ -0,0 +1,302 @@
+#include "engine/renderer/texture_atlas.h"
+
+#include "base/common/profiler.hpp"
+#include "engine/graphics.h"
+#include "engine/renderer/renderer.h"
+
+static TextureAtlas g_texture_atlas = {.enabled = true};
+
+TextureAtlas& texture_atlas() { return g_texture_atlas; }
+
+static void atlas_upload(AssetTexture* tex, TextureAtlasRect r, const u8* rgba) {
+    if (the<Renderer>().EnableDSA) [[likely]] {
+        glTextureSubImage2D(tex->id, 0, r.x, r.y, r.w, r.h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    } else {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, tex->id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r.x, r.y, r.w, r.h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+static bool atlas_page_create(TextureAtlas* a) {
+    if (a->page_count == TEXTURE_ATLAS_MAX_PAGES) return false;
+
+    TextureAtlasPage& page = a->pages[a->page_count++];
+    page = {};
+    page.tex.width = page.tex.height = TEXTURE_ATLAS_PAGE_SIZE;
+    page.tex.components = 4;
+    page.tex.flags = TEXTURE_ALIASED;
+
+    const u64 bytes = (u64)TEXTURE_ATLAS_PAGE_SIZE * TEXTURE_ATLAS_PAGE_SIZE * 4;
+    u8* zeros = (u8*)mem_alloc(bytes);
+    memset(zeros, 0, bytes);
+
+    if (the<Renderer>().EnableDSA) [[likely]] {
+        glCreateTextures(GL_TEXTURE_2D, 1, &page.tex.id);
+        glTextureParameteri(page.tex.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(page.tex.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(page.tex.id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(page.tex.id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureStorage2D(page.tex.id, 1, GL_RGBA8, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE);
+        glTextureSubImage2D(page.tex.id, 0, 0, 0, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, zeros);
+    } else {
+        glGenTextures(1, &page.tex.id);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, page.tex.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, zeros);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    mem_free(zeros);
+
+    page.nodes = (stbrp_node*)mem_alloc(sizeof(stbrp_node) * TEXTURE_ATLAS_PAGE_SIZE);
+    stbrp_init_target(&page.packer, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, page.nodes, TEXTURE_ATLAS_PAGE_SIZE);
+
+    a->stats.pages++;
+    a->stats.page_bytes += bytes;
+    return true;
+}
+
+static bool atlas_pack(TextureAtlasPage& page, u32 w, u32 h, TextureAtlasRect* rect) {
+    stbrp_rect r = {};
+    r.w = (stbrp_coord)w;
+    r.h = (stbrp_coord)h;
+    if (!stbrp_pack_rects(&page.packer, &r, 1)) return false;
+    *rect = TextureAtlasRect{(u32)r.x, (u32)r.y, w, h};
+    return true;
+}
+
+// 先找最合适的空闲位置 再依次往各页中放入 最后开新页
+static bool atlas_alloc(TextureAtlas* a, u32 w, u32 h, u32* page_index, TextureAtlasRect* rect) {
+    i32 best_page = -1;
+    u64 best_free = 0;
+    u32 best_area = 0;
+    for (u32 p = 0; p < a->page_count; p++) {
+        TextureAtlasPage& page = a->pages[p];
+        for (u64 i = 0; i < page.free.len; i++) {
+            TextureAtlasRect& r = page.free[i];
+            if (r.w < w || r.h < h) continue;
+            if (best_page < 0 || r.w * r.h < best_area) {
+                best_page = (i32)p;
+                best_free = i;
+                best_area = r.w * r.h;
+            }
+        }
+    }
+    if (best_page >= 0) {
+        TextureAtlasPage& page = a->pages[best_page];
+        *rect = page.free[best_free];
+        page.free.quick_remove(best_free);
+        page.dead_area -= best_area;
+        page.used_area += best_area;
+        *page_index = (u32)best_page;
+        return true;
+    }
+
+    for (u32 p = 0; p <= a->page_count; p++) {
+        if (p == a->page_count && !atlas_page_create(a)) return false;
+        if (atlas_pack(a->pages[p], w, h, rect)) {
+            a->pages[p].used_area += w * h;
+            *page_index = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 整个位置连同 padding 一起上传 复用的位置中残留的像素也被清掉
+static void atlas_upload_entry(TextureAtlas* a, TextureAtlasEntry& e) {
+    const TextureAtlasRect& r = e.rect;
+    u8* staging = (u8*)mem_alloc((u64)r.w * r.h * 4);
+    memset(staging, 0, (u64)r.w * r.h * 4);
+    for (u32 y = 0; y < e.height; y++) {
+        memcpy(staging + ((u64)(y + TEXTURE_ATLAS_PADDING) * r.w + TEXTURE_ATLAS_PADDING) * 4, e.pixels + (u64)y * e.width * 4, (u64)e.width * 4);
+    }
+    atlas_upload(&a->pages[e.page].tex, r, staging);
+    mem_free(staging);
+
+    const f32 size = (f32)TEXTURE_ATLAS_PAGE_SIZE;
+    e.u0 = (f32)(r.x + TEXTURE_ATLAS_PADDING) / size;
+    e.v0 = (f32)(r.y + TEXTURE_ATLAS_PADDING) / size;
+    e.u1 = (f32)(r.x + TEXTURE_ATLAS_PADDING + e.width) / size;
+    e.v1 = (f32)(r.y + TEXTURE_ATLAS_PADDING + e.height) / size;
+}
+
+// 丢弃记录 源纹理之后直接使用
+static void atlas_drop(TextureAtlas* a, u64 index) {
+    TextureAtlasEntry& e = a->entries[index];
+    a->stats.entries--;
+    a->stats.used_bytes -= (u64)e.rect.w * e.rect.h * 4;
+    a->by_source[e.source] = 0;
+    mem_free(e.pixels);
+    e = {};
+}
+
+bool texture_atlas_put(TextureAtlas* atlas, u32 source, u32 width, u32 height, u32 num_comps, TextureFlags flags, const u8* data) {
+    PROFILE_FUNC();
+
+    if (source == 0) return false;
+
+    bool small = width > 0 && height > 0 && width <= TEXTURE_ATLAS_MAX_SIZE && height <= TEXTURE_ATLAS_MAX_SIZE;
+    if (!atlas->enabled || !data || !small || (num_comps != 3 && num_comps != 4) || (flags & TEXTURE_LINEAR)) {
+        texture_atlas_remove(atlas, source);
+        return false;
+    }
+
+    u8* pixels = (u8*)mem_alloc((u64)width * height * 4);
+    if (num_comps == 4) {
+        memcpy(pixels, data, (u64)width * height * 4);
+    } else {
+        for (u64 i = 0; i < (u64)width * height; i++) {
+            pixels[i * 4 + 0] = data[i * 3 + 0];
+            pixels[i * 4 + 1] = data[i * 3 + 1];
+            pixels[i * 4 + 2] = data[i * 3 + 2];
+            pixels[i * 4 + 3] = 255;
+        }
+    }
+
+    // 同样大小 原位更新
+    u32* index = atlas->by_source.get(source);
+    if (index && *index) {
+        TextureAtlasEntry& e = atlas->entries[*index - 1];
+        if (e.width == width && e.height == height) {
+            mem_free(e.pixels);
+            e.pixels = pixels;
+            atlas_upload_entry(atlas, e);
+            atlas->stats.updates++;
+            return true;
+        }
+    }
+    texture_atlas_remove(atlas, source);
+
+    TextureAtlasEntry e = {};
+    e.source = source;
+    e.width = width;
+    e.height = height;
+    e.pixels = pixels;
+    if (!atlas_alloc(atlas, width + 2 * TEXTURE_ATLAS_PADDING, height + 2 * TEXTURE_ATLAS_PADDING, &e.page, &e.rect)) {
+        mem_free(pixels);
+        atlas->stats.rejects++;
+        return false;
+    }
+
+    u64 slot = atlas->entries.len;
+    for (u64 i = 0; i < atlas->entries.len; i++) {
+        if (atlas->entries[i].source == 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == atlas->entries.len) atlas->entries.push({});
+    atlas->entries[slot] = e;
+    atlas->by_source[source] = (u32)slot + 1;
+
+    atlas_upload_entry(atlas, atlas->entries[slot]);
+
+    atlas->stats.packs++;
+    atlas->stats.entries++;
+    atlas->stats.used_bytes += (u64)e.rect.w * e.rect.h * 4;
+    return true;
+}
+
+void texture_atlas_remove(TextureAtlas* atlas, u32 source) {
+    u32* index = atlas->by_source.get(source);
+    if (!index || !*index) return;
+
+    TextureAtlasEntry& e = atlas->entries[*index - 1];
+    TextureAtlasPage& page = atlas->pages[e.page];
+    page.free.push(e.rect);
+    page.used_area -= e.rect.w * e.rect.h;
+    page.dead_area += e.rect.w * e.rect.h;
+
+    atlas_drop(atlas, *index - 1);
+}
+
+void texture_atlas_rekey(TextureAtlas* atlas, u32 from, u32 to) {
+    if (from == to) return;
+
+    u32* index = atlas->by_source.get(from);
+    if (!index || !*index) return;
+    u32 slot = *index;
+
+    texture_atlas_remove(atlas, to);  // 残留的记录
+    atlas->by_source[from] = 0;
+    atlas->by_source[to] = slot;
+    atlas->entries[slot - 1].source = to;
+}
+
+bool texture_atlas_find(TextureAtlas* atlas, u32 source, TextureAtlasRegion* region) {
+    if (!atlas->enabled || source == 0) return false;
+
+    u32* index = atlas->by_source.get(source);
+    if (!index || !*index) return false;
+
+    const TextureAtlasEntry& e = atlas->entries[*index - 1];
+    *region = TextureAtlasRegion{&atlas->pages[e.page].tex, e.u0, e.v0, e.u1, e.v1};
+    return true;
+}
+
+void texture_atlas_compact(TextureAtlas* atlas) {
+    PROFILE_FUNC();
+
+    for (u32 p = 0; p < atlas->page_count; p++) {
+        TextureAtlasPage& page = atlas->pages[p];
+        if (page.dead_area == 0 || page.dead_area < page.used_area) continue;  // 空闲不到一半
+
+        // 页中存活的记录一起重新放入 stb_rect_pack 内部按高度排序
+        Array<stbrp_rect> live = {};
+        for (u64 i = 0; i < atlas->entries.len; i++) {
+            TextureAtlasEntry& e = atlas->entries[i];
+            if (e.source == 0 || e.page != p) continue;
+            stbrp_rect r = {};
+            r.id = (int)i;
+            r.w = (stbrp_coord)(e.width + 2 * TEXTURE_ATLAS_PADDING);
+            r.h = (stbrp_coord)(e.height + 2 * TEXTURE_ATLAS_PADDING);
+            live.push(r);
+            atlas->stats.used_bytes -= (u64)e.rect.w * e.rect.h * 4;
+        }
+
+        stbrp_init_target(&page.packer, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, page.nodes, TEXTURE_ATLAS_PAGE_SIZE);
+        if (live.len) stbrp_pack_rects(&page.packer, live.data, (int)live.len);
+        page.free.len = 0;
+        page.used_area = 0;
+        page.dead_area = 0;
+
+        for (u64 i = 0; i < live.len; i++) {
+            stbrp_rect& r = live[i];
+            TextureAtlasEntry& e = atlas->entries[r.id];
+            e.rect = TextureAtlasRect{(u32)r.x, (u32)r.y, (u32)r.w, (u32)r.h};
+            atlas->stats.used_bytes += (u64)e.rect.w * e.rect.h * 4;
+            if (!r.was_packed) {
+                atlas_drop(atlas, r.id);
+                atlas->stats.rejects++;
+                continue;
+            }
+            page.used_area += e.rect.w * e.rect.h;
+            atlas_upload_entry(atlas, e);
+        }
+        live.trash();
+
+        atlas->stats.repacks++;
+    }
+}
+
+void texture_atlas_trash(TextureAtlas* atlas) {
+    for (u32 p = 0; p < atlas->page_count; p++) {
+        TextureAtlasPage& page = atlas->pages[p];
+        glDeleteTextures(1, &page.tex.id);
+        mem_free(page.nodes);
+        page.free.trash();
+    }
+    for (u64 i = 0; i < atlas->entries.len; i++) mem_free(atlas->entries[i].pixels);
+    atlas->entries.trash();
+    atlas->by_source.trash();
+
+    bool enabled = atlas->enabled;
+    *atlas = {};
+    atlas->enabled = enabled;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "base/common/array.hpp"
+#include "base/common/base.hpp"
+#include "base/common/hashmap.hpp"
+#include "engine/renderer/texture.h"
+
+// deps
+#include <stb_rect_pack.h>
+
+// 运行时纹理图集
+// 不大于 TEXTURE_ATLAS_MAX_SIZE 的 RGB/RGBA 最近邻纹理在创建时被复制进共享的图集页 (stb_rect_pack 的 skyline 装箱)
+// 源纹理保持不变 直接使用它的代码 (ImGui 图片 自定义着色器) 不受影响
+// Batch 与 QuadRenderer 用 texture_atlas_find 把源纹理换成所在的页 并把源纹理空间的 uv 映射到页中
+// 这样不同的小纹理可以在同一次绘制中提交
+// 热重载时同样大小的纹理原位更新 大小变化时释放旧位置 放入空闲位置或页的天际线
+// texture_atlas_compact 重新排列空闲面积过多的页 只在帧之间调用 (热重载之后)
+
+#define TEXTURE_ATLAS_PAGE_SIZE 1024
+#define TEXTURE_ATLAS_MAX_SIZE 256  // 宽高都不大于该值的纹理才放入图集
+#define TEXTURE_ATLAS_MAX_PAGES 8
+#define TEXTURE_ATLAS_PADDING 1  // 每边留出的透明像素 避免采样到相邻的纹理
+
+struct TextureAtlasRect {
+    u32 x, y, w, h;
+};
+
+struct TextureAtlasPage {
+    AssetTexture tex;
+    stbrp_context packer;  // 逐个放入 整理时重新初始化
+    stbrp_node* nodes;
+    Array<TextureAtlasRect> free;  // 被释放的位置 可以放入不大于它的纹理
+    u32 used_area;                 // 存活的位置 含 padding
+    u32 dead_area;                 // 被释放且还没有重新使用的位置
+};
+
+struct TextureAtlasEntry {
+    u32 source;  // 源纹理 0 为空位
+    u32 page;
+    TextureAtlasRect rect;  // 在页中的位置 含 padding
+    u32 width, height;      // 源纹理尺寸
+    f32 u0, v0, u1, v1;
+    u8* pixels;  // RGBA 副本 整理页面时重新上传
+};
+
+struct TextureAtlasRegion {
+    AssetTexture* page;
+    f32 u0, v0, u1, v1;
+};
+
+struct TextureAtlasStats {
+    u32 pages;
+    u32 entries;
+    u32 packs;    // 放入新位置
+    u32 updates;  // 原位更新
+    u32 repacks;  // 整理过的页
+    u32 rejects;  // 页满 留在源纹理上
+    u64 page_bytes;
+    u64 used_bytes;
+};
+
+struct TextureAtlas {
+    bool enabled;
+    TextureAtlasPage pages[TEXTURE_ATLAS_MAX_PAGES];  // 定长 页的 AssetTexture 指针在整个生命期内有效
+    u32 page_count;
+    Array<TextureAtlasEntry> entries;
+    HashMap<u32> by_source;  // 源纹理 -> entries 下标 + 1 移除后为 0
+    TextureAtlasStats stats;
+};
+
+TextureAtlas& texture_atlas();
+
+// data 为已经按上传方向排列的像素 num_comps 为 3 或 4 其他纹理只会移除旧的记录
+bool texture_atlas_put(TextureAtlas* atlas, u32 source, u32 width, u32 height, u32 num_comps, TextureFlags flags, const u8* data);
+void texture_atlas_remove(TextureAtlas* atlas, u32 source);
+void texture_atlas_rekey(TextureAtlas* atlas, u32 from, u32 to);  // 源纹理换了句柄 (热重载) 保留原来的位置
+bool texture_atlas_find(TextureAtlas* atlas, u32 source, TextureAtlasRegion* region);  // 未启用或不在图集中时返回 false
+void texture_atlas_compact(TextureAtlas* atlas);
+void texture_atlas_trash(TextureAtlas* atlas);
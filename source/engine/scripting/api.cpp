@@ -23,6 +23,7 @@
 #include "engine/scripting/lua_util.h"
 #include "engine/scripting/lua_database.h"
 #include "engine/components/transform.h"
+#include "engine/components/pathfind.h"
 #include "engine/scripting/wrap_meta.h"
 
 // lua
@@ -384,6 +385,30 @@ static int mt_tilemap_astar(lua_State *L) {
     goal.x = (i32)ex;
     goal.y = (i32)ey;
 
+    // bloom 为 1 时与网格的移动规则相同 走稠密网格 (代价一致时使用跳点搜索)
+    if (asset.tilemap.graph_bloom == 1 && asset.tilemap.grid.cost != nullptr) {
+        Array<TilePoint> path = {};
+        neko_defer(path.trash());
+        if (asset.tilemap.hpa.cluster > 0) {
+            asset.tilemap.astar_hierarchical(start, goal, &path);
+        } else {
+            asset.tilemap.astar_grid(start, goal, TileGridMode_JPS, &path);
+        }
+
+        PROFILE_BLOCK("construct path");
+
+        lua_createtable(L, (i32)path.len, 0);
+        for (u64 i = 0; i < path.len; i++) {
+            lua_createtable(L, 0, 2);
+
+            luax_set_number_field(L, "x", path[i].x * asset.tilemap.graph_grid_size);
+            luax_set_number_field(L, "y", path[i].y * asset.tilemap.graph_grid_size);
+
+            lua_rawseti(L, -2, (i32)i + 1);
+        }
+        return 1;
+    }
+
     TileNode *end = asset.tilemap.astar(goal, start);
 
     {
@@ -406,6 +431,67 @@ static int mt_tilemap_astar(lua_State *L) {
     return 1;
 }
 
+// tilemap:astar_async(sx, sy, ex, ey) -> ticket 用 neko.path_poll 取结果 没有网格时为 0
+static int mt_tilemap_astar_async(lua_State *L) {
+    Asset asset = check_asset_mt(L, 1, "mt_tilemap");
+    MapLdtk &tm = asset.tilemap;
+
+    PathTicket ticket = 0;
+    if (TileGridSnapshot *snapshot = tm.path_snapshot()) {
+        i32 sx = (i32)(luaL_checknumber(L, 2) / tm.graph_grid_size);
+        i32 sy = (i32)(luaL_checknumber(L, 3) / tm.graph_grid_size);
+        i32 ex = (i32)(luaL_checknumber(L, 4) / tm.graph_grid_size);
+        i32 ey = (i32)(luaL_checknumber(L, 5) / tm.graph_grid_size);
+        ticket = the<PathService>().path_submit(snapshot, sx, sy, ex, ey, TileGridMode_JPS);
+    }
+    asset_write(asset);  // 快照可能是新生成的
+
+    lua_pushinteger(L, ticket);
+    return 1;
+}
+
+// tilemap:flow_field(x, y [, id]) -> id 以 (x, y) 为目标在作业线程上构建流场 用 neko.flow_sample 采样
+// 传入有效的 id 时更新该流场的目标 构建完成前仍采样旧的场 没有网格时为 0
+static int mt_tilemap_flow_field(lua_State *L) {
+    Asset asset = check_asset_mt(L, 1, "mt_tilemap");
+    MapLdtk &tm = asset.tilemap;
+
+    PathService &ps = the<PathService>();
+    PathFlowId id = (PathFlowId)luaL_optinteger(L, 4, 0);
+    if (TileGridSnapshot *snapshot = tm.path_snapshot()) {
+        i32 gx = (i32)(luaL_checknumber(L, 2) / tm.graph_grid_size);
+        i32 gy = (i32)(luaL_checknumber(L, 3) / tm.graph_grid_size);
+        if (!ps.flow_set_goal(id, snapshot, gx, gy)) {
+            id = ps.flow_create();
+            ps.flow_set_goal(id, snapshot, gx, gy);
+        }
+    }
+    asset_write(asset);  // 快照可能是新生成的
+
+    lua_pushinteger(L, id);
+    return 1;
+}
+
+// tilemap:make_hierarchy(cluster_size) 之后 astar 使用分层寻路
+static int mt_tilemap_make_hierarchy(lua_State *L) {
+    Asset asset = check_asset_mt(L, 1, "mt_tilemap");
+    asset.tilemap.make_hierarchy((i32)luaL_optinteger(L, 2, TILE_HPA_CLUSTER));
+    asset_write(asset);
+    return 0;
+}
+
+// tilemap:set_cost(x, y, cost) 像素坐标 只更新受影响的部分
+static int mt_tilemap_set_cost(lua_State *L) {
+    Asset asset = check_asset_mt(L, 1, "mt_tilemap");
+
+    TilePoint p = {};
+    p.x = (float)luaL_checknumber(L, 2);
+    p.y = (float)luaL_checknumber(L, 3);
+    asset.tilemap.set_tile_cost(p, (float)luaL_checknumber(L, 4));
+    asset_write(asset);
+    return 0;
+}
+
 static int open_mt_tilemap(lua_State *L) {
     luaL_Reg reg[] = {
             {"draw", mt_tilemap_draw},
@@ -414,6 +500,10 @@ static int open_mt_tilemap(lua_State *L) {
             {"draw_fixtures", mt_tilemap_draw_fixtures},
             {"make_graph", mt_tilemap_make_graph},
             {"astar", mt_tilemap_astar},
+            {"astar_async", mt_tilemap_astar_async},
+            {"flow_field", mt_tilemap_flow_field},
+            {"make_hierarchy", mt_tilemap_make_hierarchy},
+            {"set_cost", mt_tilemap_set_cost},
             {nullptr, nullptr},
     };
 
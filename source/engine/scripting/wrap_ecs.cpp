@@ -391,6 +391,32 @@ struct EcsLuaWrap {
         }
     };
 
+    static int match_mode(const char* name, size_t sz) {
+        switch (sz) {
+            [[likely]] case 3:
+                if (name[0] == 'a' && name[1] == 'l' && name[2] == 'l') return MATCH_ALL;
+                break;
+            case 5:
+                if (memcmp(name, "dirty", 5) == 0) return MATCH_DIRTY;
+                break;
+            case 4:
+                if (memcmp(name, "dead", 4) == 0) return MATCH_DEAD;
+                break;
+        }
+        return -1;
+    }
+
+    static int match_start(EcsWorld* world, MatchMode mode, int key) {
+        switch (mode) {
+            case MATCH_DIRTY:
+                return world->component_pool[key].dirty_head;
+            case MATCH_DEAD:
+                return world->component_pool[key].dead_head;
+            default:
+                return 0;  // 从0开始遍历
+        }
+    }
+
     static int l_ecs_match_component(lua_State* L) {
 
         size_t match_mode_name_sz;
@@ -400,26 +426,17 @@ struct EcsLuaWrap {
         EcsWorld* world = (EcsWorld*)luaL_checkudata(L, ECS_WORLD, ECS_WORLD_METATABLE);
 
         lua_CFunction iter = NULL;
-        MatchMode mode = MATCH_ALL;
+        int mode = match_mode(match_mode_name, match_mode_name_sz);
 
-        switch (match_mode_name_sz) {
-            [[likely]] case 3:
-                if (match_mode_name[0] == 'a' && match_mode_name[1] == 'l' && match_mode_name[2] == 'l') {
-                    iter = MatchFunc::match_all;
-                    mode = MATCH_ALL;
-                }
+        switch (mode) {
+            case MATCH_ALL:
+                iter = MatchFunc::match_all;
                 break;
-            case 5:
-                if (memcmp(match_mode_name, "dirty", 5) == 0) {
-                    iter = MatchFunc::match_dirty;
-                    mode = MATCH_DIRTY;
-                }
+            case MATCH_DIRTY:
+                iter = MatchFunc::match_dirty;
                 break;
-            case 4:
-                if (memcmp(match_mode_name, "dead", 4) == 0) {
-                    iter = MatchFunc::match_dead;
-                    mode = MATCH_DEAD;
-                }
+            case MATCH_DEAD:
+                iter = MatchFunc::match_dead;
                 break;
         }
 
@@ -435,19 +452,132 @@ struct EcsLuaWrap {
         mctx->world = world;
         mctx->kn = 0;
         for (int i = 3; i <= top; i++) mctx->keys[mctx->kn++] = EcsGetTid_w(L, i, top + 1);
-        switch (mode) {
+        mctx->i = match_start(world, (MatchMode)mode, mctx->keys[0]);
+        lua_pushinteger(L, 114514);  // iter + 2
+        return 3;
+    }
+
+    // 取得下一个匹配的实体 没有时返回 NULL
+    static EntityData* batch_next_match(EcsWorld* w, MatchBatch* b) {
+        ComponentPool* cp = &w->component_pool[b->keys[0]];
+        EntityData* e;
+        switch (b->mode) {
             case MATCH_ALL:
-                mctx->i = 0;  // 从0开始遍历
+                while (b->i < cp->free_idx) {
+                    ComponentData* c = &cp->buf[b->i++];
+                    if (c->dead_next != LINK_NONE) continue;
+                    if ((e = MatchFunc::restrict_component(w->entity_buf, c, b->keys, b->kn)) != NULL) return e;
+                }
                 break;
             case MATCH_DIRTY:
-                mctx->i = world->component_pool[mctx->keys[0]].dirty_head;
+                while (b->i != LINK_NIL && b->i < cp->cap) {
+                    ComponentData* c = &cp->buf[b->i];
+                    b->i = c->dirty_next;
+                    if (c->dead_next != LINK_NONE) continue;
+                    if ((e = MatchFunc::restrict_component(w->entity_buf, c, b->keys, b->kn)) != NULL) return e;
+                }
                 break;
             case MATCH_DEAD:
-                mctx->i = world->component_pool[mctx->keys[0]].dead_head;
+                while (b->i != LINK_NIL && b->i < cp->cap) {
+                    ComponentData* c = &cp->buf[b->i];
+                    b->i = c->dead_next;
+                    if ((e = MatchFunc::restrict_component(w->entity_buf, c, b->keys, b->kn)) != NULL) return e;
+                }
                 break;
         }
-        lua_pushinteger(L, 114514);  // iter + 2
-        return 3;
+        b->i = b->mode == MATCH_ALL ? cp->free_idx : LINK_NIL;
+        return NULL;
+    }
+
+    // world:query(mode, name1, name2, ...) -> batch
+    static int l_ecs_query(lua_State* L) {
+        size_t sz;
+        const char* name = luaL_checklstring(L, ECS_WORLD + 1, &sz);
+        int top = lua_gettop(L);
+        EcsWorld* world = (EcsWorld*)luaL_checkudata(L, ECS_WORLD, ECS_WORLD_METATABLE);
+
+        int mode = match_mode(name, sz);
+        if (mode < 0) return luaL_argerror(L, 2, "mode can only be[all,dirty,dead]");
+        luaL_argcheck(L, top >= 3, 3, "lost the component name");
+        luaL_argcheck(L, top < ENTITY_MAX_COMPONENTS, top, "too many component");
+
+        lua_getiuservalue(L, ECS_WORLD, WORLD_PROTO_ID);  // top + 1
+
+        MatchBatch* b = (MatchBatch*)lua_newuserdatauv(L, sizeof(MatchBatch), 1);
+        b->mode = (MatchMode)mode;
+        b->kn = 0;
+        for (int i = 3; i <= top; i++) b->keys[b->kn++] = EcsGetTid_w(L, i, top + 1);
+        b->i = match_start(world, b->mode, b->keys[0]);
+
+        lua_pushvalue(L, ECS_WORLD);
+        lua_setiuservalue(L, -2, 1);
+
+        if (luaL_newmetatable(L, ECS_MATCH_BATCH_METATABLE)) {
+            luaL_Reg batch_mt[] = {
+                    {"next", Wrap<EcsLuaWrap::l_batch_next>},
+                    {"reset", Wrap<EcsLuaWrap::l_batch_reset>},
+                    {NULL, NULL},
+            };
+            luaL_setfuncs(L, batch_mt, 0);
+            lua_pushvalue(L, -1);
+            lua_setfield(L, -2, "__index");
+        }
+        lua_setmetatable(L, -2);
+        return 1;
+    }
+
+    // batch:next(n, ents, out1, out2, ...) -> count
+    // ents[1..count] 为实体 id outK[1..count] 为第 K 个组件表 传 nil 的输出被跳过
+    // 输出表可以跨批次复用 count 之后的旧元素不会清除
+    static int l_batch_next(lua_State* L) {
+        MatchBatch* b = (MatchBatch*)luaL_checkudata(L, 1, ECS_MATCH_BATCH_METATABLE);
+        int n = (int)luaL_checkinteger(L, 2);
+        luaL_argcheck(L, n > 0, 2, "batch size must be positive");
+        int top = lua_gettop(L);
+        luaL_argcheck(L, top - 3 <= b->kn, top, "too many output tables");
+
+        lua_getiuservalue(L, 1, 1);
+        EcsWorld* w = (EcsWorld*)lua_touserdata(L, -1);
+        lua_getiuservalue(L, -1, WORLD_COMPONENTS);
+        int components = lua_gettop(L);
+
+        // 组件表每批只取一次
+        int outs[ENTITY_MAX_COMPONENTS], keys[ENTITY_MAX_COMPONENTS], on = 0;
+        luaL_checkstack(L, top, NULL);
+        for (int k = 0; k < top - 3; k++) {
+            if (!lua_istable(L, 4 + k)) continue;
+            outs[on] = 4 + k;
+            keys[on] = b->keys[k];
+            lua_rawgeti(L, components, b->keys[k]);
+            on++;
+        }
+        bool want_ents = lua_istable(L, 3);
+
+        int count = 0;
+        EntityData* e;
+        while (count < n && (e = batch_next_match(w, b)) != NULL) {
+            count++;
+            if (want_ents) {
+                lua_pushinteger(L, e - w->entity_buf);
+                lua_rawseti(L, 3, count);
+            }
+            for (int k = 0; k < on; k++) {
+                lua_rawgeti(L, components + 1 + k, EcsEntityGetCid(e, keys[k]));
+                lua_rawseti(L, outs[k], count);
+            }
+        }
+
+        lua_pushinteger(L, count);
+        return 1;
+    }
+
+    // batch:reset() 从头开始 dirty/dead 重新读取链表头
+    static int l_batch_reset(lua_State* L) {
+        MatchBatch* b = (MatchBatch*)luaL_checkudata(L, 1, ECS_MATCH_BATCH_METATABLE);
+        lua_getiuservalue(L, 1, 1);
+        EcsWorld* w = (EcsWorld*)lua_touserdata(L, -1);
+        b->i = match_start(w, b->mode, b->keys[0]);
+        return 0;
     }
 
     static void print_value(lua_State* L, int stk, int tab) {
@@ -527,6 +657,7 @@ int EcsCreateWorld(lua_State* L) {
                 {"remove", Wrap<EcsLuaWrap::l_ecs_remove_component>},
                 {"touch", Wrap<EcsLuaWrap::l_ecs_touch_component>},
                 {"match", Wrap<EcsLuaWrap::l_ecs_match_component>},
+                {"query", Wrap<EcsLuaWrap::l_ecs_query>},
                 {"dump", Wrap<EcsLuaWrap::l_ecs_dump>},
                 {"detail", Wrap<EcsLuaWrap::l_ecs_get_detail>},
                 {NULL, NULL},
@@ -291,6 +291,9 @@ void AseSpriteData::trash() {
     tags.trash();
     arena.trash();
 
+    // 热重载会创建新的纹理 旧的纹理与它在图集中的位置在这里释放
+    if (tex.id != 0) texture_release(&tex);
+
     cute_aseprite_free(ase);
 }
 
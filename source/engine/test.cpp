@@ -527,9 +527,59 @@ void TestPanel() {
 
     extern int Test_LuaWrap();
     extern int Test_Shader();
+    extern int Test_Snapshot();
+    extern int Test_TransformHierarchy();
+    extern int Test_TransformDirty();
+    extern int Test_EntityDestroyed();
+    extern int Test_MathSimd();
+    extern int Test_NativeComponent();
+    extern int Test_EcsMatchBatch();
+    extern int Test_SpatialIndex();
+    extern int Test_SpriteDepthSort();
+    extern int Test_SpriteInstanceUpload();
+    extern int Test_CameraCulling();
+    extern int Test_TiledChunkMesh();
+    extern int Test_TmxStreamingLoad();
+    extern int Test_TileGridPath();
+    extern int Test_PathServiceAsync();
+    extern int Test_HpaPath();
+    extern int Test_FlowField();
+    extern int Test_TileCollision();
+    extern int Test_StreamBatch();
+    extern int Test_UniformCache();
+    extern int Test_UniformBlocks();
+    extern int Test_RenderQueue();
+    extern int Test_GfxNull();
+    extern int Test_RenderGraph();
+    extern int Test_TextureAtlas();
 
     if (ImGui::Button("Test_LuaWrap")) Test_LuaWrap();
     if (ImGui::Button("Test_Shader")) Test_Shader();
+    if (ImGui::Button("Test_Snapshot")) Test_Snapshot();
+    if (ImGui::Button("Test_TransformHierarchy")) Test_TransformHierarchy();
+    if (ImGui::Button("Test_TransformDirty")) Test_TransformDirty();
+    if (ImGui::Button("Test_EntityDestroyed")) Test_EntityDestroyed();
+    if (ImGui::Button("Test_MathSimd")) Test_MathSimd();
+    if (ImGui::Button("Test_NativeComponent")) Test_NativeComponent();
+    if (ImGui::Button("Test_EcsMatchBatch")) Test_EcsMatchBatch();
+    if (ImGui::Button("Test_SpatialIndex")) Test_SpatialIndex();
+    if (ImGui::Button("Test_SpriteDepthSort")) Test_SpriteDepthSort();
+    if (ImGui::Button("Test_SpriteInstanceUpload")) Test_SpriteInstanceUpload();
+    if (ImGui::Button("Test_CameraCulling")) Test_CameraCulling();
+    if (ImGui::Button("Test_TiledChunkMesh")) Test_TiledChunkMesh();
+    if (ImGui::Button("Test_TmxStreamingLoad")) Test_TmxStreamingLoad();
+    if (ImGui::Button("Test_TileGridPath")) Test_TileGridPath();
+    if (ImGui::Button("Test_PathServiceAsync")) Test_PathServiceAsync();
+    if (ImGui::Button("Test_HpaPath")) Test_HpaPath();
+    if (ImGui::Button("Test_FlowField")) Test_FlowField();
+    if (ImGui::Button("Test_TileCollision")) Test_TileCollision();
+    if (ImGui::Button("Test_StreamBatch")) Test_StreamBatch();
+    if (ImGui::Button("Test_UniformCache")) Test_UniformCache();
+    if (ImGui::Button("Test_UniformBlocks")) Test_UniformBlocks();
+    if (ImGui::Button("Test_RenderQueue")) Test_RenderQueue();
+    if (ImGui::Button("Test_GfxNull")) Test_GfxNull();
+    if (ImGui::Button("Test_RenderGraph")) Test_RenderGraph();
+    if (ImGui::Button("Test_TextureAtlas")) Test_TextureAtlas();
 }
 
 #if 1
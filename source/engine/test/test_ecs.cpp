@@ -0,0 +1,836 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include "base/common/os.hpp"
+#include "engine/bootstrap.h"
+#include "engine/components/camera.h"
+#include "engine/components/rectangle.h"
+#include "engine/components/spatial.h"
+#include "engine/components/sprite.h"
+#include "engine/components/transform.h"
+#include "engine/ecs/entity.h"
+#include "engine/ecs/native_component.h"
+#include "engine/ecs/snapshot.h"
+#include "engine/renderer/gfx_null.h"
+
+using namespace Neko;
+using namespace Neko::ecs;
+
+static Slice<u8> as_slice(SnapshotWriter& w) { return Slice<u8>(w.buf); }
+
+// 建一个组件表嵌套 depth 层的实体 最深的表中 leaf = depth
+static CEntity snapshot_deep_entity(lua_State* L, int depth) {
+    const char* src = "local d = ... local root = { __name = 'snapshot_deep' } local t = root for i = 1, d do t.next = {} t = t.next end t.leaf = d return root";
+    luaL_loadstring(L, src);
+    lua_pushinteger(L, depth);
+    lua_call(L, 1, 1);
+    LuaRef table = LuaRef::FromStack(L);
+    lua_pop(L, 1);
+    EntityData* e = EcsEntityNew(L, table, NULL);
+    return CEntity{(EcsId)(e - ENGINE_ECS()->entity_buf)};
+}
+
+// 沿 next 走 depth 层 返回 leaf 没有时为 -1
+static lua_Integer snapshot_deep_leaf(lua_State* L, CEntity ent, int depth) {
+    LuaRef table = EcsComponentGet(L, EcsGetEnt(L, ENGINE_ECS(), ent.id), EcsGetTid(L, "CTag"));
+    const char* src = "local t, d = ... for i = 1, d do t = type(t) == 'table' and t.next or nil end return type(t) == 'table' and t.leaf or -1";
+    luaL_loadstring(L, src);
+    table.Push();
+    lua_pushinteger(L, depth);
+    lua_call(L, 2, 1);
+    lua_Integer leaf = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return leaf;
+}
+
+int Test_Snapshot() {
+    constexpr int N = 100000;
+
+    // 先保存当前世界 测试结束后恢复
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Array<CEntity> ents = {};
+    for (int i = 0; i < N; i++) {
+        CEntity ent = entity_create("snapshot_test");
+        the<Transform>().ComponentAdd(ent);
+        the<Transform>().transform_set_position(ent, luavec2((f32)i, (f32)-i));
+        if (i % 2 == 0) {
+            the<Sprite>().ComponentAdd(ent);
+            the<Sprite>().sprite_set_depth(ent, i % 7);
+        }
+        ents.push(ent);
+    }
+    for (int i = 1; i < N; i += 10) the<Transform>().transform_set_parent(ents[i], ents[i - 1]);
+
+    SnapshotWriter full = {}, delta = {}, merged = {};
+
+    u64 t = TimeUtil::now();
+    snapshot_save(&full);
+    std::cout << "full snapshot " << N << " entities: " << full.buf.len << " bytes " << TimeUtil::to_milliseconds(TimeUtil::since(t)) << " ms" << std::endl;
+
+    // 修改 1% 的实体
+    for (int i = 0; i < N; i += 100) the<Transform>().transform_set_position(ents[i], luavec2(-1.f, -1.f));
+
+    t = TimeUtil::now();
+    snapshot_save(&delta, as_slice(full));
+    std::cout << "delta snapshot: " << delta.buf.len << " bytes " << TimeUtil::to_milliseconds(TimeUtil::since(t)) << " ms" << std::endl;
+
+    t = TimeUtil::now();
+    bool ok = snapshot_apply(&merged, as_slice(full), as_slice(delta));
+    std::cout << "apply delta: " << TimeUtil::to_milliseconds(TimeUtil::since(t)) << " ms" << std::endl;
+
+    // 回到 full 再加载合并后的快照 结果应与修改后的世界一致
+    ok = ok && snapshot_load(as_slice(full));
+    ok = ok && the<Transform>().transform_get_position(ents[100]).x == 100.f;
+
+    t = TimeUtil::now();
+    ok = ok && snapshot_load(as_slice(merged));
+    std::cout << "load snapshot: " << TimeUtil::to_milliseconds(TimeUtil::since(t)) << " ms" << std::endl;
+
+    for (int i = 0; ok && i < N; i++) {
+        vec2 pos = the<Transform>().transform_get_position(ents[i]);
+        vec2 expect = i % 100 == 0 ? luavec2(-1.f, -1.f) : luavec2((f32)i, (f32)-i);
+        ok = pos.x == expect.x && pos.y == expect.y;
+        if (ok && i % 2 == 0) ok = the<Sprite>().sprite_get_depth(ents[i]) == i % 7;
+        if (ok && i % 10 == 1) ok = CEntityEq(the<Transform>().transform_get_parent(ents[i]), ents[i - 1]);
+    }
+    std::cout << "snapshot round trip: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    // 嵌套层数的上限 能保存的表都能加载 更深的表在保存时丢弃
+    lua_State* L = ENGINE_LUA();
+    CEntity limit = snapshot_deep_entity(L, 31);
+    CEntity over = snapshot_deep_entity(L, 32);
+    SnapshotWriter deep = {};
+    snapshot_save(&deep);
+    bool deep_ok = snapshot_load(as_slice(deep));
+    deep_ok = deep_ok && snapshot_deep_leaf(L, limit, 31) == 31;
+    deep_ok = deep_ok && snapshot_deep_leaf(L, over, 31) == -1;
+    std::cout << "snapshot depth limit: " << (deep_ok ? "ok" : "FAILED") << std::endl;
+    ok = ok && deep_ok;
+    deep.trash();
+
+    snapshot_load(as_slice(orig));
+
+    ents.trash();
+    orig.trash();
+    full.trash();
+    delta.trash();
+    merged.trash();
+
+    return ok ? 0 : 1;
+}
+
+// 比较递归更新与扁平层级线性更新的世界矩阵传播耗时
+static double bench_hierarchy(Array<CEntity>& roots, Array<CEntity>& probe, bool flat, Array<vec2>* out) {
+    Transform& tr = the<Transform>();
+    tr.transform_set_flat_hierarchy(flat);
+    tr.transform_get_world_matrix(roots[0]);  // 扁平模式下先完成首次排序
+
+    u64 t = TimeUtil::now();
+    for (int frame = 0; frame < 10; frame++) {
+        for (CEntity root : roots) tr.transform_translate(root, luavec2(1.f, 0.5f));
+        tr.transform_get_world_matrix(roots[0]);
+    }
+    double ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / 10.0;
+
+    for (CEntity ent : probe) out->push(tr.transform_get_world_position(ent));
+    return ms;
+}
+
+int Test_TransformHierarchy() {
+    constexpr int N = 100000;
+    constexpr int DEPTH = 20;
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Transform& tr = the<Transform>();
+    bool was_flat = tr.transform_get_flat_hierarchy();
+    bool ok = true;
+
+    for (int wide = 0; wide < 2; wide++) {
+        Array<CEntity> ents = {}, roots = {}, probe = {};
+        for (int i = 0; i < N; i++) {
+            CEntity ent = entity_create("hierarchy_test");
+            tr.ComponentAdd(ent);
+            tr.transform_set_rotation(ent, 0.01f * (i % 13));
+            ents.push(ent);
+        }
+
+        if (wide) {
+            // 一个根 N-1 个子级
+            roots.push(ents[0]);
+            for (int i = 1; i < N; i++) tr.transform_set_parent(ents[i], ents[0]);
+            probe.push(ents[N - 1]);
+        } else {
+            // N/DEPTH 条深度为 DEPTH 的链 逆序连接使子级在池中位于父级之前
+            for (int c = 0; c < N / DEPTH; c++) {
+                for (int d = 0; d < DEPTH - 1; d++) tr.transform_set_parent(ents[c * DEPTH + d], ents[c * DEPTH + d + 1]);
+                roots.push(ents[c * DEPTH + DEPTH - 1]);
+                probe.push(ents[c * DEPTH]);
+            }
+        }
+
+        Array<vec2> rec = {}, flat = {};
+        double rec_ms = bench_hierarchy(roots, probe, false, &rec);
+        double flat_ms = bench_hierarchy(roots, probe, true, &flat);
+
+        for (u64 i = 0; ok && i < rec.len; i++) ok = fabsf(rec[i].x + 10.f - flat[i].x) < 1e-2f && fabsf(rec[i].y + 5.f - flat[i].y) < 1e-2f;
+
+        std::cout << (wide ? "wide tree " : "deep tree ") << N << " nodes: recursive " << rec_ms << " ms flat " << flat_ms << " ms per frame" << std::endl;
+
+        rec.trash();
+        flat.trash();
+        ents.trash();
+        roots.trash();
+        probe.trash();
+
+        tr.transform_set_flat_hierarchy(was_flat);
+        snapshot_load(Slice<u8>(orig.buf));
+    }
+
+    std::cout << "transform hierarchy: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+// 每帧多次移动大量根节点 统计延迟更新后的矩阵运算次数
+int Test_TransformDirty() {
+    constexpr int ROOTS = 1000;
+    constexpr int CHILDREN = 20;
+    constexpr int MOVES = 10;
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Transform& tr = the<Transform>();
+
+    Array<CEntity> roots = {};
+    for (int r = 0; r < ROOTS; r++) {
+        CEntity root = entity_create("dirty_test");
+        tr.ComponentAdd(root);
+        for (int c = 0; c < CHILDREN; c++) {
+            CEntity child = entity_create("dirty_test");
+            tr.ComponentAdd(child);
+            tr.transform_set_parent(child, root);
+            tr.transform_set_position(child, luavec2((f32)c, 0.f));
+        }
+        roots.push(root);
+    }
+    tr.transform_update_all(Event{});
+
+    u64 t = TimeUtil::now();
+    for (int m = 0; m < MOVES; m++)
+        for (CEntity root : roots) tr.transform_translate(root, luavec2(0.1f, 0.f));
+    tr.transform_update_all(Event{});
+    double ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    // 立即更新时每次移动根都要合成一次并重写整个子树
+    u64 eager = (u64)MOVES * ROOTS * (1 + CHILDREN);
+    u64 lazy = tr.transform_get_matrix_ops();
+    std::cout << "transform dirty: " << ROOTS << " roots x " << MOVES << " moves, matrix ops " << lazy << " (eager " << eager << ") " << ms << " ms" << std::endl;
+
+    vec2 pos = tr.transform_get_world_position(roots[0]);
+    bool ok = lazy <= (u64)ROOTS * (1 + CHILDREN) && fabsf(pos.x - 0.1f * MOVES) < 1e-4f;
+    std::cout << "transform dirty: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    roots.trash();
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+struct CTestElem : CEntityBase {
+    int value;
+};
+
+// 销毁少量实体时 事件流只处理被销毁的实体 对比全量检查
+int Test_EntityDestroyed() {
+    constexpr int N = 50000;
+    constexpr int DESTROY = 100;
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    CEntityPool<CTestElem>* pool = entitypool_new<CTestElem>();
+    entitypool_subscribe_destroyed(pool);
+    Array<CEntity> ents = {};
+    for (int i = 0; i < N; i++) {
+        CEntity ent = entity_create("destroyed_test");
+        pool->Add(ent)->value = i;
+        ents.push(ent);
+    }
+
+    bool ok = true;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < DESTROY; i++) EcsEntityDel(ENGINE_LUA(), ents[pass * DESTROY + i * 7].id);
+        if (pass == 1) entity_destroyed_invalidate();  // 强制全量检查
+
+        int removed = 0;
+        u64 t = TimeUtil::now();
+        entitypool_remove_destroyed(pool, [&](CEntity ent) {
+            pool->Remove(ent);
+            removed++;
+        });
+        double ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+        std::cout << (pass ? "full scan: " : "destroyed events: ") << removed << " removed from " << N << " in " << ms << " ms" << std::endl;
+        ok &= removed == DESTROY && entitypool_size(pool) == (EcsId)(N - (pass + 1) * DESTROY);
+
+        the<Entity>().entity_update_all(Event{});
+    }
+
+    // 销毁后 id 在处理事件前被重新使用 过期的事件不能移除新实体的组件
+    CEntity victim = ents[N - 1];
+    EcsEntityDel(ENGINE_LUA(), victim.id);
+    the<Entity>().entity_update_all(Event{});
+    CEntity reused = entity_create("destroyed_test");
+    pool->Add(reused)->value = -1;
+    int stale = 0;
+    entitypool_remove_destroyed(pool, [&](CEntity ent) {
+        pool->Remove(ent);
+        stale++;
+    });
+    std::cout << "stale event: id " << (reused.id == victim.id ? "reused" : "not reused") << ", " << stale << " removed" << std::endl;
+    ok &= reused.id != victim.id || (stale == 0 && pool->GetPtr(reused) && pool->GetPtr(reused)->value == -1);
+
+    std::cout << "entity destroyed: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    entitypool_free(pool);
+    ents.trash();
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+struct CNativeTest {
+    vec2 velocity;
+    f32 drag;
+    i32 hits;
+};
+
+// 100k 个纯原生组件与带 Lua 组件表镜像的组件 比较 Lua 内存与完整 GC 耗时
+int Test_NativeComponent() {
+    constexpr int N = 100000;
+
+    lua_State* L = ENGINE_LUA();
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    int type = native_component_register<CNativeTest>();
+    NATIVE_COMPONENT_FIELD(type, CNativeTest, velocity, NativeField_Vec2);
+    NATIVE_COMPONENT_FIELD(type, CNativeTest, drag, NativeField_F32);
+    NATIVE_COMPONENT_FIELD(type, CNativeTest, hits, NativeField_I32);
+
+    Array<CEntity> ents = {};
+    for (int i = 0; i < N; i++) ents.push(entity_create("native_test"));
+
+    auto measure = [&](const char* name, auto add) {
+        lua_gc(L, LUA_GCCOLLECT);
+        int kb = lua_gc(L, LUA_GCCOUNT);
+        u64 bytes = native_component_memory();
+
+        u64 t = TimeUtil::now();
+        for (CEntity ent : ents) add(ent);
+        double add_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+        t = TimeUtil::now();
+        lua_gc(L, LUA_GCCOLLECT);
+        double gc_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+        std::cout << name << ": add " << add_ms << " ms, lua heap +" << lua_gc(L, LUA_GCCOUNT) - kb << " KB, native +" << (native_component_memory() - bytes) / 1024 << " KB, full gc "
+                  << gc_ms << " ms" << std::endl;
+    };
+
+    Array<CNativeTest> mirrored = {};
+    mirrored.resize(N);
+    // 实体创建时已经有 CTag 镜像表放在单独注册的 Lua 组件中
+    static int mirror_tid = 0;
+    if (!mirror_tid) mirror_tid = EcsRegister(L, "CNativeTestMirror");
+    u64 i = 0;
+    measure("lua mirrored", [&](CEntity ent) {
+        EntityData* e = EcsGetEnt(L, ENGINE_ECS(), ent.id);
+        LuaRef tb = LuaRef::NewTable(L);
+        tb["__ud"] = &mirrored[i++];
+        EcsComponentSet(L, e, mirror_tid, tb);
+    });
+    measure("native only", [&](CEntity ent) { native_component_add<CNativeTest>(type, ent)->hits = (i32)ent.id; });
+
+    bool ok = native_component_count(type) == N;
+    for (int k = 0; ok && k < N; k += 997) ok = native_component_get<CNativeTest>(type, ents[k])->hits == (i32)ents[k].id;
+
+    // Lua 视图读写
+    const char* src = "local ent = ... local v = neko.native_component_get(ent, 'CNativeTest') v.drag = 0.5 v.hits = v.hits + 1 return v.hits";
+    bool loaded = luaL_loadstring(L, src) == LUA_OK;
+    if (loaded) LuaPush<CEntity>(L, ents[0]);
+    if (loaded && lua_pcall(L, 1, 1, 0) == LUA_OK) {
+        ok = ok && lua_tointeger(L, -1) == (lua_Integer)ents[0].id + 1 && native_component_get<CNativeTest>(type, ents[0])->drag == 0.5f;
+    } else {
+        std::cout << lua_tostring(L, -1) << std::endl;
+        ok = false;
+    }
+    lua_pop(L, 1);
+
+    // 销毁的实体在下一次更新时移除
+    EcsEntityDel(L, ents[1].id);
+    the<Entity>().entity_update_all(Event{});
+    ok = ok && native_component_get(type, ents[1]) == nullptr && native_component_count(type) == N - 1;
+
+    std::cout << "native component: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    snapshot_load(Slice<u8>(orig.buf));  // 同时清空原生池
+    mirrored.trash();
+    ents.trash();
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+// Lua 逐个 match 迭代与 query 批量填充 (每批 256) 的对比
+int Test_EcsMatchBatch() {
+    constexpr int N = 10000;
+    constexpr int ROUNDS = 20;
+
+    lua_State* L = ENGINE_LUA();
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    const char* src = R"lua(
+local N, ROUNDS = ...
+local w = neko.ecs_f()
+pcall(w.register, w, "batch_test_pos", {})
+pcall(w.register, w, "batch_test_vel", {})
+for i = 1, N do w:new({batch_test_pos = {x = i, y = 0}, batch_test_vel = {x = 1, y = 2}}) end
+local clock = os.clock
+
+local t = clock()
+local sum_iter = 0
+for r = 1, ROUNDS do
+    for p, v in w:match("all", "batch_test_pos", "batch_test_vel") do
+        p.x = p.x + v.x
+        sum_iter = sum_iter + p.x
+    end
+end
+local iter_ms = (clock() - t) * 1000
+
+local q = w:query("all", "batch_test_pos", "batch_test_vel")
+local ents, ps, vs = {}, {}, {}
+local sum_batch, count = 0, 0
+t = clock()
+for r = 1, ROUNDS do
+    q:reset()
+    while true do
+        local n = q:next(256, ents, ps, vs)
+        if n == 0 then break end
+        for i = 1, n do
+            local p = ps[i]
+            p.x = p.x - vs[i].x
+            sum_batch = sum_batch + p.x
+        end
+        count = count + n
+    end
+end
+local batch_ms = (clock() - t) * 1000
+return iter_ms, batch_ms, sum_iter, sum_batch, count
+)lua";
+
+    bool ok = luaL_loadstring(L, src) == LUA_OK;
+    if (ok) {
+        lua_pushinteger(L, N);
+        lua_pushinteger(L, ROUNDS);
+        ok = lua_pcall(L, 2, 5, 0) == LUA_OK;
+    }
+    if (ok) {
+        double iter_ms = lua_tonumber(L, -5), batch_ms = lua_tonumber(L, -4);
+        double sum_iter = lua_tonumber(L, -3), sum_batch = lua_tonumber(L, -2);
+        lua_Integer count = lua_tointeger(L, -1);
+        lua_pop(L, 5);
+
+        // 先逐个 +1 共 ROUNDS 次 再批量 -1 共 ROUNDS 次 两边的累加和对称
+        double base = (double)N * (N + 1) / 2 * ROUNDS;
+        double inc = (double)N * ROUNDS * (ROUNDS + 1) / 2;
+        ok = count == (lua_Integer)N * ROUNDS && sum_iter == base + inc && sum_batch == base + inc - (double)N * ROUNDS;
+
+        std::cout << "ecs match " << N << " entities x " << ROUNDS << ": iterator " << iter_ms / ROUNDS << " ms batch(256) " << batch_ms / ROUNDS << " ms per pass" << std::endl;
+    } else {
+        std::cout << lua_tostring(L, -1) << std::endl;
+        lua_pop(L, 1);
+    }
+
+    std::cout << "ecs match batch: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+// 100k 个实体 空间索引查询与遍历全部实体的暴力查询对比
+int Test_SpatialIndex() {
+    constexpr int N = 100000;
+    constexpr int QUERIES = 1000;
+    constexpr f32 WORLD = 2000.f;
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Transform& tr = the<Transform>();
+    Spatial& sp = the<Spatial>();
+
+    std::mt19937 rng(1919810);
+    std::uniform_real_distribution<f32> pos(0.f, WORLD), ext(0.1f, 2.f), rot(0.f, 6.28f);
+
+    Array<CEntity> ents = {};
+    for (int i = 0; i < N; i++) {
+        CEntity ent = entity_create("spatial_test");
+        tr.ComponentAdd(ent);
+        tr.transform_set_position(ent, luavec2(pos(rng), pos(rng)));
+        tr.transform_set_rotation(ent, rot(rng));
+        f32 w = ext(rng), h = ext(rng);
+        sp.spatial_set_bounds(ent, bbox(luavec2(-w, -h), luavec2(w, h)));
+        ents.push(ent);
+    }
+
+    u64 t = TimeUtil::now();
+    sp.spatial_update_all(Event{});
+    double build_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    // 移动 1% 的实体
+    for (int i = 0; i < N; i += 100) tr.transform_translate(ents[i], luavec2(5.f, -5.f));
+    t = TimeUtil::now();
+    sp.spatial_update_all(Event{});
+    double move_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    auto brute = [&](auto hit, Array<CEntity>* out) {
+        for (CEntity ent : ents) {
+            BBox b = bbox_transform(tr.transform_get_world_matrix(ent), sp.spatial_get_bounds(ent));
+            if (hit(b)) out->push(ent);
+        }
+    };
+    auto same = [](Array<CEntity>& a, Array<CEntity>& b) {
+        if (a.len != b.len) return false;
+        auto cmp = [](const CEntity& l, const CEntity& r) { return l.id < r.id; };
+        std::sort(a.begin(), a.end(), cmp);
+        std::sort(b.begin(), b.end(), cmp);
+        for (u64 i = 0; i < a.len; i++)
+            if (a[i].id != b[i].id) return false;
+        return true;
+    };
+
+    bool ok = true;
+    Array<CEntity> fast = {}, slow = {};
+    Array<SpatialRayHit> hits = {};
+    double index_ms[4] = {}, brute_ms[4] = {};
+    const char* names[4] = {"point", "aabb", "radius", "ray"};
+
+    for (int q = 0; q < QUERIES && ok; q++) {
+        vec2 p = luavec2(pos(rng), pos(rng));
+        vec2 p2 = luavec2(p.x + 50.f, p.y + 30.f);
+        BBox box = bbox(p, luavec2(p.x + 10.f, p.y + 10.f));
+        f32 r = 8.f;
+
+        for (int kind = 0; kind < 4; kind++) {
+            fast.len = 0;
+            slow.len = 0;
+            hits.len = 0;
+
+            t = TimeUtil::now();
+            if (kind == 0) sp.spatial_query_point(p, &fast);
+            if (kind == 1) sp.spatial_query_aabb(box, &fast);
+            if (kind == 2) sp.spatial_query_radius(p, r, &fast);
+            if (kind == 3) {
+                sp.spatial_raycast(p, p2, &hits);
+                for (SpatialRayHit& h : hits) fast.push(h.ent);
+                for (u64 i = 1; i < hits.len; i++) ok &= hits[i - 1].fraction <= hits[i].fraction;
+            }
+            index_ms[kind] += TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+            t = TimeUtil::now();
+            if (kind == 0) brute([&](BBox b) { return bbox_contains(b, p); }, &slow);
+            if (kind == 1) brute([&](BBox b) { return b.min.x <= box.max.x && box.min.x <= b.max.x && b.min.y <= box.max.y && box.min.y <= b.max.y; }, &slow);
+            if (kind == 2) brute(
+                        [&](BBox b) {
+                            f32 dx = p.x - NEKO_CLAMP(p.x, b.min.x, b.max.x), dy = p.y - NEKO_CLAMP(p.y, b.min.y, b.max.y);
+                            return dx * dx + dy * dy <= r * r;
+                        },
+                        &slow);
+            if (kind == 3) brute(
+                        [&](BBox b) {
+                            // 与线段 p-p2 相交 (分离轴)
+                            f32 tmin = 0.f, tmax = 1.f;
+                            f32 o[2] = {p.x, p.y}, d[2] = {p2.x - p.x, p2.y - p.y}, lo[2] = {b.min.x, b.min.y}, hi[2] = {b.max.x, b.max.y};
+                            for (int i = 0; i < 2; i++) {
+                                f32 inv = 1.0f / d[i];
+                                f32 t1 = (lo[i] - o[i]) * inv, t2 = (hi[i] - o[i]) * inv;
+                                if (t1 > t2) std::swap(t1, t2);
+                                tmin = fmaxf(tmin, t1);
+                                tmax = fminf(tmax, t2);
+                            }
+                            return tmin <= tmax;
+                        },
+                        &slow);
+            brute_ms[kind] += TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+            ok &= same(fast, slow);
+        }
+    }
+
+    std::cout << "spatial index " << N << " entities: build " << build_ms << " ms, update 1% moved " << move_ms << " ms" << std::endl;
+    for (int kind = 0; kind < 4; kind++)
+        std::cout << "spatial " << names[kind] << " query: index " << index_ms[kind] / QUERIES * 1000.0 << " us brute " << brute_ms[kind] / QUERIES * 1000.0 << " us" << std::endl;
+    std::cout << "spatial index: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    fast.trash();
+    slow.trash();
+    hits.trash();
+    ents.trash();
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+static int sprite_qsort_compare(const void* a, const void* b) {
+    const CSprite *sa = (CSprite*)a, *sb = (CSprite*)b;
+    if (sb->depth == sa->depth) return ((int)sa->ent.id) - ((int)sb->ent.id);
+    return sb->depth - sa->depth;
+}
+
+// 100k 个精灵 比较每帧 qsort 与按需的插入/基数排序
+int Test_SpriteDepthSort() {
+    constexpr int N = 100000;
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Sprite& spr = the<Sprite>();
+    CEntityPool<CSprite>* pool = EcsProtoGetCType<CSprite>(ENGINE_LUA());
+
+    std::mt19937 rng(114514);
+    Array<CEntity> ents = {};
+    for (int i = 0; i < N; i++) {
+        CEntity ent = entity_create("sprite_sort_test");
+        spr.ComponentAdd(ent);
+        spr.sprite_set_depth(ent, (int)(rng() % 64) - 32);
+        ents.push(ent);
+    }
+
+    Array<CSprite> ref = {};
+    bool ok = true;
+
+    // 与 qsort 的结果逐个比较 并检查 emap
+    auto check = [&]() {
+        ref.resize(pool->array.len);
+        memcpy(ref.data, pool->array.data, pool->array.len * sizeof(CSprite));
+        qsort(ref.data, ref.len, sizeof(CSprite), sprite_qsort_compare);
+        for (u64 i = 0; i < ref.len; i++) {
+            if (pool->array[i].ent.id != ref[i].ent.id || entitymap_get(pool->emap, pool->array[i].ent) != (int)i) return false;
+        }
+        return true;
+    };
+
+    auto run = [&](const char* name, EntityPoolSortPath expect) {
+        u64 t = TimeUtil::now();
+        spr.sprite_sort();
+        double ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+        EntityPoolSortPath path = spr.sprite_get_last_sort();
+        bool pass = path == expect && check();
+        std::cout << name << ": " << ms << " ms, path " << (int)path << (pass ? "" : " FAILED") << std::endl;
+        ok &= pass;
+    };
+
+    run("initial", EntityPoolSort_Radix);
+    run("unchanged", EntityPoolSort_None);
+
+    // 深度只差 1 时移动距离小 走插入排序
+    for (int i = 0; i < 50; i++) {
+        CEntity ent = ents[rng() % N];
+        spr.sprite_set_depth(ent, spr.sprite_get_depth(ent) + (rng() % 2 ? 1 : -1));
+    }
+    run("50 nudged", EntityPoolSort_Insertion);
+
+    // 逆序不多但移动距离大 插入排序超出移动次数上限后改走基数排序
+    for (int i = 0; i < 100; i++) spr.sprite_set_depth(ents[rng() % N], (int)(rng() % 64) - 32);
+    run("100 changed", EntityPoolSort_Radix);
+
+    for (CEntity ent : ents) spr.sprite_set_depth(ent, (int)(rng() % 4096) - 2048);
+    run("all changed", EntityPoolSort_Radix);
+
+    // 每帧 qsort 的耗时作为参照 (已经有序)
+    u64 t = TimeUtil::now();
+    entitypool_sort(pool, sprite_qsort_compare);
+    std::cout << "qsort sorted pool: " << TimeUtil::to_milliseconds(TimeUtil::since(t)) << " ms" << std::endl;
+
+    std::cout << "sprite depth sort: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    ref.trash();
+    ents.trash();
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+// 精灵实例只上传变化的区间 在空后端上记录 上传字节数应与改变的精灵数成正比
+int Test_SpriteInstanceUpload() {
+    constexpr int N = 10000;
+
+    // 精灵的顶点缓冲区在启动时创建 只有整个程序使用空后端时才能记录
+    if (!gfx_null_installed()) {
+        std::cout << "sprite instance upload: start with --gfx=null to measure" << std::endl;
+        return 0;
+    }
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Sprite& spr = the<Sprite>();
+    Transform& tr = the<Transform>();
+    Camera& cam = the<Camera>();
+
+    bool culling = cam.camera_get_culling();
+    cam.camera_set_culling(false);  // 只关心实例变化
+
+    Array<CEntity> ents = {};
+    for (int i = 0; i < N; i++) {
+        CEntity ent = entity_create("sprite_upload_test");
+        spr.ComponentAdd(ent);
+        tr.transform_set_position(ent, luavec2((f32)(i % 100), (f32)(i / 100)));
+        ents.push(ent);
+    }
+
+    struct UploadFrame {
+        u64 instances;
+        u32 ranges;
+        u64 bytes;
+        bool reallocate;
+    };
+
+    auto frame = [&]() {
+        tr.transform_update_all(Event{});
+        spr.sprite_update_all(Event{});
+        gfx_recorder_reset();
+        spr.sprite_draw_all();
+        const GfxRecorder& r = gfx_recorder();
+        return UploadFrame{r.vertices, gfx_recorder_calls("glBufferSubData"), r.buffer_upload_bytes, gfx_recorder_calls("glBufferData") > 0};
+    };
+
+    bool ok = true;
+    u64 total = 0;
+    auto report = [&](const char* name, const UploadFrame& s) {
+        total = s.instances;
+        std::cout << name << ": " << s.bytes << " bytes in " << s.ranges << " uploads" << (s.reallocate ? " (reallocate)" : "") << ", full upload would be "
+                  << s.instances * sizeof(SpriteInstance) << " bytes" << std::endl;
+    };
+
+    UploadFrame s = frame();
+    report("first frame", s);
+    frame();  // 上一帧可能还有其他变化
+
+    s = frame();
+    report("unchanged", s);
+    ok &= s.bytes == 0 && !s.reallocate;
+
+    for (int moved : {10, 100, 1000}) {
+        for (int i = 0; i < moved; i++) tr.transform_translate(ents[(i * 7919) % N], luavec2(0.5f, 0.0f));
+        s = frame();
+        report(moved == 10 ? "10 moved" : moved == 100 ? "100 moved" : "1000 moved", s);
+        ok &= s.bytes >= (u64)moved * sizeof(SpriteInstance) && s.bytes <= (u64)moved * (SPRITE_RANGE_MERGE_GAP + 1) * sizeof(SpriteInstance);
+    }
+
+    // 只打包不绘制 不影响下一次绘制要上传的内容
+    for (int i = 0; i < 10; i++) tr.transform_translate(ents[(i * 7919) % N], luavec2(0.5f, 0.0f));
+    tr.transform_update_all(Event{});
+    spr.sprite_update_all(Event{});
+    spr.sprite_pack_instances();
+    spr.sprite_pack_instances();
+    s = frame();
+    report("10 moved after pack", s);
+    ok &= s.bytes >= 10 * sizeof(SpriteInstance) && !s.reallocate;
+
+    // 改变深度会重新排序 但只有位置变化的实例需要上传
+    spr.sprite_set_depth(ents[N / 2], 1);
+    s = frame();
+    report("1 depth changed", s);
+    ok &= s.bytes > 0 && s.bytes < total * sizeof(SpriteInstance);
+
+    std::cout << "sprite instance upload: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    cam.camera_set_culling(culling);
+    ents.trash();
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
+
+// 摄像机视图剔除 可见数量与逐个比较的结果一致
+int Test_CameraCulling() {
+    constexpr int N = 10000;
+
+    SnapshotWriter orig = {};
+    snapshot_save(&orig);
+
+    Sprite& spr = the<Sprite>();
+    Transform& tr = the<Transform>();
+    Camera& cam = the<Camera>();
+
+    cam.camera_update_all(Event{});
+    BBox view = cam.camera_get_view_bounds();
+    vec2 center = luavec2((view.min.x + view.max.x) * 0.5f, (view.min.y + view.max.y) * 0.5f);
+    vec2 extent = luavec2(view.max.x - view.min.x, view.max.y - view.min.y);
+
+    // 精灵分布在 5 倍视图大小的区域内
+    std::mt19937 rng(810);
+    std::uniform_real_distribution<f32> ux(center.x - extent.x * 2.5f, center.x + extent.x * 2.5f), uy(center.y - extent.y * 2.5f, center.y + extent.y * 2.5f);
+    vec2 size = luavec2(extent.x * 0.01f, extent.y * 0.01f);
+    for (int i = 0; i < N; i++) {
+        CEntity ent = entity_create("cull_test");
+        spr.ComponentAdd(ent);
+        spr.sprite_set_size(ent, size);
+        tr.transform_set_position(ent, luavec2(ux(rng), uy(rng)));
+    }
+
+    tr.transform_update_all(Event{});
+    spr.sprite_update_all(Event{});
+
+    u32 expect = 0;
+    CEntityPool<CSprite>* pool = EcsProtoGetCType<CSprite>(ENGINE_LUA());
+    for (CSprite& s : pool->array) {
+        BBox b = bbox_transform(s.wmat, bbox(vec2_float_mul(s.size, -0.5f), vec2_float_mul(s.size, 0.5f)));
+        if (bbox_overlaps(view, b)) expect++;
+    }
+
+    CameraCullStats& stats = cam.camera_get_cull_stats();
+    stats = {};
+    u64 t = TimeUtil::now();
+    spr.sprite_pack_instances();
+    double culled_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    CameraCullStats culled = stats;
+
+    bool ok = culled.sprites == pool->array.len && culled.sprites_visible == expect && culled.sprites_visible < culled.sprites;
+
+    cam.camera_set_culling(false);
+    stats = {};
+    t = TimeUtil::now();
+    spr.sprite_pack_instances();
+    double all_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    ok &= stats.sprites_visible == stats.sprites;
+    cam.camera_set_culling(true);
+
+    // 视图外的矩形不提交
+    CEntity rect_ent = entity_create("cull_test_rect");
+    CRectangle* rect = the<RectangleBox>().ComponentAdd(rect_ent);
+    rect->pos = luavec2(view.max.x + 10.f, 0.f);
+    rect->size = luavec2(1.f, 1.f);
+    stats = {};
+    ok &= !the<RectangleBox>().immediate_push(rect_ent) && stats.rects == 1 && stats.rects_visible == 0;
+
+    std::cout << "camera culling: sprites " << culled.sprites_visible << "/" << culled.sprites << " visible, pack " << culled_ms << " ms (no culling " << all_ms << " ms)" << std::endl;
+    std::cout << "camera culling: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    stats = {};
+    snapshot_load(Slice<u8>(orig.buf));
+    orig.trash();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <random>
+
+#include "base/common/math_simd.hpp"
+#include "base/common/os.hpp"
+
+using namespace Neko;
+
+// 批量 mat3 计算 各实现与标量版本逐位比较并计时
+int Test_MathSimd() {
+    constexpr u64 N = 100003;  // 非 4 的倍数 覆盖尾部处理
+    constexpr int ROUNDS = 20;
+
+    std::mt19937 rng(114514);
+    std::uniform_real_distribution<f32> dist(-100.f, 100.f);
+
+    Array<mat3> a = {}, b = {}, out = {}, ref = {};
+    Array<vec2> v = {}, vout = {}, vref = {};
+    a.resize(N);
+    b.resize(N);
+    out.resize(N);
+    ref.resize(N);
+    v.resize(N);
+    vout.resize(N);
+    vref.resize(N);
+
+    for (u64 i = 0; i < N; i++) {
+        for (int k = 0; k < 9; k++) {
+            a[i].v[k] = dist(rng);
+            b[i].v[k] = dist(rng);
+        }
+        if (i % 17 == 0) a[i].v[2] = -0.0f;  // 负零
+        v[i] = luavec2(dist(rng), dist(rng));
+    }
+
+    MathSimdLevel cpu = math_simd_detect();
+    std::cout << "math simd: cpu supports " << math_simd_level_name(cpu) << std::endl;
+
+    bool ok = true;
+    for (int level = MathSimd_Scalar; level <= cpu; level++) {
+        math_simd_set_level((MathSimdLevel)level);
+        const char *name = math_simd_level_name((MathSimdLevel)level);
+        bool exact = true;
+
+        for (u64 i = 0; i < N; i++) ref[i] = mat3_mul(a[i], b[i]);
+        mat3_mul_batch(out.data, a.data, b.data, N);
+        exact &= memcmp(out.data, ref.data, sizeof(mat3) * N) == 0;
+
+        for (u64 i = 0; i < N; i++) ref[i] = mat3_mul(a[0], b[i]);
+        mat3_mul_batch_left(out.data, a[0], b.data, N);
+        exact &= memcmp(out.data, ref.data, sizeof(mat3) * N) == 0;
+
+        for (u64 i = 0; i < N; i++) vref[i] = mat3_transform(a[1], v[i]);
+        mat3_transform_batch(vout.data, a[1], v.data, N);
+        exact &= memcmp(vout.data, vref.data, sizeof(vec2) * N) == 0;
+
+        for (u64 i = 0; i < N; i++) vref[i] = mat3_transform(a[i], v[i]);
+        mat3_transform_each(vout.data, a.data, v.data, N);
+        exact &= memcmp(vout.data, vref.data, sizeof(vec2) * N) == 0;
+
+        // 计时
+        u64 t = TimeUtil::now();
+        for (int r = 0; r < ROUNDS; r++) mat3_mul_batch(out.data, a.data, b.data, N);
+        double mul_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / ROUNDS;
+
+        t = TimeUtil::now();
+        for (int r = 0; r < ROUNDS; r++) mat3_transform_batch(vout.data, a[1], v.data, N);
+        double transform_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / ROUNDS;
+
+        t = TimeUtil::now();
+        for (int r = 0; r < ROUNDS; r++) mat3_transform_each(vout.data, a.data, v.data, N);
+        double each_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / ROUNDS;
+
+        std::cout << "math simd " << name << ": mul " << mul_ms << " ms transform " << transform_ms << " ms transform_each " << each_ms << " ms (" << N << " elements) "
+                  << (exact ? "bit-exact" : "MISMATCH") << std::endl;
+        ok &= exact;
+    }
+    math_simd_set_level(cpu);
+
+    a.trash();
+    b.trash();
+    out.trash();
+    ref.trash();
+    v.trash();
+    vout.trash();
+    vref.trash();
+
+    std::cout << "math simd: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
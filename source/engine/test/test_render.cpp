@@ -0,0 +1,742 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "base/common/os.hpp"
+#include "engine/asset.h"
+#include "engine/bootstrap.h"
+#include "engine/components/camera.h"
+#include "engine/draw.h"
+#include "engine/graphics.h"
+#include "engine/renderer/gfx_null.h"
+#include "engine/renderer/render_graph.h"
+#include "engine/renderer/texture_atlas.h"
+#include "engine/renderer/renderer.h"
+
+using namespace Neko;
+
+// QuadRenderer 与 Batch 通过流缓冲提交 在空后端上记录 每批一次绘制 持久映射时没有 glBufferSubData
+int Test_StreamBatch() {
+    constexpr u32 N = 10000;
+    constexpr u32 FRAMES = 8;
+    constexpr u32 QUAD_BATCH = 2048;  // renderer.cpp batch_size
+
+    // 着色器资源在安装前加载 资源缓存里的程序始终是真实的句柄
+    Asset shader = {};
+    bool ok = asset_load_kind(AssetKind_Shader, "@code/game/shader/sprite2.glsl", &shader);
+    if (!ok) {
+        std::cout << "stream batch: sprite shader not found" << std::endl;
+        return 1;
+    }
+
+    bool installed = gfx_null_install();  // 以 --gfx=null 启动时已经安装 这时也测量 Batch
+    GfxFrameStats saved = gfx_frame_stats();
+
+    RenderTarget rt = {};
+    rt.create(256, 256);
+
+    QuadRenderer qr = {};
+    qr.new_renderer(assets_get<AssetShader>(shader), neko_v2(256, 256));
+    ok &= qr.stream.persistent;  // 空后端提供 glBufferStorage
+
+    auto push_quads = [&](u32 count) {
+        for (u32 i = 0; i < count; i++) {
+            TexturedQuad quad = {
+                    .texture = NULL,
+                    .position = {(f32)(i % 256), (f32)((i / 256) % 256)},
+                    .dimentions = {4, 4},
+                    .rect = {0},
+                    .color = make_color(0xffffff, 255),
+            };
+            qr.renderer_push(&quad);
+        }
+        qr.renderer_end_frame();
+    };
+
+    rt.bind();
+
+    push_quads(1);  // 先上传一次 light_count 之后的帧只剩顶点
+
+    gfx_recorder_reset();
+    u64 t0 = TimeUtil::now();
+    for (u32 f = 0; f < FRAMES; f++) push_quads(N);
+    f32 quad_ms = TimeUtil::to_milliseconds(TimeUtil::since(t0)) / FRAMES;
+
+    GfxRecorder r = gfx_recorder();
+    const u32 quad_draws = (N + QUAD_BATCH - 1) / QUAD_BATCH;
+    std::cout << "quads: " << N << " per frame, " << r.draws / FRAMES << " draws, " << r.buffer_uploads / FRAMES << " uploads, " << r.buffer_upload_bytes / FRAMES
+              << " bytes, " << quad_ms << " ms/frame (cpu)" << std::endl;
+    std::cout << "quads before: " << (N + 99) / 100 << " draws, " << (N + 99) / 100 * 2 << " uploads" << std::endl;
+
+    ok &= r.draws == quad_draws * FRAMES;
+    ok &= r.vertices == (u64)N * 6 * FRAMES;
+    ok &= r.buffer_uploads == 0 && r.buffer_upload_bytes == 0;  // 顶点直接写入映射的流缓冲
+
+    // Batch 的流缓冲在启动时创建 只在整个程序使用空后端时可以测量
+    if (!installed) {
+        Batch& batch = the<Batch>();
+        batch.batch_draw_all();  // 本帧已有的顶点 之后从新的一段开始
+
+        const u32 capacity = (u32)batch.GetBatch()->vertex_capacity;
+        ok &= batch.GetBatch()->stream.persistent;
+
+        gfx_recorder_reset();
+        t0 = TimeUtil::now();
+        for (u32 f = 0; f < FRAMES; f++) {
+            batch.batch_texture(0);
+            for (u32 i = 0; i < N; i++) {
+                f32 x = (f32)(i % 256), y = (f32)((i / 256) % 256);
+                batch.batch_push_vertex(x, y, 0, 0);
+                batch.batch_push_vertex(x + 4, y + 4, 1, 1);
+                batch.batch_push_vertex(x, y + 4, 0, 1);
+                batch.batch_push_vertex(x, y, 0, 0);
+                batch.batch_push_vertex(x + 4, y, 1, 0);
+                batch.batch_push_vertex(x + 4, y + 4, 1, 1);
+            }
+            batch.batch_draw_all();
+        }
+        f32 batch_ms = TimeUtil::to_milliseconds(TimeUtil::since(t0)) / FRAMES;
+
+        // 默认的层不排序 每批立即绘制一次
+        r = gfx_recorder();
+        const u32 batches = (N * 6 + capacity - 1) / capacity;
+        std::cout << "batch: " << N * 6 << " vertices per frame, capacity " << capacity << ", " << r.draws / FRAMES << " draws, " << r.buffer_uploads / FRAMES
+                  << " uploads, " << batch_ms << " ms/frame (cpu)" << std::endl;
+
+        ok &= r.draws == batches * FRAMES;
+        ok &= r.vertices == (u64)N * 6 * FRAMES;
+        ok &= r.buffer_uploads == 0 && r.buffer_upload_bytes == 0;
+    } else {
+        std::cout << "stream batch: start with --gfx=null to measure Batch" << std::endl;
+    }
+
+    rt.unbind();
+
+    qr.free_renderer();
+    rt.release();
+
+    gfx_frame_stats() = saved;
+    if (installed) gfx_null_uninstall();
+
+    std::cout << "stream batch: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+// uniform 位置缓存 在空图形后端上反射一个程序 预热后不再调用 glGetUniformLocation
+static const char* g_uniform_cache_source = R"(
+#define MAX_LIGHTS 2
+struct Light {
+    vec2 position;
+    float intensity;
+    float range;
+};
+uniform mat4 camera;
+uniform mat4 view;
+uniform vec3 ambient_light;
+uniform int light_count;
+uniform sampler2D textures[32];
+uniform Light lights[MAX_LIGHTS];
+layout(std140) uniform NekoFrame {
+    mat4 projection;
+};
+void main() {}
+)";
+
+int Test_UniformCache() {
+    constexpr u32 FRAMES = 1000;
+
+    bool installed = gfx_null_install();  // 以 --gfx=null 启动时已经安装
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &g_uniform_cache_source, nullptr);
+    glCompileShader(vs);
+    const u32 shader = glCreateProgram();
+    glAttachShader(shader, vs);
+    glLinkProgram(shader);
+
+    gfx_recorder_reset();
+    neko_shader_reflect(shader);
+    u32 reflect_calls = gfx_recorder_calls("glGetUniformLocation");
+    gfx_recorder_reset();
+
+    // 与 renderer_flush 相同的查询 外加一个着色器里没有的名字
+    // 位置按反射时查询的顺序分配 textures[0..31] 为 4..35 lights 的成员从 36 开始
+    bool ok = true;
+    u64 lookups = 0;
+    u32 warmup_calls = 0;
+    u64 t0 = TimeUtil::now();
+    for (u32 f = 0; f < FRAMES; f++) {
+        char name[64];
+        for (u32 i = 0; i < 32; i++) {
+            sprintf(name, "textures[%u]", i);
+            ok &= neko_shader_uniform(shader, name) == (GLint)(4 + i);
+        }
+        for (u32 i = 0; i < 2; i++) {
+            sprintf(name, "lights[%u].position", i);
+            ok &= neko_shader_uniform(shader, name) == (GLint)(36 + i * 3);
+            sprintf(name, "lights[%u].intensity", i);
+            ok &= neko_shader_uniform(shader, name) == (GLint)(37 + i * 3);
+            sprintf(name, "lights[%u].range", i);
+            ok &= neko_shader_uniform(shader, name) == (GLint)(38 + i * 3);
+        }
+        ok &= neko_shader_uniform(shader, "camera") == 0;
+        ok &= neko_shader_uniform(shader, "textures") == 4;
+        ok &= neko_shader_uniform(shader, "not_in_shader") == -1;
+        lookups += 32 + 6 + 3;
+
+        if (f == 0) {
+            warmup_calls = gfx_recorder_calls("glGetUniformLocation");
+            gfx_recorder_reset();
+        }
+    }
+    f32 ms = TimeUtil::to_milliseconds(TimeUtil::since(t0));
+    u32 steady_calls = gfx_recorder_calls("glGetUniformLocation");
+
+    std::cout << "uniform cache: " << reflect_calls << " lookups at reflect, " << warmup_calls << " in first frame, " << steady_calls << " in the next " << FRAMES - 1 << " frames, "
+              << ms * 1e6f / lookups << " ns/lookup" << std::endl;
+
+    ok &= reflect_calls > 0;
+    ok &= warmup_calls == 1;  // not_in_shader
+    ok &= steady_calls == 0;
+
+    // 删除后重新链接 程序 id 被重用
+    neko_shader_forget(shader);
+    neko_shader_reflect(shader);
+    ok &= neko_shader_uniform(shader, "lights[1].range") == 41;
+    neko_shader_forget(shader);
+
+    glDeleteProgram(shader);
+    glDeleteShader(vs);
+    if (installed) gfx_null_uninstall();
+
+    std::cout << "uniform cache: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+// 共享 uniform 块 在空后端上记录一帧中设置 uniform 与上传 uniform 缓冲的调用次数
+int Test_UniformBlocks() {
+    constexpr u32 FRAMES = 4;
+    constexpr u32 LIGHTS = max_lights;
+    constexpr u32 QUADS = 500;  // 不超过一批 每帧只 flush 一次
+
+    // 着色器资源在安装前加载 资源缓存里的程序始终是真实的句柄
+    Asset shader = {};
+    bool ok = asset_load_kind(AssetKind_Shader, "@code/game/shader/sprite2.glsl", &shader);
+    if (!ok) {
+        std::cout << "uniform blocks: sprite shader not found" << std::endl;
+        return 1;
+    }
+
+    bool installed = gfx_null_install();  // 以 --gfx=null 启动时已经安装
+    GfxFrameStats saved = gfx_frame_stats();
+
+    RenderTarget rt = {};
+    rt.create(256, 256);
+
+    QuadRenderer qr = {};
+    qr.new_renderer(assets_get<AssetShader>(shader), neko_v2(256, 256));
+    qr.ambient_light = 0.5f;
+    ok &= qr.stream.persistent;  // 顶点不经过 glBufferSubData 上传
+
+    rt.bind();
+
+    gfx_recorder_reset();
+    for (u32 f = 0; f < FRAMES; f++) {
+        the<Renderer>().UpdateFrameConstants(the<Camera>().GetInverseViewMatrix(), neko_v2(256, 256), (f32)f / 60.f);
+
+        for (u32 i = 0; i < LIGHTS; i++) {
+            qr.renderer_push_light(light{.position = {(f32)(i % 16) * 16, (f32)(i / 16) * 16}, .range = 64.0f, .intensity = 0.5f});
+        }
+        for (u32 i = 0; i < QUADS; i++) {
+            TexturedQuad quad = {
+                    .texture = NULL,
+                    .position = {(f32)(i % 64) * 4, (f32)(i / 64) * 4},
+                    .dimentions = {4, 4},
+                    .rect = {0},
+                    .color = make_color(0xffffff, 255),
+            };
+            qr.renderer_push(&quad);
+        }
+        qr.renderer_end_frame();
+    }
+
+    rt.unbind();
+
+    // 逐个设置时每帧 3 * LIGHTS + 1 次光源 另加 camera view ambient_light
+    const GfxRecorder& r = gfx_recorder();
+    u32 uniforms = r.uniforms / FRAMES;
+    u32 ubo_uploads = gfx_recorder_calls("glBufferSubData") / FRAMES;
+    std::cout << "uniform blocks: " << LIGHTS << " lights, " << uniforms << " uniform calls and " << ubo_uploads << " uniform buffer uploads per frame, was "
+              << 3 * LIGHTS + 1 + 3 << " uniform calls" << std::endl;
+
+    ok &= r.uniforms == 3 * FRAMES;                                   // camera view ambient_light
+    ok &= gfx_recorder_calls("glUniformMatrix4fv") == 2 * FRAMES;     // camera view
+    ok &= gfx_recorder_calls("glUniform1f") == FRAMES;                // ambient_light
+    ok &= gfx_recorder_calls("glBufferSubData") == (1 + 2) * FRAMES;  // NekoFrame NekoLights (光源 + light_count)
+
+    qr.free_renderer();
+    rt.release();
+
+    gfx_frame_stats() = saved;
+    if (installed) gfx_null_uninstall();
+
+    std::cout << "uniform blocks: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+// 检查合并结果: 每次绘制内状态相同 相邻绘制状态不同 顶点总数不变
+static bool render_queue_check(RenderQueue* q) {
+    bool ok = true;
+    u64 vertices = 0, submitted = 0;
+    for (u64 i = 0; i < q->commands.len; i++) submitted += q->commands[i].count;
+    for (u64 i = 0; i < q->counts.len; i++) vertices += q->counts[i];
+    ok &= vertices == submitted;
+
+    for (u64 d = 0; d < q->draws.len; d++) {
+        u32 begin = q->draws[d].command;
+        u32 end = d + 1 < q->draws.len ? q->draws[d + 1].command : (u32)q->order.len;
+        const RenderCommand* head = &q->commands[q->order[begin]];
+        for (u32 i = begin + 1; i < end; i++) {
+            const RenderCommand* cmd = &q->commands[q->order[i]];
+            ok &= cmd->shader == head->shader && cmd->texture == head->texture && cmd->state == head->state;
+        }
+        if (end < q->order.len) {
+            const RenderCommand* next = &q->commands[q->order[end]];
+            ok &= next->shader != head->shader || next->texture != head->texture || next->state != head->state;
+        }
+    }
+    return ok;
+}
+
+// 命令队列的排序与合并 不调用 GL
+int Test_RenderQueue() {
+    constexpr u32 N = 100000;
+    constexpr u32 TEXTURES = 8;
+
+    bool ok = true;
+    RenderQueue q = {};
+    for (u8 layer : {0, 64, 128, 192}) render_queue_set_layer_sorted(&q, layer, true);
+    ok &= render_queue_layer_sorted(&q, 64) && !render_queue_layer_sorted(&q, 65);
+
+    u64 seed = 0x9E3779B97F4A7C15ull;
+    auto rnd = [&]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+
+    // 随机键 与 std::stable_sort 一致 (键相同时保持提交顺序)
+    for (u32 i = 0; i < N; i++) {
+        RenderCommand cmd = {};
+        cmd.key = render_key((u8)(rnd() % 4 * 64), 1 + rnd() % 3, 1 + rnd() % 16, rnd() % 64);
+        cmd.first = (i32)i;
+        cmd.count = 1;
+        render_queue_submit(&q, cmd);
+    }
+
+    u64 t0 = TimeUtil::now();
+    render_queue_sort(&q);
+    f32 sort_ms = TimeUtil::to_milliseconds(TimeUtil::since(t0));
+
+    std::vector<u32> ref(N);
+    for (u32 i = 0; i < N; i++) ref[i] = i;
+    std::stable_sort(ref.begin(), ref.end(), [&](u32 a, u32 b) { return q.commands[a].key < q.commands[b].key; });
+    ok &= memcmp(ref.data(), q.order.data, N * sizeof(u32)) == 0;
+
+    render_queue_merge(&q);
+    ok &= render_queue_check(&q);
+    render_queue_clear(&q);
+
+    // 开启排序的层: 精灵轮流使用 TEXTURES 张纹理 每换一次纹理提交 6 个顶点 按纹理分组
+    auto submit_sprites = [&](bool contiguous, u32 state_every) {
+        render_queue_clear(&q);
+        for (u32 i = 0; i < N; i++) {
+            u32 tex = i % TEXTURES;
+            RenderCommand cmd = {};
+            cmd.key = render_key(RenderLayer_World, 3, 1 + tex, i);
+            cmd.shader = 3;
+            cmd.texture = 1 + tex;
+            cmd.vao = 1;
+            cmd.mode = GL_TRIANGLES;
+            cmd.first = (i32)(contiguous ? (tex * (N / TEXTURES) + i / TEXTURES) * 6 : i * 6);
+            cmd.count = 6;
+            cmd.state = state_every && i % state_every == 0 ? 1 : 0;
+            render_queue_submit(&q, cmd);
+        }
+        render_queue_sort(&q);
+        t0 = TimeUtil::now();
+        render_queue_merge(&q);
+        return TimeUtil::to_milliseconds(TimeUtil::since(t0));
+    };
+
+    f32 merge_ms = submit_sprites(false, 0);
+    RenderQueueStats s = q.stats;
+    std::cout << "render queue: " << N << " commands, " << TEXTURES << " textures -> " << s.draws << " draws, " << s.ranges << " ranges, " << s.texture_binds << " texture binds"
+              << std::endl;
+    ok &= s.draws == TEXTURES && s.texture_binds == TEXTURES && s.shader_binds == 1 && s.ranges == N;
+    ok &= render_queue_check(&q);
+
+    // 同一结果再做一次 完全一致
+    Array<i32> firsts = {};
+    firsts.resize(q.firsts.len);
+    memcpy(firsts.data, q.firsts.data, q.firsts.len * sizeof(i32));
+    submit_sprites(false, 0);
+    ok &= firsts.len == q.firsts.len && memcmp(firsts.data, q.firsts.data, firsts.len * sizeof(i32)) == 0;
+    firsts.trash();
+
+    // 同一纹理的顶点相接时合并为一段
+    submit_sprites(true, 0);
+    std::cout << "render queue: contiguous -> " << q.stats.draws << " draws, " << q.stats.ranges << " ranges" << std::endl;
+    ok &= q.stats.draws == TEXTURES && q.stats.ranges == TEXTURES;
+    ok &= render_queue_check(&q);
+
+    // 状态不同的命令打断合并
+    submit_sprites(false, 100);
+    std::cout << "render queue: 1% other state -> " << q.stats.draws << " draws" << std::endl;
+    ok &= q.stats.draws > TEXTURES;
+    ok &= render_queue_check(&q);
+
+    std::cout << "render queue: sort " << sort_ms << " ms, merge " << merge_ms << " ms for " << N << " commands" << std::endl;
+    std::cout << "render queue: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    render_queue_trash(&q);
+    return ok ? 0 : 1;
+}
+
+// 空图形后端 不需要 GPU 记录 QuadRenderer 与命令队列每帧的绘制和状态切换
+int Test_GfxNull() {
+    constexpr u32 N = 10000;
+    constexpr u32 FRAMES = 8;
+    constexpr u32 QUAD_BATCH = 2048;  // renderer.cpp batch_size
+    constexpr u32 TEXTURES = 8;
+
+    // 着色器资源在安装前加载 资源缓存里的程序始终是真实的句柄
+    Asset shader = {};
+    bool ok = asset_load_kind(AssetKind_Shader, "@code/game/shader/sprite2.glsl", &shader);
+    if (!ok) {
+        std::cout << "gfx null: sprite shader not found" << std::endl;
+        return 1;
+    }
+
+    bool installed = gfx_null_install();  // 以 --gfx=null 启动时已经安装
+
+    GfxNullObjects before = gfx_null_objects();
+    GfxFrameStats saved = gfx_frame_stats();
+
+    RenderTarget rt = {};
+    rt.create(256, 256);
+
+    QuadRenderer qr = {};
+    qr.new_renderer(assets_get<AssetShader>(shader), neko_v2(256, 256));
+    ok &= qr.stream.persistent;  // 空后端提供 glBufferStorage
+
+    rt.bind();
+
+    gfx_recorder_reset();
+    u64 t0 = TimeUtil::now();
+    for (u32 f = 0; f < FRAMES; f++) {
+        for (u32 i = 0; i < N; i++) {
+            TexturedQuad quad = {
+                    .texture = NULL,
+                    .position = {(f32)(i % 256), (f32)((i / 256) % 256)},
+                    .dimentions = {4, 4},
+                    .rect = {0},
+                    .color = make_color(0xffffff, 255),
+            };
+            qr.renderer_push(&quad);
+        }
+        qr.renderer_end_frame();
+    }
+    f32 quad_ms = TimeUtil::to_milliseconds(TimeUtil::since(t0)) / FRAMES;
+
+    GfxRecorder r = gfx_recorder();
+    const u32 quad_draws = (N + QUAD_BATCH - 1) / QUAD_BATCH;
+    std::cout << "gfx null: " << N << " quads, " << r.draws / FRAMES << " draws, " << r.state_changes / FRAMES << " state changes, " << r.redundant / FRAMES << " redundant, "
+              << r.uniforms / FRAMES << " uniforms, " << r.calls / FRAMES << " calls, " << quad_ms << " ms/frame (cpu)" << std::endl;
+
+    ok &= r.draws == quad_draws * FRAMES;
+    ok &= r.vertices == (u64)N * 6 * FRAMES;
+    ok &= gfx_recorder_calls("glBufferSubData") <= 1;       // 没有光源 只在第一帧上传 light_count
+    ok &= gfx_recorder_calls("glGetUniformLocation") == 0;  // 已缓存
+    ok &= r.fences == FRAMES;
+
+    rt.unbind();
+
+    // 命令队列 轮流使用 TEXTURES 张纹理 开启排序的层合并后每张纹理一次绘制
+    GLuint textures[TEXTURES];
+    glGenTextures(TEXTURES, textures);
+    for (u32 i = 0; i < TEXTURES; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 64, 64, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    ok &= gfx_null_objects().texture_bytes - before.texture_bytes >= TEXTURES * 64 * 64 * 4;
+
+    RenderQueue q = {};
+    auto submit_queue = [&]() {
+        gfx_recorder_reset();
+        for (u32 i = 0; i < N; i++) {
+            RenderCommand cmd = {};
+            cmd.shader = assets_get<AssetShader>(shader).id;
+            cmd.texture = textures[i % TEXTURES];
+            cmd.key = render_key(RenderLayer_World, cmd.shader, cmd.texture, i);
+            cmd.vao = qr.vb.va_id;
+            cmd.mode = GL_TRIANGLES;
+            cmd.first = (i32)i * 6;
+            cmd.count = 6;
+            render_queue_submit(&q, cmd);
+        }
+        u32 queued = (u32)q.commands.len;
+        render_queue_flush(&q);
+        return queued;
+    };
+
+    // 默认的层不排序 提交时按原顺序立即绘制
+    u32 queued = submit_queue();
+    r = gfx_recorder();
+    std::cout << "gfx null: unsorted layer " << N << " commands -> " << r.draws << " draws, " << r.texture_binds << " texture binds" << std::endl;
+    ok &= queued == 0 && r.draws == N && r.texture_binds == N;
+
+    render_queue_set_layer_sorted(&q, RenderLayer_World, true);
+    queued = submit_queue();
+    r = gfx_recorder();
+    std::cout << "gfx null: render queue " << N << " commands -> " << r.draws << " draws, " << r.texture_binds << " texture binds, " << r.program_binds << " program binds"
+              << std::endl;
+    ok &= queued == N && r.draws == TEXTURES && r.texture_binds == TEXTURES && r.program_binds <= 1;
+
+    render_queue_trash(&q);
+    glDeleteTextures(TEXTURES, textures);
+    qr.free_renderer();
+    rt.release();
+
+    // 创建的对象全部释放
+    const GfxNullObjects& after = gfx_null_objects();
+    ok &= after.textures == before.textures && after.buffers == before.buffers && after.vertex_arrays == before.vertex_arrays && after.framebuffers == before.framebuffers;
+
+    gfx_frame_stats() = saved;
+    if (installed) gfx_null_uninstall();
+
+    std::cout << "gfx null: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+// 后处理 pass 图 与原来每个效果各自持有全分辨率目标相比 池中目标的数量与纹理内存
+int Test_RenderGraph() {
+    constexpr u32 W = 640, H = 360;
+    constexpr u64 RGB8 = 3;
+
+    const char* files[] = {
+            "@code/game/shader/post_bright.glsl",   "@code/game/shader/post_blur_h.glsl",    "@code/game/shader/post_blur_v.glsl",
+            "@code/game/shader/post_vignette.glsl", "@code/game/shader/post_composite.glsl",
+    };
+    for (const char* file : files) {
+        Asset shader = {};
+        if (!asset_load_kind(AssetKind_Shader, file, &shader)) {
+            std::cout << "render graph: " << file << " not found" << std::endl;
+            return 1;
+        }
+    }
+
+    bool installed = gfx_null_install();
+
+    GfxNullObjects before = gfx_null_objects();
+    GfxFrameStats saved = gfx_frame_stats();
+
+    PostProcessor bright = {}, blur_h = {}, blur_v = {}, vignette = {}, composite = {};
+    bright.create(files[0], false);
+    blur_h.create(files[1], false);
+    blur_v.create(files[2], false);
+    vignette.create(files[3], false);
+    composite.create(files[4], false);
+
+    RenderTarget scene = {};
+    scene.create(W, H);
+
+    RenderGraph g = {};
+    RenderResourceId source = render_graph_import(&g, "scene", &scene);
+    RenderResourceId r_bright = render_graph_transient(&g, "bright", 1);
+    RenderResourceId r_blur_h = render_graph_transient(&g, "blur_h", 1);
+    RenderResourceId r_bloom = render_graph_transient(&g, "bloom", 1);
+    RenderResourceId r_vignette = render_graph_transient(&g, "vignette");
+    RenderResourceId r_unused = render_graph_transient(&g, "unused");
+    render_graph_pass(&g, "bright", &bright, source, RenderResource_None, r_bright);
+    render_graph_pass(&g, "blur_h", &blur_h, r_bright, RenderResource_None, r_blur_h);
+    render_graph_pass(&g, "blur_v", &blur_v, r_blur_h, RenderResource_None, r_bloom);
+    render_graph_pass(&g, "vignette", &vignette, source, RenderResource_None, r_vignette);
+    render_graph_pass(&g, "unused", &vignette, source, RenderResource_None, r_unused);  // 没有被读取 应被剔除
+    render_graph_pass(&g, "composite", &composite, r_vignette, r_bloom, RenderResource_Screen);
+
+    render_graph_execute(&g, W, H);
+
+    // 原来: blur_h blur_v composite 三个全分辨率目标
+    const u64 old_bytes = 3 * (u64)W * H * RGB8;
+    const u64 expect_bytes = (u64)W * H * RGB8 + 2 * (u64)(W / 2) * (H / 2) * RGB8;
+    std::cout << "render graph: " << g.stats.passes << " passes, " << g.stats.culled << " culled, " << g.stats.transients << " transients, " << g.stats.targets
+              << " targets, " << g.stats.target_bytes / 1024 << " KiB (was 3 targets, " << old_bytes / 1024 << " KiB)" << std::endl;
+
+    bool ok = true;
+    ok &= g.stats.passes == 5 && g.stats.culled == 1 && g.stats.transients == 4;
+    ok &= g.stats.targets == 3 && g.stats.target_bytes == expect_bytes;
+    ok &= render_graph_target(&g, r_bloom) != nullptr && render_graph_target(&g, r_bloom)->width == W / 2;
+    ok &= render_graph_target(&g, r_unused) == nullptr;
+
+    // 之后的帧只复用池中的目标
+    gfx_recorder_reset();
+    render_graph_execute(&g, W, H);
+    GfxRecorder r = gfx_recorder();
+    ok &= r.draws == 5 && r.created == 0 && r.deleted == 0;
+
+    // 改变大小后 旧的目标在空闲几帧后被释放
+    for (u32 f = 0; f < 5; f++) render_graph_execute(&g, W / 2, H / 2);
+    ok &= g.stats.targets == 3 && g.stats.target_bytes == expect_bytes / 4;
+
+    render_graph_trash(&g);
+    scene.release();
+    bright.release();
+    blur_h.release();
+    blur_v.release();
+    vignette.release();
+    composite.release();
+
+    const GfxNullObjects& after = gfx_null_objects();
+    ok &= after.textures == before.textures && after.framebuffers == before.framebuffers;
+
+    gfx_frame_stats() = saved;
+    if (installed) gfx_null_uninstall();
+
+    std::cout << "render graph: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+// 运行时图集 轮流使用许多小纹理时 放入图集前后每帧的绘制次数 以及热重载时的原位更新与整理
+int Test_TextureAtlas() {
+    constexpr u32 TEXTURES = 48;
+    constexpr u32 N = 4096;
+    constexpr u32 FRAMES = 4;
+    constexpr u32 QUAD_BATCH = 2048;  // renderer.cpp batch_size
+
+    Asset shader = {};
+    bool ok = asset_load_kind(AssetKind_Shader, "@code/game/shader/sprite2.glsl", &shader);
+    if (!ok) {
+        std::cout << "texture atlas: sprite shader not found" << std::endl;
+        return 1;
+    }
+
+    bool installed = gfx_null_install();  // 以 --gfx=null 启动时已经安装 这时也测量 Batch
+
+    GfxNullObjects before = gfx_null_objects();
+    GfxFrameStats saved = gfx_frame_stats();
+
+    // 换成测试自己的图集 结束后恢复
+    TextureAtlas saved_atlas = texture_atlas();
+    texture_atlas() = {};
+    texture_atlas().enabled = true;
+    TextureAtlas& atlas = texture_atlas();
+
+    static u8 pixels[64 * 64 * 4];
+    for (u32 i = 0; i < NEKO_ARR_SIZE(pixels); i++) pixels[i] = (u8)i;
+
+    AssetTexture textures[TEXTURES] = {};
+    for (u32 i = 0; i < TEXTURES; i++) {
+        texture_create(&textures[i], pixels, 8 + (i * 7) % 57, 8 + (i * 13) % 57, 4, TEXTURE_ALIASED);
+    }
+    ok &= atlas.stats.entries == TEXTURES && atlas.stats.pages == 1;
+
+    TextureAtlasRegion region = {};
+    ok &= texture_atlas_find(&atlas, textures[5].id, &region);
+    ok &= (u32)((region.u1 - region.u0) * TEXTURE_ATLAS_PAGE_SIZE + 0.5f) == (u32)textures[5].width;
+
+    QuadRenderer qr = {};
+    qr.new_renderer(assets_get<AssetShader>(shader), neko_v2(256, 256));
+
+    auto quad_frames = [&]() {
+        gfx_recorder_reset();
+        for (u32 f = 0; f < FRAMES; f++) {
+            for (u32 i = 0; i < N; i++) {
+                AssetTexture* tex = &textures[i % TEXTURES];
+                TexturedQuad quad = {
+                        .texture = tex,
+                        .position = {(f32)(i % 256), (f32)((i / 256) % 256)},
+                        .dimentions = {4, 4},
+                        .rect = {0, 0, (f32)tex->width, (f32)tex->height},
+                        .color = make_color(0xffffff, 255),
+                };
+                qr.renderer_push(&quad);
+            }
+            qr.renderer_end_frame();
+        }
+        return gfx_recorder().draws / FRAMES;
+    };
+
+    atlas.enabled = false;
+    u32 quad_before = quad_frames();
+    atlas.enabled = true;
+    u32 quad_after = quad_frames();
+    std::cout << "texture atlas: quads " << N << " over " << TEXTURES << " textures, " << quad_before << " -> " << quad_after << " draws per frame" << std::endl;
+    ok &= quad_after == (N + QUAD_BATCH - 1) / QUAD_BATCH && quad_after < quad_before;
+
+    // Batch 只在整个程序使用空后端时可以测量
+    if (!installed) {
+        Batch& batch = the<Batch>();
+        batch.batch_draw_all();
+
+        auto batch_frames = [&]() {
+            gfx_recorder_reset();
+            for (u32 f = 0; f < FRAMES; f++) {
+                for (u32 i = 0; i < N; i++) {
+                    f32 x = (f32)(i % 256), y = (f32)((i / 256) % 256);
+                    batch.batch_texture(textures[i % TEXTURES].id);
+                    batch.batch_push_vertex(x, y, 0, 0);
+                    batch.batch_push_vertex(x + 4, y + 4, 1, 1);
+                    batch.batch_push_vertex(x, y + 4, 0, 1);
+                    batch.batch_push_vertex(x, y, 0, 0);
+                    batch.batch_push_vertex(x + 4, y, 1, 0);
+                    batch.batch_push_vertex(x + 4, y + 4, 1, 1);
+                }
+                batch.batch_draw_all();
+            }
+            return gfx_recorder().draws / FRAMES;
+        };
+
+        atlas.enabled = false;
+        u32 batch_before = batch_frames();
+        atlas.enabled = true;
+        u32 batch_after = batch_frames();
+        std::cout << "texture atlas: batch " << N << " sprites, " << batch_before << " -> " << batch_after << " draws per frame" << std::endl;
+        ok &= batch_after * 8 < batch_before;
+    } else {
+        std::cout << "texture atlas: start with --gfx=null to measure Batch" << std::endl;
+    }
+
+    // 热重载 同样大小的纹理换了句柄也原位更新 不放入新位置
+    u32 packs = atlas.stats.packs, updates = atlas.stats.updates;
+    ok &= texture_atlas_find(&atlas, textures[3].id, &region);
+    TextureAtlasRegion reloaded = {};
+    texture_create(&textures[3], pixels, textures[3].width, textures[3].height, 4, TEXTURE_ALIASED);
+    ok &= texture_atlas_find(&atlas, textures[3].id, &reloaded) && reloaded.u0 == region.u0 && reloaded.v0 == region.v0;
+    ok &= atlas.stats.packs == packs && atlas.stats.updates == updates + 1 && atlas.stats.entries == TEXTURES && atlas.pages[0].dead_area == 0;
+
+    // 释放大半以后整理 剩下的纹理仍在图集中
+    for (u32 i = 0; i < TEXTURES; i += 4) {
+        for (u32 j = i; j < i + 3; j++) texture_release(&textures[j]);
+    }
+    texture_atlas_compact(&atlas);
+    ok &= atlas.stats.repacks == 1 && atlas.pages[0].dead_area == 0 && atlas.stats.entries == TEXTURES / 4;
+    for (u32 i = 3; i < TEXTURES; i += 4) ok &= texture_atlas_find(&atlas, textures[i].id, &region);
+    std::cout << "texture atlas: " << atlas.stats.pages << " pages, " << atlas.stats.entries << " entries, " << atlas.stats.used_bytes / 1024 << " KiB used, "
+              << atlas.stats.packs << " packs, " << atlas.stats.updates << " updates, " << atlas.stats.repacks << " repacks" << std::endl;
+
+    for (u32 i = 3; i < TEXTURES; i += 4) texture_release(&textures[i]);
+    qr.free_renderer();
+    texture_atlas_trash(&atlas);
+    texture_atlas() = saved_atlas;
+
+    const GfxNullObjects& after = gfx_null_objects();
+    ok &= after.textures == before.textures && after.buffers == before.buffers;
+
+    gfx_frame_stats() = saved;
+    if (installed) gfx_null_uninstall();
+
+    std::cout << "texture atlas: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
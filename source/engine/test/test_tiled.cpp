@@ -0,0 +1,787 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "base/common/job.hpp"
+#include "base/common/os.hpp"
+#include "engine/asset.h"
+#include "engine/bootstrap.h"
+#include "engine/components/camera.h"
+#include "engine/components/pathfind.h"
+#include "engine/components/tiledmap.hpp"
+
+// deps
+#include <box2d/box2d.h>
+#include <miniz/miniz.h>
+
+// 生成一个只有图块数据的地图 (不加载 tmx)
+static TiledMap make_test_map(u32 width, u32 height) {
+    TiledMap map = {};
+
+    tileset_t tileset = {};
+    tileset.tile_width = 16;
+    tileset.tile_height = 16;
+    tileset.width = 256;
+    tileset.height = 256;
+    tileset.first_gid = 1;
+    tileset.tile_count = 256;
+    map.tilesets.push(tileset);
+
+    layer_t layer = {};
+    layer.width = width;
+    layer.height = height;
+    layer.tint = Color256{{{255, 255, 255, 255}}};
+    layer.tiles = (tile_t*)mem_alloc(sizeof(tile_t) * width * height);
+    for (u32 y = 0; y < height; y++) {
+        for (u32 x = 0; x < width; x++) {
+            tile_t* tile = &layer.tiles[x + y * width];
+            tile->id = (x + y) % 17 == 0 ? 0 : 1 + (x * 7 + y) % 15;  // 留一些空格子
+            tile->tileset_id = 0;
+        }
+    }
+    map.layers.push(layer);
+    return map;
+}
+
+static void free_test_map(TiledMap* map) {
+    for (layer_t& layer : map->layers) mem_free(layer.tiles);
+    map->layers.trash();
+    map->tilesets.trash();
+}
+
+// 1024x1024 的图块层 比较每帧重新生成所有图块与缓存区块网格的 CPU 耗时
+int Test_TiledChunkMesh() {
+    constexpr u32 W = 1024, H = 1024;
+    constexpr int FRAMES = 10;
+
+    TiledMap map = make_test_map(W, H);
+
+    u32 expect = 0;
+    for (u32 i = 0; i < W * H; i++) expect += map.layers[0].tiles[i].id != 0;
+
+    // 每帧重新生成所有图块的顶点 (原来的做法 不含逐个四边形的 glBufferSubData)
+    Array<TiledVertex> verts = {};
+    Array<TiledChunkBatch> batches = {};
+    BBox bounds;
+    u64 t = TimeUtil::now();
+    u32 quads = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        quads = 0;
+        for (u32 cy = 0; cy < H / TILED_CHUNK_SIZE; cy++) {
+            for (u32 cx = 0; cx < W / TILED_CHUNK_SIZE; cx++) {
+                tiled_chunk_fill(&map, 0, cx, cy, &verts, &batches, &bounds);
+                quads += (u32)(verts.len / VERTS_PER_QUAD);
+            }
+        }
+    }
+    double regen_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / FRAMES;
+    bool ok = quads == expect;
+
+    TiledMesh mesh = {};
+    t = TimeUtil::now();
+    tiled_mesh_update(&mesh, &map, 1, 0);
+    double build_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    ok &= mesh.rebuilt == mesh.chunks.len && mesh.chunks.len == (W / TILED_CHUNK_SIZE) * (H / TILED_CHUNK_SIZE);
+
+    u32 total = 0;
+    for (TiledChunk& chunk : mesh.chunks) total += chunk.quad_count;
+    ok &= total == expect;
+
+    CameraCullStats& stats = the<Camera>().camera_get_cull_stats();
+    CameraCullStats saved = stats;
+    stats = {};
+
+    // 区块作为命令提交到排序的层 只有一个图块集时整帧只绑定一次纹理
+    RenderQueue q = {};
+    render_queue_set_layer_sorted(&q, RenderLayer_Background, true);
+    t = TimeUtil::now();
+    for (int f = 0; f < FRAMES; f++) {
+        tiled_mesh_submit(&mesh, &q, luavec2(0.f, 0.f), RenderLayer_Background);
+        render_queue_flush(&q);
+    }
+    double draw_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / FRAMES;
+    ok &= stats.tiles == expect * FRAMES;
+    u32 visible = stats.tiles_visible / FRAMES;
+    ok &= visible == 0 || (q.stats.texture_binds == 1 && q.stats.shader_binds == 1 && q.stats.draws == q.stats.commands);
+    stats = saved;
+    render_queue_trash(&q);
+
+    // 修改一个图块只重建所在区块
+    map.layers[0].tiles[100 + 200 * W].id = 0;
+    tiled_mesh_invalidate(&mesh, 0, 100, 200);
+    t = TimeUtil::now();
+    tiled_mesh_update(&mesh, &map, 1, 0);
+    double edit_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    ok &= mesh.rebuilt == 1;
+
+    // 地图重新加载 (修改时间改变) 后整体重建
+    tiled_mesh_update(&mesh, &map, 1, 1);
+    ok &= mesh.rebuilt == mesh.chunks.len;
+
+    std::cout << "tiled " << W << "x" << H << ": regenerate every frame " << regen_ms << " ms/frame, chunk mesh build " << build_ms << " ms, cached draw " << draw_ms << " ms/frame ("
+              << visible << "/" << expect << " tiles visible), edit one tile " << edit_ms << " ms" << std::endl;
+    std::cout << "tiled chunk mesh: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    tiled_mesh_free(&mesh);
+    verts.trash();
+    batches.trash();
+    free_test_map(&map);
+    return ok ? 0 : 1;
+}
+
+static std::string base64_encode(const u8* data, u64 len) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    u64 i = 0;
+    for (; i + 2 < len; i += 3) {
+        u32 v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out += alphabet[v >> 18];
+        out += alphabet[(v >> 12) & 63];
+        out += alphabet[(v >> 6) & 63];
+        out += alphabet[v & 63];
+    }
+    if (len - i == 1) {
+        u32 v = data[i] << 16;
+        out += alphabet[v >> 18];
+        out += alphabet[(v >> 12) & 63];
+        out += "==";
+    } else if (len - i == 2) {
+        u32 v = (data[i] << 16) | (data[i + 1] << 8);
+        out += alphabet[v >> 18];
+        out += alphabet[(v >> 12) & 63];
+        out += alphabet[(v >> 6) & 63];
+        out += '=';
+    }
+    return out;
+}
+
+// 生成 2048x2048 4 层的 tmx (csv/csv/base64/base64+zlib) 比较流式加载与原来的 DOM 解析
+int Test_TmxStreamingLoad() {
+    constexpr u32 W = 2048, H = 2048, N = W * H;
+
+    // 与 assets/maps/map.tmx 使用相同的图块集
+    std::mt19937 rng(2048);
+    Array<u32> gids[4] = {};
+    for (int l = 0; l < 4; l++) {
+        gids[l].resize(N);
+        for (u32 i = 0; i < N; i++) {
+            u32 gid = rng() % 400;
+            if (rng() % 64 == 0) gid |= 0x80000000u;  // 水平翻转标记
+            gids[l][i] = gid;
+        }
+    }
+
+    std::string tmx = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    tmx += "<map version=\"1.10\" orientation=\"orthogonal\" width=\"2048\" height=\"2048\" tilewidth=\"16\" tileheight=\"16\" infinite=\"0\">\n";
+    tmx += " <tileset firstgid=\"1\" source=\"tileset.tsx\"/>\n";
+    tmx += " <tileset firstgid=\"257\" source=\"tx_grass.tsx\"/>\n";
+    for (int l = 0; l < 4; l++) {
+        tmx += " <layer id=\"" + std::to_string(l + 1) + "\" name=\"layer\" width=\"2048\" height=\"2048\">\n";
+        if (l < 2) {
+            tmx += "  <data encoding=\"csv\">\n";
+            for (u32 i = 0; i < N; i++) {
+                tmx += std::to_string(gids[l][i]);
+                if (i + 1 < N) tmx += ',';
+                if (i % W == W - 1) tmx += '\n';
+            }
+        } else if (l == 2) {
+            tmx += "  <data encoding=\"base64\">\n   ";
+            tmx += base64_encode((u8*)gids[l].data, (u64)N * sizeof(u32));
+            tmx += "\n";
+        } else {
+            mz_ulong packed_len = mz_compressBound(N * sizeof(u32));
+            u8* packed = (u8*)mem_alloc(packed_len);
+            mz_compress(packed, &packed_len, (u8*)gids[l].data, N * sizeof(u32));
+            tmx += "  <data encoding=\"base64\" compression=\"zlib\">\n   ";
+            tmx += base64_encode(packed, packed_len);
+            tmx += "\n";
+            mem_free(packed);
+        }
+        tmx += "  </data>\n </layer>\n";
+    }
+    tmx += "</map>\n";
+
+    TiledMap map = {};
+    u64 t = TimeUtil::now();
+    bool ok = tiled_load_source(&map, String(tmx), "@gamedata/assets/maps");
+    double stream_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    ok = ok && map.layers.len == 4 && map.tilesets.len == 2;
+    for (u32 l = 0; ok && l < 4; l++) {
+        layer_t* layer = &map.layers[l];
+        ok = layer->width == W && layer->height == H;
+        for (u32 i = 0; ok && i < N; i++) {
+            u32 gid = gids[l][i] & 0x0fffffffu;
+            u32 tileset = gid >= 257 ? 1 : 0;
+            ok = layer->tiles[i].id == gid && layer->tiles[i].tileset_id == tileset;
+        }
+    }
+
+    // 原来的加载先建立整个 DOM 这里只计 DOM 解析
+    XMLDoc doc = {};
+    t = TimeUtil::now();
+    doc.Parse(String(tmx));
+    double dom_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    doc.Trash();
+
+    std::cout << "tmx " << W << "x" << H << "x4 (" << tmx.size() / (1024 * 1024) << " MB): streaming load " << stream_ms << " ms, dom parse only " << dom_ms << " ms" << std::endl;
+    std::cout << "tmx streaming load: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    tiled_unload(&map);
+    for (auto& g : gids) g.trash();
+    return ok ? 0 : 1;
+}
+
+static float tile_path_cost(TileNode* end) {
+    float cost = 0;
+    for (TileNode* n = end; n != nullptr && n->prev != nullptr; n = n->prev) {
+        float dx = (float)(n->x - n->prev->x);
+        float dy = (float)(n->y - n->prev->y);
+        cost += n->cost * sqrtf(dx * dx + dy * dy);
+    }
+    return cost;
+}
+
+static float tile_path_cost(Array<TilePoint>& path) {
+    float cost = 0;
+    for (u64 i = 1; i < path.len; i++) {
+        bool diagonal = path[i].x != path[i - 1].x && path[i].y != path[i - 1].y;
+        cost += diagonal ? 1.4142135f : 1.0f;
+    }
+    return cost;
+}
+
+// 512x512 的 LDtk IntGrid 层 (房间之间的墙上开门) 比较哈希图 astar 与稠密网格 A*/JPS
+int Test_TileGridPath() {
+    constexpr i32 W = 512, H = 512;
+    constexpr int QUERIES = 100;
+    constexpr float GRID = 16;
+
+    // 0 可通行 1 为墙
+    Array<TilemapInt> cells = {};
+    cells.resize(W * H);
+    for (i32 y = 0; y < H; y++) {
+        for (i32 x = 0; x < W; x++) {
+            bool wall = (x % 32 == 31 && (y % 32) / 4 != 3) || (y % 32 == 31 && (x % 32) / 4 != 5);
+            cells[y * W + x] = wall ? 1 : 0;
+        }
+    }
+
+    Array<TilemapLayer> layers = {};
+    TilemapLayer layer = {};
+    layer.identifier = "Grid";
+    layer.c_width = W;
+    layer.c_height = H;
+    layer.int_grid = Slice<TilemapInt>(cells);
+    layer.grid_size = GRID;
+    layers.push(layer);
+
+    Array<TilemapLevel> levels = {};
+    TilemapLevel level = {};
+    level.layers = Slice<TilemapLayer>(layers);
+    levels.push(level);
+
+    MapLdtk tm = {};
+    tm.levels = Slice<TilemapLevel>(levels);
+
+    Array<TileCost> floor = {};
+    floor.push(TileCost{0, 1.0f});
+    u64 t = TimeUtil::now();
+    tm.make_graph(1, "Grid", Slice<TileCost>(floor));
+    double build_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    std::mt19937 rng(39);
+    Array<TilePoint> starts = {}, goals = {};
+    while (starts.len < QUERIES) {
+        i32 sx = rng() % W, sy = rng() % H, ex = rng() % W, ey = rng() % H;
+        if (cells[sy * W + sx] || cells[ey * W + ex]) continue;
+        starts.push(TilePoint{sx * GRID + 1, sy * GRID + 1});
+        goals.push(TilePoint{ex * GRID + 1, ey * GRID + 1});
+    }
+
+    Array<float> costs = {};
+    t = TimeUtil::now();
+    for (int i = 0; i < QUERIES; i++) costs.push(tile_path_cost(tm.astar(starts[i], goals[i])));
+    double graph_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / QUERIES;
+
+    bool ok = true;
+    double grid_ms[2] = {};
+    u64 expanded[2] = {};
+    Array<TilePoint> path = {};
+    for (int mode = TileGridMode_AStar; mode <= TileGridMode_JPS; mode++) {
+        t = TimeUtil::now();
+        for (int i = 0; i < QUERIES; i++) {
+            ok &= tm.astar_grid(starts[i], goals[i], (TileGridMode)mode, &path);
+            ok &= fabsf(tile_path_cost(path) - costs[i]) < 0.01f;
+            ok &= path.len > 0 && path[0].x == (i32)(starts[i].x / GRID) && path[path.len - 1].y == (i32)(goals[i].y / GRID);
+            expanded[mode] += tm.grid.search.stats.expanded;
+        }
+        grid_ms[mode] = TimeUtil::to_milliseconds(TimeUtil::since(t)) / QUERIES;
+    }
+
+    // 墙里的点没有路径
+    ok &= !tm.astar_grid(TilePoint{31 * GRID, 0}, goals[0], TileGridMode_JPS, &path) && path.len == 0;
+
+    std::cout << "tile grid " << W << "x" << H << ": make_graph " << build_ms << " ms, hashmap astar " << graph_ms << " ms/query, grid astar " << grid_ms[0] << " ms/query ("
+              << expanded[0] / QUERIES << " expanded), grid jps " << grid_ms[1] << " ms/query (" << expanded[1] / QUERIES << " expanded)" << std::endl;
+    std::cout << "tile grid path: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    path.trash();
+    costs.trash();
+    starts.trash();
+    goals.trash();
+    tm.trash();
+    floor.trash();
+    levels.trash();
+    layers.trash();
+    cells.trash();
+    return ok ? 0 : 1;
+}
+
+static bool tile_path_equal(Array<TilePoint>& a, Array<TilePoint>& b) { return a.len == b.len && (a.len == 0 || memcmp(a.data, b.data, sizeof(TilePoint) * a.len) == 0); }
+
+// 10k 个排队的异步查询 结果必须与同步查询逐格一致 与派发方式无关
+int Test_PathServiceAsync() {
+    constexpr i32 W = 256, H = 256;
+    constexpr int QUERIES = 10000;
+
+    PathService& ps = the<PathService>();
+    ps.path_flush();  // 清掉脚本提交的查询
+
+    TileGrid grid = {};
+    tile_grid_init(&grid, 0, 0, W, H);
+    for (i32 y = 0; y < H; y++) {
+        for (i32 x = 0; x < W; x++) {
+            bool wall = (x % 32 == 31 && (y % 32) / 4 != 3) || (y % 32 == 31 && (x % 32) / 4 != 5);
+            tile_grid_set_cost(&grid, x, y, wall ? -1.0f : 1.0f);
+        }
+    }
+    TileGridSnapshot* snapshot = tile_grid_snapshot(&grid, 16);
+
+    // 少量起点在墙里 没有路径
+    std::mt19937 rng(40);
+    Array<i32> coords = {};
+    for (int i = 0; i < QUERIES * 4; i++) coords.push(rng() % W);
+
+    Array<Array<TilePoint>> expect = {};
+    u64 t = TimeUtil::now();
+    for (int i = 0; i < QUERIES; i++) {
+        Array<TilePoint> path = {};
+        tile_grid_find_path(&grid, coords[i * 4], coords[i * 4 + 1], coords[i * 4 + 2], coords[i * 4 + 3], TileGridMode_JPS, &path);
+        expect.push(path);
+    }
+    double sync_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    Array<PathTicket> tickets = {};
+    Array<TilePoint> path = {};
+    bool ok = true;
+
+    // 一次全部派发
+    t = TimeUtil::now();
+    for (int i = 0; i < QUERIES; i++) tickets.push(ps.path_submit(snapshot, coords[i * 4], coords[i * 4 + 1], coords[i * 4 + 2], coords[i * 4 + 3], TileGridMode_JPS));
+    ps.path_flush();
+    double flush_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    for (int i = 0; i < QUERIES; i++) {
+        PathQueryStatus status = ps.path_take(tickets[i], &path);
+        ok &= status == (expect[i].len > 0 ? PathQuery_Found : PathQuery_NotFound);
+        ok &= tile_path_equal(path, expect[i]);
+        ok &= ps.path_status(tickets[i]) == PathQuery_Invalid;  // 取出后失效
+    }
+
+    // 按每帧预算分批 每次同步最多派发预算内的查询 取消的查询不会交付
+    f32 budget = ps.path_get_budget();
+    ps.path_set_budget(0.5f);
+    tickets.len = 0;
+    for (int i = 0; i < QUERIES; i++) tickets.push(ps.path_submit(snapshot, coords[i * 4], coords[i * 4 + 1], coords[i * 4 + 2], coords[i * 4 + 3], TileGridMode_JPS));
+    for (int i = 0; i < QUERIES; i += 97) ps.path_cancel(tickets[i]);
+
+    int frames = 0;
+    u32 max_batch = 0;
+    t = TimeUtil::now();
+    while (ps.path_pending() > 0) {
+        ps.path_sync();
+        max_batch = NEKO_MAX(max_batch, ps.path_get_stats().in_flight);
+        frames++;
+        std::this_thread::yield();
+    }
+    double budget_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    ps.path_set_budget(budget);
+
+    for (int i = 0; i < QUERIES; i++) {
+        PathQueryStatus status = ps.path_take(tickets[i], &path);
+        if (i % 97 == 0) {
+            ok &= status == PathQuery_Invalid;
+            continue;
+        }
+        ok &= status == (expect[i].len > 0 ? PathQuery_Found : PathQuery_NotFound);
+        ok &= tile_path_equal(path, expect[i]);
+    }
+    ok &= max_batch < QUERIES;
+
+    std::cout << "path service " << QUERIES << " queries on " << W << "x" << H << ": sync " << sync_ms << " ms, async flush " << flush_ms << " ms (" << Job::ThreadCount() << " threads), budgeted "
+              << budget_ms << " ms over " << frames << " syncs (max batch " << max_batch << ", " << ps.path_get_stats().query_ms << " ms/query)" << std::endl;
+    std::cout << "path service: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    for (Array<TilePoint>& p : expect) p.trash();
+    expect.trash();
+    tickets.trash();
+    path.trash();
+    coords.trash();
+    tile_grid_snapshot_release(snapshot);
+    tile_grid_trash(&grid);
+    return ok ? 0 : 1;
+}
+
+// 2048x2048 的房间地图 (墙上开门 另有 8% 随机障碍) 比较平面 A* 与 HPA* 的展开节点数与耗时
+int Test_HpaPath() {
+    constexpr i32 W = 2048, H = 2048;
+    constexpr int QUERIES = 16;
+
+    TileGrid grid = {};
+    tile_grid_init(&grid, 0, 0, W, H);
+    std::mt19937 rng(41);
+    for (i32 y = 0; y < H; y++) {
+        for (i32 x = 0; x < W; x++) {
+            bool wall = (x % 64 == 63 && (y % 64) / 8 != 3) || (y % 64 == 63 && (x % 64) / 8 != 5) || rng() % 100 < 8;
+            tile_grid_set_cost(&grid, x, y, wall ? -1 : 1);
+        }
+    }
+
+    TileHpa hpa = {};
+    u64 t = TimeUtil::now();
+    tile_hpa_build(&hpa, &grid, TILE_HPA_CLUSTER);
+    double build_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    // 路径必须首尾正确 每步走到相邻的可通行格
+    auto valid = [&](Array<TilePoint>& path, i32 sx, i32 sy, i32 ex, i32 ey) {
+        if (path.len == 0 || path[0].x != sx || path[0].y != sy || path[path.len - 1].x != ex || path[path.len - 1].y != ey) return false;
+        for (u64 i = 1; i < path.len; i++) {
+            float dx = fabsf(path[i].x - path[i - 1].x), dy = fabsf(path[i].y - path[i - 1].y);
+            if (dx > 1 || dy > 1 || dx + dy == 0 || tile_grid_get_cost(&grid, (i32)path[i].x, (i32)path[i].y) <= 0) return false;
+        }
+        return true;
+    };
+
+    bool ok = true;
+    double flat_ms = 0, hpa_ms = 0, flat_cost = 0, hpa_cost = 0;
+    u64 flat_expanded = 0, hpa_expanded = 0;
+    Array<TilePoint> path = {};
+    for (int n = 0; n < QUERIES;) {
+        // 从左上角到右下角的长距离查询
+        i32 sx = rng() % 256, sy = rng() % 256, ex = W - 1 - rng() % 256, ey = H - 1 - rng() % 256;
+        if (tile_grid_get_cost(&grid, sx, sy) <= 0 || tile_grid_get_cost(&grid, ex, ey) <= 0) continue;
+        n++;
+
+        t = TimeUtil::now();
+        bool flat_found = tile_grid_find_path(&grid, sx, sy, ex, ey, TileGridMode_AStar, &path);
+        flat_ms += TimeUtil::to_milliseconds(TimeUtil::since(t));
+        flat_expanded += grid.search.stats.expanded;
+        float optimal = tile_path_cost(path);
+
+        t = TimeUtil::now();
+        bool hpa_found = tile_hpa_find_path(&hpa, &grid, sx, sy, ex, ey, &path);
+        hpa_ms += TimeUtil::to_milliseconds(TimeUtil::since(t));
+        hpa_expanded += hpa.stats.expanded;
+
+        ok &= flat_found == hpa_found;
+        if (flat_found && hpa_found) {
+            ok &= valid(path, sx, sy, ex, ey) && tile_path_cost(path) >= optimal - 0.01f;
+            flat_cost += optimal;
+            hpa_cost += tile_path_cost(path);
+        }
+    }
+
+    // 改动两个格子 只重建所在的簇与边界
+    t = TimeUtil::now();
+    tile_hpa_set_cost(&hpa, &grid, 1000, 1000, -1);
+    tile_hpa_set_cost(&hpa, &grid, 1023, 1000, -1);
+    tile_hpa_update(&hpa, &grid);
+    double update_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+    ok &= hpa.stats.rebuilt_clusters <= 2;
+
+    // 堵死的格子之后的查询与平面 A* 一致
+    i32 sx = 1000, sy = 1001, ex = 1010, ey = 1040;
+    if (tile_grid_get_cost(&grid, sx, sy) > 0 && tile_grid_get_cost(&grid, ex, ey) > 0) {
+        bool flat_found = tile_grid_find_path(&grid, sx, sy, ex, ey, TileGridMode_AStar, &path);
+        ok &= tile_hpa_find_path(&hpa, &grid, sx, sy, ex, ey, &path) == flat_found && (!flat_found || valid(path, sx, sy, ex, ey));
+    }
+
+    std::cout << "hpa " << W << "x" << H << ": build " << build_ms << " ms (" << hpa.stats.nodes << " nodes), flat astar " << flat_ms / QUERIES << " ms/query (" << flat_expanded / QUERIES
+              << " expanded), hpa " << hpa_ms / QUERIES << " ms/query (" << hpa_expanded / QUERIES << " expanded), cost ratio " << (flat_cost > 0 ? hpa_cost / flat_cost : 0) << ", update "
+              << update_ms << " ms (" << hpa.stats.rebuilt_clusters << " clusters)" << std::endl;
+    std::cout << "hpa path: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    path.trash();
+    tile_hpa_trash(&hpa);
+    tile_grid_trash(&grid);
+    return ok ? 0 : 1;
+}
+
+// 5000 个单位走向同一个目标 比较逐个 JPS 查询与一次流场 (作业线程构建) 加每个单位 O(1) 采样
+int Test_FlowField() {
+    constexpr i32 W = 256, H = 256;
+    constexpr int AGENTS = 5000;
+
+    PathService& ps = the<PathService>();
+    ps.path_flush();
+
+    // 房间地图 另有 10% 随机障碍 (部分单位被围住 不可达)
+    TileGrid grid = {};
+    tile_grid_init(&grid, 0, 0, W, H);
+    std::mt19937 rng(42);
+    for (i32 y = 0; y < H; y++) {
+        for (i32 x = 0; x < W; x++) {
+            bool wall = (x % 32 == 31 && (y % 32) / 4 != 3) || (y % 32 == 31 && (x % 32) / 4 != 5) || rng() % 100 < 10;
+            tile_grid_set_cost(&grid, x, y, wall ? -1.0f : 1.0f);
+        }
+    }
+    i32 gx = W / 2 + 1, gy = H / 2 + 1;
+    tile_grid_set_cost(&grid, gx, gy, 1.0f);
+    TileGridSnapshot* snapshot = tile_grid_snapshot(&grid, 16);
+
+    Array<i32> agents = {};
+    while (agents.len < AGENTS * 2) {
+        i32 x = rng() % W, y = rng() % H;
+        if (tile_grid_get_cost(&grid, x, y) <= 0) continue;
+        agents.push(x);
+        agents.push(y);
+    }
+
+    // 逐个查询
+    Array<float> costs = {};
+    Array<TilePoint> path = {};
+    u64 t = TimeUtil::now();
+    for (int i = 0; i < AGENTS; i++) {
+        bool found = tile_grid_find_path(&grid, agents[i * 2], agents[i * 2 + 1], gx, gy, TileGridMode_JPS, &path);
+        costs.push(found ? tile_path_cost(path) : -1.0f);
+    }
+    double astar_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    // 流场在作业线程上构建 于同步点交付
+    t = TimeUtil::now();
+    PathFlowId id = ps.flow_create();
+    bool ok = ps.flow_set_goal(id, snapshot, gx, gy);
+    ok &= ps.flow_field(id) == nullptr;  // 交付前没有场
+    ps.path_flush();
+    double build_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    f32 cell_size = 0;
+    const TileFlowField* flow = ps.flow_field(id, &cell_size);
+    ok &= flow != nullptr && cell_size == 16 && flow->gx == gx && flow->gy == gy;
+    if (flow == nullptr) {
+        std::cout << "flow field: FAILED" << std::endl;
+        return 1;
+    }
+
+    // 每个单位采样一次下一步
+    i32 dx = 0, dy = 0, sum = 0;
+    t = TimeUtil::now();
+    for (int i = 0; i < AGENTS; i++) {
+        if (tile_flow_sample(flow, agents[i * 2], agents[i * 2 + 1], &dx, &dy)) sum += dx + dy;
+    }
+    double sample_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+    // 积分场等于最短路径代价 沿方向场一定走到目标
+    int unreachable = 0;
+    for (int i = 0; i < AGENTS; i++) {
+        float cost = tile_flow_cost(flow, agents[i * 2], agents[i * 2 + 1]);
+        unreachable += cost < 0;
+        ok &= (cost < 0) == (costs[i] < 0);
+        if (cost < 0) continue;
+        ok &= fabsf(cost - costs[i]) < 0.01f + costs[i] * 1e-4f;
+
+        if (i % 50 == 0) {
+            i32 x = agents[i * 2], y = agents[i * 2 + 1];
+            float walked = 0;
+            for (int step = 0; step < W * H && tile_flow_sample(flow, x, y, &dx, &dy); step++) {
+                x += dx;
+                y += dy;
+                walked += dx != 0 && dy != 0 ? 1.4142135f : 1.0f;
+            }
+            ok &= x == gx && y == gy && fabsf(walked - cost) < 0.01f + cost * 1e-4f;
+        }
+    }
+
+    // 与在主线程上构建的场逐格一致
+    TileFlowField expect = {};
+    TileGridSearch search = {};
+    tile_flow_build(&expect, &grid, &search, gx, gy);
+    ok &= memcmp(expect.integration.data, flow->integration.data, sizeof(float) * W * H) == 0;
+    ok &= memcmp(expect.dir.data, flow->dir.data, W * H) == 0;
+
+    // 构建期间连续改目标 只保留最后一个
+    ps.flow_set_goal(id, snapshot, 5, 5);
+    ps.flow_set_goal(id, snapshot, 40, 40);
+    ps.flow_set_goal(id, snapshot, gx, gy - 2);
+    ps.path_flush();
+    flow = ps.flow_field(id);
+    ok &= flow != nullptr && flow->gx == gx && flow->gy == gy - 2;
+
+    ps.flow_destroy(id);
+    ok &= ps.flow_field(id) == nullptr && !ps.flow_set_goal(id, snapshot, gx, gy);
+
+    std::cout << "flow field " << W << "x" << H << ", " << AGENTS << " agents (" << unreachable << " unreachable): per-agent jps " << astar_ms << " ms, flow build " << build_ms
+              << " ms + sampling " << sample_ms << " ms (" << sum << ")" << std::endl;
+    std::cout << "flow field: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    tile_flow_trash(&expect);
+    tile_grid_search_trash(&search);
+    path.trash();
+    costs.trash();
+    agents.trash();
+    tile_grid_snapshot_release(snapshot);
+    tile_grid_trash(&grid);
+    return ok ? 0 : 1;
+}
+
+// 256x256 的洞穴图层 比较矩形与轮廓两种静态碰撞的 body/fixture/宽相代理数 以及 b2World::Step 耗时
+int Test_TileCollision() {
+    constexpr i32 W = 256, H = 256;
+    constexpr float GRID = 16, METER = 16;
+    constexpr int BALLS = 500, STEPS = 120;
+
+    // 元胞自动机生成洞穴 四周为墙
+    std::mt19937 rng(43);
+    Array<TilemapInt> cells = {};
+    cells.resize(W * H);
+    for (u64 i = 0; i < cells.len; i++) cells[i] = rng() % 100 < 45;
+    for (int iteration = 0; iteration < 4; iteration++) {
+        Array<TilemapInt> next = {};
+        next.resize(W * H);
+        for (i32 y = 0; y < H; y++) {
+            for (i32 x = 0; x < W; x++) {
+                int n = 0;
+                for (i32 dy = -1; dy <= 1; dy++) {
+                    for (i32 dx = -1; dx <= 1; dx++) {
+                        i32 nx = x + dx, ny = y + dy;
+                        n += nx < 0 || ny < 0 || nx >= W || ny >= H ? 1 : cells[ny * W + nx];
+                    }
+                }
+                next[y * W + x] = n >= 5 || x == 0 || y == 0 || x == W - 1 || y == H - 1;
+            }
+        }
+        cells.trash();
+        cells = next;
+    }
+
+    // 轮廓围成的面积等于实心格子数 总长度等于实心与空格之间的边数
+    bool ok = true;
+    {
+        Array<u8> solid = {};
+        solid.resize(W * H);
+        i32 count = 0, perimeter = 0;
+        for (i32 y = 0; y < H; y++) {
+            for (i32 x = 0; x < W; x++) {
+                solid[y * W + x] = cells[y * W + x];
+                if (!cells[y * W + x]) continue;
+                count++;
+                perimeter += (y == 0 || !cells[(y - 1) * W + x]) + (x == W - 1 || !cells[y * W + x + 1]) + (y == H - 1 || !cells[(y + 1) * W + x]) + (x == 0 || !cells[y * W + x - 1]);
+            }
+        }
+
+        TileContours contours = {};
+        tile_contours_build(&contours, solid.data, W, H);
+        double area = 0, length = 0;
+        u32 begin = 0;
+        for (u32 end : contours.ends) {
+            ok &= end - begin >= 4;
+            for (u32 i = begin; i < end; i++) {
+                TilePoint p = contours.points[i], q = contours.points[i + 1 < end ? i + 1 : begin];
+                ok &= p.x == q.x || p.y == q.y;
+                area += p.x * q.y - q.x * p.y;
+                length += fabsf(q.x - p.x) + fabsf(q.y - p.y);
+            }
+            begin = end;
+        }
+        ok &= area / 2 == count && length == perimeter;
+        tile_contours_trash(&contours);
+        solid.trash();
+    }
+
+    Array<TilemapLayer> layers = {};
+    TilemapLayer layer = {};
+    layer.identifier = "Collision";
+    layer.c_width = W;
+    layer.c_height = H;
+    layer.int_grid = Slice<TilemapInt>(cells);
+    layer.grid_size = GRID;
+    layers.push(layer);
+
+    Array<TilemapLevel> levels = {};
+    TilemapLevel level = {};
+    level.layers = Slice<TilemapLayer>(layers);
+    levels.push(level);
+
+    MapLdtk tm = {};
+    tm.levels = Slice<TilemapLevel>(levels);
+
+    Array<TilemapInt> walls = {};
+    walls.push(1);
+
+    const char* names[] = {"chains", "boxes"};
+    for (int mode = TileCollision_Chains; mode <= TileCollision_Boxes; mode++) {
+        b2World world(b2Vec2(0, 10));
+
+        u64 t = TimeUtil::now();
+        tm.make_collision(&world, METER, "Collision", Slice<TilemapInt>(walls), (TileCollisionMode)mode);
+        double build_ms = TimeUtil::to_milliseconds(TimeUtil::since(t));
+
+        b2Body* body = *tm.bodies.get("Collision"_hash);
+        i32 bodies = world.GetBodyCount();
+        i32 fixtures = 0, proxies = 0;
+        for (b2Fixture* f = body->GetFixtureList(); f != nullptr; f = f->GetNext()) {
+            fixtures++;
+            proxies += f->GetShape()->GetChildCount();
+        }
+
+        // 两种方式使用相同的小球
+        std::mt19937 spawn(44);
+        Array<b2Body*> balls = {};
+        while (balls.len < BALLS) {
+            i32 x = spawn() % W, y = spawn() % H;
+            if (cells[y * W + x]) continue;
+
+            b2BodyDef def = {};
+            def.type = b2_dynamicBody;
+            def.position.Set((x + 0.5f) * GRID / METER, (y + 0.5f) * GRID / METER);
+            b2Body* ball = world.CreateBody(&def);
+
+            b2CircleShape circle = {};
+            circle.m_radius = 0.4f * GRID / METER;
+            ball->CreateFixture(&circle, 1.0f);
+            balls.push(ball);
+        }
+
+        t = TimeUtil::now();
+        for (int i = 0; i < STEPS; i++) world.Step(1.0f / 60.0f, 8, 3);
+        double step_ms = TimeUtil::to_milliseconds(TimeUtil::since(t)) / STEPS;
+
+        // 小球不能穿过墙 也不能停在实心格子里
+        int escaped = 0;
+        for (b2Body* ball : balls) {
+            b2Vec2 p = ball->GetPosition();
+            i32 x = (i32)floorf(p.x * METER / GRID), y = (i32)floorf(p.y * METER / GRID);
+            escaped += x < 0 || y < 0 || x >= W || y >= H || cells[y * W + x];
+        }
+        ok &= escaped == 0;
+
+        std::cout << "tile collision " << W << "x" << H << " " << names[mode] << ": build " << build_ms << " ms, " << bodies - BALLS << " static bodies, " << fixtures << " fixtures, " << proxies
+                  << " proxies, step " << step_ms << " ms (" << BALLS << " balls, " << escaped << " escaped)" << std::endl;
+
+        balls.trash();
+        tm.bodies.trash();
+        tm.bodies = {};
+    }
+
+    std::cout << "tile collision: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    tm.trash();
+    walls.trash();
+    levels.trash();
+    layers.trash();
+    cells.trash();
+    return ok ? 0 : 1;
+}
@@ -5,6 +5,7 @@
 #include "engine/scripting/lua_util.h"
 
 int game_set_window_vsync(bool vsync) {
+    if (gfx_backend() == GfxBackend_Null) return 0;
     glfwSwapInterval(vsync);
     return 0;
 }
@@ -76,7 +77,10 @@ double Window::Scale() {
 
 void Window::SetFramebufferSizeCallback(GLFWframebuffersizefun func) { glfwSetFramebufferSizeCallback(window, func); }
 
-void Window::SwapBuffer() { glfwSwapBuffers(window); }
+void Window::SwapBuffer() {
+    if (gfx_backend() == GfxBackend_Null) return;
+    glfwSwapBuffers(window);
+}
 
 int wrap_window_clipboard(lua_State *L) {
     const_str v = the<Window>().GetClipboard();
@@ -131,6 +135,14 @@ void Window::init() {
 void Window::create() {
     PROFILE_FUNC();
 
+    // 空后端 不可见且没有 GL 上下文的窗口 只用于输入与尺寸
+    if (gfx_backend() == GfxBackend_Null) {
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(800, 600, "neko_game", NULL, NULL);
+        return;
+    }
+
     // create glfw window
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
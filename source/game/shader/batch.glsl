@@ -7,7 +7,11 @@ layout(location=0) in vec2 a_position;
 layout(location=1) in vec2 a_texindex;
 
 out vec2 v_texindex;
-uniform mat3 inverse_view_matrix;
+layout(std140) uniform NekoFrame {
+    mat3 inverse_view_matrix;
+    vec2 NekoScreenSize;
+    float NekoTime;
+};
 uniform float scale;
 
 void main() {
@@ -62,7 +62,11 @@ in vec2 bbmin_[];
 in vec2 bbmax_[];
 in float selected_[];
 
-uniform mat3 inverse_view_matrix;
+layout(std140) uniform NekoFrame {
+    mat3 inverse_view_matrix;
+    vec2 NekoScreenSize;
+    float NekoTime;
+};
 uniform float aspect;
 
 out float selected;
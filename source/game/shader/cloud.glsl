@@ -6,7 +6,11 @@ layout(location=0) in vec2 a_position;
 layout(location=1) in vec2 a_texindex;
 
 out vec2 v_texindex;
-uniform mat3 inverse_view_matrix;
+layout(std140) uniform NekoFrame {
+    mat3 inverse_view_matrix;
+    vec2 NekoScreenSize;
+    float NekoTime;
+};
 
 void main() {
     vec2 position = a_position * 1.0; // 应用缩放因子
@@ -22,10 +26,15 @@ void main() {
 
 in vec2 v_texindex;
 
-uniform float u_time;
+#define u_time (NekoTime / 8.0)
 uniform vec3 light_pos = vec3(0.0, 0.0, 0.0);
 
-uniform mat3 inverse_view_matrix;
+layout(std140) uniform NekoFrame {
+    mat3 inverse_view_matrix;
+    vec2 NekoScreenSize;
+    float NekoTime;
+};
+
 uniform vec3 u_groundColor = vec3(0.1, 0.1, 0.1);
 
 uniform float u_morph_time = 200.0;
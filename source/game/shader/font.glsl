@@ -7,8 +7,11 @@ layout (location = 1) in vec2 inTexCoord;
 
 out vec2 TexCoord;
 
-uniform mat3 inverse_view_matrix;
-uniform mat4 u_mvp;
+layout(std140) uniform NekoFrame {
+    mat3 inverse_view_matrix;
+    vec2 NekoScreenSize;
+    float NekoTime;
+};
 uniform int mode;
 
 void main() {
@@ -19,8 +22,8 @@ void main() {
         gl_Position = vec4(transformed_position.xy, 0.0, 1.0);
     } else {
         vec2 position = inPos * 1.0; // 应用缩放因子
-        vec4 transformed_position = u_mvp * vec4(position, 1.0, 1.0);
-        gl_Position = vec4(transformed_position.xy, 0.0, 1.0);
+        // 屏幕像素坐标 左上角为原点
+        gl_Position = vec4(position.x / NekoScreenSize.x * 2.0 - 1.0, 1.0 - position.y / NekoScreenSize.y * 2.0, 0.0, 1.0);
     }
     TexCoord = inTexCoord;
 }
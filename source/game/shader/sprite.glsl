@@ -3,9 +3,8 @@
 
 #version 150
 
-in vec3 wmat1; // columns 1, 2, 3 of transform matrix
-in vec3 wmat2;
-in vec3 wmat3;
+in vec4 wmat_xy; // columns 1, 2 of transform matrix (x, y only)
+in vec2 wmat_t;  // translation
 in vec2 size;
 in vec2 texcell;
 in vec2 texsize;
@@ -17,7 +16,7 @@ out vec2 texsize_;
 
 void main()
 {
-    wmat = mat3(wmat1, wmat2, wmat3);
+    wmat = mat3(vec3(wmat_xy.xy, 0.0), vec3(wmat_xy.zw, 0.0), vec3(wmat_t, 1.0));
     size_ = size;
     texcell_ = texcell;
     texsize_ = texsize;
@@ -60,7 +59,11 @@ in vec2 texsize_[];
 
 out vec2 texcoord;
 
-uniform mat3 inverse_view_matrix;
+layout(std140) uniform NekoFrame {
+    mat3 inverse_view_matrix;
+    vec2 NekoScreenSize;
+    float NekoTime;
+};
 
 uniform vec2 atlas_size;
 
@@ -52,16 +52,18 @@ in VS_OUT {
 
 struct light {
 	vec2 position;
-	float intensity;
 	float range;
+	float intensity;
 };
 
 uniform sampler2D textures[32];
 
 uniform float ambient_light;
 
-uniform light lights[100];
-uniform int light_count;
+layout(std140) uniform NekoLights {
+	light lights[100];
+	int light_count;
+};
 
 void main() {
 	vec4 texture_color = vec4(1.0);